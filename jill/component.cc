@@ -0,0 +1,274 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <boost/bind.hpp>
+#include "component.hh"
+#include "jack_client.hh"
+#include "offline_client.hh"
+#include "logging.hh"
+#include "util/string.hh"
+
+using namespace jill;
+using std::string;
+
+component_host::component_host(jack_client & client)
+        : _client(client), _jack(&client), _offline(0), _current_config(0), _active(false)
+{}
+
+component_host::component_host(offline_client & client)
+        : _client(client), _jack(0), _offline(&client), _current_config(0), _active(false)
+{}
+
+component_host::~component_host()
+{
+        if (_active) deactivate();
+}
+
+void
+component_host::add(string const & name, boost::shared_ptr<component> comp,
+                    component::config_type const & config)
+{
+        if (_active)
+                throw Error("can't add components after the host is activated");
+        for (std::vector<entry_t>::const_iterator it = _components.begin(); it != _components.end(); ++it) {
+                if (it->name == name)
+                        throw Error(util::make_string() << "component " << name << " already exists");
+        }
+        _current = name;
+        _current_config = &config;
+        comp->setup(*this, config);
+        _current_config = 0;
+
+        entry_t e = { name, comp };
+        _components.push_back(e);
+        LOG << "added component: " << name;
+}
+
+namespace {
+
+/** the name of a component's port in the JACK graph */
+string
+full_name(string const & instance, string const & name)
+{
+        return instance.empty() ? name : instance + "_" + name;
+}
+
+}
+
+component_host::port_id
+component_host::input(string const & name, dtype_t dtype, unsigned long flags)
+{
+        if (_current_config == 0)
+                throw Error("ports can only be declared during component setup");
+        string source;
+        component::config_type::const_iterator it = _current_config->find(name);
+        if (it != _current_config->end()) source = it->second;
+
+        port_t p = { 0, full_name(_current, name), dtype, false, 0 };
+        std::map<string, port_id>::const_iterator out = _outputs.find(source);
+        if (out != _outputs.end()) {
+                // share the buffer of an earlier component's output
+                port_t const & src = _ports[out->second];
+                if (src.dtype != dtype)
+                        throw Error(util::make_string() << "type of " << source
+                                    << " doesn't match input " << _current << "." << name);
+                p.port = src.port;
+                p.name = src.name;
+                p.index = src.index;
+                LOG << "internal connection: " << source << " -> " << _current << "." << name;
+        }
+        else if (_offline) {
+                try {
+                        p.index = _offline->port_index(p.name);
+                }
+                catch (Error const &) {
+                        if (dtype == SAMPLED)
+                                p.index = _offline->add_input(p.name, 0, 0);
+                        else
+                                p.index = _offline->add_event_input(p.name, std::vector<offline_client::event_t>());
+                }
+        }
+        else {
+                char const * type = (dtype == SAMPLED) ? JACK_DEFAULT_AUDIO_TYPE : JACK_DEFAULT_MIDI_TYPE;
+                p.port = _jack->register_port(p.name, type, JackPortIsInput | flags, 0);
+                p.index = _client.port_index(p.name);
+                if (!source.empty())
+                        _connections.push_back(std::make_pair(source, p.name));
+        }
+        _ports.push_back(p);
+        return _ports.size() - 1;
+}
+
+component_host::port_id
+component_host::output(string const & name, dtype_t dtype, unsigned long flags)
+{
+        if (_current_config == 0)
+                throw Error("ports can only be declared during component setup");
+        port_t p = { 0, full_name(_current, name), dtype, true, 0 };
+        if (_offline) {
+                p.index = (dtype == SAMPLED) ? _offline->add_output(p.name) : _offline->add_event_output(p.name);
+        }
+        else {
+                char const * type = (dtype == SAMPLED) ? JACK_DEFAULT_AUDIO_TYPE : JACK_DEFAULT_MIDI_TYPE;
+                p.port = _jack->register_port(p.name, type, JackPortIsOutput | flags, 0);
+                p.index = _client.port_index(p.name);
+        }
+        _ports.push_back(p);
+        port_id id = _ports.size() - 1;
+        _outputs[_current + "." + name] = id;
+        return id;
+}
+
+void
+component_host::activate()
+{
+        if (_offline) {
+                _offline->set_process_callback(boost::bind(&component_host::process, this, _1, _2, _3));
+                _offline->set_sample_rate_callback(boost::bind(&component_host::sampling_rate_changed, this, _1, _2));
+                _offline->set_buffer_size_callback(boost::bind(&component_host::buffer_size_changed, this, _1, _2));
+                _active = true;
+        }
+        else {
+                _jack->set_process_callback(boost::bind(&component_host::process, this, _1, _2, _3));
+                _jack->set_sample_rate_callback(boost::bind(&component_host::sampling_rate_changed, this, _1, _2));
+                _jack->set_buffer_size_callback(boost::bind(&component_host::buffer_size_changed, this, _1, _2));
+                _jack->set_xrun_callback(boost::bind(&component_host::xrun, this, _1, _2));
+                _jack->activate();
+                _active = true;
+                std::vector<std::pair<string, string> >::const_iterator it;
+                for (it = _connections.begin(); it != _connections.end(); ++it)
+                        _jack->connect_port(it->first, it->second);
+        }
+        for (std::vector<entry_t>::iterator c = _components.begin(); c != _components.end(); ++c)
+                c->comp->start();
+}
+
+void
+component_host::deactivate()
+{
+        for (std::vector<entry_t>::iterator c = _components.begin(); c != _components.end(); ++c)
+                c->comp->stop();
+        if (_offline)
+                _offline->set_process_callback(offline_client::ProcessCallback());
+        else
+                _jack->deactivate();
+        _active = false;
+}
+
+nframes_t
+component_host::buffer_size() const
+{
+        return _client.buffer_size();
+}
+
+component_host::port_id
+component_host::port_index(string const & name) const
+{
+        for (port_id i = 0; i < _ports.size(); ++i) {
+                if (_ports[i].name == name) return i;
+        }
+        throw Error(util::make_string() << "the port " << name << " does not exist");
+}
+
+sample_t *
+component_host::port_samples(port_id port, nframes_t nframes)
+{
+        return _client.port_samples(_ports[port].index, nframes);
+}
+
+std::size_t
+component_host::nevents(port_id port)
+{
+        return _client.nevents(_ports[port].index);
+}
+
+component_host::event_ref_t
+component_host::event(port_id port, std::size_t index)
+{
+        return _client.event(_ports[port].index, index);
+}
+
+int
+component_host::write_event(port_id port, nframes_t time, void const * data, std::size_t size)
+{
+        return _client.write_event(_ports[port].index, time, data, size);
+}
+
+int
+component_host::process(process_client *, nframes_t nframes, nframes_t time)
+{
+        // the client has already fetched the buffers and cleared the event
+        // outputs; inputs fed by an earlier output share its index
+        for (std::vector<entry_t>::iterator c = _components.begin(); c != _components.end(); ++c) {
+                int ret = c->comp->process(*this, nframes, time);
+                if (ret != 0) return ret;
+        }
+        return 0;
+}
+
+int
+component_host::buffer_size_changed(process_client *, nframes_t nframes)
+{
+        for (std::vector<entry_t>::iterator c = _components.begin(); c != _components.end(); ++c)
+                c->comp->buffer_size(*this, nframes);
+        return 0;
+}
+
+int
+component_host::sampling_rate_changed(process_client *, nframes_t rate)
+{
+        for (std::vector<entry_t>::iterator c = _components.begin(); c != _components.end(); ++c)
+                c->comp->sampling_rate(*this, rate);
+        return 0;
+}
+
+int
+component_host::xrun(jack_client *, float usec_delay)
+{
+        for (std::vector<entry_t>::iterator c = _components.begin(); c != _components.end(); ++c)
+                c->comp->xrun(*this, usec_delay);
+        return 0;
+}
+
+char const *
+component_host::name() const
+{
+        return _client.name();
+}
+
+nframes_t
+component_host::sampling_rate() const
+{
+        return _client.sampling_rate();
+}
+
+nframes_t
+component_host::frame() const
+{
+        return _client.frame();
+}
+
+nframes_t
+component_host::frame(utime_t usec) const
+{
+        return _client.frame(usec);
+}
+
+utime_t
+component_host::time(nframes_t frame) const
+{
+        return _client.time(frame);
+}
+
+utime_t
+component_host::time() const
+{
+        return _client.time();
+}
@@ -0,0 +1,206 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _COMPONENT_HH
+#define _COMPONENT_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <jack/jack.h>
+#include "process_client.hh"
+
+namespace jill {
+
+class offline_client;
+class component_host;
+
+/**
+ * @ingroup clientgroup
+ * @brief A processing stage that shares a JACK client with other stages
+ *
+ * Components are run by a component_host, which calls their process()
+ * functions in order within a single process callback. A component gets its
+ * buffers from the host, and an input may be fed directly from the output of
+ * an earlier component in the same period, without a trip through the JACK
+ * graph.
+ *
+ * The filter, detector, and recorder used by jhost and by the standalone
+ * modules are in jill/components.
+ */
+class component : boost::noncopyable {
+
+public:
+        typedef std::map<std::string, std::string> config_type;
+
+        virtual ~component() {}
+
+        /**
+         * Declare ports with component_host::input() and output(), and
+         * allocate any state. Called once, before the client is activated.
+         *
+         * @param host    the host running the component
+         * @param config  settings for the component (from the host's config file)
+         */
+        virtual void setup(component_host & host, config_type const & config) = 0;
+
+        /**
+         * Process one period. Must be realtime safe.
+         *
+         * @return 0 if no errors, non-zero on error
+         */
+        virtual int process(component_host & host, nframes_t nframes, nframes_t time) = 0;
+
+        /** Called after the client has been activated */
+        virtual void start() {}
+
+        /** Called before the client is deactivated; may block until the component is done */
+        virtual void stop() {}
+
+        /** Called when the period size changes */
+        virtual void buffer_size(component_host & host, nframes_t nframes) {}
+
+        /** Called when the sampling rate changes */
+        virtual void sampling_rate(component_host & host, nframes_t rate) {}
+
+        /** Called after an xrun */
+        virtual void xrun(component_host & host, float usec_delay) {}
+};
+
+
+/**
+ * @ingroup clientgroup
+ * @brief Runs a chain of components in a single jack_client or offline_client
+ *
+ * Ports are named instance_port in JACK, or just port if the instance name is
+ * empty (as in the standalone modules, which run a single component). A
+ * component's input is taken from an earlier component's output if its source
+ * (set in the component's config under the name of the port) has the form
+ * instance.port; otherwise a JACK input port is registered and connected to
+ * the source after activation. Outputs are always registered as JACK ports,
+ * so they can also be used by other clients.
+ *
+ * The host implements process_client for the components, with ports
+ * numbered in order of declaration. The calls are forwarded to the client's
+ * port table, which already holds the buffers for the current period, so
+ * the host adds no per-port work to the process callback. It takes over the
+ * client's process, sampling rate, buffer size, and xrun callbacks when it's
+ * activated.
+ *
+ * In an offline_client, inputs that aren't fed by another component use the
+ * client's port of the same name, if it was added before the component, and
+ * are otherwise added as empty (silent) inputs; outputs are added as client
+ * outputs, so results can be read with offline_client::output(). There are
+ * no connections or port flags, and activate() only installs the callbacks
+ * and starts the components; run the client to process data.
+ */
+class component_host : public process_client {
+
+public:
+        component_host(jack_client & client);
+        component_host(offline_client & client);
+        ~component_host();
+
+        /**
+         * Add a component to the end of the chain and call its setup function.
+         *
+         * @param name    the name of the instance, used to name ports
+         * @param comp    the component
+         * @param config  settings for the component, including input sources
+         */
+        void add(std::string const & name, boost::shared_ptr<component> comp,
+                 component::config_type const & config);
+
+        /**
+         * Declare an input port for the component being set up
+         *
+         * @param name   the name of the port (without the instance)
+         * @param dtype  SAMPLED or EVENT
+         * @param flags  additional JACK port flags (e.g. JackPortIsTerminal)
+         */
+        port_id input(std::string const & name, dtype_t dtype, unsigned long flags=0);
+
+        /** Declare an output port for the component being set up */
+        port_id output(std::string const & name, dtype_t dtype, unsigned long flags=0);
+
+        /** Install callbacks, activate the client, make connections, and start the components */
+        void activate();
+
+        /** Stop the components and deactivate the client */
+        void deactivate();
+
+        /* Implementations of process_client functions */
+        nframes_t buffer_size() const;
+        port_id port_index(std::string const & name) const;
+        sample_t * port_samples(port_id port, nframes_t nframes);
+        std::size_t nevents(port_id port);
+        event_ref_t event(port_id port, std::size_t index);
+        int write_event(port_id port, nframes_t time, void const * data, std::size_t size);
+
+        /** The short name of a port (the name in the JACK graph, without the client) */
+        std::string const & port_name(port_id port) const { return _ports[port].name; }
+
+        /** The type of data carried by a port */
+        dtype_t port_type(port_id port) const { return _ports[port].dtype; }
+
+        /** The JACK port holding a port's buffer, or 0 in an offline client */
+        jack_port_t * port(port_id port) const { return _ports[port].port; }
+
+        process_client & client() { return _client; }
+
+        /** The JACK client running the host, or 0 if it's running offline */
+        jack_client * jack() { return _jack; }
+
+        /* Implementations of data_source functions; these use the client */
+        char const * name() const;
+        nframes_t sampling_rate() const;
+        nframes_t frame() const;
+        nframes_t frame(utime_t) const;
+        utime_t time(nframes_t) const;
+        utime_t time() const;
+
+private:
+        struct port_t {
+                jack_port_t * port;     // the port holding the buffer
+                std::string name;
+                dtype_t dtype;
+                bool is_output;
+                port_id index;          // index of the port in the client
+        };
+
+        struct entry_t {
+                std::string name;
+                boost::shared_ptr<component> comp;
+        };
+
+        int process(process_client *, nframes_t nframes, nframes_t time);
+        int buffer_size_changed(process_client *, nframes_t nframes);
+        int sampling_rate_changed(process_client *, nframes_t rate);
+        int xrun(jack_client *, float usec_delay);
+
+        process_client & _client;
+        jack_client * _jack;
+        offline_client * _offline;
+        std::vector<entry_t> _components;
+        std::vector<port_t> _ports;
+        std::map<std::string, port_id> _outputs;                // by instance.port
+        std::vector<std::pair<std::string, std::string> > _connections; // made after activation
+
+        /* state for the component being set up */
+        std::string _current;
+        component::config_type const * _current_config;
+        bool _active;
+};
+
+} // namespace jill
+
+#endif
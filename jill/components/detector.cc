@@ -0,0 +1,269 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <stdexcept>
+#include <unistd.h>
+#include <boost/bind.hpp>
+
+#include "detector.hh"
+#include "../logging.hh"
+#include "../dsp/crossing_trigger_bank.hh"
+#include "../dsp/spectral_trigger_bank.hh"
+
+using namespace jill;
+using namespace jill::components;
+using std::string;
+
+crossing_options::crossing_options()
+        : open_threshold(0.01), close_threshold(0.01),
+          open_crossing_rate(20), close_crossing_rate(2),
+          period_size_ms(20), open_crossing_period_ms(500), close_crossing_period_ms(5000)
+{}
+
+nframes_t
+crossing_options::period_size(nframes_t samplerate) const
+{
+        return period_size_ms * samplerate / 1000;
+}
+
+int
+crossing_options::open_periods() const
+{
+        return open_crossing_period_ms / period_size_ms;
+}
+
+int
+crossing_options::close_periods() const
+{
+        return close_crossing_period_ms / period_size_ms;
+}
+
+int
+crossing_options::open_count_thresh(nframes_t samplerate) const
+{
+        return open_crossing_rate * period_size(samplerate) / 1000 * open_periods();
+}
+
+int
+crossing_options::close_count_thresh(nframes_t samplerate) const
+{
+        return close_crossing_rate * period_size(samplerate) / 1000 * close_periods();
+}
+
+void
+crossing_options::log(nframes_t samplerate) const
+{
+        LOG << "period size: " << period_size_ms << " ms, " << period_size(samplerate) << " samples";
+        LOG << "open threshold: " << open_threshold;
+        LOG << "open count thresh: " << open_count_thresh(samplerate);
+        LOG << "open integration window: " << open_crossing_period_ms << " ms, " << open_periods() << " periods ";
+        LOG << "close threshold: " << close_threshold;
+        LOG << "close count thresh: " << close_count_thresh(samplerate);
+        LOG << "close integration window: " << close_crossing_period_ms << " ms, " << close_periods() << " periods ";
+}
+
+
+detector::options_type::options_type()
+        : chan(0), type("crossing"), open_ratio(6), close_ratio(3), min_power(-60),
+          open_fraction(0.5), close_fraction(0.2), fft_size(0)
+{}
+
+detector::detector(options_type const & options)
+        : _options(options), _host(0), _samplerate(0), _times(1024), _stopping(0)
+{
+        if (_options.inputs.empty())
+                throw std::invalid_argument("detector needs at least one input");
+        if (_options.outputs.size() != 1 && _options.outputs.size() != _options.inputs.size())
+                throw std::invalid_argument("detector needs one output, or one output per input");
+        if (!_options.counts.empty() && _options.counts.size() != _options.inputs.size())
+                throw std::invalid_argument("detector needs one count port per input");
+        if (_options.outputs.size() == 1 && _options.inputs.size() > 128)
+                throw std::invalid_argument("more than 128 inputs require an output per input");
+        if (_options.type != "crossing" && _options.type != "spectral")
+                throw std::invalid_argument("unknown detector type: " + _options.type);
+        if (_options.type == "spectral" &&
+            (_options.band.size() != 2 || _options.band[0] < 0 || _options.band[1] <= _options.band[0]))
+                throw std::invalid_argument("the spectral detector requires a band (lo, hi), with 0 <= lo < hi");
+}
+
+void
+detector::setup(component_host & host, config_type const & config)
+{
+        _host = &host;
+        std::vector<string>::const_iterator it;
+        for (it = _options.inputs.begin(); it != _options.inputs.end(); ++it)
+                _in.push_back(host.input(*it, SAMPLED));
+        for (it = _options.counts.begin(); it != _options.counts.end(); ++it)
+                _count.push_back(host.output(*it, SAMPLED));
+        for (it = _options.outputs.begin(); it != _options.outputs.end(); ++it)
+                _out.push_back(host.output(*it, EVENT));
+        _in_buffers.resize(_in.size(), 0);
+        _count_buffers.resize(_in.size(), 0);
+        LOG << "inputs: " << _in.size() << ", MIDI outputs: " << _out.size();
+        LOG << "detector: " << _options.type;
+        make_trigger(host.sampling_rate());
+        _events.resize(_trigger->max_events(host.buffer_size()));
+}
+
+/** the periods and the spectral band are converted to frames at samplerate */
+void
+detector::make_trigger(nframes_t samplerate)
+{
+        crossing_options const & c = _options.crossing;
+        nframes_t period_size = c.period_size(samplerate);
+        if (_options.type == "spectral") {
+                dsp::spectral_trigger_bank::params_type p;
+                p.band_lo = _options.band[0];
+                p.band_hi = _options.band[1];
+                p.open_ratio = _options.open_ratio;
+                p.close_ratio = _options.close_ratio;
+                p.min_power = _options.min_power;
+                p.ocount_thresh = _options.open_fraction * c.open_periods();
+                p.owindow_periods = c.open_periods();
+                p.ccount_thresh = _options.close_fraction * c.close_periods();
+                p.cwindow_periods = c.close_periods();
+                p.period_size = period_size;
+                p.fft_size = _options.fft_size;
+                dsp::spectral_trigger_bank * bank =
+                        new dsp::spectral_trigger_bank(_in.size(), samplerate, p);
+                _trigger.reset(bank);
+
+                LOG << "period size: " << c.period_size_ms << " ms, " << period_size << " samples";
+                LOG << "band: " << p.band_lo << "-" << p.band_hi << " Hz, FFT size: " << bank->fft_size();
+                LOG << "minimum band power: " << p.min_power << " dB";
+                LOG << "open ratio: " << p.open_ratio << " dB";
+                LOG << "open count thresh: " << p.ocount_thresh;
+                LOG << "open integration window: " << c.open_crossing_period_ms << " ms, " << c.open_periods() << " periods ";
+                LOG << "close ratio: " << p.close_ratio << " dB";
+                LOG << "close count thresh: " << p.ccount_thresh;
+                LOG << "close integration window: " << c.close_crossing_period_ms << " ms, " << c.close_periods() << " periods ";
+        }
+        else {
+                _trigger.reset(new dsp::crossing_trigger_bank(_in.size(),
+                                                              c.open_threshold,
+                                                              c.open_count_thresh(samplerate),
+                                                              c.open_periods(),
+                                                              c.close_threshold,
+                                                              c.close_count_thresh(samplerate),
+                                                              c.close_periods(),
+                                                              period_size));
+                c.log(samplerate);
+        }
+        _samplerate = samplerate;
+}
+
+/*
+ * The MIDI message for a change in the state of an input. If all the inputs
+ * share one output port, the key number gives the index of the input.
+ */
+void
+detector::make_message(midi::data_type * buf, std::size_t channel, bool open) const
+{
+        buf[0] = (_options.chan & midi::chan_nib) + (open ? midi::note_on : midi::note_off);
+        buf[1] = (_in.size() > 1 && _out.size() == 1) ? channel : midi::default_pitch;
+        buf[2] = midi::default_velocity;
+}
+
+int
+detector::process(component_host & host, nframes_t nframes, nframes_t time)
+{
+        std::size_t const nchannels = _in.size();
+        for (std::size_t c = 0; c < nchannels; ++c) {
+                _in_buffers[c] = host.port_samples(_in[c], nframes);
+                if (!_count.empty())
+                        _count_buffers[c] = host.port_samples(_count[c], nframes);
+        }
+        midi::data_type buf[3];
+
+        if (_stopping) {
+                for (std::size_t c = 0; c < nchannels; ++c) {
+                        if (!_trigger->open(c)) continue;
+                        make_message(buf, c, false);
+                        host.write_event(_out[c % _out.size()], 0, buf, 3);
+                }
+                _trigger->reset();
+                __sync_add_and_fetch(&_stopping, -1);
+                return 0;
+        }
+
+	// Pass samples to the window discriminators. They return the
+	// channels whose state changed and the frame in which their
+	// gates opened or closed, in order of time. This also copies the
+	// current state of the counters to the count monitor ports (if
+	// there are any)
+        std::size_t nevents = _trigger->push(&_in_buffers[0], nframes, &_events[0], _events.size(),
+                                             _count.empty() ? 0 : &_count_buffers[0]);
+        for (std::size_t i = 0; i < nevents; ++i) {
+                dsp::trigger_bank::event_type const & e = _events[i];
+                make_message(buf, e.channel, e.open);
+                event_t event = { time + nframes_t(e.offset), buf[0] & midi::type_nib, e.channel };
+                if (host.write_event(_out[e.channel % _out.size()], e.offset, buf, 3) != 0) {
+                        // indicate error to logger function
+                        event.status = midi::sysex;
+                }
+                _times.push(event);
+        }
+        return 0;
+}
+
+/** there are at most a few events per period */
+void
+detector::buffer_size(component_host & host, nframes_t nframes)
+{
+        if (_trigger) _events.resize(_trigger->max_events(nframes));
+}
+
+/** the trigger bank is rebuilt, so the detector starts over closed */
+void
+detector::sampling_rate(component_host & host, nframes_t rate)
+{
+        if (!_trigger || rate == _samplerate) return;
+        LOG << "sampling rate changed to " << rate << " Hz; rebuilding detector";
+        make_trigger(rate);
+        _events.resize(_trigger->max_events(host.buffer_size()));
+}
+
+void
+detector::stop()
+{
+        if (!_host) return;
+        __sync_add_and_fetch(&_stopping, 1);
+        // wait for at least one process loop
+        usleep(2e6 * _host->buffer_size() / _host->sampling_rate());
+        log_events();
+}
+
+void
+detector::log_events()
+{
+        _times.pop(boost::bind(&detector::log_times, this, _1, _2));
+}
+
+/** visitor function for gate time ringbuffer */
+std::size_t
+detector::log_times(event_t const * events, std::size_t count)
+{
+        event_t const *e;
+        std::size_t i;
+	for (i = 0; i < count; ++i) {
+                e = events+i;
+                log_msg msg;
+                if (e->status==midi::note_on)
+                        msg << "signal on: ";
+                else if (e->status==midi::note_off)
+                        msg << "signal off:";
+                else
+                        msg << "WARNING: detected but couldn't send event: ";
+                if (_in.size() > 1)
+                        msg << " chan=" << e->channel << ",";
+                msg << " frames=" << e->time << ", us=" << _host->time(e->time);
+        }
+        return i;
+}
@@ -0,0 +1,125 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _COMPONENTS_DETECTOR_HH
+#define _COMPONENTS_DETECTOR_HH
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "../component.hh"
+#include "../midi.hh"
+#include "../dsp/ringbuffer.hh"
+#include "../dsp/trigger_bank.hh"
+
+namespace jill { namespace components {
+
+/**
+ * Settings for a crossing detector, in the units of the modules' options.
+ * These are converted to the frame counts used by dsp::crossing_trigger and
+ * dsp::crossing_trigger_bank.
+ */
+struct crossing_options {
+        float open_threshold;           // sample threshold (0-1.0)
+        float close_threshold;
+        float open_crossing_rate;       // s^-1
+        float close_crossing_rate;
+        float period_size_ms;
+        float open_crossing_period_ms;  // integration windows
+        float close_crossing_period_ms;
+
+        crossing_options();
+
+        nframes_t period_size(nframes_t samplerate) const;
+        int open_periods() const;
+        int close_periods() const;
+        int open_count_thresh(nframes_t samplerate) const;
+        int close_count_thresh(nframes_t samplerate) const;
+
+        /** log the settings */
+        void log(nframes_t samplerate) const;
+};
+
+
+/**
+ * @ingroup clientgroup
+ * @brief Detects signals in one or more inputs (see jdetect)
+ *
+ * Each input is monitored by a crossing or spectral trigger bank, and changes
+ * in state are written as MIDI note on and note off messages. The inputs can
+ * share one output, in which case the key number gives the index of the
+ * input, or each input can have its own. When the component is stopped, it
+ * closes any open gates. The times of the changes are stored for
+ * log_events().
+ */
+class detector : public component {
+
+public:
+        struct options_type {
+                std::vector<std::string> inputs;
+                std::vector<std::string> outputs;       // MIDI outputs: one, or one per input
+                std::vector<std::string> counts;        // detector state outputs: none, or one per input
+                midi::data_type chan;                   // MIDI channel of output messages
+                std::string type;                       // crossing or spectral
+                crossing_options crossing;
+
+                /* spectral detector */
+                std::vector<float> band;                // lo, hi (Hz)
+                float open_ratio;                       // dB
+                float close_ratio;
+                float min_power;                        // dB re full scale
+                float open_fraction;                    // of periods in the window
+                float close_fraction;
+                int fft_size;
+
+                options_type();
+        };
+
+        explicit detector(options_type const & options);
+
+        void setup(component_host & host, config_type const & config);
+        int process(component_host & host, nframes_t nframes, nframes_t time);
+        void buffer_size(component_host & host, nframes_t nframes);
+        void sampling_rate(component_host & host, nframes_t rate);
+
+        /** Closes open gates; blocks for a couple of periods */
+        void stop();
+
+        /** Log the state changes since the last call. Not RT safe */
+        void log_events();
+
+private:
+        /* a state change, stored for logging */
+        struct event_t {
+                nframes_t time;
+                int status;
+                std::size_t channel;
+        };
+
+        /* build the trigger bank for a sampling rate */
+        void make_trigger(nframes_t samplerate);
+        void make_message(midi::data_type * buf, std::size_t channel, bool open) const;
+        std::size_t log_times(event_t const * events, std::size_t count);
+
+        options_type _options;
+        component_host * _host;
+        nframes_t _samplerate;                  // the rate the trigger was built for
+        boost::shared_ptr<dsp::trigger_bank> _trigger;
+        std::vector<component_host::port_id> _in, _out, _count;
+        std::vector<sample_t const *> _in_buffers;
+        std::vector<sample_t *> _count_buffers;
+        std::vector<dsp::trigger_bank::event_type> _events;
+        dsp::ringbuffer<event_t> _times;
+        int _stopping;          // set to 1 to get process to clean up
+};
+
+}} // namespace jill::components
+
+#endif
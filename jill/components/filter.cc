@@ -0,0 +1,104 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include <boost/bind.hpp>
+
+#include "filter.hh"
+#include "../jack_client.hh"
+#include "../logging.hh"
+
+using namespace jill;
+using namespace jill::components;
+using std::string;
+
+filter::options_type::options_type()
+        : order(0), type("low-pass"), fft_block(64), fft_uniform(false), nthreads(0), pin(false)
+{}
+
+filter::filter(options_type const & options)
+        : _options(options), _nframes(0)
+{
+        if (_options.inputs.size() != _options.outputs.size())
+                throw std::invalid_argument("filter needs one output per input");
+}
+
+void
+filter::setup(component_host & host, config_type const & config)
+{
+        if (!_options.numerator.empty() && !_options.denominator.empty()) {
+                _filter.set_fft(_options.fft_block, _options.fft_uniform);
+                _filter.set_period(host.buffer_size());
+                _filter.custom_coef(_options.numerator, _options.denominator);
+        }
+        else if (_options.order > 0 && !_options.cutoff.empty()) {
+                _filter.butter(_options.order, _options.cutoff, _options.type, host.sampling_rate());
+        }
+        else {
+                throw std::invalid_argument("filter needs order and cutoff, or numerator and denominator");
+        }
+
+        // allocate filter state before the process callback starts
+        for (std::size_t i = 0; i < _options.inputs.size(); ++i) {
+                _in.push_back(host.input(_options.inputs[i], SAMPLED));
+                _out.push_back(host.output(_options.outputs[i], SAMPLED));
+                _filter.add_channel(host.port_name(_out.back()));
+        }
+        _buffers_in.resize(_in.size(), 0);
+        _buffers_out.resize(_out.size(), 0);
+        _job = boost::bind(&filter::filter_group, this, _1);
+        LOG << "filtering " << _filter.group_size() << " channels at a time ("
+            << dsp::simd::name(_filter.isa()) << ")";
+        if (_filter.is_fft()) {
+                LOG << "filter latency: " << _filter.latency() << " frames";
+        }
+        // offline, the workers use the default scheduler like the caller
+        int priority = host.jack() ? jack_client_real_time_priority(host.jack()->client()) : -1;
+        _pool.reset(new util::rt_pool(_options.nthreads, priority, _options.pin));
+}
+
+void
+filter::filter_group(std::size_t i)
+{
+        std::size_t first = i * _filter.group_size();
+        std::size_t count = std::min(_filter.group_size(), _buffers_in.size() - first);
+        _filter.filter_bufs(&_buffers_in[first], &_buffers_out[first], first, count, _nframes);
+}
+
+int
+filter::process(component_host & host, nframes_t nframes, nframes_t)
+{
+        for (std::size_t i = 0; i < _in.size(); ++i) {
+                _buffers_in[i] = host.port_samples(_in[i], nframes);
+                _buffers_out[i] = host.port_samples(_out[i], nframes);
+        }
+        _nframes = nframes;
+        _pool->run(_job, (_in.size() + _filter.group_size() - 1) / _filter.group_size());
+        return 0;
+}
+
+/** the FFT engine's latency may depend on the period size */
+void
+filter::buffer_size(component_host & host, nframes_t nframes)
+{
+        nframes_t latency = _filter.latency();
+        _filter.set_period(nframes);
+        if (_filter.latency() != latency) {
+                LOG << "filter latency: " << _filter.latency() << " frames";
+                if (host.jack()) jack_recompute_total_latencies(host.jack()->client());
+        }
+}
+
+void
+filter::xrun(component_host &, float)
+{
+        _filter.reset_pads();
+}
@@ -0,0 +1,87 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _COMPONENTS_FILTER_HH
+#define _COMPONENTS_FILTER_HH
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "../component.hh"
+#include "../digital_filter.hh"
+#include "../util/rt_pool.hh"
+
+namespace jill { namespace components {
+
+/**
+ * @ingroup clientgroup
+ * @brief Filters one or more inputs with a Butterworth or custom filter (see jfilter)
+ *
+ * Each input is filtered to the output with the same index. Groups of
+ * channels can be filtered in parallel by a pool of worker threads. Long FIR
+ * filters may be run with FFT convolution, which can delay the output (@see
+ * digital_filter::set_fft).
+ */
+class filter : public component {
+
+public:
+        typedef digital_filter::COEF_t COEF_t;
+
+        struct options_type {
+                std::vector<std::string> inputs;
+                std::vector<std::string> outputs;       // one per input
+
+                /* Butterworth filter, used if there are no custom coefficients */
+                int order;
+                std::vector<COEF_t> cutoff;             // Hz
+                std::string type;                       // low-pass, high-pass, band-pass, band-stop
+
+                /* custom coefficients */
+                std::vector<COEF_t> numerator;
+                std::vector<COEF_t> denominator;
+                std::size_t fft_block;                  // 0 to disable FFT convolution
+                bool fft_uniform;
+
+                int nthreads;                           // additional worker threads
+                bool pin;                               // pin workers to cpus
+
+                options_type();
+        };
+
+        explicit filter(options_type const & options);
+
+        void setup(component_host & host, config_type const & config);
+        int process(component_host & host, nframes_t nframes, nframes_t time);
+        void buffer_size(component_host & host, nframes_t nframes);
+        void xrun(component_host & host, float usec_delay);
+
+        /** The delay of the output relative to the input (frames) */
+        nframes_t latency() const { return _filter.latency(); }
+
+        std::vector<component_host::port_id> const & inputs() const { return _in; }
+        std::vector<component_host::port_id> const & outputs() const { return _out; }
+
+private:
+        void filter_group(std::size_t i);
+
+        options_type _options;
+        digital_filter _filter;
+        std::vector<component_host::port_id> _in, _out;
+
+        /* groups of channels are filtered in parallel by the worker pool */
+        boost::shared_ptr<util::rt_pool> _pool;
+        util::rt_pool::job_type _job;
+        std::vector<sample_t *> _buffers_in, _buffers_out;
+        nframes_t _nframes;
+};
+
+}} // namespace jill::components
+
+#endif
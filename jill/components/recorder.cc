@@ -0,0 +1,320 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "recorder.hh"
+#include "../jack_client.hh"
+#include "../logging.hh"
+#include "../file/arf_writer.hh"
+#include "../dsp/buffered_data_writer.hh"
+#include "../dsp/triggered_data_writer.hh"
+#include "../dsp/decimating_writer.hh"
+
+using namespace jill;
+using namespace jill::components;
+using std::string;
+typedef std::vector<string> svec;
+
+recorder::options_type::options_type()
+        : compression(0), swmr(false), triggered(false), trigger_port("trig_in"),
+          pretrigger_s(1.0), posttrigger_s(0.5), buffer_s(2.0), spill_size_mb(1024),
+          decimate_factor(0), decimate_only(false)
+{}
+
+recorder::trigger_group
+recorder::parse_trigger_group(string const & spec, float pretrigger_s, float posttrigger_s)
+{
+        svec fields;
+        boost::split(fields, spec, boost::is_any_of(":"));
+        if (fields.size() < 2 || fields.size() > 4 || fields[0].empty() || fields[1].empty())
+                throw std::invalid_argument("trigger group syntax: name:chan[,chan...][:pre[:post]]");
+        trigger_group group;
+        group.name = fields[0];
+        boost::split(group.channels, fields[1], boost::is_any_of(","));
+        group.pretrigger_s = pretrigger_s;
+        group.posttrigger_s = posttrigger_s;
+        try {
+                if (fields.size() > 2)
+                        group.pretrigger_s = boost::lexical_cast<float>(fields[2]);
+                if (fields.size() > 3)
+                        group.posttrigger_s = boost::lexical_cast<float>(fields[3]);
+        }
+        catch (boost::bad_lexical_cast const &) {
+                throw std::invalid_argument("trigger group syntax: name:chan[,chan...][:pre[:post]]");
+        }
+        return group;
+}
+
+void
+recorder::parse_decimate(string const & spec, int & factor, svec & channels)
+{
+        string::size_type colon = spec.find(':');
+        try {
+                factor = boost::lexical_cast<int>(spec.substr(0, colon));
+        }
+        catch (boost::bad_lexical_cast const &) {
+                factor = 0;
+        }
+        if (factor < 2)
+                throw std::invalid_argument("decimation syntax: factor[:chan,chan...], factor > 1");
+        channels.clear();
+        if (colon != string::npos) {
+                string list = spec.substr(colon + 1);
+                boost::split(channels, list, boost::is_any_of(","));
+        }
+}
+
+recorder::recorder(options_type const & options)
+        : _options(options), _trig_writer(0), _started(false), _joined(false)
+{
+        if (_options.output_file.empty())
+                throw std::invalid_argument("recorder needs an output file");
+        if (!_options.groups.empty() || !_options.detect_channel.empty())
+                _options.triggered = true;
+        if (_options.swmr && _options.triggered)
+                throw std::invalid_argument("SWMR can only be used in continuous recording mode");
+}
+
+string
+recorder::host_name(component_host & host, string const & name) const
+{
+        std::map<string, component_host::port_id>::const_iterator it = _names.find(name);
+        if (it == _names.end()) return name;
+        return host.port_name(it->second);
+}
+
+void
+recorder::setup(component_host & host, config_type const &)
+{
+        nframes_t samplerate = host.sampling_rate();
+        boost::shared_ptr<dsp::decimating_writer> decimator;
+        _arf.reset(new file::arf_writer(_options.output_file, host.client(), _options.attributes,
+                                        _options.compression, _options.swmr));
+        boost::shared_ptr<data_writer> sink = _arf;         // writer, or decimator if used
+        if (_options.decimate_factor > 1) {
+                decimator.reset(new dsp::decimating_writer(_arf, _options.decimate_factor, samplerate));
+                sink = decimator;
+        }
+
+        /* register ports: triggers first, then inputs */
+        if (_options.triggered) {
+                component_host::port_id p = host.input(_options.trigger_port, EVENT, JackPortIsTerminal);
+                _ports.push_back(p);
+                _names[_options.trigger_port] = p;
+                for (std::size_t i = 0; i < _options.groups.size(); ++i) {
+                        string name = "trig_" + _options.groups[i].name;
+                        p = host.input(name, EVENT, JackPortIsTerminal);
+                        _ports.push_back(p);
+                        _names[name] = p;
+                }
+        }
+        std::vector<std::pair<string, dtype_t> >::const_iterator in;
+        for (in = _options.inputs.begin(); in != _options.inputs.end(); ++in) {
+                component_host::port_id p = host.input(in->first, in->second, JackPortIsTerminal);
+                _ports.push_back(p);
+                _names[in->first] = p;
+        }
+
+        if (_options.triggered) {
+                LOG << "recordings will be triggered";
+                _trig_writer = new dsp::triggered_data_writer(
+                        sink, host.port_name(_ports[0]),
+                        _options.pretrigger_s * samplerate, _options.posttrigger_s * samplerate);
+                _writer.reset(_trig_writer);
+                if (!_options.detect_channel.empty()) {
+                        crossing_options const & o = _options.detect;
+                        _detector.reset(new dsp::crossing_trigger<sample_t>(o.open_threshold,
+                                                                            o.open_count_thresh(samplerate),
+                                                                            o.open_periods(),
+                                                                            o.close_threshold,
+                                                                            o.close_count_thresh(samplerate),
+                                                                            o.close_periods(),
+                                                                            o.period_size(samplerate)));
+                        string channel = host_name(host, _options.detect_channel);
+                        _trig_writer->set_detector(host.port_name(_ports[0]), channel,
+                                                   boost::bind(&recorder::detect, this, _1, _2, _3));
+                        LOG << "detecting signals in " << channel;
+                        o.log(samplerate);
+                }
+
+                /* each trigger group gets its own port and output file */
+                string const & base = _options.output_file;
+                string::size_type ext = base.find_last_of(".");
+                if (ext == string::npos || ext < base.find_last_of("/") + 1)
+                        ext = base.size();
+                for (std::size_t i = 0; i < _options.groups.size(); ++i) {
+                        trigger_group const & group = _options.groups[i];
+                        string path = base.substr(0, ext) + "_" + group.name + base.substr(ext);
+                        string port = host.port_name(_ports[i + 1]);
+                        svec channels;
+                        for (svec::const_iterator c = group.channels.begin(); c != group.channels.end(); ++c)
+                                channels.push_back(host_name(host, *c));
+                        boost::shared_ptr<file::arf_writer> group_writer(
+                                new file::arf_writer(path, host.client(), _options.attributes,
+                                                     _options.compression));
+                        _trig_writer->add_trigger(group_writer, port, channels,
+                                                  group.pretrigger_s * samplerate,
+                                                  group.posttrigger_s * samplerate);
+                        _group_writers.push_back(group_writer);
+                        LOG << "trigger group " << group.name << ": " << port << " -> " << path;
+                }
+        }
+        else {
+                LOG << "recording will be continuous";
+                _writer.reset(new dsp::buffered_data_writer(sink));
+        }
+        if (!_options.spill_file.empty()) {
+                _writer->enable_spill(_options.spill_file, std::size_t(_options.spill_size_mb) << 20);
+        }
+        /* bind socket for storing messages in arf file */
+        if (!_options.logger_server.empty())
+                _writer->bind_logger(_options.logger_server);
+
+        /* outputs prepare datasets for new entries from a template */
+        svec decimate_channels;
+        for (svec::const_iterator c = _options.decimate_channels.begin();
+             c != _options.decimate_channels.end(); ++c)
+                decimate_channels.push_back(host_name(host, *c));
+        std::vector<svec> group_channels(_options.groups.size());
+        for (std::size_t i = 0; i < _options.groups.size(); ++i) {
+                svec const & channels = _options.groups[i].channels;
+                for (svec::const_iterator c = channels.begin(); c != channels.end(); ++c)
+                        group_channels[i].push_back(host_name(host, *c));
+        }
+        for (std::vector<component_host::port_id>::const_iterator it = _ports.begin();
+             it != _ports.end(); ++it) {
+                string const & name = host.port_name(*it);
+                bool is_sampled = (host.port_type(*it) == SAMPLED);
+                bool decimated = decimator && is_sampled &&
+                        (decimate_channels.empty() ||
+                         find(decimate_channels.begin(), decimate_channels.end(), name) != decimate_channels.end());
+                if (decimated) {
+                        string output = name + "_d" + boost::lexical_cast<string>(_options.decimate_factor);
+                        decimator->add_channel(name, output, !_options.decimate_only);
+                        _arf->add_template(output, true);
+                }
+                if (!decimated || !_options.decimate_only)
+                        _arf->add_template(name, is_sampled);
+                for (std::size_t i = 0; i < _group_writers.size(); ++i) {
+                        if (*it == _ports[i + 1] ||
+                            find(group_channels[i].begin(), group_channels[i].end(), name) != group_channels[i].end())
+                                _group_writers[i]->add_template(name, is_sampled);
+                }
+        }
+
+        std::size_t bytes = _writer->request_buffer_size(buffer_bytes(samplerate));
+        LOG << "recording " << _ports.size() << " channels to " << _options.output_file
+            << " (ringbuffer=" << bytes << " bytes)";
+}
+
+/*
+ * In triggered mode the buffer holds the longest pretrigger window, plus room
+ * for the data that arrive while pretrigger data are being written. The
+ * largest such write is a snapshot, which writes the window of every trigger
+ * to its own file at once; this assumes the disk is at least as fast as
+ * realtime, so that writing N seconds of data takes no longer than N seconds.
+ */
+std::size_t
+recorder::buffer_bytes(nframes_t samplerate) const
+{
+        float seconds = _options.buffer_s * _ports.size();      // summed over channels
+        if (_trig_writer) {
+                float pretrigger_s = _options.pretrigger_s;
+                float snapshot = _options.pretrigger_s * _ports.size();
+                std::vector<trigger_group>::const_iterator it;
+                for (it = _options.groups.begin(); it != _options.groups.end(); ++it) {
+                        pretrigger_s = std::max(pretrigger_s, it->pretrigger_s);
+                        // the group's channels and its trigger port
+                        snapshot += it->pretrigger_s * (it->channels.size() + 1);
+                }
+                seconds += pretrigger_s * _ports.size() + snapshot;
+        }
+        return std::size_t(samplerate * seconds) * sizeof(sample_t);
+}
+
+int
+recorder::process(component_host & host, nframes_t nframes, nframes_t time)
+{
+        for (std::vector<component_host::port_id>::const_iterator it = _ports.begin();
+             it != _ports.end(); ++it) {
+                char const * name = host.port_name(*it).c_str();
+                if (host.port_type(*it) == SAMPLED) {
+                        _writer->push(time, SAMPLED, name, nframes * sizeof(sample_t),
+                                      host.port_samples(*it, nframes));
+                }
+                else {
+                        std::size_t nevents = host.nevents(*it);
+                        for (std::size_t j = 0; j < nevents; ++j) {
+                                component_host::event_ref_t event = host.event(*it, j);
+                                if (event.size == 0) continue;
+                                _writer->push(time + event.time, EVENT, name, event.size, event.data);
+                        }
+                }
+        }
+        _writer->data_ready();
+        return 0;
+}
+
+int
+recorder::detect(sample_t const * samples, nframes_t nframes, bool & open)
+{
+        int offset = _detector->push(samples, nframes);
+        open = _detector->open();
+        return offset;
+}
+
+void
+recorder::buffer_size(component_host & host, nframes_t)
+{
+        // will block until buffer is empty (with any current implementation, anyway)
+        std::size_t bytes = _writer->request_buffer_size(buffer_bytes(host.sampling_rate()));
+        _writer->reset();
+        LOG << "ringbuffer size (bytes): " << bytes;
+}
+
+void
+recorder::xrun(component_host &, float)
+{
+        _writer->xrun();
+}
+
+void
+recorder::start()
+{
+        _writer->start();
+        _started = true;
+}
+
+void
+recorder::stop()
+{
+        _writer->stop();
+        join();
+}
+
+void
+recorder::join()
+{
+        if (_started && !_joined) {
+                _joined = true;
+                _writer->join();
+        }
+}
+
+void
+recorder::snapshot()
+{
+        if (_trig_writer) _trig_writer->snapshot();
+}
@@ -0,0 +1,154 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _COMPONENTS_RECORDER_HH
+#define _COMPONENTS_RECORDER_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/shared_ptr.hpp>
+#include "../component.hh"
+#include "../dsp/crossing_trigger.hh"
+#include "detector.hh"
+
+namespace jill {
+
+namespace file { class arf_writer; }
+namespace dsp { class buffered_data_writer; class triggered_data_writer; }
+
+namespace components {
+
+/**
+ * @ingroup clientgroup
+ * @brief Records inputs to an ARF file, continuously or when triggered (see jrecord)
+ *
+ * The data are passed to a writer thread through a ringbuffer. In triggered
+ * mode, recording is started and stopped by MIDI events in a trigger port,
+ * or by a crossing detector monitoring one of the inputs, and the pretrigger
+ * windows can be written on demand with snapshot().
+ * Trigger groups record subsets of the channels to separate files, with
+ * their own trigger ports (named trig_NAME). Sampled channels can also be
+ * stored at a lower sampling rate.
+ *
+ * Channels in the options (for trigger groups, the detector, and decimation)
+ * are named by the name given to the port in the options.
+ */
+class recorder : public component {
+
+public:
+        /** A set of channels recorded to a separate file by an independent trigger */
+        struct trigger_group {
+                std::string name;
+                std::vector<std::string> channels;
+                float pretrigger_s;
+                float posttrigger_s;
+        };
+
+        struct options_type {
+                std::string output_file;
+                std::map<std::string, std::string> attributes;  // stored in each entry
+                int compression;
+                bool swmr;                                      // continuous mode only
+
+                std::vector<std::pair<std::string, dtype_t> > inputs;
+
+                /* triggered recording; implied by trigger groups or the detector */
+                bool triggered;
+                std::string trigger_port;
+                float pretrigger_s;
+                float posttrigger_s;
+                std::vector<trigger_group> groups;
+
+                float buffer_s;                                 // minimum ringbuffer size
+                std::string spill_file;                         // empty to drop data when full
+                int spill_size_mb;
+
+                /* decimation of sampled channels (all, if the list is empty) */
+                int decimate_factor;                            // 0 for none
+                std::vector<std::string> decimate_channels;
+                bool decimate_only;
+
+                /* built-in detector, run by the writer thread */
+                std::string detect_channel;                     // empty for none
+                crossing_options detect;
+
+                /** if not empty, log messages from this server are stored in the file */
+                std::string logger_server;
+
+                options_type();
+        };
+
+        /**
+         * Parse a trigger group: name:chan[,chan...][:pretrigger[:posttrigger]]
+         *
+         * @throws std::invalid_argument for syntax errors
+         */
+        static trigger_group parse_trigger_group(std::string const & spec,
+                                                 float pretrigger_s, float posttrigger_s);
+
+        /**
+         * Parse a decimation setting: factor[:chan,chan...]
+         *
+         * @throws std::invalid_argument for syntax errors, or if factor < 2
+         */
+        static void parse_decimate(std::string const & spec, int & factor,
+                                   std::vector<std::string> & channels);
+
+        explicit recorder(options_type const & options);
+
+        void setup(component_host & host, config_type const & config);
+        int process(component_host & host, nframes_t nframes, nframes_t time);
+        void buffer_size(component_host & host, nframes_t nframes);
+        void xrun(component_host & host, float usec_delay);
+
+        /** Start the writer thread */
+        void start();
+
+        /** Stop the writer thread and wait for it to finish writing */
+        void stop();
+
+        /** Wait for the writer thread to exit */
+        void join();
+
+        /** Record the pretrigger windows (triggered mode only). Safe to call from a signal handler */
+        void snapshot();
+
+        /** The writer thread. Its stop() may be called from a signal handler */
+        dsp::buffered_data_writer & writer() { return *_writer; }
+
+        bool triggered() const { return _trig_writer != 0; }
+
+private:
+        /* the detector function for the triggered writer */
+        int detect(sample_t const * samples, nframes_t nframes, bool & open);
+
+        /* the name of a port in the host, or name if the port wasn't declared */
+        std::string host_name(component_host & host, std::string const & name) const;
+
+        /* the size of the ringbuffer */
+        std::size_t buffer_bytes(nframes_t samplerate) const;
+
+        options_type _options;
+        boost::shared_ptr<file::arf_writer> _arf;
+        std::vector<boost::shared_ptr<file::arf_writer> > _group_writers;
+        boost::shared_ptr<dsp::buffered_data_writer> _writer;
+        dsp::triggered_data_writer * _trig_writer;  // same object as _writer, if triggered
+        boost::shared_ptr<dsp::crossing_trigger<sample_t> > _detector;
+
+        std::vector<component_host::port_id> _ports;
+        std::map<std::string, component_host::port_id> _names;  // by name in the options
+        bool _started;
+        bool _joined;
+};
+
+}} // namespace jill::components
+
+#endif
@@ -92,6 +92,13 @@ public:
          */
         virtual void flush() {}
 
+        /**
+         * Set the sampling rate of a channel whose rate differs from that of
+         * the data source (e.g., decimated data). Must be called before the
+         * channel is first written. May be a noop.
+         */
+        virtual void set_sampling_rate(std::string const & id, nframes_t rate) {}
+
 };
 
 }
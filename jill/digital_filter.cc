@@ -1,6 +1,8 @@
 #include <iostream>
 #include <complex>
+#include <cmath>
 #include <map>
+#include <stdexcept>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lambda/lambda.hpp>
@@ -19,82 +21,246 @@ using namespace jill;
 digital_filter::digital_filter(): _coef_in(std::vector<COEF_t>(1,0)),
   _coef_out(),
   _pads_out(),
-  _pads_in()
+  _pads_in(),
+  _isa(dsp::simd::detect()),
+  _fft_block(64),
+  _fft_uniform(false),
+  _period(0)
 {}
 
+const std::size_t digital_filter::fft_min_taps;
+
 
 void
 digital_filter::filter_buf(sample_t const * const in, sample_t * const out, 
-                           std::string port_name, nframes_t nframes) {
+                           std::string const & port_name, nframes_t nframes) {
+        std::map<std::string, std::size_t>::const_iterator it = _channels.find(port_name);
+        std::size_t channel = (it != _channels.end()) ? it->second : add_channel(port_name);
+        filter_buf(in, out, channel, nframes);
+}
 
+void
+digital_filter::filter_buf(sample_t const * const in, sample_t * const out,
+                           std::size_t channel, nframes_t nframes) {
+        if (is_sos()) {
+                _filter_sos(in, out, channel, nframes);
+        }
+        else {
+                _filter_direct(in, out, channel, nframes);
+        }
+}
 
+void
+digital_filter::filter_bufs(sample_t const * const * in, sample_t * const * out,
+                            std::size_t first, std::size_t count, nframes_t nframes) {
 
-        
-        memset(out, 0, nframes * sizeof(sample_t));
-        
-        if (!_pads_in.count(port_name)) {
-                _pads_in[port_name].assign(pad_len(), 0);
+        std::size_t const group = group_size();
+        COEF_t * state[dsp::simd::max_lanes];
+
+        if (is_sos()) {
+                for (std::size_t i = 0; i < count; i += group) {
+                        std::size_t const n = std::min(group, count - i);
+                        for (std::size_t j = 0; j < n; j++) {
+                                state[j] = &_sos_state[first + i + j][0];
+                        }
+                        dsp::simd::sos(_isa, &_sos[0], _sos.size(), state,
+                                       in + i, out + i, n, nframes);
+                }
         }
- 
-        if (is_iir() && !_pads_out.count(port_name)) {
-                _pads_out[port_name].assign(pad_len(), 0);
+        else if (_fft) {
+                _fft->process(in, out, first, count, nframes);
+        }
+        else if (is_fir()) {
+                for (std::size_t i = 0; i < count; i += group) {
+                        std::size_t const n = std::min(group, count - i);
+                        for (std::size_t j = 0; j < n; j++) {
+                                std::vector<COEF_t> & pad = _pads_in[first + i + j];
+                                state[j] = pad.empty() ? 0 : &pad[0];
+                        }
+                        dsp::simd::fir(_isa, &_fir_taps[0], _fir_taps.size(), state,
+                                       in + i, out + i, n, nframes,
+                                       &_workspace[(first + i) / group][0]);
+                }
+        }
+        else {
+                for (std::size_t i = 0; i < count; i++) {
+                        if (in[i]) filter_buf(in[i], out[i], first + i, nframes);
+                }
         }
+}
 
-        if (is_iir()) {
-                
-                //double precision output buffer so filter remains stable
-                static const nframes_t MaxNFrames = 10000;
-                COEF_t precise_out[MaxNFrames] = {0};
-
-                // ensure coefficient vectors are same size so index
-                // doesn't go out of range
-                if (_coef_in.size() < _coef_out.size()) {
-                        _coef_in.resize(_coef_out.size());       
+void
+digital_filter::_filter_sos(sample_t const * const in, sample_t * const out,
+                            std::size_t channel, nframes_t nframes) {
+
+        // transposed direct form II; each section's state is kept in double
+        // precision, and the output of one section is the input to the next
+        COEF_t * const state = &_sos_state[channel][0];
+        biquad_t const * const sos = &_sos[0];
+        std::size_t const nsections = _sos.size();
+
+        for (nframes_t n = 0; n < nframes; n++) {
+                COEF_t x = in[n];
+                for (std::size_t k = 0; k < nsections; k++) {
+                        biquad_t const & s = sos[k];
+                        COEF_t * const z = state + 2 * k;
+                        COEF_t const y = s.b0 * x + z[0];
+                        z[0] = s.b1 * x - s.a1 * y + z[1];
+                        z[1] = s.b2 * x - s.a2 * y;
+                        x = y;
                 }
-                else if (_coef_in.size() > _coef_out.size() ) {
-                        _coef_out.resize(_coef_in.size());
-                } 
- 
-                for (nframes_t n = 0; n < nframes; n++) {
+                out[n] = x;
+        }
+}
 
-                        for (nframes_t i = 0; i <= pad_len(); i++) {                           
-                                if (i == 0) {
-                                        precise_out[n] = _coef_in[i] * in[n-i];
-                                }
-                                else if (i <= n) {
-                                        precise_out[n] += _coef_in[i]*in[n-i] - _coef_out[i] * precise_out[n-i];      
+namespace {
+
+/* the number of frames the direct form filters at a time */
+const digital_filter::nframes_t direct_chunk = 256;
+
+/* keep the last pad.size() samples of a signal, which may span several buffers */
+template <typename T> void
+update_pad(std::vector<digital_filter::COEF_t> & pad, T const * x, digital_filter::nframes_t nframes)
+{
+        std::size_t const n = pad.size();
+        if (nframes >= n) {
+                std::copy(x + nframes - n, x + nframes, pad.begin());
+        }
+        else {
+                std::copy(pad.begin() + nframes, pad.end(), pad.begin());
+                std::copy(x, x + nframes, pad.end() - nframes);
+        }
+}
+
+}
+
+void
+digital_filter::_filter_direct(sample_t const * const in, sample_t * const out,
+                               std::size_t channel, nframes_t nframes) {
+
+        std::vector<COEF_t> & pad_in = _pads_in[channel];
+        std::vector<COEF_t> & pad_out = _pads_out[channel];
+        nframes_t const P = pad_len();
+
+        if (is_iir()) {
+                // double precision output so the filter remains stable. The
+                // buffer is filtered in chunks that fit on the stack, with
+                // the pads carrying the state from one chunk to the next.
+                COEF_t precise_out[direct_chunk];
+
+                for (nframes_t start = 0; start < nframes; start += direct_chunk) {
+                        sample_t const * const x = in + start;
+                        nframes_t const nx = std::min(direct_chunk, nframes - start);
+                        for (nframes_t n = 0; n < nx; n++) {
+                                COEF_t y = _coef_in[0] * x[n];
+                                for (nframes_t i = 1; i <= P; i++) {
+                                        if (i <= n) {
+                                                y += _coef_in[i] * x[n-i] - _coef_out[i] * precise_out[n-i];
+                                        }
+                                        else {
+                                                y += _coef_in[i] * pad_in[n-i + P] -
+                                                        _coef_out[i] * pad_out[n-i + P];
+                                        }
                                 }
-                                else {
-                                        precise_out[n] += _coef_in[i] * _pads_in[port_name][n-i + pad_len()] -      
-                                                _coef_out[i] * _pads_out[port_name][n-i + pad_len()];
-                                }       
+                                precise_out[n] = y / _coef_out[0];
                         }
-                        precise_out[n] /= _coef_out[0];
-
+                        // read the input before writing, in case out is in
+                        update_pad(pad_in, x, nx);
+                        update_pad(pad_out, precise_out, nx);
+                        std::copy(precise_out, precise_out + nx, out + start);
                 }
-                std::copy(precise_out + nframes-pad_len(), precise_out + nframes, _pads_out[port_name].begin());
-                std::copy(precise_out, precise_out + nframes, out);
-                std::copy(in + nframes-pad_len(), in + nframes, _pads_in[port_name].begin());
-                
         }
         else {
+                memset(out, 0, nframes * sizeof(sample_t));
                 for (nframes_t n = 0; n < nframes; n++) {
                         for (nframes_t i = 0; i <= pad_len(); i++) {
                                 if (i <= n) {
                                         out[n] += _coef_in[i] * in[n-i];    
                                 }
                                 else {
-                                        out[n] += _coef_in[i] *
-                                                _pads_in[port_name][n-i + pad_len()];
+                                        out[n] += _coef_in[i] * pad_in[n-i + pad_len()];
                                 }
                         }
                         if (_coef_out.size() > 0) {
                                 out[n] /= _coef_out[0];
                         }
                 }
-                std::copy(in + nframes-pad_len(), in + nframes, _pads_in[port_name].begin());
-        }     
+                update_pad(pad_in, in, nframes);
+        }
+
+}
+
+std::size_t
+digital_filter::add_channel(std::string const & port_name) {
+        if (_coef_in.size() < _coef_out.size()) {
+                _coef_in.resize(_coef_out.size());
+        }
+        else if (is_iir() && _coef_in.size() > _coef_out.size()) {
+                _coef_out.resize(_coef_in.size());
+        }
+        std::size_t channel;
+        std::map<std::string, std::size_t>::const_iterator it = _channels.find(port_name);
+        bool const exists = (it != _channels.end());
+        if (exists) {
+                channel = it->second;
+        }
+        else {
+                channel = _channel_names.size();
+                _channels[port_name] = channel;
+                _channel_names.push_back(port_name);
+                _sos_state.resize(channel + 1);
+                _pads_in.resize(channel + 1);
+                _pads_out.resize(channel + 1);
+        }
+        _sos_state[channel].assign(2 * _sos.size(), 0);
+        _pads_in[channel].assign(pad_len(), 0);
+        _pads_out[channel].assign(is_iir() ? pad_len() : 0, 0);
+        if (exists) return channel;
+        if (_fft) _fft->resize(_channel_names.size());
+        _resize_workspace();
+        return channel;
+}
 
+void
+digital_filter::set_isa(dsp::simd::isa_type isa) {
+        _isa = isa;
+        _make_fft();
+        _resize_workspace();
+}
+
+void
+digital_filter::set_fft(std::size_t block, bool uniform) {
+        _fft_block = block;
+        _fft_uniform = uniform;
+        _make_fft();
+        _resize_workspace();
+}
+
+void
+digital_filter::set_period(nframes_t nframes) {
+        _period = nframes;
+        if (_fft) _fft->reset(nframes);
+}
+
+void
+digital_filter::_make_fft() {
+        if (is_fir() && _fft_block > 0 && _fir_taps.size() >= fft_min_taps) {
+                _fft.reset(new dsp::fft_convolver(_fir_taps, _fft_block, _fft_uniform, _period, _isa));
+                _fft->resize(_channel_names.size());
+        }
+        else {
+                _fft.reset();
+        }
+}
+
+void
+digital_filter::_resize_workspace() {
+        std::size_t const group = group_size();
+        std::size_t const size = (is_fir() && !_fft) ? dsp::simd::fir_workspace(_isa, _fir_taps.size()) : 0;
+        _workspace.resize((_channel_names.size() + group - 1) / group);
+        for (std::size_t i = 0; i < _workspace.size(); i++) {
+                _workspace[i].assign(size, 0);
+        }
 }
 
 void 
@@ -102,22 +268,43 @@ digital_filter::custom_coef(std::vector<COEF_t> b,
                             std::vector<COEF_t> a) {
         _coef_in = b;
         _coef_out = a;
+        // the direct form needs coefficient vectors of the same size
+        if (is_iir()) {
+                std::size_t const n = std::max(b.size(), a.size());
+                _coef_in.resize(n);
+                _coef_out.resize(n);
+        }
+        _sos.clear();
+        _fir_taps.clear();
+        if (a.size() <= 1) {
+                COEF_t a0 = a.empty() ? 1 : a[0];
+                for (std::size_t i = 0; i < b.size(); i++) {
+                        _fir_taps.push_back(b[i] / a0);
+                }
+        }
+        // resize the pads of any existing channels
+        for (std::size_t i = 0; i < _channel_names.size(); i++) {
+                add_channel(_channel_names[i]);
+        }
+        _make_fft();
+        _resize_workspace();
         log_coefs();
+        if (_fft) {
+                LOG << "FIR filter (" << _fir_taps.size() << " taps) uses FFT convolution, "
+                    << _fft->partitions() << " partitions of " << _fft->block_size()
+                    << (_fft->uniform() ? " taps" : " taps after a direct block");
+        }
 }
 
 
 void 
 digital_filter::reset_pads() {
-        std::map<std::string, std::vector<COEF_t> >::iterator it_in, it_out;
-        if (is_iir()) {
-                it_out = _pads_out.begin();
-        }
-        for (it_in = _pads_in.begin(); it_in != _pads_out.end(); it_in++) {
-                it_in->second.assign(it_in->second.size(), 0);
-                if (is_iir()) {
-                        it_out->second.assign(it_out->second.size(), 0);
-                }
+        for (std::size_t i = 0; i < _channel_names.size(); i++) {
+                _pads_in[i].assign(_pads_in[i].size(), 0);
+                _pads_out[i].assign(_pads_out[i].size(), 0);
+                _sos_state[i].assign(_sos_state[i].size(), 0);
         }
+        if (_fft) _fft->reset();
 }
        
 digital_filter::COEF_t
@@ -146,10 +333,244 @@ digital_filter::_tf2coefficients(transfer_function H) {
         }
 } 
 
+namespace {
+
+typedef std::complex<double> cplx;
+typedef std::vector<cplx> cvec;
+
+/*
+ * Zero-pole-gain transformations of analog prototypes. These parallel the
+ * polynomial transforms in transfer_function, but keep the roots so that the
+ * filter can be factored into second-order sections without the loss of
+ * precision that comes from expanding and refactoring the polynomials.
+ */
+struct zpk_t {
+        cvec z;
+        cvec p;
+        double k;
+};
+
+cplx
+prod_neg(cvec const & v)
+{
+        cplx out(1, 0);
+        for (cvec::const_iterator it = v.begin(); it != v.end(); ++it) out *= -*it;
+        return out;
+}
+
+void
+zpk_lp2lp(zpk_t & f, double wo)
+{
+        int degree = f.p.size() - f.z.size();
+        for (std::size_t i = 0; i < f.z.size(); i++) f.z[i] *= wo;
+        for (std::size_t i = 0; i < f.p.size(); i++) f.p[i] *= wo;
+        f.k *= std::pow(wo, degree);
+}
+
+void
+zpk_lp2hp(zpk_t & f, double wo)
+{
+        int degree = f.p.size() - f.z.size();
+        f.k *= (prod_neg(f.z) / prod_neg(f.p)).real();
+        for (std::size_t i = 0; i < f.z.size(); i++) f.z[i] = wo / f.z[i];
+        for (std::size_t i = 0; i < f.p.size(); i++) f.p[i] = wo / f.p[i];
+        f.z.insert(f.z.end(), degree, cplx(0, 0));
+}
+
+void
+zpk_lp2bp(zpk_t & f, double wo, double bw)
+{
+        int degree = f.p.size() - f.z.size();
+        cvec z, p;
+        for (std::size_t i = 0; i < f.z.size(); i++) {
+                cplx r = f.z[i] * bw / 2.0;
+                cplx d = std::sqrt(r * r - wo * wo);
+                z.push_back(r + d);
+                z.push_back(r - d);
+        }
+        for (std::size_t i = 0; i < f.p.size(); i++) {
+                cplx r = f.p[i] * bw / 2.0;
+                cplx d = std::sqrt(r * r - wo * wo);
+                p.push_back(r + d);
+                p.push_back(r - d);
+        }
+        z.insert(z.end(), degree, cplx(0, 0));
+        f.z = z;
+        f.p = p;
+        f.k *= std::pow(bw, degree);
+}
+
+void
+zpk_lp2bs(zpk_t & f, double wo, double bw)
+{
+        int degree = f.p.size() - f.z.size();
+        f.k *= (prod_neg(f.z) / prod_neg(f.p)).real();
+        cvec z, p;
+        for (std::size_t i = 0; i < f.z.size(); i++) {
+                cplx r = (bw / 2.0) / f.z[i];
+                cplx d = std::sqrt(r * r - wo * wo);
+                z.push_back(r + d);
+                z.push_back(r - d);
+        }
+        for (std::size_t i = 0; i < f.p.size(); i++) {
+                cplx r = (bw / 2.0) / f.p[i];
+                cplx d = std::sqrt(r * r - wo * wo);
+                p.push_back(r + d);
+                p.push_back(r - d);
+        }
+        z.insert(z.end(), degree, cplx(0, wo));
+        z.insert(z.end(), degree, cplx(0, -wo));
+        f.z = z;
+        f.p = p;
+}
+
+/* s = 2 (1 - z^-1) / (1 + z^-1), as in transfer_function::bilinear */
+void
+zpk_bilinear(zpk_t & f)
+{
+        const double fs2 = 2.0;
+        int degree = f.p.size() - f.z.size();
+        cplx num(1, 0), denom(1, 0);
+        for (std::size_t i = 0; i < f.z.size(); i++) {
+                num *= fs2 - f.z[i];
+                f.z[i] = (fs2 + f.z[i]) / (fs2 - f.z[i]);
+        }
+        for (std::size_t i = 0; i < f.p.size(); i++) {
+                denom *= fs2 - f.p[i];
+                f.p[i] = (fs2 + f.p[i]) / (fs2 - f.p[i]);
+        }
+        f.z.insert(f.z.end(), degree, cplx(-1, 0));
+        f.k *= (num / denom).real();
+}
+
+bool
+by_real(cplx const & a, cplx const & b)
+{
+        return a.real() < b.real();
+}
+
+/*
+ * Group roots into pairs: complex roots with their conjugates, and real roots
+ * with each other (smallest with largest, so that zeros at +1 and -1 share a
+ * section). A leftover real root is paired with nothing (count of 1).
+ */
+struct root_pair {
+        cplx a, b;
+        int count;
+};
+
+std::vector<root_pair>
+pair_roots(cvec const & roots)
+{
+        const double eps = 1e-8;
+        std::vector<root_pair> out;
+        cvec real;
+        for (cvec::const_iterator it = roots.begin(); it != roots.end(); ++it) {
+                if (std::fabs(it->imag()) <= eps * std::max(1.0, std::abs(*it))) {
+                        real.push_back(cplx(it->real(), 0));
+                }
+                else if (it->imag() > 0) {
+                        root_pair rp = { *it, std::conj(*it), 2 };
+                        out.push_back(rp);
+                }
+        }
+        std::sort(real.begin(), real.end(), by_real);
+        std::size_t lo = 0, hi = real.size();
+        while (hi - lo >= 2) {
+                root_pair rp = { real[lo++], real[--hi], 2 };
+                out.push_back(rp);
+        }
+        if (hi > lo) {
+                root_pair rp = { real[lo], cplx(0, 0), 1 };
+                out.push_back(rp);
+        }
+        return out;
+}
+
+bool
+by_radius(root_pair const & a, root_pair const & b)
+{
+        return std::max(std::abs(a.a), std::abs(a.b)) < std::max(std::abs(b.a), std::abs(b.b));
+}
+
+/*
+ * Factor a digital zpk filter into second-order sections. Sections are
+ * ordered with the poles farthest from the unit circle first, and each pole
+ * pair gets the remaining zero pair closest to it.
+ */
+std::vector<digital_filter::biquad_t>
+zpk2sos(zpk_t const & f)
+{
+        std::vector<root_pair> poles = pair_roots(f.p);
+        std::vector<root_pair> zeros = pair_roots(f.z);
+        root_pair none = { cplx(0, 0), cplx(0, 0), 0 };
+        std::size_t nsections = std::max(poles.size(), zeros.size());
+        poles.resize(nsections, none);
+        std::sort(poles.begin(), poles.end(), by_radius);
+
+        std::vector<digital_filter::biquad_t> sos(nsections);
+        std::vector<bool> used(zeros.size(), false);
+        for (std::size_t i = nsections; i-- > 0; ) {
+                // match zeros to the most resonant poles first
+                root_pair const & p = poles[i];
+                std::size_t best = zeros.size();
+                double best_dist = 0;
+                for (std::size_t j = 0; j < zeros.size(); j++) {
+                        if (used[j]) continue;
+                        double d = std::min(std::abs(zeros[j].a - p.a), std::abs(zeros[j].b - p.a));
+                        if (best == zeros.size() || d < best_dist) {
+                                best = j;
+                                best_dist = d;
+                        }
+                }
+                root_pair z = none;
+                if (best < zeros.size()) {
+                        z = zeros[best];
+                        used[best] = true;
+                }
+                digital_filter::biquad_t & s = sos[i];
+                s.b0 = 1;
+                s.b1 = (z.count == 2) ? -(z.a + z.b).real() : (z.count == 1) ? -z.a.real() : 0;
+                s.b2 = (z.count == 2) ? (z.a * z.b).real() : 0;
+                s.a1 = (p.count == 2) ? -(p.a + p.b).real() : (p.count == 1) ? -p.a.real() : 0;
+                s.a2 = (p.count == 2) ? (p.a * p.b).real() : 0;
+        }
+        if (nsections > 0) {
+                sos[0].b0 *= f.k;
+                sos[0].b1 *= f.k;
+                sos[0].b2 *= f.k;
+        }
+        return sos;
+}
+
+}
+
 void 
 digital_filter::butter(int N, std::vector<COEF_t> Wc, std::string filter_type, nframes_t fs) {
-  
-        
+
+        std::size_t ncutoffs;
+        if (filter_type == "low-pass" || filter_type == "high-pass") {
+                ncutoffs = 1;
+        }
+        else if (filter_type == "band-pass" || filter_type == "band-stop") {
+                ncutoffs = 2;
+        }
+        else {
+                throw std::invalid_argument("unknown filter type: " + filter_type);
+        }
+        if (Wc.size() != ncutoffs) {
+                throw std::invalid_argument(filter_type + " filters need " +
+                                            (ncutoffs == 1 ? "one cutoff frequency" : "two cutoff frequencies"));
+        }
+        if (N < 1) {
+                throw std::invalid_argument("filter order must be at least 1");
+        }
+        for (std::size_t j = 0; j < Wc.size(); j++) {
+                if (Wc[j] <= 0 || Wc[j] >= fs / 2.0) {
+                        throw std::invalid_argument("cutoff frequencies must be between 0 and the Nyquist frequency");
+                }
+        }
+
         const complex_t i(0,1);
         const COEF_t pi = arg(complex_t(-1,0));	
         
@@ -184,9 +605,86 @@ digital_filter::butter(int N, std::vector<COEF_t> Wc, std::string filter_type, n
      
         _tf2coefficients(H);       
 
+        // repeat the design in zero-pole-gain form to get second-order sections
+        zpk_t f = { cvec(), p, 1.0 };
+        if (filter_type == "low-pass") {
+                zpk_lp2lp(f, prewarped[0]);
+        }
+        else if (filter_type == "high-pass") {
+                zpk_lp2hp(f, prewarped[0]);
+        }
+        else {
+                COEF_t lo = std::min(prewarped[0], prewarped[1]);
+                COEF_t hi = std::max(prewarped[0], prewarped[1]);
+                if (filter_type == "band-pass")
+                        zpk_lp2bp(f, std::sqrt(lo * hi), hi - lo);
+                else
+                        zpk_lp2bs(f, std::sqrt(lo * hi), hi - lo);
+        }
+        zpk_bilinear(f);
+        _sos = zpk2sos(f);
+        _fir_taps.clear();
+        _fft.reset();
+        for (std::size_t c = 0; c < _sos_state.size(); c++) {
+                _sos_state[c].assign(2 * _sos.size(), 0);
+        }
+
         log_filter(N, Wc, filter_type, "butterworth");
 }
 
+namespace {
+
+/* modified Bessel function of the first kind, order 0 */
+double
+bessel_i0(double x)
+{
+        double sum = 1, term = 1;
+        for (int k = 1; k < 100 && term > 1e-12 * sum; k++) {
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+        }
+        return sum;
+}
+
+}
+
+std::vector<digital_filter::COEF_t>
+digital_filter::kaiser_lowpass(COEF_t Wp, COEF_t width, COEF_t attenuation) {
+
+        if (Wp <= 0 || width <= 0 || Wp + width > 1) {
+                throw std::invalid_argument("low-pass band edges must be between 0 and Nyquist");
+        }
+        const COEF_t pi = std::arg(complex_t(-1,0));
+        COEF_t const A = attenuation;
+        // Kaiser's formulas for the window shape and length
+        COEF_t beta = 0;
+        if (A > 50) {
+                beta = 0.1102 * (A - 8.7);
+        }
+        else if (A > 21) {
+                beta = 0.5842 * std::pow(A - 21, 0.4) + 0.07886 * (A - 21);
+        }
+        int N = (int)std::ceil((A - 7.95) / (2.285 * pi * width)) + 1;
+        N = std::max(N, 3) | 1;    // odd, so the delay is a whole number of samples
+
+        COEF_t const Wc = Wp + width / 2;
+        COEF_t const M = (N - 1) / 2.0;
+        std::vector<COEF_t> h(N);
+        COEF_t sum = 0;
+        for (int n = 0; n < N; n++) {
+                COEF_t const x = n - M;
+                COEF_t const r = x / M;
+                COEF_t const sinc = (x == 0) ? 1 : std::sin(pi * Wc * x) / (pi * Wc * x);
+                h[n] = Wc * sinc * bessel_i0(beta * std::sqrt(1 - r * r)) / bessel_i0(beta);
+                sum += h[n];
+        }
+        // unity gain at DC
+        for (int n = 0; n < N; n++) {
+                h[n] /= sum;
+        }
+        return h;
+}
+
 void
 digital_filter::log_filter(int N, std::vector<COEF_t> Wc, std::string filter_type, std::string filter_class){
         
@@ -205,8 +703,10 @@ digital_filter::log_coefs() {
         //printing polynomials for convenience
         LOG << "Numerator filter coefficients set to " 
             << poly(&_coef_in[0], _coef_in.size()-1); 
-        LOG << "Denominator filter coefficients set to " 
-            << poly(&_coef_out[0],_coef_out.size()-1);
+        if (!_coef_out.empty()) {
+                LOG << "Denominator filter coefficients set to " 
+                    << poly(&_coef_out[0],_coef_out.size()-1);
+        }
 }        
                 
  
@@ -2,7 +2,10 @@
 #define _DIGITAL_FILTER_HH 1
 
 #include "transfer_function.hh"
+#include "dsp/simd_filter.hh"
+#include "dsp/fft_convolver.hh"
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/math/tools/polynomial.hpp>
 #include <jack/jack.h>
 #include <string>
@@ -29,10 +32,50 @@ public:
         digital_filter();
         ~digital_filter(){}
        
-        // filters single buffer from a port and stores pad for that port 
+        // coefficients of a second-order section, normalized so a0 = 1
+        typedef dsp::biquad_t biquad_t;
+
+        // filters single buffer from a port and stores pad for that port.
+        // Looks up the port by name, and adds it if it's new, so realtime
+        // code should use the overload that takes a channel index.
         void 
         filter_buf(sample_t const * const in, sample_t * const out, 
-                        std::string port_name, nframes_t nframes);
+                        std::string const & port_name, nframes_t nframes);
+
+        // filters single buffer for a channel index returned by add_channel.
+        // Avoids looking up the channel by name.
+        void
+        filter_buf(sample_t const * const in, sample_t * const out,
+                   std::size_t channel, nframes_t nframes);
+
+        // filters channels [first, first + count), where in[i] and out[i]
+        // are the buffers for channel first + i. Channels are filtered
+        // group_size() at a time with SIMD instructions (custom IIR filters
+        // fall back to filter_buf). Channels with a null input are skipped.
+        // Calls from multiple threads must use ranges that start on a
+        // multiple of group_size(). For FIR filters out must not overlap in,
+        // unless the FFT engine is in use (see set_fft). The FFT engine keeps
+        // its own state, so a channel should be filtered either with
+        // filter_bufs or with filter_buf, not both.
+        void
+        filter_bufs(sample_t const * const * in, sample_t * const * out,
+                    std::size_t first, std::size_t count, nframes_t nframes);
+
+        // the number of channels filter_bufs processes together
+        std::size_t group_size() const {
+                return _fft ? _fft->group_size() : dsp::simd::lanes(_isa);
+        }
+
+        // the instruction set used by filter_bufs; detected at construction.
+        // set_isa must be called before adding channels, with an instruction
+        // set the cpu supports.
+        dsp::simd::isa_type isa() const {return _isa;}
+        void set_isa(dsp::simd::isa_type isa);
+
+        // allocates pads for a port and returns its index. filter_buf may be
+        // called from multiple threads for different ports once all the ports
+        // have been added.
+        std::size_t add_channel(std::string const & port_name);
 
         void reset_pads(); 
         
@@ -41,6 +84,33 @@ public:
         
         std::vector<COEF_t> coef_in() {return _coef_in;}
         std::vector<COEF_t> coef_out() {return _coef_out;}
+
+        // filters designed with butter() are run as a cascade of
+        // second-order sections; custom filters use the direct form
+        bool is_sos() const {return !_sos.empty();}
+        std::vector<biquad_t> const & sos() const {return _sos;}
+
+        // custom filters with a single denominator coefficient are FIR
+        // filters; these are the coefficients normalized by that term
+        bool is_fir() const {return !_fir_taps.empty();}
+
+        // FIR filters with at least this many taps are run by filter_bufs
+        // with partitioned FFT convolution instead of directly
+        static const std::size_t fft_min_taps = 256;
+
+        // sets the partition size of the FFT engine (0 to disable it). If
+        // uniform is false, the first block of taps is convolved directly,
+        // which keeps the latency at zero for any period; otherwise the
+        // latency is zero only if the period is a multiple of the block.
+        void set_fft(std::size_t block, bool uniform=false);
+        bool is_fft() const {return _fft.get() != 0;}
+
+        // sets the number of frames per call to filter_bufs, which the FFT
+        // engine needs to know to avoid latency. Resets filter state.
+        void set_period(nframes_t nframes);
+
+        // the delay (in frames) filter_bufs adds to the signal
+        nframes_t latency() const {return _fft ? _fft->latency() : 0;}
         
         void log_coefs();
         void log_filter(int N, std::vector<COEF_t> Wc, 
@@ -48,14 +118,45 @@ public:
         void custom_coef(std::vector<COEF_t>, std::vector<COEF_t>);       
         void butter(int N, std::vector<COEF_t> Wn, std::string filter_type, nframes_t fs);
 
+        // designs a linear-phase low-pass FIR filter with a Kaiser window.
+        // The pass band ends at Wp and the stop band starts at Wp + width
+        // (both relative to the Nyquist frequency); the number of taps is
+        // chosen to attenuate the stop band by at least attenuation dB.
+        static std::vector<COEF_t> kaiser_lowpass(COEF_t Wp, COEF_t width, COEF_t attenuation);
+
 
 protected:
                 
         std::vector<COEF_t> _coef_in;
         std::vector<COEF_t> _coef_out;
         
-        std::map<std::string, std::vector<COEF_t> > _pads_out;
-        std::map<std::string, std::vector<COEF_t> > _pads_in;
+        // the last pad_len() inputs and outputs of each channel, indexed
+        // like _sos_state so that filtering doesn't look up channel names
+        std::vector<std::vector<COEF_t> > _pads_out;
+        std::vector<std::vector<COEF_t> > _pads_in;
+
+        std::vector<biquad_t> _sos;
+        // state of the sections (2 per section) for each channel
+        std::vector<std::vector<COEF_t> > _sos_state;
+        std::map<std::string, std::size_t> _channels;
+        std::vector<std::string> _channel_names;
+
+        std::vector<COEF_t> _fir_taps;
+        dsp::simd::isa_type _isa;
+        // scratch space for filter_bufs, one for each group of channels
+        std::vector<std::vector<COEF_t> > _workspace;
+        void _resize_workspace();
+
+        std::size_t _fft_block;
+        bool _fft_uniform;
+        nframes_t _period;
+        boost::shared_ptr<dsp::fft_convolver> _fft;
+        void _make_fft();
+
+        void _filter_direct(sample_t const * const in, sample_t * const out,
+                            std::size_t channel, nframes_t nframes);
+        void _filter_sos(sample_t const * const in, sample_t * const out,
+                         std::size_t channel, nframes_t nframes);
 
         void _tf2coefficients(transfer_function H);
         COEF_t _prewarp(COEF_t Wn);
@@ -11,6 +11,7 @@
  */
 
 #include "block_ringbuffer.hh"
+#include <cassert>
 #include "../logging.hh"
 
 using namespace jill::dsp;
@@ -21,6 +22,10 @@ block_ringbuffer::block_ringbuffer(std::size_t size)
         : super(size), _read_ahead_ptr(0)
 {}
 
+block_ringbuffer::block_ringbuffer(std::size_t size, std::string const & backing_file)
+        : super(size, backing_file), _read_ahead_ptr(0)
+{}
+
 block_ringbuffer::~block_ringbuffer()
 {}
 
@@ -68,6 +73,14 @@ block_ringbuffer::peek() const
         return ptr;
 }
 
+data_block_t const *
+block_ringbuffer::peek(std::size_t offset) const
+{
+        data_block_t const * ptr = 0;
+        if (read_space() > offset)
+                ptr = reinterpret_cast<data_block_t const *>(buffer() + read_offset() + offset);
+        return ptr;
+}
 
 void
 block_ringbuffer::release()
@@ -80,9 +93,36 @@ block_ringbuffer::release()
         }
 }
 
+void
+block_ringbuffer::release(std::size_t bytes)
+{
+        assert(bytes <= read_space());
+        if (bytes == 0) return;    // pop(0,0) would release everything
+        _read_ahead_ptr = (_read_ahead_ptr > bytes) ? _read_ahead_ptr - bytes : 0;
+        super::pop(0, bytes);
+}
+
 void
 block_ringbuffer::release_all()
 {
         super::pop(0,0);
         _read_ahead_ptr = 0;
 }
+
+size_t
+block_ringbuffer::transfer(block_ringbuffer & dest)
+{
+        data_block_t const * ptr = peek();
+        if (ptr == 0 || ptr->size() > dest.write_space())
+                return 0;
+        size_t size = ptr->size();
+        bool read_ahead = (_read_ahead_ptr > 0);
+        assert(!read_ahead || dest.empty_ahead());
+        // blocks are contiguous in the mirrored buffer, so copy in one go
+        memcpy(dest.buffer() + dest.write_offset(), ptr, size);
+        dest.super::push(0, size);
+        if (read_ahead)
+                dest._read_ahead_ptr += size;
+        release();
+        return size;
+}
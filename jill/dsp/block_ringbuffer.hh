@@ -50,6 +50,15 @@ public:
          *  sampled data. A good minimum is nframes*nchannels*12
          */
         explicit block_ringbuffer(std::size_t size);
+
+        /**
+         * Initialize a file-backed ringbuffer. Useful as a second-tier store
+         * for data that can't fit in memory.
+         *
+         *  @param size          the size of the buffer, in bytes
+         *  @param backing_file  the path of the file to create
+         */
+        block_ringbuffer(std::size_t size, std::string const & backing_file);
         ~block_ringbuffer();
 
         /// @return the number of samples ahead of the read pointer the read-ahead pointer is
@@ -103,15 +112,50 @@ public:
          */
         data_block_t const * peek() const;
 
+        /**
+         * Read access to blocks in the read queue by position. This can be
+         * used to iterate through data that's been read ahead, for example.
+         *
+         * @param offset the number of bytes ahead of the oldest block. Must
+         *               be the start of a block.
+         * @return data_block_t* for the block, or 0 if offset is past the
+         * end of the read queue
+         */
+        data_block_t const * peek(std::size_t offset) const;
+
         /**
          * Release the oldest block in the read queue, making the memory
          * available to the write thread and advancing the read pointer
          */
         void release();
 
+        /**
+         * Release a run of blocks in one step. The caller is responsible for
+         * ensuring that bytes falls on a block boundary (for example, by
+         * using an offset obtained from peek(offset)).
+         *
+         * @param bytes  the number of bytes to release from the tail
+         */
+        void release(std::size_t bytes);
+
         /** Release all data in the read queue */
         void release_all();
 
+        /**
+         * Move the oldest block in the read queue to the end of another
+         * buffer. If the block had already been accessed with peek_ahead(),
+         * it's counted as read-ahead data in the destination, which must not
+         * have any blocks that haven't been read ahead.
+         *
+         * Not wait-free: the caller is responsible for ensuring that no other
+         * thread is accessing the read side of this buffer or the write side
+         * of the destination.
+         *
+         * @return the number of bytes moved, or 0 if this buffer is empty or
+         *         there wasn't room in the destination
+         */
+        std::size_t transfer(block_ringbuffer & dest);
+
 private:
         std::size_t _read_ahead_ptr; // the number of bytes ahead of the _read_ptr
 
@@ -11,6 +11,9 @@
  */
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <sys/time.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
@@ -19,6 +22,7 @@
 #include "../zmq.hh"
 #include "buffered_data_writer.hh"
 #include "block_ringbuffer.hh"
+#include "../util/thread_policy.hh"
 
 using namespace jill;
 using namespace jill::dsp;
@@ -41,6 +45,17 @@ using std::string;
  * Similarly, calls to stop() atomically update the _state variable so that
  * calls to push() no longer add data to the ringbuffer and so that the consumer
  * thread exits when the ringbuffer is fully flushed.
+ *
+ * If spilling is enabled, a helper thread moves blocks from the tail of the
+ * ringbuffer to a file-backed overflow buffer whenever the ringbuffer starts to
+ * fill up. The consumer reads from the overflow buffer first, and then from the
+ * ringbuffer, so the data stay in order. The read sides of both buffers are
+ * protected by _spill_lock, which the consumer holds except when it's waiting
+ * for data or calling the data_writer. This is why blocks in the ringbuffer are
+ * copied to a scratch buffer before they're written: otherwise the helper
+ * thread couldn't free space while the consumer is busy. Moving blocks doesn't
+ * change their order, so their offsets from the oldest block are stable. The
+ * producer never touches _spill_lock except to try to wake the helper.
  */
 
 buffered_data_writer::buffered_data_writer(boost::shared_ptr<data_writer> writer, size_t buffer_size)
@@ -53,6 +68,8 @@ buffered_data_writer::buffered_data_writer(boost::shared_ptr<data_writer> writer
         DBG << "buffered_data_writer initializing";
         pthread_mutex_init(&_lock, 0);
         pthread_cond_init(&_ready, 0);
+        pthread_mutex_init(&_spill_lock, 0);
+        pthread_cond_init(&_spill_ready, 0);
 }
 
 buffered_data_writer::~buffered_data_writer()
@@ -64,6 +81,8 @@ buffered_data_writer::~buffered_data_writer()
         // pthread_cancel(_thread_id);
         pthread_mutex_destroy(&_lock);
         pthread_cond_destroy(&_ready);
+        pthread_mutex_destroy(&_spill_lock);
+        pthread_cond_destroy(&_spill_ready);
         zmq_close(_socket);
         zmq_term(_context);
 }
@@ -86,6 +105,12 @@ buffered_data_writer::data_ready()
                 pthread_cond_signal (&_ready);
                 pthread_mutex_unlock (&_lock);
         }
+        if (_spill && _buffer->write_space() < _buffer->size() / 4) {
+                if (pthread_mutex_trylock (&_spill_lock) == 0) {
+                        pthread_cond_signal (&_spill_ready);
+                        pthread_mutex_unlock (&_spill_lock);
+                }
+        }
 }
 
 
@@ -137,9 +162,11 @@ buffered_data_writer::request_buffer_size(size_t bytes)
 {
         // block until the buffer is empty
         pthread_mutex_lock(&_lock);
+        pthread_mutex_lock(&_spill_lock);
         if (bytes > _buffer->size()) {
                 _buffer->resize(bytes);
         }
+        pthread_mutex_unlock(&_spill_lock);
         pthread_mutex_unlock(&_lock);
         return _buffer->size();
 }
@@ -151,17 +178,28 @@ buffered_data_writer::thread(void * arg)
         data_block_t const * hdr;
 
 	pthread_setcanceltype (PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+        util::apply_thread_policy(util::WRITER_THREAD);
 	pthread_mutex_lock (&self->_lock);
         self->_state = Running;
         self->_xrun = self->_reset = false;
         INFO << "started writer thread";
+        if (self->_spill) {
+                int ret = pthread_create(&self->_spill_thread_id, NULL,
+                                         buffered_data_writer::spill_thread, self);
+                if (ret != 0) {
+                        LOG << "ERROR: failed to start spill thread";
+                        self->_spill.reset();
+                }
+        }
 
+        pthread_mutex_lock (&self->_spill_lock);
         while (1) {
                 if (__sync_bool_compare_and_swap(&self->_xrun, true, false)) {
-                        self->_writer->xrun();
+                        self->store_xrun();
                 }
-                hdr = self->_buffer->peek_ahead();
+                hdr = self->peek_ahead();
                 if (hdr == 0) {
+                        pthread_mutex_unlock (&self->_spill_lock);
                         self->write_messages();
                         /* if ringbuffer empty and Stopping, exit loop */
                         if (self->_state == Stopping) {
@@ -169,30 +207,195 @@ buffered_data_writer::thread(void * arg)
                         }
                         /* otherwise flush to disk and wait for more data */
                         else {
-                                self->_writer->flush();
+                                self->flush();
                                 pthread_cond_wait (&self->_ready, &self->_lock);
                         }
+                        pthread_mutex_lock (&self->_spill_lock);
                 }
                 else {
                         self->write(hdr);
                 }
         }
-        self->_writer->close_entry();
+        if (self->_spill) {
+                pthread_mutex_lock (&self->_spill_lock);
+                pthread_cond_signal (&self->_spill_ready);
+                pthread_mutex_unlock (&self->_spill_lock);
+                pthread_join(self->_spill_thread_id, NULL);
+        }
+        self->close_entries();
         pthread_mutex_unlock(&self->_lock);
         self->_state = Stopped;
         INFO << "exited writer thread";
         return 0;
 }
 
+void *
+buffered_data_writer::spill_thread(void * arg)
+{
+        buffered_data_writer * self = static_cast<buffered_data_writer *>(arg);
+        std::size_t spilled = 0;
+        struct timeval now;
+        struct timespec timeout;
+
+        util::apply_thread_policy(util::WRITER_THREAD);
+        pthread_mutex_lock (&self->_spill_lock);
+        INFO << "started spill thread";
+        while (self->_state == Running) {
+                if (self->_buffer->write_space() < self->_buffer->size() / 4) {
+                        while (self->_buffer->write_space() < self->_buffer->size() / 2) {
+                                size_t bytes = self->_buffer->transfer(*self->_spill);
+                                if (bytes == 0) break;
+                                spilled += bytes;
+                        }
+                        INFO << "spilled " << spilled << " bytes to overflow buffer ("
+                             << self->_spill->read_space() << " in use)";
+                }
+                // the producer's signal can get lost if the consumer has the
+                // lock, so don't wait too long between checks
+                gettimeofday(&now, 0);
+                timeout.tv_sec = now.tv_sec + (now.tv_usec + 100000) / 1000000;
+                timeout.tv_nsec = ((now.tv_usec + 100000) % 1000000) * 1000;
+                pthread_cond_timedwait (&self->_spill_ready, &self->_spill_lock, &timeout);
+        }
+        pthread_mutex_unlock (&self->_spill_lock);
+        if (spilled > 0)
+                LOG << "spilled " << spilled << " bytes during run";
+        INFO << "exited spill thread";
+        return 0;
+}
+
 void
-buffered_data_writer::write(data_block_t const * data)
+buffered_data_writer::write(data_block_t const *)
 {
         // do we need to check that a complete period has been written?
         if (__sync_bool_compare_and_swap(&_reset, true, false)) {
-                _writer->close_entry();
+                close_entry(*_writer);
         }
-        _writer->write(data, 0, 0);
-        _buffer->release();
+        write_tail();
+}
+
+void
+buffered_data_writer::store_xrun()
+{
+        _writer->xrun();
+}
+
+void
+buffered_data_writer::flush()
+{
+        _writer->flush();
+}
+
+void
+buffered_data_writer::close_entries()
+{
+        _writer->close_entry();
+}
+
+void
+buffered_data_writer::command(std::string const & cmd)
+{
+        INFO << "ignoring command: " << cmd;
+}
+
+data_block_t const *
+buffered_data_writer::peek()
+{
+        if (_spill && !_spill->empty())
+                return _spill->peek();
+        return _buffer->peek();
+}
+
+data_block_t const *
+buffered_data_writer::peek(size_t offset)
+{
+        if (_spill) {
+                if (offset < _spill->read_space())
+                        return _spill->peek(offset);
+                offset -= _spill->read_space();
+        }
+        return _buffer->peek(offset);
+}
+
+data_block_t const *
+buffered_data_writer::peek_ahead()
+{
+        if (_spill && !_spill->empty_ahead())
+                return _spill->peek_ahead();
+        return _buffer->peek_ahead();
+}
+
+size_t
+buffered_data_writer::read_ahead_space() const
+{
+        if (_spill)
+                return _spill->read_ahead_space() + _buffer->read_ahead_space();
+        return _buffer->read_ahead_space();
+}
+
+void
+buffered_data_writer::release()
+{
+        if (_spill && !_spill->empty())
+                _spill->release();
+        else
+                _buffer->release();
+}
+
+void
+buffered_data_writer::release(size_t bytes)
+{
+        if (_spill) {
+                size_t n = std::min(bytes, _spill->read_space());
+                _spill->release(n);
+                bytes -= n;
+        }
+        _buffer->release(bytes);
+}
+
+void
+buffered_data_writer::write_block(data_writer & writer, data_block_t const * block,
+                                  nframes_t start, nframes_t stop)
+{
+        if (!_spill) {
+                writer.write(block, start, stop);
+                return;
+        }
+        // the helper thread only appends to the spill buffer, so blocks there
+        // stay valid until they're released. Blocks in the ringbuffer may be
+        // moved as soon as the lock is dropped.
+        char const * ptr = reinterpret_cast<char const *>(block);
+        if (ptr < _spill->buffer() || ptr >= _spill->buffer() + 2 * _spill->size()) {
+                _scratch.resize(block->size());
+                memcpy(&_scratch[0], block, block->size());
+                block = reinterpret_cast<data_block_t const *>(&_scratch[0]);
+        }
+        pthread_mutex_unlock(&_spill_lock);
+        writer.write(block, start, stop);
+        pthread_mutex_lock(&_spill_lock);
+}
+
+void
+buffered_data_writer::write_tail(nframes_t start, nframes_t stop)
+{
+        write_block(*_writer, peek(), start, stop);
+        release();
+}
+
+void
+buffered_data_writer::new_entry(data_writer & writer, nframes_t frame)
+{
+        pthread_mutex_unlock(&_spill_lock);
+        writer.new_entry(frame);
+        pthread_mutex_lock(&_spill_lock);
+}
+
+void
+buffered_data_writer::close_entry(data_writer & writer)
+{
+        pthread_mutex_unlock(&_spill_lock);
+        writer.close_entry();
+        pthread_mutex_lock(&_spill_lock);
 }
 
 void
@@ -221,9 +424,21 @@ buffered_data_writer::write_messages()
                                      zmq::msg_str(messages[0]),
                                      zmq::msg_str(messages[2]));
                 }
+                else if (messages.size() == 1) {
+                        command(zmq::msg_str(messages[0]));
+                }
         }
 }
 
+void
+buffered_data_writer::enable_spill(std::string const & path, size_t bytes)
+{
+        if (_state != Stopped)
+                throw std::runtime_error("Tried to enable spilling while writer thread is running");
+        _spill.reset(new block_ringbuffer(bytes, path));
+        LOG << "overflow buffer size (bytes): " << _spill->size();
+}
+
 void
 buffered_data_writer::bind_logger(std::string const & server_name)
 {
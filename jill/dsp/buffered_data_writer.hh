@@ -13,6 +13,7 @@
 #define _BUFFERED_DATA_WRITER_HH
 
 #include <iosfwd>
+#include <vector>
 #include <pthread.h>
 #include <boost/shared_ptr.hpp>
 #include "../data_thread.hh"
@@ -30,6 +31,11 @@ class block_ringbuffer;
  * storing the data (and log messages) is provided through an owned data_writer.
  * This implementation records continuously, though other threads may call
  * reset() to split data into separate entries.
+ *
+ * Optionally, data can be spilled to a file-backed overflow buffer when the
+ * writer thread falls behind (e.g. during a slow flush). A helper thread moves
+ * the oldest blocks out of the ringbuffer when it starts to fill up, and the
+ * writer thread reads them back in order.
  */
 class buffered_data_writer : public data_thread {
 
@@ -77,11 +83,25 @@ public:
          */
         void bind_logger(std::string const & server_name);
 
+        /**
+         * Enable spilling to a file-backed overflow buffer. When the free
+         * space in the ringbuffer drops below 1/4 of its size, a helper thread
+         * moves the oldest data into the overflow buffer until half the
+         * ringbuffer is free again. push() remains wait-free.
+         *
+         * @param path   the location of the spill file. It's preallocated and
+         *               deleted as soon as it's created.
+         * @param bytes  the size of the overflow buffer
+         *
+         * @pre the writer thread is not running
+         */
+        void enable_spill(std::string const & path, std::size_t bytes);
+
 protected:
         /**
          * Entry point for deriving classes to handle data pulled off the
          * ringbuffer. Deriving classes *must* release data using
-         * _buffer->release() when they are done with the data or the buffer
+         * release() when they are done with the data or the buffer
          * will overrun.
          *
          * @param data   the header and data for the period. may be null if
@@ -89,9 +109,83 @@ protected:
          */
         virtual void write(data_block_t const * data);
 
+        /** Mark an xrun in the output. Called by the writer thread. */
+        virtual void store_xrun();
+
+        /** Flush the output to disk. Called by the writer thread when idle. */
+        virtual void flush();
+
+        /** Close any open entries. Called by the writer thread before exiting. */
+        virtual void close_entries();
+
+        /**
+         * Handle a command received on the message socket. Commands are sent
+         * as single-part messages, to distinguish them from log messages. The
+         * default implementation ignores them.
+         */
+        virtual void command(std::string const & cmd);
+
+        /*
+         * Deriving classes should use the following functions to access data
+         * in the buffer, because some of it may have been spilled. Pointers
+         * returned by peek() and peek_ahead() are invalidated by any call to
+         * write_block(), write_tail(), new_entry(), or close_entry(), but the
+         * offsets of unreleased blocks don't change until release() is called.
+         */
+
+        /** The oldest unreleased block. @see block_ringbuffer::peek() */
+        data_block_t const * peek();
+
+        /**
+         * Access unreleased blocks by position.
+         *
+         * @param offset  the number of bytes ahead of the oldest block. Must
+         *                be the start of a block.
+         * @return the block at offset, or 0 if offset is past the last block
+         */
+        data_block_t const * peek(std::size_t offset);
+
+        /** Read-ahead access to unread blocks. @see block_ringbuffer::peek_ahead() */
+        data_block_t const * peek_ahead();
+
+        /** The number of bytes that have been read ahead but not released */
+        std::size_t read_ahead_space() const;
+
+        /** Release the oldest unreleased block */
+        void release();
+
+        /**
+         * Release the oldest unreleased blocks in one step.
+         *
+         * @param bytes  the number of bytes to release. Must be the offset of
+         *               a block, as used by peek(offset).
+         */
+        void release(std::size_t bytes);
+
+        /**
+         * Write a block of data to an output. Unlocks the buffer while the
+         * output is busy, so pointers to blocks are invalidated.
+         *
+         * @param writer the output
+         * @param block  the block, obtained from one of the peek functions
+         * @param start  if nonzero, only write frames >= start
+         * @param stop   if nonzero, only write frames < stop
+         */
+        void write_block(data_writer & writer, data_block_t const * block,
+                         nframes_t start=0, nframes_t stop=0);
+
+        /** Write the oldest unreleased block to _writer and release it. */
+        void write_tail(nframes_t start=0, nframes_t stop=0);
+
+        /** Create a new entry in an output. @see data_writer::new_entry() */
+        void new_entry(data_writer & writer, nframes_t frame);
+
+        /** Close the current entry in an output. @see data_writer::close_entry() */
+        void close_entry(data_writer & writer);
+
         /**
-         * Collect log messages from the zmq socket and write them. Call this
-         * when load is low.
+         * Collect log messages and commands from the zmq socket and write or
+         * dispatch them. Call this when load is low.
          */
         void write_messages();
 
@@ -100,6 +194,7 @@ protected:
 
         boost::shared_ptr<data_writer> _writer;            // output
         boost::shared_ptr<block_ringbuffer> _buffer;      // ringbuffer
+        boost::shared_ptr<block_ringbuffer> _spill;       // overflow buffer (optional)
 
 private:
         pthread_mutex_t _lock;                     // mutex for condition variable
@@ -107,6 +202,12 @@ private:
         static void * thread(void * arg);           // the thread entry point
         pthread_t _thread_id;                      // thread id
         bool _xrun;                                // flag to indicate xrun
+        // variables for spilling data
+        pthread_mutex_t _spill_lock;               // protects read side of buffers
+        pthread_cond_t  _spill_ready;              // indicates buffer filling up
+        static void * spill_thread(void * arg);     // the spill thread entry point
+        pthread_t _spill_thread_id;
+        std::vector<char> _scratch;                // copy of block being written
         // variables for receiving incoming messages
         void * _context;
         void * _socket;
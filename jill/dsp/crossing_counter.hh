@@ -12,11 +12,33 @@
 #ifndef _CROSSING_COUNTER_HH
 #define _CROSSING_COUNTER_HH
 
+#include <cmath>
+#include <algorithm>
 #include <boost/noncopyable.hpp>
 #include "counter.hh"
+#include "simd_filter.hh"
 
 namespace jill { namespace dsp {
 
+/**
+ * The number of rising crossings of thresh between consecutive samples in
+ * x[0, nframes). Blocks of floats are counted with the SIMD kernels.
+ */
+template<typename T> inline
+std::size_t count_crossings(simd::isa_type, const T * x, std::size_t nframes, T thresh)
+{
+	std::size_t count = 0;
+	for (std::size_t i = 1; i < nframes; ++i)
+		count += (x[i-1] < thresh) & (x[i] >= thresh);
+	return count;
+}
+
+inline
+std::size_t count_crossings(simd::isa_type isa, const float * x, std::size_t nframes, float thresh)
+{
+	return simd::crossings(isa, x, nframes, thresh);
+}
+
 /**
  * Counts the number of times a signal crosses a threshold within a time window.
  *
@@ -34,7 +56,8 @@ public:
 
 	crossing_counter(const sample_type &threshold, size_type period_size, size_type period_count)
 		:  _counter(period_count), _thresh(threshold), _period_size(period_size),
-		   _period_crossings(0), _period_nsamples(0) {
+		   _period_crossings(0), _period_nsamples(0), _period_end(0), _period_end_crossings(0),
+		   _period_end_count(0), _last(NAN), _isa(simd::detect()) {
 		_max_crossings = period_count * _period_size / 2;
 	}
 
@@ -46,8 +69,15 @@ public:
 	 * value of the function indicates the block in which the count crossed
 	 * this threshold.
 	 *
+	 * Crossings are counted with count_crossings() on each stretch of
+	 * samples between period boundaries, and the state buffer is filled
+	 * once per stretch rather than once per sample. The last sample of
+	 * each block is kept, so that crossings between blocks are counted
+	 * and the periods are the same however the signal is divided into
+	 * blocks.
+	 *
 	 * @param samples      A buffer of samples to analyze
-	 * @param size         The number of samples in the buffer. Must be at least 2
+	 * @param size         The number of samples in the buffer
 	 * @param count_thresh The count threshold. Can be negative or positive,
 	 *                     to indicate which crossing direction to look for.
 	 * @param state        If this is not null, copies the running count in each sample
@@ -55,15 +85,58 @@ public:
 	 *                     Useful for debug.
 	 *
 	 * @returns  -1 if no crossing occurred (including calls with samples < period_size)
-	 *           N=0+ if a crossing occurred in the Nth block of data
+	 *           N=0+ if a crossing occurred in the Nth block of data; the
+	 *           end of that period in the buffer is given by period_end()
 	 *
 	 */
- 	int push(const sample_type * samples, size_type size, count_type count_thresh, sample_type * state=0) {
+	int push(const sample_type * samples, size_type size, count_type count_thresh, sample_type * state=0) {
+		int ret = -1, period = 0;
+		sample_type const thresh = _thresh;
+		// the block is split at period boundaries; each segment
+		// covers samples [i, i + n), with crossings counted against
+		// the preceding sample
+		for (size_t i = 0; i < size; ) {
+			size_t n = std::min(size - i, _period_size - _period_nsamples);
+			if (i == 0)
+				_period_crossings += (_last < thresh && samples[0] >= thresh)
+					+ count_crossings(_isa, samples, n, thresh);
+			else
+				_period_crossings += count_crossings(_isa, samples + i - 1, n + 1, thresh);
+			_period_nsamples += n;
+			if (state)
+				std::fill(state + i, state + i + n - 1,
+					  float(_counter.running_count()) / _max_crossings);
+			i += n;
+			if (_period_nsamples >= _period_size)
+			{
+				_counter.push(_period_crossings);
+				if (_counter.full() && ret < 0) {
+					if (count_thresh > 0 && _counter.running_count() > count_thresh)
+						ret = period;
+					else if (count_thresh < 0 && _counter.running_count() < -count_thresh)
+						ret = period;
+					if (ret >= 0) mark_period(i);
+				} // if (ret < 0)
+				period += 1;
+				_period_nsamples = 0;
+				_period_crossings = 0;
+			}
+			if (state)
+				state[i - 1] = float(_counter.running_count()) / _max_crossings;
+			// here, ret should be the period in blocks or -1 if no crossing
+		}
+		if (size) _last = samples[size - 1];
+		return ret;
+	}
+
+	/**
+	 * Analyze a block of samples one at a time. This gives the same
+	 * results as push(), and is kept as a reference for testing.
+	 */
+	int push_scalar(const sample_type * samples, size_type size, count_type count_thresh, sample_type * state=0) {
 		int ret = -1, period = 0;
-		sample_type last = *samples;
-		if (state)
-			state[0] = float(_counter.running_count()) / _max_crossings;
-		for (size_t i = 1; i < size; ++i) {
+		sample_type last = _last;
+		for (size_t i = 0; i < size; ++i) {
 			// I only check positive crossings because
 			// it's faster and there's not much point in
 			// counting both for most signals
@@ -79,6 +152,7 @@ public:
 						ret = period;
 					else if (count_thresh < 0 && _counter.running_count() < -count_thresh)
 						ret = period;
+					if (ret >= 0) mark_period(i + 1);
 				} // if (ret < 0)
 				period += 1;
 				_period_nsamples = 0;
@@ -88,24 +162,46 @@ public:
 				state[i] = float(_counter.running_count()) / _max_crossings;
 			// here, ret should be the period in blocks or -1 if no crossing
 		}
+		_last = last;
 		return ret;
 	}
 
 	/** The state of the counter */
 	int count() const { return _counter.running_count(); }
 
-	/** reset the queue */
+	/** reset the queue; the next block starts a new period */
 	void reset() {
 		_counter.reset();
 		_period_crossings = 0;
 		_period_nsamples = 0;
+		_last = NAN;
 	}
         /** @return the size of the analysis period (in samples) */
 	size_type period_size() const { return _period_size; }
+        /**
+         * @return the offset in the last buffer passed to push() just past
+         * the end of the period in which the count crossed the threshold.
+         * Only meaningful if push() returned a period.
+         */
+        size_type period_end() const { return _period_end; }
+        /** @return the number of crossings in the period that crossed the threshold */
+        count_type period_end_crossings() const { return _period_end_crossings; }
+        /** @return the running count at the end of that period */
+        count_type period_end_count() const { return _period_end_count; }
         /** @return current value of the threshold. */
         sample_type thresh() const { return _thresh;}
 
+        /** the instruction set used to count crossings; detected at construction */
+        simd::isa_type isa() const { return _isa; }
+        void set_isa(simd::isa_type isa) { _isa = isa; }
+
 private:
+        void mark_period(size_type end) {
+                _period_end = end;
+                _period_end_crossings = _period_crossings;
+                _period_end_count = _counter.running_count();
+        }
+
         /// running count of crossings
         running_counter<count_type> _counter;
 
@@ -120,8 +216,17 @@ private:
 	count_type _period_crossings;
 	/// number of samples analyzed in the current period
 	size_type _period_nsamples;
+        /// end of the period where the count last crossed the threshold, and
+        /// the counts at that point
+        size_type _period_end;
+        count_type _period_end_crossings;
+        count_type _period_end_count;
+        /// last sample of the previous block (NaN before the first)
+        sample_type _last;
         /// max possible crossings in the period (used to normalize)
 	count_type _max_crossings;
+        /// instruction set for counting crossings
+        simd::isa_type _isa;
 
 };
 
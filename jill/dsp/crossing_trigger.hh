@@ -25,6 +25,12 @@ namespace jill { namespace dsp {
  * different from the open threshhold) more than a certain number of times in a
  * time window the gate closes.
  *
+ * The state changes are located to the sample. When the gate opens, the
+ * change is placed at the crossing that brought the running count over its
+ * threshold; when it closes, at the last crossing of the closing threshold in
+ * the period where the count fell below its threshold. Only the samples of
+ * that period are searched, and only when the state changes, so the cost of
+ * counting crossings is the same as without the refinement.
  */
 template <typename T>
 class crossing_trigger : boost::noncopyable {
@@ -50,14 +56,19 @@ public:
 		  _open_counter(othresh, period_size, owindow_periods),
 		  _close_counter(cthresh, period_size, cwindow_periods),
 		  _open_count_thresh(ocount_thresh),
-		  _close_count_thresh(-ccount_thresh) {} // note sign reversal
+		  _close_count_thresh(-ccount_thresh), // note sign reversal
+		  _change_time(0) {}
 
 	/**
 	 *  Analyze a block of samples. Depending on the state of the detector,
 	 *  they are either pushed to the open-threshold counter or the
 	 *  close-threshold counter. If the active counter changes state, the
 	 *  gate is opened or closed, and the offset in the supplied data where
-	 *  this occurred (to the nearest period) is returned. If no state
+	 *  this occurred is returned: the sample of the crossing that opened
+	 *  the gate, or of the last crossing before it closed. If the
+	 *  crossing that opened the gate was in an earlier block, the offset
+	 *  is 0; if there were no crossings in the period where the gate
+	 *  closed, the offset is the last sample of that period. If no state
 	 *  changed, -1 is returned.
 	 *
 	 *  @param samples    The input samples
@@ -72,7 +83,7 @@ public:
 		if (_open) {
 			int per = _close_counter.push(samples, size, _close_count_thresh, counts);
 			if (per > -1) {
-				int offset = per * _close_counter.period_size();
+				int offset = find_offset(samples);
 				_open = false;
 				_close_counter.reset();
 				// push samples after offset to open counter
@@ -84,7 +95,7 @@ public:
 		else {
 			int per = _open_counter.push(samples, size, _open_count_thresh, counts);
 			if (per > -1) {
-				int offset = per * _open_counter.period_size();
+				int offset = find_onset(samples);
 				_open = true;
 				_open_counter.reset();
 				// push samples after offset to close counter
@@ -99,6 +110,13 @@ public:
         /** The state of the detector */
 	bool open() const { return _open; }
 
+        /**
+         * The time of the last state change, relative to the start of the
+         * block passed to push(), with the crossing interpolated between
+         * samples. Lies in (offset - 1, offset].
+         */
+        double change_time() const { return _change_time; }
+
         /** The threshold for going to an open state */
 	sample_type &open_thresh() { return _open_counter.thresh(); }
 
@@ -107,11 +125,66 @@ public:
 
 private:
 
+        /* the start of the part of the triggering period in this block */
+        static size_type period_start(crossing_counter<sample_type> const & counter) {
+                size_type const end = counter.period_end();
+                return (end > counter.period_size()) ? end - counter.period_size() : 0;
+        }
+
+        /* the fraction of the interval between a and b where the signal crosses t */
+        static double interpolate(sample_type a, sample_type b, sample_type t) {
+                return (b > a) ? double(t - a) / (b - a) : 1.0;
+        }
+
+        /*
+         * The crossing in the triggering period that brought the running
+         * count over the threshold. Some of the period's crossings may have
+         * been in the previous block.
+         */
+        int find_onset(const sample_type * samples) {
+                size_type const start = period_start(_open_counter);
+                size_type const first = std::max(start, size_type(1));
+                size_type const end = _open_counter.period_end();
+                sample_type const t = _open_counter.thresh();
+                int const visible = count_crossings(_open_counter.isa(), samples + first - 1,
+                                                    end - first + 1, t);
+                int const earlier = _open_counter.period_end_count() - _open_counter.period_end_crossings();
+                int target = _open_count_thresh + 1 - earlier
+                        - (_open_counter.period_end_crossings() - visible);
+                // if the window only just filled, the count may have been over
+                // the threshold before this period
+                if (_open_counter.period_end_crossings() == visible) target = std::max(target, 1);
+                for (size_type k = first; target > 0 && k < end; ++k) {
+                        if (samples[k-1] < t && samples[k] >= t && --target == 0) {
+                                _change_time = k - 1 + interpolate(samples[k-1], samples[k], t);
+                                return k;
+                        }
+                }
+                _change_time = start;
+                return start;
+        }
+
+        /* the last crossing of the closing threshold in the triggering period */
+        int find_offset(const sample_type * samples) {
+                size_type const start = period_start(_close_counter);
+                size_type const end = _close_counter.period_end();
+                sample_type const t = _close_counter.thresh();
+                for (size_type k = end; k-- > std::max(start, size_type(1)); ) {
+                        if (samples[k-1] < t && samples[k] >= t) {
+                                _change_time = k - 1 + interpolate(samples[k-1], samples[k], t);
+                                return k;
+                        }
+                }
+                _change_time = end - 1;
+                return end - 1;
+        }
+
 	bool _open;
 	crossing_counter<sample_type> _open_counter;
 	crossing_counter<sample_type> _close_counter;
 	int _open_count_thresh;
 	int _close_count_thresh;
+        double _change_time;
 };
 
 }} // namespace
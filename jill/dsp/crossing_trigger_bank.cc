@@ -0,0 +1,182 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "crossing_trigger_bank.hh"
+
+using namespace jill::dsp;
+
+crossing_trigger_bank::crossing_trigger_bank(size_type nchannels,
+                                             sample_type othresh, count_type ocount_thresh,
+                                             size_type owindow_periods,
+                                             sample_type cthresh, count_type ccount_thresh,
+                                             size_type cwindow_periods,
+                                             size_type period_size)
+        : _nchannels(nchannels), _period_size(period_size), _isa(simd::detect()),
+          _open(nchannels), _last(nchannels), _crossings(nchannels), _running(nchannels),
+          _filled(nchannels),
+          _history(std::max(owindow_periods, cwindow_periods) * nchannels)
+{
+        if (period_size < 1 || owindow_periods < 1 || cwindow_periods < 1)
+                throw std::invalid_argument("trigger periods and windows must be at least 1");
+        _thresh[0] = othresh;
+        _thresh[1] = cthresh;
+        _count_thresh[0] = ocount_thresh;
+        _count_thresh[1] = ccount_thresh;
+        _window[0] = owindow_periods;
+        _window[1] = cwindow_periods;
+        reset();
+}
+
+void
+crossing_trigger_bank::reset()
+{
+        _period_nsamples = 0;
+        _head = 0;
+        std::fill(_open.begin(), _open.end(), 0);
+        // comparisons with the first sample are false
+        std::fill(_last.begin(), _last.end(), NAN);
+        std::fill(_crossings.begin(), _crossings.end(), 0);
+        std::fill(_running.begin(), _running.end(), 0);
+        std::fill(_filled.begin(), _filled.end(), 0);
+        std::fill(_history.begin(), _history.end(), 0);
+}
+
+crossing_trigger_bank::size_type
+crossing_trigger_bank::push(sample_type const * const * samples, size_type nframes,
+                            event_type * events, size_type max_events,
+                            sample_type * const * counts)
+{
+        size_type nevents = 0;
+        for (size_type i = 0; i < nframes; ) {
+                size_type const n = std::min(nframes - i, _period_size - _period_nsamples);
+                bool const period_done = _period_nsamples + n == _period_size;
+                for (size_type c = 0; c < _nchannels; ++c) {
+                        sample_type const * x = samples[c] + i;
+                        sample_type const t = _thresh[_open[c]];
+                        _crossings[c] += (_last[c] < t) & (x[0] >= t);
+                        _crossings[c] += simd::crossings(_isa, x, n, t);
+                        _last[c] = x[n - 1];
+                        if (counts && counts[c]) {
+                                size_type const w = _window[_open[c]];
+                                std::fill(counts[c] + i, counts[c] + i + n - period_done,
+                                          sample_type(_running[c]) / (w * _period_size / 2));
+                        }
+                }
+                _period_nsamples += n;
+                i += n;
+                if (period_done) {
+                        nevents += end_period(samples, i, events + nevents, max_events - nevents);
+                        if (counts) {
+                                for (size_type c = 0; c < _nchannels; ++c) {
+                                        if (!counts[c]) continue;
+                                        size_type const w = _window[_open[c]];
+                                        counts[c][i - 1] = sample_type(_running[c]) / (w * _period_size / 2);
+                                }
+                        }
+                }
+        }
+        return nevents;
+}
+
+crossing_trigger_bank::size_type
+crossing_trigger_bank::end_period(sample_type const * const * samples, size_type end,
+                                  event_type * events, size_type max_events)
+{
+        size_type const nrows = _history.size() / _nchannels;
+        count_type * row = &_history[_head * _nchannels];
+        // the rows that drop out of the opening and closing windows
+        count_type const * old[2] = {
+                &_history[((_head + nrows - _window[0]) % nrows) * _nchannels],
+                &_history[((_head + nrows - _window[1]) % nrows) * _nchannels]
+        };
+
+        // update the running counts; no branches, so the loop can be vectorized
+        for (size_type c = 0; c < _nchannels; ++c) {
+                count_type const state = _open[c];
+                count_type const window = _window[state];
+                count_type const full = _filled[c] >= window;
+                count_type const dropped = (state ? old[1][c] : old[0][c]) * full;
+                count_type const count = _crossings[c];
+                _running[c] += count - dropped;
+                _filled[c] = std::min(_filled[c] + 1, window);
+                _crossings[c] = 0;
+                row[c] = count;
+        }
+        _head = (_head + 1) % nrows;
+        _period_nsamples = 0;
+
+        // check the thresholds; state changes are rare, so the search for
+        // the crossing where the state changed can be done here
+        size_type nevents = 0;
+        for (size_type c = 0; c < _nchannels; ++c) {
+                count_type const state = _open[c];
+                if (_filled[c] < count_type(_window[state])) continue;
+                bool const change = state ? (_running[c] < _count_thresh[1])
+                        : (_running[c] > _count_thresh[0]);
+                if (!change) continue;
+                if (nevents < max_events) {
+                        size_type const offset = state ? find_offset(samples[c], end, c)
+                                : find_onset(samples[c], end, c);
+                        // keep the events in order of offset
+                        size_type k = nevents++;
+                        for (; k > 0 && events[k-1].offset > offset; --k)
+                                events[k] = events[k-1];
+                        event_type e = { c, offset, !state };
+                        events[k] = e;
+                }
+                _open[c] = !state;
+                _running[c] = 0;
+                _filled[c] = 0;
+        }
+        return nevents;
+}
+
+/*
+ * These parallel crossing_trigger::find_onset and find_offset. They are called
+ * before the state changes, while _running holds the count at the end of the
+ * triggering period and the period's crossings are in the newest row of
+ * _history.
+ */
+crossing_trigger_bank::size_type
+crossing_trigger_bank::find_onset(sample_type const * x, size_type end, size_type channel) const
+{
+        size_type const nrows = _history.size() / _nchannels;
+        size_type const start = (end > _period_size) ? end - _period_size : 0;
+        size_type const first = std::max(start, size_type(1));
+        sample_type const t = _thresh[0];
+        count_type const crossings = _history[((_head + nrows - 1) % nrows) * _nchannels + channel];
+        count_type const visible = simd::crossings(_isa, x + first - 1, end - first + 1, t);
+        count_type const earlier = _running[channel] - crossings;
+        count_type target = _count_thresh[0] + 1 - earlier - (crossings - visible);
+        // if the window only just filled, the count may have been over the
+        // threshold before this period
+        if (crossings == visible) target = std::max(target, 1);
+        for (size_type k = first; target > 0 && k < end; ++k) {
+                if (x[k-1] < t && x[k] >= t && --target == 0)
+                        return k;
+        }
+        return start;
+}
+
+crossing_trigger_bank::size_type
+crossing_trigger_bank::find_offset(sample_type const * x, size_type end, size_type) const
+{
+        size_type const start = (end > _period_size) ? end - _period_size : 0;
+        sample_type const t = _thresh[1];
+        for (size_type k = end; k-- > std::max(start, size_type(1)); ) {
+                if (x[k-1] < t && x[k] >= t)
+                        return k;
+        }
+        return end - 1;
+}
@@ -0,0 +1,124 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _CROSSING_TRIGGER_BANK_HH
+#define _CROSSING_TRIGGER_BANK_HH
+
+#include <vector>
+#include <stdint.h>
+#include "trigger_bank.hh"
+#include "simd_filter.hh"
+
+namespace jill { namespace dsp {
+
+/**
+ * A set of crossing triggers (@see jill::dsp::crossing_trigger) sharing the
+ * same parameters, one for each of a number of channels. The state of the
+ * triggers is kept in arrays indexed by channel, so that the update at the
+ * end of each analysis period is a branch-free loop over the channels, and
+ * crossings are counted with the SIMD kernels in simd_filter.
+ *
+ * State changes are located to the sample in the same way as in
+ * crossing_trigger: an onset is placed at the crossing that brought the
+ * running count over its threshold, and an offset at the last crossing of the
+ * closing threshold in the period where the count fell below its threshold
+ * (or at the last sample of that period if there were none). Only the part of
+ * the period in the current block is searched, so an onset crossing from an
+ * earlier block is reported at offset 0.
+ *
+ * The analysis periods are aligned across channels and run continuously
+ * from one block to the next. This is the one difference from
+ * crossing_trigger, which starts a new period at the sample where the gate
+ * changed state: here the newly active counter starts with the next period,
+ * so the following state change can be decided up to a period earlier or
+ * later than it would be by crossing_trigger.
+ */
+class crossing_trigger_bank : public trigger_bank {
+public:
+        typedef int32_t count_type;
+
+        /**
+         * @param nchannels        the number of channels
+         * @param othresh          the opening threshold (in sample units)
+         * @param ocount_thresh    the gate opens when crossings exceed this count
+         * @param owindow_periods  the number of periods to analyze for opening
+         * @param cthresh          the closing threshold (in sample units)
+         * @param ccount_thresh    the gate closes when crossings drop below this count
+         * @param cwindow_periods  the number of periods to analyze for closing
+         * @param period_size      the size of the analysis period
+         */
+        crossing_trigger_bank(size_type nchannels,
+                              sample_type othresh, count_type ocount_thresh, size_type owindow_periods,
+                              sample_type cthresh, count_type ccount_thresh, size_type cwindow_periods,
+                              size_type period_size);
+
+        /**
+         * Analyze a block of samples from each channel (@see
+         * trigger_bank::push). There can be an event for each channel in
+         * each period that ends in the block. The counts are the running
+         * counts of the active counters, normalized to the most crossings
+         * possible.
+         */
+        size_type push(sample_type const * const * samples, size_type nframes,
+                       event_type * events, size_type max_events,
+                       sample_type * const * counts=0);
+
+        size_type max_events(size_type nframes) const {
+                return _nchannels * (nframes / _period_size + 1);
+        }
+
+        bool open(size_type channel) const { return _open[channel]; }
+
+        /** the running count of the active counter for a channel */
+        count_type count(size_type channel) const { return _running[channel]; }
+
+        size_type nchannels() const { return _nchannels; }
+        size_type period_size() const { return _period_size; }
+
+        void reset();
+
+        /** the instruction set used to count crossings; detected at construction */
+        simd::isa_type isa() const { return _isa; }
+        void set_isa(simd::isa_type isa) { _isa = isa; }
+
+private:
+        /*
+         * update the counters at the end of a period, which is at end in the
+         * current block; returns the number of events, in order of offset
+         */
+        size_type end_period(sample_type const * const * samples, size_type end,
+                             event_type * events, size_type max_events);
+
+        /* locate a state change in the part of the period in the current block */
+        size_type find_onset(sample_type const * x, size_type end, size_type channel) const;
+        size_type find_offset(sample_type const * x, size_type end, size_type channel) const;
+
+        size_type _nchannels;
+        sample_type _thresh[2];                 // indexed by gate state
+        count_type _count_thresh[2];
+        size_type _window[2];
+        size_type _period_size;
+        simd::isa_type _isa;
+
+        size_type _period_nsamples;             // shared by all channels
+        size_type _head;                        // next row of _history
+
+        // per-channel state
+        std::vector<uint8_t> _open;
+        std::vector<sample_type> _last;         // last sample of the previous block
+        std::vector<count_type> _crossings;     // in the current period
+        std::vector<count_type> _running;       // sum over the active window
+        std::vector<count_type> _filled;        // periods in the active window
+        std::vector<count_type> _history;       // period counts; one row per period
+};
+
+}}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/type_traits/make_signed.hpp>
+
+#include "decimating_writer.hh"
+#include "../logging.hh"
+
+using namespace jill;
+using namespace jill::dsp;
+using std::string;
+
+/** A data type for comparing differences between frame counts */
+typedef boost::make_signed<nframes_t>::type framediff_t;
+
+decimating_writer::decimating_writer(boost::shared_ptr<data_writer> writer, std::size_t factor,
+                                     nframes_t sampling_rate)
+        : _writer(writer), _factor(factor), _sampling_rate(sampling_rate), _entry_start(0)
+{
+        if (factor < 1 || sampling_rate % factor != 0)
+                throw std::invalid_argument("decimation factor must divide the sampling rate");
+}
+
+void
+decimating_writer::add_channel(string const & id, string const & output, bool keep)
+{
+        channel_type ch;
+        ch.output = output;
+        ch.keep = keep;
+        ch.filter.reset(new decimator(_factor));
+        ch.aligned = false;
+        ch.skip = 0;
+        ch.next_frame = 0;
+        _channels[id] = ch;
+        _writer->set_sampling_rate(output, _sampling_rate / _factor);
+        LOG << "decimating " << id << " -> " << output << " (" << _sampling_rate / _factor
+            << " Hz, " << ch.filter->ntaps() << " taps, compensated delay " << ch.filter->delay()
+            << " frames)";
+}
+
+void
+decimating_writer::new_entry(nframes_t frame)
+{
+        _writer->new_entry(frame);
+        _entry_start = frame;
+        for (channel_map::iterator it = _channels.begin(); it != _channels.end(); ++it)
+                it->second.aligned = false;
+}
+
+void
+decimating_writer::write(data_block_t const * data, nframes_t start, nframes_t stop)
+{
+        if (!_writer->ready()) {
+                // start the entry here, as the block's decimated output may
+                // be empty while the filter delay is being dropped
+                new_entry(data->time + start);
+        }
+        channel_map::iterator it = _channels.end();
+        if (data->dtype == SAMPLED)
+                it = _channels.find(data->id());
+        if (it == _channels.end()) {
+                _writer->write(data, start, stop);
+                return;
+        }
+
+        channel_type & ch = it->second;
+        nframes_t const nframes = data->nframes();
+        stop = (stop > 0) ? std::min(stop, nframes) : nframes;
+        if (stop > start) {
+                nframes_t const first = data->time + start;
+                if (!ch.aligned) {
+                        if (first != ch.next_frame) ch.filter->reset();
+                        // the output for the start of the entry comes delay()
+                        // frames later; earlier outputs are dropped
+                        nframes_t const start_out = _entry_start + ch.filter->delay();
+                        framediff_t const lead = start_out - first;
+                        if (lead >= 0) {
+                                ch.filter->set_phase(lead % _factor);
+                                ch.skip = lead / _factor;
+                        }
+                        else {
+                                ch.filter->set_phase(_factor - (-lead) % _factor);
+                                ch.skip = 0;
+                        }
+                        ch.aligned = true;
+                }
+                ch.next_frame = data->time + stop;
+
+                // write the decimated data first, so the writer's record of
+                // the last frame comes from the full-rate data
+                // the samples follow the id in the block, so they may not
+                // be aligned
+                _input.resize(stop - start);
+                std::memcpy(&_input[0], static_cast<char const *>(data->data()) + start * sizeof(sample_t),
+                            (stop - start) * sizeof(sample_t));
+                _samples.resize(ch.filter->max_output(stop - start));
+                std::size_t n = ch.filter->process(&_input[0], &_samples[0], stop - start);
+                std::size_t const dropped = std::min(ch.skip, n);
+                ch.skip -= dropped;
+                n -= dropped;
+
+                if (n > 0) {
+                        std::size_t const header = sizeof(data_block_t) + ch.output.size();
+                        _buffer.resize(header + n * sizeof(sample_t));
+                        std::memcpy(&_buffer[header], &_samples[dropped], n * sizeof(sample_t));
+                        data_block_t * block = reinterpret_cast<data_block_t *>(&_buffer[0]);
+                        block->time = first;
+                        block->dtype = SAMPLED;
+                        block->sz_id = ch.output.size();
+                        block->sz_data = n * sizeof(sample_t);
+                        std::memcpy(&_buffer[sizeof(data_block_t)], ch.output.data(), ch.output.size());
+                        _writer->write(block, 0, 0);
+                }
+        }
+        if (ch.keep)
+                _writer->write(data, start, stop);
+}
@@ -0,0 +1,93 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _DECIMATING_WRITER_HH
+#define _DECIMATING_WRITER_HH
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "../data_writer.hh"
+#include "decimator.hh"
+
+namespace jill { namespace dsp {
+
+/**
+ * A data_writer that passes data on to another writer, along with
+ * downsampled copies of selected sampled channels. Because the writer is
+ * called from the disk thread of a buffered_data_writer, the decimation is
+ * done there and not in the process callback.
+ *
+ * The first sample of a decimated channel in each entry is aligned with the
+ * start of the entry, so sample k corresponds to frame k * factor of the
+ * full-rate channels. The delay of the anti-aliasing filter is compensated by
+ * dropping the outputs it produces in the first delay() frames of the entry,
+ * so the decimated channel ends about delay() frames before the full-rate
+ * channels. If the data written to a new entry don't continue the data
+ * written to the previous one, the filter is reset.
+ */
+class decimating_writer : public data_writer {
+public:
+        /**
+         * @param writer         the sink for the data
+         * @param factor         the decimation factor
+         * @param sampling_rate  the sampling rate of the input; should be a
+         *                       multiple of factor
+         */
+        decimating_writer(boost::shared_ptr<data_writer> writer, std::size_t factor,
+                          nframes_t sampling_rate);
+
+        /**
+         * Write a decimated copy of channel @a id to channel @a output. If
+         * @a keep is false, the full-rate data are not passed on.
+         */
+        void add_channel(std::string const & id, std::string const & output, bool keep=true);
+
+        std::size_t factor() const { return _factor; }
+
+        /* data_writer overrides */
+        bool ready() const { return _writer->ready(); }
+        void new_entry(nframes_t frame);
+        void close_entry() { _writer->close_entry(); }
+        void xrun() { _writer->xrun(); }
+        void write(data_block_t const * data, nframes_t start, nframes_t stop);
+        void log(timestamp_t const & time, std::string const & source, std::string const & message) {
+                _writer->log(time, source, message);
+        }
+        void flush() { _writer->flush(); }
+        void set_sampling_rate(std::string const & id, nframes_t rate) {
+                _writer->set_sampling_rate(id, rate);
+        }
+
+private:
+        struct channel_type {
+                std::string output;
+                bool keep;
+                boost::shared_ptr<decimator> filter;
+                bool aligned;                   // phase set for the current entry
+                std::size_t skip;               // outputs to drop before the first aligned one
+                nframes_t next_frame;           // frame after the last one written
+        };
+        typedef std::map<std::string, channel_type> channel_map;
+
+        boost::shared_ptr<data_writer> _writer;
+        std::size_t _factor;
+        nframes_t _sampling_rate;
+        nframes_t _entry_start;
+        channel_map _channels;
+        std::vector<sample_t> _input;           // aligned copy of the input
+        std::vector<sample_t> _samples;         // output of the decimator
+        std::vector<char> _buffer;              // block holding decimated data
+};
+
+}}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <stdexcept>
+
+#include "decimator.hh"
+#include "../digital_filter.hh"
+
+using namespace jill::dsp;
+
+decimator::decimator(std::size_t factor, std::vector<double> const & taps, simd::isa_type isa)
+        : _factor(factor), _isa(isa), _phase(0)
+{
+        if (factor < 1)
+                throw std::invalid_argument("decimation factor must be at least 1");
+        std::vector<double> h = taps.empty() ? design(factor) : taps;
+        _taps.assign(h.rbegin(), h.rend());
+        _history.resize(_taps.size());    // ntaps - 1 are used
+        _workspace.resize(simd::decimate_workspace(_taps.size()));
+}
+
+std::vector<double>
+decimator::design(std::size_t factor)
+{
+        if (factor <= 1) return std::vector<double>(1, 1.0);
+        double const nyquist = 1.0 / factor;
+        return jill::digital_filter::kaiser_lowpass(0.8 * nyquist, 0.2 * nyquist, 80);
+}
+
+std::size_t
+decimator::process(sample_type const * in, sample_type * out, std::size_t nframes)
+{
+        return simd::decimate(_isa, &_taps[0], _taps.size(), _factor, &_history[0], _phase,
+                              in, out, nframes, &_workspace[0]);
+}
+
+void
+decimator::reset()
+{
+        _history.assign(_history.size(), 0.0);
+        _phase = 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _DECIMATOR_HH
+#define _DECIMATOR_HH
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "simd_filter.hh"
+
+namespace jill { namespace dsp {
+
+/**
+ * Reduces the sampling rate of a channel by an integer factor. The signal is
+ * low-pass filtered with a linear-phase FIR filter to prevent aliasing, and
+ * only the samples that are kept are computed (see simd::decimate).
+ *
+ * Samples are passed in blocks of any size; the filter state and the
+ * position of the next output carry over from one block to the next. The
+ * output is delayed by delay() input frames, the group delay of the filter.
+ */
+class decimator : boost::noncopyable {
+public:
+        typedef float sample_type;
+
+        /**
+         * @param factor  the decimation factor
+         * @param taps    the anti-aliasing filter. If empty, one is designed
+         *                with design().
+         * @param isa     the instruction set to use
+         */
+        explicit decimator(std::size_t factor,
+                           std::vector<double> const & taps=std::vector<double>(),
+                           simd::isa_type isa=simd::detect());
+
+        /**
+         * A Kaiser-window low-pass filter for decimating by factor. The pass
+         * band extends to 80% of the new Nyquist frequency, and the stop band
+         * starts at the new Nyquist frequency and is attenuated by 80 dB.
+         */
+        static std::vector<double> design(std::size_t factor);
+
+        std::size_t factor() const { return _factor; }
+        std::size_t ntaps() const { return _taps.size(); }
+        simd::isa_type isa() const { return _isa; }
+
+        /** the delay of the output, in input frames */
+        std::size_t delay() const { return (_taps.size() - 1) / 2; }
+
+        /** the most output frames process() returns for nframes of input */
+        std::size_t max_output(std::size_t nframes) const {
+                return (nframes + _factor - 1) / _factor;
+        }
+
+        /**
+         * Filter and downsample nframes samples.
+         *
+         * @param in   the input samples
+         * @param out  room for max_output(nframes) samples
+         * @return the number of output samples
+         */
+        std::size_t process(sample_type const * in, sample_type * out, std::size_t nframes);
+
+        /** clear the filter state; the next input sample produces an output */
+        void reset();
+
+        /** set the number of input samples to skip before the next output */
+        void set_phase(std::size_t phase) { _phase = phase % _factor; }
+
+private:
+        std::size_t _factor;
+        std::vector<double> _taps;        // reversed
+        simd::isa_type _isa;
+        std::vector<double> _history;
+        std::vector<double> _workspace;
+        std::size_t _phase;
+};
+
+}}
+
+#endif
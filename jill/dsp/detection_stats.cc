@@ -0,0 +1,83 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cmath>
+#include <algorithm>
+
+#include "detection_stats.hh"
+
+using namespace jill::dsp;
+
+detection_stats::detection_stats()
+        : true_pos(0), false_pos(0), false_neg(0),
+          latency_sum(0), latency_min(HUGE_VAL), latency_max(-HUGE_VAL)
+{}
+
+double
+detection_stats::precision() const
+{
+        return (true_pos + false_pos) ? double(true_pos) / (true_pos + false_pos) : 1.0;
+}
+
+double
+detection_stats::recall() const
+{
+        return (true_pos + false_neg) ? double(true_pos) / (true_pos + false_neg) : 1.0;
+}
+
+double
+detection_stats::f1() const
+{
+        double const p = precision(), r = recall();
+        return (p + r > 0) ? 2 * p * r / (p + r) : 0.0;
+}
+
+double
+detection_stats::mean_latency() const
+{
+        return true_pos ? latency_sum / true_pos : NAN;
+}
+
+detection_stats &
+detection_stats::operator+=(detection_stats const & other)
+{
+        true_pos += other.true_pos;
+        false_pos += other.false_pos;
+        false_neg += other.false_neg;
+        latency_sum += other.latency_sum;
+        latency_min = std::min(latency_min, other.latency_min);
+        latency_max = std::max(latency_max, other.latency_max);
+        return *this;
+}
+
+detection_stats
+jill::dsp::match_detections(std::vector<long> const & detected,
+                            std::vector<long> const & reference,
+                            long before, long after)
+{
+        detection_stats stats;
+        std::vector<long>::const_iterator d = detected.begin();
+        for (std::vector<long>::const_iterator r = reference.begin(); r != reference.end(); ++r) {
+                // detections too early for this event can't match later ones
+                while (d != detected.end() && *d < *r - before) ++d;
+                if (d != detected.end() && *d <= *r + after) {
+                        double const latency = *d - *r;
+                        stats.true_pos += 1;
+                        stats.latency_sum += latency;
+                        stats.latency_min = std::min(stats.latency_min, latency);
+                        stats.latency_max = std::max(stats.latency_max, latency);
+                        ++d;
+                }
+                else
+                        stats.false_neg += 1;
+        }
+        stats.false_pos = detected.size() - stats.true_pos;
+        return stats;
+}
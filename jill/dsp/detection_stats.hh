@@ -0,0 +1,62 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _DETECTION_STATS_HH
+#define _DETECTION_STATS_HH
+
+#include <cstddef>
+#include <vector>
+
+namespace jill { namespace dsp {
+
+/**
+ * Scores for a detector compared against reference (e.g. annotated) events.
+ * Latencies are in samples, from the reference event to the detection, and
+ * only count the detections that matched a reference event.
+ */
+struct detection_stats {
+        std::size_t true_pos;
+        std::size_t false_pos;
+        std::size_t false_neg;
+        double latency_sum;
+        double latency_min;
+        double latency_max;
+
+        detection_stats();
+
+        /** the fraction of detections that matched; 1 if there were none */
+        double precision() const;
+        /** the fraction of reference events that were detected; 1 if there were none */
+        double recall() const;
+        /** the harmonic mean of precision and recall */
+        double f1() const;
+        double mean_latency() const;
+
+        /** combine the scores from another recording */
+        detection_stats & operator+=(detection_stats const & other);
+};
+
+/**
+ * Match detections to reference events. Each reference event is matched to
+ * the earliest unmatched detection in [ref - before, ref + after]; the other
+ * detections are false positives.
+ *
+ * @param detected   the times of the detections, in increasing order
+ * @param reference  the times of the reference events, in increasing order
+ * @param before     how early a detection can be and still match
+ * @param after      how late a detection can be and still match
+ */
+detection_stats match_detections(std::vector<long> const & detected,
+                                 std::vector<long> const & reference,
+                                 long before, long after);
+
+}}
+
+#endif
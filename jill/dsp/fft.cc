@@ -0,0 +1,41 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cmath>
+#include <stdexcept>
+
+#include "fft.hh"
+
+using namespace jill::dsp;
+
+real_fft::real_fft(std::size_t size)
+        : _size(size)
+{
+        if (size < 4 || (size & (size - 1)))
+                throw std::invalid_argument("FFT size must be a power of two");
+        const double pi = std::acos(-1.0);
+        _wr.resize(size / 2 + 1);
+        _wi.resize(size / 2 + 1);
+        for (std::size_t k = 0; k <= size / 2; ++k) {
+                double phase = -2 * pi * k / size;
+                _wr[k] = std::cos(phase);
+                _wi[k] = std::sin(phase);
+        }
+        std::size_t const m = size / 2;
+        std::size_t bits = 0;
+        while ((std::size_t(1) << bits) < m) ++bits;
+        _bitrev.resize(m);
+        for (std::size_t i = 0; i < m; ++i) {
+                std::size_t r = 0;
+                for (std::size_t b = 0; b < bits; ++b)
+                        if (i & (std::size_t(1) << b)) r |= std::size_t(1) << (bits - 1 - b);
+                _bitrev[i] = r;
+        }
+}
@@ -0,0 +1,157 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _FFT_HH
+#define _FFT_HH
+
+#include <vector>
+#include <cstddef>
+
+namespace jill { namespace dsp {
+
+/**
+ * Fast Fourier transform of real sequences whose length is a power of two.
+ * The sequence is packed into a complex sequence of half the length, which is
+ * transformed with an iterative radix-2 FFT, and the spectra of the even and
+ * odd samples are then separated.
+ *
+ * Spectra are stored with the real and imaginary parts in separate arrays.
+ * The transforms are templates on the sample type, which can be double or a
+ * compiler vector of doubles; in the latter case each lane holds a separate
+ * sequence, and they are all transformed at once (see fft_convolver).
+ *
+ * The twiddle factors are computed when the object is constructed; the
+ * transforms do not allocate memory and can be called from several threads
+ * with different buffers.
+ */
+class real_fft {
+public:
+        /** @param size  length of the sequences; a power of two, at least 4 */
+        explicit real_fft(std::size_t size);
+
+        std::size_t size() const { return _size; }
+
+        /** the number of frequency bins (size / 2 + 1) */
+        std::size_t nbins() const { return _size / 2 + 1; }
+
+        /**
+         * Compute the spectrum of size() samples in @a in, storing nbins()
+         * values in @a re and @a im. @a scratch needs room for size() values.
+         */
+        template <typename T>
+        void forward(T const * in, T * re, T * im, T * scratch) const;
+
+        /**
+         * Compute size() samples from nbins() values of a spectrum. The
+         * result is scaled so that inverse(forward(x)) == x. @a scratch needs
+         * room for size() values.
+         */
+        template <typename T>
+        void inverse(T const * re, T const * im, T * out, T * scratch) const;
+
+private:
+        template <typename T>
+        void transform(T * re, T * im, bool inverse) const;
+
+        std::size_t _size;
+        // exp(-2 pi i k / size) for k in [0, size / 2]
+        std::vector<double> _wr, _wi;
+        std::vector<std::size_t> _bitrev;
+};
+
+/*
+ * The templates are always inlined, so that when they are called from a
+ * function compiled for a particular instruction set, they are too.
+ */
+
+/* in-place transform of size / 2 points whose input is in bit-reversed order */
+template <typename T> inline __attribute__((always_inline)) void
+real_fft::transform(T * re, T * im, bool inverse) const
+{
+        std::size_t const m = _size / 2;
+        for (std::size_t i = 0; i < m; i += 2) {
+                T const ar = re[i], ai = im[i];
+                re[i] = ar + re[i + 1];
+                im[i] = ai + im[i + 1];
+                re[i + 1] = ar - re[i + 1];
+                im[i + 1] = ai - im[i + 1];
+        }
+        double const sign = inverse ? -1 : 1;
+        for (std::size_t len = 4; len <= m; len <<= 1) {
+                std::size_t const half = len / 2;
+                std::size_t const stride = _size / len;
+                for (std::size_t start = 0; start < m; start += len) {
+                        T * r0 = re + start, * i0 = im + start;
+                        T * r1 = r0 + half, * i1 = i0 + half;
+                        for (std::size_t k = 0; k < half; ++k) {
+                                double const wr = _wr[k * stride];
+                                double const wi = sign * _wi[k * stride];
+                                T const tr = r1[k] * wr - i1[k] * wi;
+                                T const ti = r1[k] * wi + i1[k] * wr;
+                                r1[k] = r0[k] - tr;
+                                i1[k] = i0[k] - ti;
+                                r0[k] = r0[k] + tr;
+                                i0[k] = i0[k] + ti;
+                        }
+                }
+        }
+}
+
+template <typename T> inline __attribute__((always_inline)) void
+real_fft::forward(T const * in, T * re, T * im, T * scratch) const
+{
+        std::size_t const m = _size / 2;
+        T * zr = scratch, * zi = scratch + m;
+        for (std::size_t n = 0; n < m; ++n) {
+                zr[_bitrev[n]] = in[2 * n];
+                zi[_bitrev[n]] = in[2 * n + 1];
+        }
+        transform(zr, zi, false);
+        // separate the spectra of the even (e) and odd (o) samples:
+        // x[k] = e[k] + w^k o[k], e = (z[k] + z*[m-k]) / 2, o = -i (z[k] - z*[m-k]) / 2
+        for (std::size_t k = 0; k <= m; ++k) {
+                std::size_t const a = (k == m) ? 0 : k;
+                std::size_t const b = (k == 0) ? 0 : m - k;
+                T const er = (zr[a] + zr[b]) * 0.5;
+                T const ei = (zi[a] - zi[b]) * 0.5;
+                T const or_ = (zi[a] + zi[b]) * 0.5;
+                T const oi = (zr[b] - zr[a]) * 0.5;
+                re[k] = er + or_ * _wr[k] - oi * _wi[k];
+                im[k] = ei + or_ * _wi[k] + oi * _wr[k];
+        }
+}
+
+template <typename T> inline __attribute__((always_inline)) void
+real_fft::inverse(T const * re, T const * im, T * out, T * scratch) const
+{
+        std::size_t const m = _size / 2;
+        T * zr = scratch, * zi = scratch + m;
+        // e = (x[k] + x*[m-k]) / 2, o = (x[k] - x*[m-k]) / (2 w^k), z = e + i o
+        for (std::size_t k = 0; k < m; ++k) {
+                T const er = (re[k] + re[m - k]) * 0.5;
+                T const ei = (im[k] - im[m - k]) * 0.5;
+                T const dr = (re[k] - re[m - k]) * 0.5;
+                T const di = (im[k] + im[m - k]) * 0.5;
+                T const or_ = dr * _wr[k] + di * _wi[k];
+                T const oi = di * _wr[k] - dr * _wi[k];
+                zr[_bitrev[k]] = er - oi;
+                zi[_bitrev[k]] = ei + or_;
+        }
+        transform(zr, zi, true);
+        double const scale = 1.0 / m;
+        for (std::size_t n = 0; n < m; ++n) {
+                out[2 * n] = zr[n] * scale;
+                out[2 * n + 1] = zi[n] * scale;
+        }
+}
+
+}}
+
+#endif
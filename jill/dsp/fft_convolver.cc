@@ -0,0 +1,310 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#include "fft_convolver.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JILL_SIMD_X86 1
+#endif
+
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+using namespace jill::dsp;
+
+namespace {
+
+/* one register holds a whole group */
+typedef double v2d __attribute__((vector_size(16)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef double v8d __attribute__((vector_size(64)));
+
+const std::size_t alignment = 64;
+
+}
+
+/*
+ * The kernels are templates on the vector type, inlined into an entry point
+ * for each instruction set (see simd_filter.cc).
+ */
+struct fft_convolver::kernel {
+
+        template <typename V> static KERNEL_INLINE V *
+        base(group_type & g) {
+                return reinterpret_cast<V *>((reinterpret_cast<uintptr_t>(&g.storage[0]) + alignment - 1) &
+                                             ~uintptr_t(alignment - 1));
+        }
+
+        /* transform a complete input block and queue a block of output */
+        template <typename V> static KERNEL_INLINE void
+        block(fft_convolver const & c, group_type & g, V * b) {
+                layout_type const & lay = c._layout;
+                std::size_t const nbins = c._fft.nbins();
+                std::size_t const B = c._block;
+                std::size_t const P = c._nparts;
+                V const zero = {};
+
+                // newest spectrum goes in front of the others
+                g.fdl_pos = (g.fdl_pos + P - 1) % P;
+                c._fft.forward(b + lay.window, b + lay.fdl_re + g.fdl_pos * nbins,
+                               b + lay.fdl_im + g.fdl_pos * nbins, b + lay.scratch);
+
+                V * sr = b + lay.spec_re, * si = b + lay.spec_im;
+                for (std::size_t k = 0; k < nbins; ++k) {
+                        sr[k] = zero;
+                        si[k] = zero;
+                }
+                for (std::size_t p = 0; p < P; ++p) {
+                        std::size_t const slot = ((g.fdl_pos + p) % P) * nbins;
+                        V const * xr = b + lay.fdl_re + slot, * xi = b + lay.fdl_im + slot;
+                        double const * hr = &c._parts_re[p * nbins], * hi = &c._parts_im[p * nbins];
+                        for (std::size_t k = 0; k < nbins; ++k) {
+                                sr[k] += xr[k] * hr[k] - xi[k] * hi[k];
+                                si[k] += xr[k] * hi[k] + xi[k] * hr[k];
+                        }
+                }
+                V * result = b + lay.result;
+                c._fft.inverse(sr, si, result, b + lay.scratch);
+
+                // the second half of the circular convolution is the linear convolution
+                V * fifo = b + lay.fifo;
+                std::size_t const size = lay.staging - lay.fifo;
+                std::size_t pos = (g.fifo_read + g.fifo_count) % size;
+                for (std::size_t n = 0; n < B; ++n) {
+                        fifo[pos] = result[B + n];
+                        if (++pos == size) pos = 0;
+                }
+                g.fifo_count += B;
+
+                V * window = b + lay.window;
+                std::memcpy(window, window + B, B * sizeof(V));
+                g.fill = 0;
+        }
+
+        template <typename V> static KERNEL_INLINE void
+        process(fft_convolver const & c, group_type & g, sample_type const * const * in,
+                sample_type * const * out, std::size_t offset, std::size_t nframes) {
+                std::size_t const L = sizeof(V) / sizeof(double);
+                layout_type const & lay = c._layout;
+                std::size_t const B = c._block;
+                std::size_t const H = c._head.size();
+                V const zero = {};
+                V * b = base<V>(g);
+                V * xs = b + lay.staging;
+                double * rows = reinterpret_cast<double *>(xs);
+
+                for (std::size_t l = 0; l < L; ++l) {
+                        if (in[l]) {
+                                sample_type const * src = in[l] + offset;
+                                for (std::size_t n = 0; n < nframes; ++n)
+                                        rows[n * L + l] = src[n];
+                        }
+                        else {
+                                for (std::size_t n = 0; n < nframes; ++n)
+                                        rows[n * L + l] = 0;
+                        }
+                }
+
+                V * hb = b + lay.head;
+                if (H > 0)
+                        std::memcpy(hb + H - 1, xs, nframes * sizeof(V));
+
+                if (c._nparts > 0) {
+                        V * window = b + lay.window + B;
+                        for (std::size_t n = 0; n < nframes; ++n) {
+                                window[g.fill] = xs[n];
+                                if (++g.fill == B)
+                                        block(c, g, b);
+                        }
+                }
+
+                // output goes back into the staging buffer
+                V const * fifo = b + lay.fifo;
+                std::size_t const size = lay.staging - lay.fifo;
+                double const * h = H ? &c._head[0] : 0;
+                for (std::size_t n = 0; n < nframes; ++n) {
+                        V y = zero;
+                        if (g.fifo_count > 0) {
+                                y = fifo[g.fifo_read];
+                                if (++g.fifo_read == size) g.fifo_read = 0;
+                                --g.fifo_count;
+                        }
+                        if (H > 0) {
+                                V const * x = hb + n;
+                                V s0 = zero, s1 = zero;
+                                std::size_t k = 0;
+                                for (; k + 1 < H; k += 2) {
+                                        s0 += x[k] * h[k];
+                                        s1 += x[k + 1] * h[k + 1];
+                                }
+                                if (k < H)
+                                        s0 += x[k] * h[k];
+                                y += s0 + s1;
+                        }
+                        xs[n] = y;
+                }
+
+                for (std::size_t l = 0; l < L; ++l) {
+                        if (!out[l]) continue;
+                        sample_type * dst = out[l] + offset;
+                        for (std::size_t n = 0; n < nframes; ++n)
+                                dst[n] = rows[n * L + l];
+                }
+
+                if (H > 1)
+                        std::memmove(hb, hb + nframes, (H - 1) * sizeof(V));
+        }
+
+        static void
+        process_generic(fft_convolver const & c, group_type & g, sample_type const * const * in,
+                        sample_type * const * out, std::size_t offset, std::size_t nframes) {
+                process<v2d>(c, g, in, out, offset, nframes);
+        }
+
+#ifdef JILL_SIMD_X86
+        __attribute__((target("avx2,fma"))) static void
+        process_avx2(fft_convolver const & c, group_type & g, sample_type const * const * in,
+                     sample_type * const * out, std::size_t offset, std::size_t nframes) {
+                process<v4d>(c, g, in, out, offset, nframes);
+        }
+
+        __attribute__((target("avx512f"))) static void
+        process_avx512(fft_convolver const & c, group_type & g, sample_type const * const * in,
+                       sample_type * const * out, std::size_t offset, std::size_t nframes) {
+                process<v8d>(c, g, in, out, offset, nframes);
+        }
+#endif
+};
+
+
+fft_convolver::fft_convolver(std::vector<double> const & taps, std::size_t block, bool uniform,
+                             std::size_t period, simd::isa_type isa)
+        : _isa(isa), _fft(2 * block), _block(block), _nparts(0), _period(period),
+          _delay(0), _chunk(block), _nchannels(0)
+{
+        std::size_t const nhead = uniform ? 0 : std::min(block, taps.size());
+        // reversed, so the direct convolution is a dot product with the input
+        _head.assign(taps.rend() - nhead, taps.rend());
+
+        std::size_t const ntail = taps.size() - nhead;
+        _nparts = (ntail + block - 1) / block;
+        std::size_t const nbins = _fft.nbins();
+        _parts_re.resize(_nparts * nbins);
+        _parts_im.resize(_nparts * nbins);
+        std::vector<double> buf(2 * block), scratch(2 * block);
+        for (std::size_t p = 0; p < _nparts; ++p) {
+                std::fill(buf.begin(), buf.end(), 0.0);
+                std::size_t const first = nhead + p * block;
+                std::size_t const n = std::min(block, taps.size() - first);
+                std::copy(taps.begin() + first, taps.begin() + first + n, buf.begin());
+                _fft.forward(&buf[0], &_parts_re[p * nbins], &_parts_im[p * nbins], &scratch[0]);
+        }
+        reset(period);
+}
+
+void
+fft_convolver::resize(std::size_t nchannels)
+{
+        _nchannels = nchannels;
+        _groups.resize((nchannels + group_size() - 1) / group_size());
+        reset();
+}
+
+void
+fft_convolver::reset(std::size_t period)
+{
+        _period = period;
+        if (!uniform()) {
+                // the tail starts one block in, which covers the block delay
+                _delay = _block;
+                _chunk = _block;
+        }
+        else if (period > 0 && period % _block == 0) {
+                _delay = 0;
+                _chunk = period;
+        }
+        else {
+                _delay = _block - 1;
+                _chunk = _block;
+        }
+
+        std::size_t const nbins = _fft.nbins();
+        std::size_t pos = 0;
+        _layout.head = pos;
+        pos += _head.empty() ? 0 : _head.size() - 1 + _chunk;
+        _layout.window = pos;
+        pos += 2 * _block;
+        _layout.fdl_re = pos;
+        pos += _nparts * nbins;
+        _layout.fdl_im = pos;
+        pos += _nparts * nbins;
+        _layout.spec_re = pos;
+        pos += nbins;
+        _layout.spec_im = pos;
+        pos += nbins;
+        _layout.scratch = pos;
+        pos += 2 * _block;
+        _layout.result = pos;
+        pos += 2 * _block;
+        _layout.fifo = pos;
+        pos += _delay + _chunk + _block;
+        _layout.staging = pos;
+        pos += _chunk;
+        _layout.size = pos;
+
+        for (std::size_t i = 0; i < _groups.size(); ++i)
+                init_group(_groups[i]);
+}
+
+void
+fft_convolver::init_group(group_type & g) const
+{
+        g.storage.assign(_layout.size * group_size() + alignment / sizeof(double), 0.0);
+        g.fill = 0;
+        g.fdl_pos = 0;
+        g.fifo_read = 0;
+        g.fifo_count = _delay;
+}
+
+void
+fft_convolver::process(sample_type const * const * in, sample_type * const * out,
+                       std::size_t first, std::size_t count, std::size_t nframes)
+{
+        std::size_t const L = group_size();
+        for (std::size_t i = 0; i < count; i += L) {
+                group_type & g = _groups[(first + i) / L];
+                std::size_t const n = std::min(L, count - i);
+                sample_type const * pin[simd::max_lanes];
+                sample_type * pout[simd::max_lanes];
+                for (std::size_t l = 0; l < simd::max_lanes; ++l) {
+                        bool active = l < n && in[i + l];
+                        pin[l] = active ? in[i + l] : 0;
+                        pout[l] = active ? out[i + l] : 0;
+                }
+                for (std::size_t offset = 0; offset < nframes; offset += _chunk) {
+                        std::size_t const m = std::min(_chunk, nframes - offset);
+                        switch (_isa) {
+#ifdef JILL_SIMD_X86
+                        case simd::AVX2:
+                                kernel::process_avx2(*this, g, pin, pout, offset, m);
+                                break;
+                        case simd::AVX512:
+                                kernel::process_avx512(*this, g, pin, pout, offset, m);
+                                break;
+#endif
+                        default:
+                                kernel::process_generic(*this, g, pin, pout, offset, m);
+                        }
+                }
+        }
+}
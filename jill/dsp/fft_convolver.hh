@@ -0,0 +1,135 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _FFT_CONVOLVER_HH
+#define _FFT_CONVOLVER_HH
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "fft.hh"
+#include "simd_filter.hh"
+
+namespace jill { namespace dsp {
+
+/**
+ * Partitioned overlap-save convolution for long FIR filters.
+ *
+ * The filter is cut into partitions of block_size() taps, and the spectra of
+ * the partitions are computed once. Input is collected in blocks of the same
+ * size; each block is transformed (with the previous block, as overlap-save
+ * requires) and kept in a frequency-domain delay line, and the output block is
+ * the inverse transform of the sum of the products of the delayed input
+ * spectra with the partition spectra. Cost per sample grows with log(block)
+ * plus the number of partitions, rather than with the number of taps.
+ *
+ * Because an output block can only be computed once its input block is
+ * complete, the engine has to delay its output unless every call supplies
+ * whole blocks. Two partitionings are supported:
+ *
+ * - uniform: all taps go through the FFT. If the period passed to reset() is a
+ *   multiple of the block size, output is not delayed; otherwise it is delayed
+ *   by block_size() - 1 frames.
+ *
+ * - non-uniform: the first block_size() taps are convolved directly, and the
+ *   rest through the FFT. The direct head covers the time it takes to fill a
+ *   block, so the output is never delayed, for any period size.
+ *
+ * As with the kernels in simd_filter.hh, channels are processed in groups,
+ * one channel per vector lane, so the transforms for a whole group are done
+ * at once. The state of a group is shared by its channels, so each call to
+ * process() has to include every channel in the groups it touches. Calls for
+ * different groups can be made from different threads. process() does not
+ * allocate memory.
+ */
+class fft_convolver : boost::noncopyable {
+public:
+        typedef float sample_type;
+
+        /**
+         * @param taps     the filter coefficients
+         * @param block    the partition size; a power of two, at least 2
+         * @param uniform  if false, convolve the first block of taps directly
+         * @param period   frames per call to process(), or 0 if not known
+         * @param isa      the instruction set to use
+         */
+        fft_convolver(std::vector<double> const & taps, std::size_t block, bool uniform,
+                      std::size_t period=0, simd::isa_type isa=simd::detect());
+
+        /** the number of channels processed together (one vector register) */
+        std::size_t group_size() const { return simd::lanes(_isa) / 2; }
+
+        /** allocate state for nchannels channels */
+        void resize(std::size_t nchannels);
+        std::size_t nchannels() const { return _nchannels; }
+
+        /** clear the state of all channels and set the expected period */
+        void reset(std::size_t period);
+        void reset() { reset(_period); }
+
+        /**
+         * Filter channels [first, first + count), where in[i] and out[i] are
+         * the buffers for channel first + i. first must be a multiple of
+         * group_size(). Channels with null input are skipped. in and out may
+         * be the same.
+         */
+        void process(sample_type const * const * in, sample_type * const * out,
+                     std::size_t first, std::size_t count, std::size_t nframes);
+
+        /** the delay (in frames) between input and output */
+        std::size_t latency() const { return uniform() ? _delay : 0; }
+
+        std::size_t block_size() const { return _block; }
+        std::size_t partitions() const { return _nparts; }
+        bool uniform() const { return _head.empty(); }
+        simd::isa_type isa() const { return _isa; }
+
+private:
+        struct kernel;
+
+        /* state of a group; the buffers hold group_size() doubles per element */
+        struct group_type {
+                std::vector<double> storage;
+                std::size_t fill;                 // samples in the current block
+                std::size_t fdl_pos;              // slot of the newest input spectrum
+                std::size_t fifo_read, fifo_count;
+        };
+
+        /* offsets of the buffers in group storage, in elements */
+        struct layout_type {
+                std::size_t head;                 // input history for the direct taps
+                std::size_t window;               // previous and current input block
+                std::size_t fdl_re, fdl_im;       // spectra of past input blocks
+                std::size_t fifo;                 // output waiting to be read
+                std::size_t spec_re, spec_im;
+                std::size_t scratch;
+                std::size_t result;
+                std::size_t staging;              // transposed input and output
+                std::size_t size;
+        };
+
+        void init_group(group_type & g) const;
+
+        simd::isa_type _isa;
+        real_fft _fft;
+        std::size_t _block;
+        std::size_t _nparts;
+        std::vector<double> _head;                // directly convolved taps, reversed
+        std::vector<double> _parts_re, _parts_im; // spectra of the partitions
+        std::size_t _period;
+        std::size_t _delay;                       // frames of zeros ahead of the FFT output
+        std::size_t _chunk;                       // frames handled at a time
+        layout_type _layout;
+        std::size_t _nchannels;
+        std::vector<group_type> _groups;
+};
+
+}}
+
+#endif
@@ -14,6 +14,7 @@
 #define _RINGBUFFER_HH
 
 #include <algorithm>
+#include <string>
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include "../util/mirrored_memory.hh"
@@ -84,10 +85,28 @@ public:
                 resize(size);
         }
 
+	/**
+	 * Construct a ringbuffer backed by a file rather than locked
+	 * memory. This is much slower to access, but can be much larger than
+	 * physical memory. @see jill::util::mirrored_memory
+	 *
+	 * @param size         The size of the ringbuffer (in objects)
+	 * @param backing_file The path of the file to create
+	 */
+	ringbuffer(std::size_t size, std::string const & backing_file)
+                : _backing_file(backing_file), _write_ptr(0), _read_ptr(0)
+        {
+                resize(size);
+        }
+
 	~ringbuffer() {}
 
         void resize(std::size_t size) {
-                _buf.reset(new jill::util::mirrored_memory(next_pow2(size * sizeof(data_type)),0,true));
+                std::size_t bytes = next_pow2(size * sizeof(data_type));
+                if (_backing_file.empty())
+                        _buf.reset(new jill::util::mirrored_memory(bytes,0,true));
+                else
+                        _buf.reset(new jill::util::mirrored_memory(_backing_file, bytes));
                 _size_mask = this->size() - 1;
         }
 
@@ -180,6 +199,7 @@ public:
 
 private:
         boost::scoped_ptr<jill::util::mirrored_memory> _buf;
+        std::string _backing_file;
         std::size_t _write_ptr;
         std::size_t _read_ptr;
         std::size_t _size_mask;
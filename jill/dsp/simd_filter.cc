@@ -0,0 +1,567 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+
+#include "simd_filter.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JILL_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * The kernels are templates that are inlined into one entry point for each
+ * instruction set, so that they are compiled for that entry point's target.
+ */
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+using namespace jill::dsp;
+using jill::dsp::simd::max_lanes;
+
+namespace {
+
+/* frames transposed at a time; a block for 16 channels is 8 kB */
+const std::size_t block_frames = 64;
+const std::size_t alignment = 64;
+
+typedef double v2d __attribute__((vector_size(16)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef double v8d __attribute__((vector_size(64)));
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef int32_t v4i __attribute__((vector_size(16)));
+typedef int32_t v8i __attribute__((vector_size(32)));
+
+/* Copy nframes samples from each channel into rows of L doubles */
+template <std::size_t L> KERNEL_INLINE void
+load_block(double * rows, float const * const * in, std::size_t offset, std::size_t nframes)
+{
+        for (std::size_t l = 0; l < L; l++) {
+                if (in[l]) {
+                        float const * src = in[l] + offset;
+                        for (std::size_t n = 0; n < nframes; n++)
+                                rows[n * L + l] = src[n];
+                }
+                else {
+                        for (std::size_t n = 0; n < nframes; n++)
+                                rows[n * L + l] = 0;
+                }
+        }
+}
+
+template <std::size_t L> KERNEL_INLINE void
+store_block(double const * rows, float * const * out, std::size_t offset, std::size_t nframes)
+{
+        for (std::size_t l = 0; l < L; l++) {
+                if (!out[l]) continue;
+                float * dst = out[l] + offset;
+                for (std::size_t n = 0; n < nframes; n++)
+                        dst[n] = rows[n * L + l];
+        }
+}
+
+/*
+ * Cascade of biquads over R vectors of type V. Each block is run through one
+ * section at a time, so only that section's state has to be gathered into
+ * registers.
+ */
+template <typename V, std::size_t R> KERNEL_INLINE void
+sos_kernel(biquad_t const * sections, std::size_t nsections, double * const * state,
+           float const * const * in, float * const * out, std::size_t nframes)
+{
+        const std::size_t W = sizeof(V) / sizeof(double);
+        const std::size_t L = R * W;
+        V const zero = {};
+        V block[block_frames * R];
+        double * rows = reinterpret_cast<double *>(block);
+
+        for (std::size_t offset = 0; offset < nframes; offset += block_frames) {
+                std::size_t const nrows = std::min(block_frames, nframes - offset);
+                load_block<L>(rows, in, offset, nrows);
+                for (std::size_t k = 0; k < nsections; k++) {
+                        biquad_t const & s = sections[k];
+                        V const b0 = zero + s.b0, b1 = zero + s.b1, b2 = zero + s.b2;
+                        V const a1 = zero + s.a1, a2 = zero + s.a2;
+                        V z0[R], z1[R];
+                        for (std::size_t r = 0; r < R; r++) {
+                                for (std::size_t w = 0; w < W; w++) {
+                                        double const * z = state[r * W + w];
+                                        z0[r][w] = z ? z[2 * k] : 0;
+                                        z1[r][w] = z ? z[2 * k + 1] : 0;
+                                }
+                        }
+                        for (std::size_t n = 0; n < nrows; n++) {
+                                V * x = block + n * R;
+                                for (std::size_t r = 0; r < R; r++) {
+                                        V const y = b0 * x[r] + z0[r];
+                                        z0[r] = b1 * x[r] - a1 * y + z1[r];
+                                        z1[r] = b2 * x[r] - a2 * y;
+                                        x[r] = y;
+                                }
+                        }
+                        for (std::size_t r = 0; r < R; r++) {
+                                for (std::size_t w = 0; w < W; w++) {
+                                        double * z = state[r * W + w];
+                                        if (!z) continue;
+                                        z[2 * k] = z0[r][w];
+                                        z[2 * k + 1] = z1[r][w];
+                                }
+                        }
+                }
+                store_block<L>(rows, out, offset, nrows);
+        }
+}
+
+/*
+ * Direct-form FIR over R vectors of type V. The window holds the previous
+ * ntaps - 1 rows followed by the current block. Even and odd taps are summed
+ * separately to shorten the dependency chains.
+ */
+template <typename V, std::size_t R> KERNEL_INLINE void
+fir_kernel(double const * taps, std::size_t ntaps, double * const * history,
+           float const * const * in, float * const * out, std::size_t nframes,
+           double * workspace)
+{
+        const std::size_t W = sizeof(V) / sizeof(double);
+        const std::size_t L = R * W;
+        const std::size_t P = ntaps - 1;
+        V const zero = {};
+        V result[block_frames * R];
+        V * window = reinterpret_cast<V *>((reinterpret_cast<uintptr_t>(workspace) + alignment - 1) &
+                                           ~uintptr_t(alignment - 1));
+        double * rows = reinterpret_cast<double *>(window);
+
+        for (std::size_t l = 0; l < L; l++) {
+                for (std::size_t i = 0; i < P; i++)
+                        rows[i * L + l] = history[l] ? history[l][i] : 0;
+        }
+        for (std::size_t offset = 0; offset < nframes; offset += block_frames) {
+                std::size_t const nrows = std::min(block_frames, nframes - offset);
+                load_block<L>(rows + P * L, in, offset, nrows);
+                for (std::size_t n = 0; n < nrows; n++) {
+                        V const * x = window + (P + n) * R;
+                        V even[R], odd[R];
+                        for (std::size_t r = 0; r < R; r++) {
+                                even[r] = x[r] * taps[0];
+                                odd[r] = zero;
+                        }
+                        std::size_t i = 1;
+                        for (; i + 1 < ntaps; i += 2) {
+                                V const * x1 = x - i * R;
+                                V const * x2 = x1 - R;
+                                for (std::size_t r = 0; r < R; r++) {
+                                        odd[r] += x1[r] * taps[i];
+                                        even[r] += x2[r] * taps[i + 1];
+                                }
+                        }
+                        if (i < ntaps) {
+                                V const * x1 = x - i * R;
+                                for (std::size_t r = 0; r < R; r++)
+                                        odd[r] += x1[r] * taps[i];
+                        }
+                        for (std::size_t r = 0; r < R; r++)
+                                result[n * R + r] = even[r] + odd[r];
+                }
+                store_block<L>(reinterpret_cast<double *>(result), out, offset, nrows);
+                std::memmove(window, window + nrows * R, P * R * sizeof(V));
+        }
+        for (std::size_t l = 0; l < L; l++) {
+                if (!history[l]) continue;
+                for (std::size_t i = 0; i < P; i++)
+                        history[l][i] = rows[i * L + l];
+        }
+}
+
+/*
+ * Helpers for data that may not be aligned. The vectors are passed by
+ * reference; these are instantiated outside the target-specific entry points,
+ * where passing or returning wide vectors by value would change the ABI.
+ */
+template <typename V> KERNEL_INLINE void
+multiply_add(V & acc, double const * x, double const * taps)
+{
+        V a, b;
+        std::memcpy(&a, x, sizeof(V));
+        std::memcpy(&b, taps, sizeof(V));
+        acc += a * b;
+}
+
+/* add -1 to the lanes of count where x[i - 1] < t <= x[i] */
+template <typename V, typename M> KERNEL_INLINE void
+add_crossings(M & count, float const * x, V const & t)
+{
+        V prev, cur;
+        std::memcpy(&prev, x - 1, sizeof(V));
+        std::memcpy(&cur, x, sizeof(V));
+        count += (prev < t) & (cur >= t);
+}
+
+/*
+ * Decimating FIR for one channel, with vectors of type V running along the
+ * taps (which are reversed, so the window and the taps go the same way). The
+ * window holds the previous ntaps - 1 samples followed by the current block;
+ * blocks are at least as long as the filter, so the cost of shifting the
+ * window is no more than a copy per sample.
+ */
+template <typename V> KERNEL_INLINE std::size_t
+decimate_kernel(double const * taps, std::size_t ntaps, std::size_t factor, double * history,
+                std::size_t & phase, float const * in, float * out, std::size_t nframes,
+                double * window)
+{
+        const std::size_t W = sizeof(V) / sizeof(double);
+        const std::size_t P = ntaps - 1;
+        std::size_t const block = std::max(block_frames, ntaps);
+        V const zero = {};
+        std::size_t nout = 0;
+
+        std::memcpy(window, history, P * sizeof(double));
+        for (std::size_t offset = 0; offset < nframes; offset += block) {
+                std::size_t const nrows = std::min(block, nframes - offset);
+                for (std::size_t n = 0; n < nrows; n++)
+                        window[P + n] = in[offset + n];
+                std::size_t n = phase;
+                for (; n < nrows; n += factor) {
+                        double const * x = window + n;
+                        V s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+                        std::size_t k = 0;
+                        for (; k + 4 * W <= ntaps; k += 4 * W) {
+                                multiply_add(s0, x + k, taps + k);
+                                multiply_add(s1, x + k + W, taps + k + W);
+                                multiply_add(s2, x + k + 2 * W, taps + k + 2 * W);
+                                multiply_add(s3, x + k + 3 * W, taps + k + 3 * W);
+                        }
+                        for (; k + W <= ntaps; k += W)
+                                multiply_add(s0, x + k, taps + k);
+                        s0 += s1 + s2 + s3;
+                        double y = 0;
+                        for (std::size_t w = 0; w < W; w++)
+                                y += s0[w];
+                        for (; k < ntaps; k++)
+                                y += x[k] * taps[k];
+                        out[nout++] = y;
+                }
+                phase = n - nrows;
+                std::memmove(window, window + nrows, P * sizeof(double));
+        }
+        std::memcpy(history, window, P * sizeof(double));
+        return nout;
+}
+
+/*
+ * Rising threshold crossings, with vectors of type V holding consecutive
+ * samples. Comparisons give -1 in the lanes where they are true, so the
+ * crossings are counted without branches by subtracting the masks from a
+ * vector of counts (M), which is summed at the end.
+ */
+template <typename V, typename M> KERNEL_INLINE std::size_t
+crossings_kernel(float const * x, std::size_t nframes, float thresh)
+{
+        const std::size_t W = sizeof(V) / sizeof(float);
+        V t;
+        for (std::size_t w = 0; w < W; w++)
+                t[w] = thresh;
+        M c0 = {}, c1 = {};
+        std::size_t i = 1;
+        for (; i + 2 * W <= nframes; i += 2 * W) {
+                add_crossings(c0, x + i, t);
+                add_crossings(c1, x + i + W, t);
+        }
+        c0 += c1;
+        std::size_t count = 0;
+        for (std::size_t w = 0; w < W; w++)
+                count -= c0[w];
+        for (; i < nframes; i++)
+                count += (x[i - 1] < thresh) & (x[i] >= thresh);
+        return count;
+}
+
+/* entry points; the multichannel kernels work on two vectors of channels */
+
+void
+sos_generic(biquad_t const * sections, std::size_t nsections, double * const * state,
+            float const * const * in, float * const * out, std::size_t nframes)
+{
+        sos_kernel<v2d, 2>(sections, nsections, state, in, out, nframes);
+}
+
+void
+fir_generic(double const * taps, std::size_t ntaps, double * const * history,
+            float const * const * in, float * const * out, std::size_t nframes, double * workspace)
+{
+        fir_kernel<v2d, 2>(taps, ntaps, history, in, out, nframes, workspace);
+}
+
+std::size_t
+decimate_generic(double const * taps, std::size_t ntaps, std::size_t factor, double * history,
+                 std::size_t & phase, float const * in, float * out, std::size_t nframes,
+                 double * workspace)
+{
+        return decimate_kernel<v2d>(taps, ntaps, factor, history, phase, in, out, nframes, workspace);
+}
+
+std::size_t
+crossings_generic(float const * x, std::size_t nframes, float thresh)
+{
+        return crossings_kernel<v4f, v4i>(x, nframes, thresh);
+}
+
+#ifdef JILL_SIMD_X86
+__attribute__((target("avx2,fma"))) void
+sos_avx2(biquad_t const * sections, std::size_t nsections, double * const * state,
+         float const * const * in, float * const * out, std::size_t nframes)
+{
+        sos_kernel<v4d, 2>(sections, nsections, state, in, out, nframes);
+}
+
+__attribute__((target("avx2,fma"))) void
+fir_avx2(double const * taps, std::size_t ntaps, double * const * history,
+         float const * const * in, float * const * out, std::size_t nframes, double * workspace)
+{
+        fir_kernel<v4d, 2>(taps, ntaps, history, in, out, nframes, workspace);
+}
+
+__attribute__((target("avx2,fma"))) std::size_t
+decimate_avx2(double const * taps, std::size_t ntaps, std::size_t factor, double * history,
+              std::size_t & phase, float const * in, float * out, std::size_t nframes,
+              double * workspace)
+{
+        return decimate_kernel<v4d>(taps, ntaps, factor, history, phase, in, out, nframes, workspace);
+}
+
+__attribute__((target("avx2,fma"))) std::size_t
+crossings_avx2(float const * x, std::size_t nframes, float thresh)
+{
+        return crossings_kernel<v8f, v8i>(x, nframes, thresh);
+}
+
+__attribute__((target("avx512f"))) void
+sos_avx512(biquad_t const * sections, std::size_t nsections, double * const * state,
+           float const * const * in, float * const * out, std::size_t nframes)
+{
+        sos_kernel<v8d, 2>(sections, nsections, state, in, out, nframes);
+}
+
+__attribute__((target("avx512f"))) void
+fir_avx512(double const * taps, std::size_t ntaps, double * const * history,
+           float const * const * in, float * const * out, std::size_t nframes, double * workspace)
+{
+        fir_kernel<v8d, 2>(taps, ntaps, history, in, out, nframes, workspace);
+}
+
+__attribute__((target("avx512f"))) std::size_t
+decimate_avx512(double const * taps, std::size_t ntaps, std::size_t factor, double * history,
+                std::size_t & phase, float const * in, float * out, std::size_t nframes,
+                double * workspace)
+{
+        return decimate_kernel<v8d>(taps, ntaps, factor, history, phase, in, out, nframes, workspace);
+}
+
+/*
+ * Without AVX512DQ the compiler turns comparisons of 16 floats into 16 scalar
+ * compares when the result is used as a vector, so this kernel works with
+ * the comparison masks directly and counts with a masked add.
+ */
+__attribute__((target("avx512f"))) std::size_t
+crossings_avx512(float const * x, std::size_t nframes, float thresh)
+{
+        __m512 const t = _mm512_set1_ps(thresh);
+        __m512i const one = _mm512_set1_epi32(1);
+        __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512();
+        std::size_t i = 1;
+        for (; i + 32 <= nframes; i += 32) {
+                __mmask16 m0 = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i - 1), t, _CMP_LT_OQ);
+                __mmask16 m1 = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i + 15), t, _CMP_LT_OQ);
+                m0 = _mm512_mask_cmp_ps_mask(m0, _mm512_loadu_ps(x + i), t, _CMP_GE_OQ);
+                m1 = _mm512_mask_cmp_ps_mask(m1, _mm512_loadu_ps(x + i + 16), t, _CMP_GE_OQ);
+                c0 = _mm512_mask_add_epi32(c0, m0, c0, one);
+                c1 = _mm512_mask_add_epi32(c1, m1, c1, one);
+        }
+        int32_t counts[16];
+        _mm512_storeu_si512(counts, _mm512_add_epi32(c0, c1));
+        std::size_t count = 0;
+        for (std::size_t w = 0; w < 16; w++)
+                count += counts[w];
+        for (; i < nframes; i++)
+                count += (x[i - 1] < thresh) & (x[i] >= thresh);
+        return count;
+}
+#endif
+
+/*
+ * Pad the per-channel arrays out to the full width of the kernel. Lanes
+ * without input get null pointers so the kernels skip them.
+ */
+struct lanes_t {
+        float const * in[max_lanes];
+        float * out[max_lanes];
+        double * state[max_lanes];
+
+        lanes_t(double * const * state_, float const * const * in_, float * const * out_,
+                std::size_t nchannels) {
+                for (std::size_t l = 0; l < max_lanes; l++) {
+                        bool active = l < nchannels && in_[l];
+                        in[l] = active ? in_[l] : 0;
+                        out[l] = active ? out_[l] : 0;
+                        state[l] = active ? state_[l] : 0;
+                }
+        }
+};
+
+}
+
+namespace jill { namespace dsp { namespace simd {
+
+bool
+supported(isa_type isa)
+{
+        switch (isa) {
+        case GENERIC:
+                return true;
+#ifdef JILL_SIMD_X86
+        case AVX2:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case AVX512:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+                return false;
+        }
+}
+
+isa_type
+detect()
+{
+        char const * env = std::getenv("JILL_SIMD");
+        if (env) {
+                for (int i = AVX512; i >= GENERIC; i--) {
+                        isa_type isa = static_cast<isa_type>(i);
+                        if (std::strcmp(env, name(isa)) == 0 && supported(isa))
+                                return isa;
+                }
+        }
+        if (supported(AVX512)) return AVX512;
+        if (supported(AVX2)) return AVX2;
+        return GENERIC;
+}
+
+char const *
+name(isa_type isa)
+{
+        switch (isa) {
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+        default: return "generic";
+        }
+}
+
+std::size_t
+lanes(isa_type isa)
+{
+        switch (isa) {
+        case AVX2: return 8;
+        case AVX512: return 16;
+        default: return 4;
+        }
+}
+
+void
+sos(isa_type isa, biquad_t const * sections, std::size_t nsections,
+    double * const * state, float const * const * in, float * const * out,
+    std::size_t nchannels, std::size_t nframes)
+{
+        lanes_t g(state, in, out, std::min(nchannels, lanes(isa)));
+        switch (isa) {
+#ifdef JILL_SIMD_X86
+        case AVX2:
+                sos_avx2(sections, nsections, g.state, g.in, g.out, nframes);
+                break;
+        case AVX512:
+                sos_avx512(sections, nsections, g.state, g.in, g.out, nframes);
+                break;
+#endif
+        default:
+                sos_generic(sections, nsections, g.state, g.in, g.out, nframes);
+        }
+}
+
+std::size_t
+fir_workspace(isa_type isa, std::size_t ntaps)
+{
+        std::size_t rows = std::max(ntaps, std::size_t(1)) - 1 + block_frames;
+        return rows * lanes(isa) + alignment / sizeof(double);
+}
+
+void
+fir(isa_type isa, double const * taps, std::size_t ntaps,
+    double * const * history, float const * const * in, float * const * out,
+    std::size_t nchannels, std::size_t nframes, double * workspace)
+{
+        if (ntaps == 0) return;
+        lanes_t g(history, in, out, std::min(nchannels, lanes(isa)));
+        switch (isa) {
+#ifdef JILL_SIMD_X86
+        case AVX2:
+                fir_avx2(taps, ntaps, g.state, g.in, g.out, nframes, workspace);
+                break;
+        case AVX512:
+                fir_avx512(taps, ntaps, g.state, g.in, g.out, nframes, workspace);
+                break;
+#endif
+        default:
+                fir_generic(taps, ntaps, g.state, g.in, g.out, nframes, workspace);
+        }
+}
+
+std::size_t
+decimate_workspace(std::size_t ntaps)
+{
+        return std::max(ntaps, std::size_t(1)) - 1 + std::max(block_frames, ntaps);
+}
+
+std::size_t
+decimate(isa_type isa, double const * taps, std::size_t ntaps, std::size_t factor,
+         double * history, std::size_t & phase, float const * in, float * out,
+         std::size_t nframes, double * workspace)
+{
+        if (ntaps == 0 || factor == 0) return 0;
+        switch (isa) {
+#ifdef JILL_SIMD_X86
+        case AVX2:
+                return decimate_avx2(taps, ntaps, factor, history, phase, in, out, nframes, workspace);
+        case AVX512:
+                return decimate_avx512(taps, ntaps, factor, history, phase, in, out, nframes, workspace);
+#endif
+        default:
+                return decimate_generic(taps, ntaps, factor, history, phase, in, out, nframes, workspace);
+        }
+}
+
+std::size_t
+crossings(isa_type isa, float const * x, std::size_t nframes, float thresh)
+{
+        switch (isa) {
+#ifdef JILL_SIMD_X86
+        case AVX2:
+                return crossings_avx2(x, nframes, thresh);
+        case AVX512:
+                return crossings_avx512(x, nframes, thresh);
+#endif
+        default:
+                return crossings_generic(x, nframes, thresh);
+        }
+}
+
+}}}
@@ -0,0 +1,130 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _SIMD_FILTER_HH
+#define _SIMD_FILTER_HH
+
+#include <cstddef>
+
+namespace jill { namespace dsp {
+
+/** coefficients of a second-order section, normalized so a0 = 1 */
+struct biquad_t {
+        double b0, b1, b2, a1, a2;
+};
+
+/**
+ * Kernels that filter a group of channels sharing the same coefficients at
+ * once. The samples of the group are transposed into short blocks in which
+ * each channel occupies one lane of the vector registers, so one instruction
+ * advances the filter for every channel in the group. The recursion for each
+ * channel stays serial in time, but the channels are independent, which hides
+ * the latency of the arithmetic.
+ *
+ * The kernel is chosen at runtime from the instruction sets the cpu supports.
+ * The generic kernel uses the compiler's vector extensions for the default
+ * target (SSE2 on x86-64) and runs anywhere.
+ */
+namespace simd {
+
+enum isa_type { GENERIC = 0, AVX2, AVX512 };
+
+/** The most channels any kernel filters together */
+const std::size_t max_lanes = 16;
+
+/**
+ * The widest instruction set supported by the cpu. If the environment
+ * variable JILL_SIMD is set to generic, avx2, or avx512, that is used instead
+ * (as long as the cpu supports it).
+ */
+isa_type detect();
+
+/** true if the cpu can run the kernels for isa */
+bool supported(isa_type isa);
+
+char const * name(isa_type isa);
+
+/** The number of channels filtered together by the kernels for isa */
+std::size_t lanes(isa_type isa);
+
+/**
+ * Filter up to lanes(isa) channels through a cascade of second-order
+ * sections (transposed direct form II).
+ *
+ * @param sections   the coefficients of the sections
+ * @param nsections  the number of sections
+ * @param state      for each channel, 2 * nsections doubles of filter state
+ * @param in         for each channel, nframes input samples. Channels with a
+ *                   null input are skipped.
+ * @param out        for each channel, nframes output samples. May be the
+ *                   same as the input.
+ * @param nchannels  the number of channels, no more than lanes(isa)
+ */
+void sos(isa_type isa, biquad_t const * sections, std::size_t nsections,
+         double * const * state, float const * const * in, float * const * out,
+         std::size_t nchannels, std::size_t nframes);
+
+/** The number of doubles of workspace fir() needs for a group */
+std::size_t fir_workspace(isa_type isa, std::size_t ntaps);
+
+/**
+ * Filter up to lanes(isa) channels with an FIR filter.
+ *
+ * @param taps       the filter coefficients
+ * @param ntaps      the number of coefficients
+ * @param history    for each channel, the last ntaps - 1 input samples,
+ *                   oldest first
+ * @param in         for each channel, nframes input samples. Channels with a
+ *                   null input are skipped.
+ * @param out        for each channel, nframes output samples. Must not
+ *                   overlap the input.
+ * @param workspace  fir_workspace(isa, ntaps) doubles, not shared with any
+ *                   concurrent call
+ */
+void fir(isa_type isa, double const * taps, std::size_t ntaps,
+         double * const * history, float const * const * in, float * const * out,
+         std::size_t nchannels, std::size_t nframes, double * workspace);
+
+/** The number of doubles of workspace decimate() needs */
+std::size_t decimate_workspace(std::size_t ntaps);
+
+/**
+ * Low-pass filter one channel with an FIR filter and keep every factor-th
+ * sample. Only the outputs that are kept are computed, which is equivalent
+ * to running the polyphase components of the filter on the phases of the
+ * input. Each output is a dot product of the taps with a window of the
+ * input, computed a vector of taps at a time.
+ *
+ * @param taps       the filter coefficients, in reverse order
+ * @param ntaps      the number of coefficients
+ * @param factor     the decimation factor
+ * @param history    the last ntaps - 1 input samples, oldest first
+ * @param phase      the number of input samples before the next output;
+ *                   less than factor. Updated for the next call.
+ * @param in         nframes input samples
+ * @param out        room for (nframes + factor - 1) / factor output samples
+ * @param workspace  decimate_workspace(ntaps) doubles
+ * @return the number of output samples
+ */
+std::size_t decimate(isa_type isa, double const * taps, std::size_t ntaps, std::size_t factor,
+                     double * history, std::size_t & phase, float const * in, float * out,
+                     std::size_t nframes, double * workspace);
+
+/**
+ * Count rising threshold crossings: the number of i in [1, nframes) for which
+ * x[i-1] < thresh and x[i] >= thresh. The comparisons are done a vector of
+ * samples at a time, without branches, and the result is the same as the
+ * scalar loop for any input (comparisons with NaN are false).
+ */
+std::size_t crossings(isa_type isa, float const * x, std::size_t nframes, float thresh);
+
+}}}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "spectral_trigger_bank.hh"
+
+using namespace jill::dsp;
+
+namespace {
+
+std::size_t
+next_pow2(std::size_t n)
+{
+        std::size_t p = 16;
+        while (p < n) p <<= 1;
+        return p;
+}
+
+}
+
+spectral_trigger_bank::spectral_trigger_bank(size_type nchannels, double sampling_rate,
+                                             params_type const & params)
+        : _nchannels(nchannels), _params(params),
+          _fft(next_pow2(params.fft_size ? params.fft_size : params.period_size)),
+          _channels(nchannels)
+{
+        if (params.period_size < 1 || params.owindow_periods < 1 || params.cwindow_periods < 1)
+                throw std::invalid_argument("trigger periods and windows must be at least 1");
+        size_type const N = _fft.size();
+        double const nyquist = sampling_rate / 2;
+        if (params.band_lo < 0 || params.band_hi <= params.band_lo || params.band_hi > nyquist)
+                throw std::invalid_argument("detection band must be between 0 and the Nyquist frequency");
+        // bins whose centers are in the band; the DC bin is not used
+        _bin_lo = std::max(size_type(1), size_type(std::ceil(params.band_lo / sampling_rate * N)));
+        _bin_hi = std::min(_fft.nbins(), size_type(std::floor(params.band_hi / sampling_rate * N)) + 1);
+        if (_bin_lo >= _bin_hi)
+                throw std::invalid_argument("detection band is narrower than the FFT resolution");
+
+        // periodic Hann window; a sinusoid with amplitude 1 has a total
+        // power of 3 N^2 / 32 in the spectrum
+        _window.resize(N);
+        for (size_type n = 0; n < N; ++n)
+                _window[n] = 0.5 - 0.5 * std::cos(2 * M_PI * n / N);
+        _power_scale = 3.0 * N * N / 32;
+
+        _frame.resize(N);
+        _re.resize(_fft.nbins());
+        _im.resize(_fft.nbins());
+        _scratch.resize(N);
+        for (size_type c = 0; c < nchannels; ++c) {
+                channel_type & ch = _channels[c];
+                ch.history.resize(N);
+                ch.detections[0].reset(new running_counter<count_type>(params.owindow_periods));
+                ch.detections[1].reset(new running_counter<count_type>(params.cwindow_periods));
+        }
+        reset();
+}
+
+void
+spectral_trigger_bank::reset()
+{
+        _period_nsamples = 0;
+        _head = 0;
+        for (size_type c = 0; c < _nchannels; ++c) {
+                channel_type & ch = _channels[c];
+                ch.open = false;
+                std::fill(ch.history.begin(), ch.history.end(), 0.0);
+                ch.detections[0]->reset();
+                ch.detections[1]->reset();
+                ch.ratio = ch.power = -HUGE_VAL;
+        }
+}
+
+spectral_trigger_bank::size_type
+spectral_trigger_bank::push(sample_type const * const * samples, size_type nframes,
+                            event_type * events, size_type max_events,
+                            sample_type * const * counts)
+{
+        size_type const N = _fft.size();
+        size_type nevents = 0;
+        for (size_type i = 0; i < nframes; ) {
+                size_type const n = std::min(nframes - i, _params.period_size - _period_nsamples);
+                bool const period_done = _period_nsamples + n == _params.period_size;
+                for (size_type c = 0; c < _nchannels; ++c) {
+                        channel_type & ch = _channels[c];
+                        sample_type const * x = samples[c] + i;
+                        for (size_type k = 0, pos = _head; k < n; ++k) {
+                                ch.history[pos] = x[k];
+                                if (++pos == N) pos = 0;
+                        }
+                        if (counts && counts[c])
+                                std::fill(counts[c] + i, counts[c] + i + n - period_done, count_value(ch));
+                }
+                _head = (_head + n) % N;
+                _period_nsamples += n;
+                i += n;
+                if (period_done) {
+                        nevents += end_period(i - 1, events + nevents, max_events - nevents);
+                        if (counts) {
+                                for (size_type c = 0; c < _nchannels; ++c)
+                                        if (counts[c]) counts[c][i - 1] = count_value(_channels[c]);
+                        }
+                }
+        }
+        return nevents;
+}
+
+void
+spectral_trigger_bank::analyze(channel_type & ch)
+{
+        size_type const N = _fft.size();
+        // the oldest sample is at _head
+        for (size_type n = 0, pos = _head; n < N; ++n) {
+                _frame[n] = _window[n] * ch.history[pos];
+                if (++pos == N) pos = 0;
+        }
+        _fft.forward(&_frame[0], &_re[0], &_im[0], &_scratch[0]);
+        double band = 0, total = 0;
+        for (size_type k = 1; k < _fft.nbins(); ++k) {
+                double const p = _re[k] * _re[k] + _im[k] * _im[k];
+                total += p;
+                if (k >= _bin_lo && k < _bin_hi) band += p;
+        }
+        // keep the logs finite for silent input
+        double const floor = 1e-20 * _power_scale;
+        ch.ratio = 10 * std::log10((band + floor) / (total - band + floor));
+        ch.power = 10 * std::log10((band + floor) / _power_scale);
+}
+
+spectral_trigger_bank::size_type
+spectral_trigger_bank::end_period(size_type offset, event_type * events, size_type max_events)
+{
+        size_type nevents = 0;
+        _period_nsamples = 0;
+        for (size_type c = 0; c < _nchannels; ++c) {
+                channel_type & ch = _channels[c];
+                analyze(ch);
+                double const ratio = ch.open ? _params.close_ratio : _params.open_ratio;
+                bool const detected = ch.ratio > ratio && ch.power > _params.min_power;
+                running_counter<count_type> & counter = *ch.detections[ch.open];
+                counter.push(detected);
+                if (!counter.full()) continue;
+                bool const change = ch.open ? (counter.running_count() < _params.ccount_thresh)
+                        : (counter.running_count() > _params.ocount_thresh);
+                if (!change) continue;
+                counter.reset();
+                ch.open = !ch.open;
+                if (nevents < max_events) {
+                        event_type e = { c, offset, ch.open };
+                        events[nevents++] = e;
+                }
+        }
+        return nevents;
+}
+
+spectral_trigger_bank::sample_type
+spectral_trigger_bank::count_value(channel_type const & ch) const
+{
+        size_type const window = ch.open ? _params.cwindow_periods : _params.owindow_periods;
+        return sample_type(ch.detections[ch.open]->running_count()) / window;
+}
@@ -0,0 +1,126 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _SPECTRAL_TRIGGER_BANK_HH
+#define _SPECTRAL_TRIGGER_BANK_HH
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "trigger_bank.hh"
+#include "counter.hh"
+#include "fft.hh"
+
+namespace jill { namespace dsp {
+
+/**
+ * Detects signals with energy in a frequency band, such as song or
+ * vocalizations, by the ratio of the energy in the band to the energy
+ * outside it. Unlike counting threshold crossings, this distinguishes
+ * band-limited signals from broadband noise of the same amplitude.
+ *
+ * At the end of each analysis period, the spectrum of the last fft_size
+ * samples of each channel is computed (with a Hann window), and the period
+ * is scored as a detection if the band ratio and the band power are both
+ * above thresholds. The gates then work like crossing_trigger: a closed gate
+ * opens when more than a number of periods in the opening window are
+ * detections, and an open gate closes when fewer than a number of periods
+ * in the closing window are. The closing ratio is normally lower than the
+ * opening ratio, to give some hysteresis.
+ *
+ * The FFT and the buffers are set up when the object is constructed, so
+ * push() does not allocate memory.
+ */
+class spectral_trigger_bank : public trigger_bank {
+public:
+        typedef int count_type;
+
+        struct params_type {
+                double band_lo;                 // edges of the band (Hz)
+                double band_hi;
+                double open_ratio;              // in-band to out-of-band energy (dB)
+                double close_ratio;
+                double min_power;               // band power, dB re full scale sine
+                count_type ocount_thresh;       // detections to open the gate
+                size_type owindow_periods;
+                count_type ccount_thresh;       // detections to keep it open
+                size_type cwindow_periods;
+                size_type period_size;
+                size_type fft_size;             // 0 to use the period size
+        };
+
+        /**
+         * @param nchannels      the number of channels
+         * @param sampling_rate  the sampling rate of the data
+         * @param params         the detector parameters
+         * @throws std::invalid_argument if the band is not in (0, Nyquist)
+         */
+        spectral_trigger_bank(size_type nchannels, double sampling_rate, params_type const & params);
+
+        /**
+         * Analyze a block of samples from each channel (@see
+         * trigger_bank::push). There can be an event for each channel in
+         * each period that ends in the block. The counts are the number of
+         * detections in the active window, as a fraction of its length.
+         */
+        size_type push(sample_type const * const * samples, size_type nframes,
+                       event_type * events, size_type max_events,
+                       sample_type * const * counts=0);
+
+        size_type max_events(size_type nframes) const {
+                return _nchannels * (nframes / _params.period_size + 1);
+        }
+
+        bool open(size_type channel) const { return _channels[channel].open; }
+
+        size_type nchannels() const { return _nchannels; }
+        size_type period_size() const { return _params.period_size; }
+
+        void reset();
+
+        /** the size of the FFT: fft_size (or the period size) rounded up to a power of two */
+        size_type fft_size() const { return _fft.size(); }
+
+        /** the ratio (dB) of in-band to out-of-band energy in the last period */
+        double ratio(size_type channel) const { return _channels[channel].ratio; }
+
+        /** the power in the band (dB re a full-scale sinusoid) in the last period */
+        double power(size_type channel) const { return _channels[channel].power; }
+
+private:
+        struct channel_type {
+                bool open;
+                std::vector<double> history;    // the last fft_size samples, circular
+                boost::shared_ptr<running_counter<count_type> > detections[2];
+                double ratio;
+                double power;
+        };
+
+        /* score the last period for each channel; returns the number of events */
+        size_type end_period(size_type offset, event_type * events, size_type max_events);
+        /* spectral analysis of one channel's history */
+        void analyze(channel_type & ch);
+        sample_type count_value(channel_type const & ch) const;
+
+        size_type _nchannels;
+        params_type _params;
+        real_fft _fft;
+        size_type _bin_lo, _bin_hi;             // bins in the band: [lo, hi)
+        double _power_scale;                    // power of a full-scale sinusoid
+
+        size_type _period_nsamples;             // shared by all channels
+        size_type _head;                        // next position in the histories
+        std::vector<channel_type> _channels;
+        std::vector<double> _window;
+        std::vector<double> _frame, _re, _im, _scratch;
+};
+
+}}
+
+#endif
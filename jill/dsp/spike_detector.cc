@@ -0,0 +1,118 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "spike_detector.hh"
+
+using namespace jill::dsp;
+
+spike_detector::spike_detector(size_type nchannels, sample_type thresh, size_type refractory,
+                               size_type align)
+        : _nchannels(nchannels), _thresh(thresh), _rising(thresh >= 0),
+          _refractory(refractory), _align(align),
+          _dead_time(std::max(std::max(refractory, align), size_type(1))),
+          _isa(simd::detect()),
+          _last(nchannels), _dead(nchannels), _searching(nchannels), _peak(nchannels),
+          _peak_offset(nchannels)
+{
+        reset();
+}
+
+void
+spike_detector::reset()
+{
+        // comparisons with the first sample are false
+        std::fill(_last.begin(), _last.end(), NAN);
+        std::fill(_dead.begin(), _dead.end(), 0);
+        std::fill(_searching.begin(), _searching.end(), 0);
+        std::fill(_peak.begin(), _peak.end(), 0);
+        std::fill(_peak_offset.begin(), _peak_offset.end(), 0);
+}
+
+bool
+spike_detector::any_crossings(sample_type const * x, size_type start, size_type nframes,
+                              sample_type prev) const
+{
+        if (crossed(prev, x[start])) return true;
+        std::size_t rising = simd::crossings(_isa, x + start, nframes - start, _thresh);
+        if (_rising) return rising > 0;
+        // falling crossings alternate with rising ones, so there is one
+        // without a rising crossing only if the block starts above the
+        // threshold and ends below it
+        return rising > 0 || (x[start] >= _thresh && x[nframes - 1] < _thresh);
+}
+
+void
+spike_detector::search(size_type c, sample_type const * x, size_type start, size_type stop)
+{
+        sample_type const sign = _rising ? 1 : -1;
+        for (size_type k = start; k < stop; ++k) {
+                if (sign * x[k] > _peak[c]) {
+                        _peak[c] = sign * x[k];
+                        _peak_offset[c] = k;
+                }
+        }
+}
+
+spike_detector::size_type
+spike_detector::push(sample_type const * const * samples, size_type nframes,
+                     event_type * events, size_type max_events)
+{
+        if (nframes == 0) return 0;
+        sample_type const sign = _rising ? 1 : -1;
+        size_type nevents = 0;
+        for (size_type c = 0; c < _nchannels; ++c) {
+                sample_type const * x = samples[c];
+                // finish the peak search for a spike in the previous block
+                if (_searching[c]) {
+                        size_type const n = std::min(_searching[c], nframes);
+                        search(c, x, 0, n);
+                        _searching[c] -= n;
+                        if (!_searching[c] && nevents < max_events) {
+                                event_type e = { c, _peak_offset[c], sign * _peak[c] };
+                                events[nevents++] = e;
+                        }
+                }
+                size_type const start = std::min(_dead[c], nframes);
+                _dead[c] -= start;
+                if (start < nframes &&
+                    any_crossings(x, start, nframes, start ? x[start - 1] : _last[c])) {
+                        for (size_type k = start; k < nframes; ++k) {
+                                if (!crossed(k ? x[k - 1] : _last[c], x[k])) continue;
+                                if (_align) {
+                                        _peak[c] = sign * x[k];
+                                        _peak_offset[c] = k;
+                                        size_type const stop = std::min(k + _align, nframes);
+                                        search(c, x, k + 1, stop);
+                                        _searching[c] = k + _align - stop;
+                                }
+                                if (!_searching[c] && nevents < max_events) {
+                                        event_type e = { c, long(k), x[k] };
+                                        if (_align) {
+                                                e.offset = _peak_offset[c];
+                                                e.value = sign * _peak[c];
+                                        }
+                                        events[nevents++] = e;
+                                }
+                                if (k + _dead_time >= nframes) {
+                                        _dead[c] = k + _dead_time - nframes;
+                                        break;
+                                }
+                                k += _dead_time - 1;
+                        }
+                }
+                _last[c] = x[nframes - 1];
+                if (_searching[c]) _peak_offset[c] -= long(nframes);
+        }
+        return nevents;
+}
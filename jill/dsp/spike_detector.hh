@@ -0,0 +1,123 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _SPIKE_DETECTOR_HH
+#define _SPIKE_DETECTOR_HH
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "simd_filter.hh"
+
+namespace jill { namespace dsp {
+
+/**
+ * Detects spikes on a number of channels by threshold crossings. A spike
+ * is the first sample past the threshold; for a negative threshold, spikes
+ * are detected when the signal falls below it. After each spike, crossings
+ * are ignored for a refractory period.
+ *
+ * The spikes can optionally be aligned to their peaks (or troughs), which
+ * are found in a fixed window following the crossing. Because the window
+ * can extend into the next block, a spike may be reported in the block
+ * after the one it occurred in, with a negative offset; the delay is never
+ * more than the length of the window (@see delay()).
+ *
+ * Most blocks on most channels don't contain spikes, so each block is first
+ * tested for crossings with the SIMD kernels in simd_filter, and only the
+ * blocks with crossings are scanned sample by sample.
+ */
+class spike_detector : boost::noncopyable {
+public:
+        typedef float sample_type;
+        typedef std::size_t size_type;
+
+        /** a detected spike */
+        struct event_type {
+                size_type channel;
+                long offset;            // frame relative to the start of the block
+                sample_type value;      // the sample at the spike
+        };
+
+        /**
+         * @param nchannels   the number of channels
+         * @param thresh      the threshold (in sample units); the sign gives
+         *                    the polarity of the spikes
+         * @param refractory  the minimum number of samples between spikes
+         * @param align       the length of the window to search for the peak
+         *                    of each spike, or 0 to report the crossing
+         */
+        spike_detector(size_type nchannels, sample_type thresh, size_type refractory,
+                       size_type align=0);
+
+        /**
+         * Analyze a block of samples from each channel. The events are
+         * ordered by channel and then by offset. The first offset for a
+         * channel may be negative (by at most delay()) if its spike began
+         * in the previous block.
+         *
+         * @param samples     nchannels() buffers of nframes samples
+         * @param nframes     the number of samples in each buffer
+         * @param events      storage for the spikes
+         * @param max_events  the size of events; later spikes are not reported
+         * @return the number of events stored
+         */
+        size_type push(sample_type const * const * samples, size_type nframes,
+                       event_type * events, size_type max_events);
+
+        /** an upper bound on the number of events in a block of nframes */
+        size_type max_events(size_type nframes) const {
+                return _nchannels * (nframes / _dead_time + 2);
+        }
+
+        /** the most a spike can be reported after it occurred */
+        size_type delay() const { return _align; }
+
+        /** clear the detector's state */
+        void reset();
+
+        size_type nchannels() const { return _nchannels; }
+        sample_type thresh() const { return _thresh; }
+        size_type refractory() const { return _refractory; }
+        size_type align() const { return _align; }
+
+        /** the instruction set used to test for crossings; detected at construction */
+        simd::isa_type isa() const { return _isa; }
+        void set_isa(simd::isa_type isa) { _isa = isa; }
+
+private:
+        /* true if the signal crosses the threshold between a and b */
+        bool crossed(sample_type a, sample_type b) const {
+                return _rising ? (a < _thresh && b >= _thresh) : (a >= _thresh && b < _thresh);
+        }
+        /* true if there are any crossings in x[start, nframes) */
+        bool any_crossings(sample_type const * x, size_type start, size_type nframes,
+                           sample_type prev) const;
+        /* search x[start, stop) for a larger peak */
+        void search(size_type c, sample_type const * x, size_type start, size_type stop);
+
+        size_type _nchannels;
+        sample_type _thresh;
+        bool _rising;
+        size_type _refractory;
+        size_type _align;
+        size_type _dead_time;                   // crossings ignored after a spike
+        simd::isa_type _isa;
+
+        // per-channel state
+        std::vector<sample_type> _last;         // last sample of the previous block
+        std::vector<size_type> _dead;           // samples left in the dead time
+        std::vector<size_type> _searching;      // samples left in the peak window
+        std::vector<sample_type> _peak;         // sign-adjusted value of the peak
+        std::vector<long> _peak_offset;         // relative to the current block
+};
+
+}}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _TRIGGER_BANK_HH
+#define _TRIGGER_BANK_HH
+
+#include <cstddef>
+#include <boost/noncopyable.hpp>
+
+namespace jill { namespace dsp {
+
+/**
+ * Interface for detectors that monitor a number of channels with a gate for
+ * each, which opens when a signal is detected and closes when it ends.
+ * Implementations must be safe to call from the real-time thread.
+ */
+class trigger_bank : boost::noncopyable {
+public:
+        typedef float sample_type;
+        typedef std::size_t size_type;
+
+        /** a change in the state of one channel */
+        struct event_type {
+                size_type channel;
+                size_type offset;       // frame in the block
+                bool open;              // true for onset, false for offset
+        };
+
+        virtual ~trigger_bank() {}
+
+        /**
+         * Analyze a block of samples from each channel.
+         *
+         * @param samples     nchannels() buffers of nframes samples
+         * @param nframes     the number of samples in each buffer
+         * @param events      storage for the state changes in the block, in
+         *                    order of offset
+         * @param max_events  the size of events; later changes are not
+         *                    reported (but still change the state)
+         * @param counts      if not null, buffers for the state of the
+         *                    detector for each channel (between 0 and 1);
+         *                    null buffers are skipped
+         * @return the number of events stored
+         */
+        virtual size_type push(sample_type const * const * samples, size_type nframes,
+                               event_type * events, size_type max_events,
+                               sample_type * const * counts=0) = 0;
+
+        /** an upper bound on the number of events in a block of nframes */
+        virtual size_type max_events(size_type nframes) const = 0;
+
+        /** the state of the gate for a channel */
+        virtual bool open(size_type channel) const = 0;
+
+        /** close all the gates and clear the detectors' state */
+        virtual void reset() = 0;
+
+        virtual size_type nchannels() const = 0;
+        virtual size_type period_size() const = 0;
+};
+
+}}
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <boost/type_traits/make_signed.hpp>
 
 #include "triggered_data_writer.hh"
@@ -28,13 +29,10 @@ operator<<(std::ostream & os, data_block_t const & b)
 triggered_data_writer::triggered_data_writer(boost::shared_ptr<data_writer> writer,
                                              string const & trigger_port,
                                              nframes_t pretrigger_frames, nframes_t posttrigger_frames)
-        : buffered_data_writer(writer),
-          _trigger_port(trigger_port),
-          _pretrigger(pretrigger_frames),
-          _posttrigger(std::max(posttrigger_frames, 1U)),
-          _recording(false)
+        : buffered_data_writer(writer), _snapshot(0), _high_water(0), _released(0)
 {
         DBG << "triggered_data_writer initializing";
+        add_trigger(writer, trigger_port, vector<string>(), pretrigger_frames, posttrigger_frames);
 }
 
 triggered_data_writer::~triggered_data_writer()
@@ -44,46 +42,139 @@ triggered_data_writer::~triggered_data_writer()
         join();
 }
 
-/*
- * This function handles opening a new entry and writing data in the prebuffer.
- * The event_time argument indicates the time when the trigger event occurred,
- * so we start at the tail of the ringbuffer and search for the sample with
- * index event_time - _pretrigger
- */
 void
-triggered_data_writer::start_recording(nframes_t event_time)
+triggered_data_writer::add_trigger(boost::shared_ptr<data_writer> writer,
+                                   string const & trigger_port,
+                                   vector<string> const & channels,
+                                   nframes_t pretrigger_frames, nframes_t posttrigger_frames)
+{
+        if (_state != Stopped)
+                throw std::runtime_error("Tried to add trigger while writer thread is running");
+        trigger_t trig;
+        trig.writer = writer;
+        trig.port = trigger_port;
+        trig.channels.insert(channels.begin(), channels.end());
+        trig.pretrigger = pretrigger_frames;
+        trig.posttrigger = std::max(posttrigger_frames, 1U);
+        trig.recording = false;
+        trig.last_offset = 0;
+        _triggers.push_back(trig);
+        DBG << "added trigger " << trigger_port << " (" << channels.size() << " channels)";
+}
+
+void
+triggered_data_writer::set_detector(string const & trigger_port, string const & channel,
+                                    detector_type detector)
 {
-        nframes_t onset = event_time - _pretrigger;
-        _writer->new_entry(onset);
+        if (_state != Stopped)
+                throw std::runtime_error("Tried to set detector while writer thread is running");
+        std::vector<trigger_t>::iterator it;
+        for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                if (it->port == trigger_port) {
+                        it->detect_channel = channel;
+                        it->detector = detector;
+                        DBG << "trigger " << trigger_port << " will detect signals in " << channel;
+                        return;
+                }
+        }
+        throw std::runtime_error("no such trigger: " + trigger_port);
+}
 
-        INFO << "writing pretrigger data from " << onset << "--" << event_time;
-        /* start at tail of queue and find onset */
-        data_block_t const * ptr = _buffer->peek();
-        assert(ptr);
+namespace {
 
-        /* skip any earlier periods */
-        while (ptr->time + ptr->nframes() < onset) {
-                _buffer->release();
-                ptr = _buffer->peek();
+/* compares index entries against frame counts, allowing for wraparound */
+struct index_compare {
+        bool operator()(pair<nframes_t, size_t> const & entry, nframes_t time) const {
+                return (framediff_t)(entry.first - time) <= 0;
         }
+};
+
+}
 
-        /* write partial period(s) */
-        while (ptr->time <= onset) {
-                DBG << "prebuf frame: t=" << ptr->time << ", on=" << onset - ptr->time
-                    << ", id=" << ptr->id() << ", dtype=" << ptr->dtype;
-                _writer->write(ptr, onset - ptr->time, 0);
-                _buffer->release();
-                ptr = _buffer->peek();
+void
+triggered_data_writer::index_block(data_block_t const * data, size_t offset)
+{
+        size_t pos = _released + offset;
+        /* the buffer was emptied out from under us (i.e., resized) */
+        if (!_index.empty() && _index.back().second > pos) {
+                DBG << "buffer was flushed; clearing time index";
+                _index.clear();
         }
+        nframes_t end = data->time + data->nframes();
+        if (_index.empty() || (framediff_t)(end - _high_water) > 0) {
+                _high_water = end;
+                _index.push_back(index_entry(end, pos));
+        }
+}
 
-        /* write additional periods in prebuffer, up to current period */
-        while (ptr->time + ptr->nframes() <= event_time) {
-                _writer->write(ptr, 0, 0);
-                _buffer->release();
-                ptr = _buffer->peek();
+size_t
+triggered_data_writer::seek(nframes_t time) const
+{
+        std::deque<index_entry>::const_iterator it =
+                std::lower_bound(_index.begin(), _index.end(), time, index_compare());
+        if (it == _index.end())
+                return read_ahead_space();
+        return (it->second > _released) ? it->second - _released : 0;
+}
+
+void
+triggered_data_writer::release_to(size_t offset)
+{
+        if (offset == 0) return;
+        release(offset);
+        _released += offset;
+        /* the last released entry still covers the blocks up to the next one */
+        while (_index.size() > 1 && _index[1].second <= _released)
+                _index.pop_front();
+        if (!_index.empty() && _index.front().second < _released)
+                _index.front().second = _released;
+}
+
+/*
+ * This function handles opening a new entry and writing data in the prebuffer.
+ * The event_time argument indicates the time when the trigger event occurred.
+ * We look up event_time - pretrigger in the index and write everything from
+ * there up to the current block. The prebuffer is not released, because other
+ * triggers may need it.
+ */
+void
+triggered_data_writer::start_recording(trigger_t & trig, nframes_t event_time, size_t offset)
+{
+        nframes_t onset = event_time - trig.pretrigger;
+        new_entry(*trig.writer, onset);
+
+        INFO << trig.port << ": writing pretrigger data from " << onset << "--" << event_time;
+        size_t pos = seek(onset);
+        while (pos < offset) {
+                data_block_t const * ptr = peek(pos);
+                assert(ptr);
+                size_t size = ptr->size();
+                /* skip earlier periods and unrecorded channels */
+                if ((framediff_t)(ptr->time + ptr->nframes() - onset) > 0 && trig.records(ptr->id())) {
+                        nframes_t start = ((framediff_t)(onset - ptr->time) > 0) ? onset - ptr->time : 0;
+                        DBG << "prebuf frame: t=" << ptr->time << ", on=" << start
+                            << ", id=" << ptr->id() << ", dtype=" << ptr->dtype;
+                        write_block(*trig.writer, ptr, start, 0);
+                }
+                pos += size;
         }
 
-        _recording = true;
+        trig.recording = true;
+}
+
+void
+triggered_data_writer::snapshot()
+{
+        __sync_bool_compare_and_swap(&_snapshot, 0, 1);
+}
+
+void
+triggered_data_writer::command(string const & cmd)
+{
+        if (cmd == "snapshot")
+                snapshot();
+        else
+                buffered_data_writer::command(cmd);
 }
 
 /*
@@ -91,68 +182,136 @@ triggered_data_writer::start_recording(nframes_t event_time)
  * write() will do this at the appropriate time
  */
 void
-triggered_data_writer::stop_recording(nframes_t event_time)
+triggered_data_writer::stop_recording(trigger_t & trig, nframes_t event_time)
 {
-        _recording = false;
-        _last_offset = event_time + _posttrigger;
-        INFO << "writing posttrigger data from " << event_time << "--" << _last_offset;
+        trig.recording = false;
+        trig.last_offset = event_time + trig.posttrigger;
+        INFO << trig.port << ": writing posttrigger data from " << event_time << "--" << trig.last_offset;
 }
 
 void
 triggered_data_writer::write(data_block_t const * data)
 {
+        std::vector<trigger_t>::iterator it;
+        /* data may be moved by write_block(), so copy out what's needed and
+         * use the block's position to find it again */
         std::string id = data->id();
+        dtype_t dtype = data->dtype;
+        nframes_t time = data->time;
         nframes_t nframes = data->nframes();
-        /* handle trigger channel */
-        if (data->dtype == EVENT && id == _trigger_port) {
-                if (_recording) {
-                        if (midi::is_offset(data->data(), data->sz_data)) {
-                                DBG << "trigger off event: time=" << data->time;
-                                stop_recording(data->time);
-                        }
+        size_t offset = read_ahead_space() - data->size();
+        index_block(data, offset);
+
+        /* handle trigger channels and detectors */
+        for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                bool onset = false, offset_event = false;
+                nframes_t event_time = time;
+                if (dtype == EVENT && id == it->port) {
+                        data = peek(offset);
+                        onset = midi::is_onset(data->data(), data->sz_data);
+                        offset_event = midi::is_offset(data->data(), data->sz_data);
                 }
-                else {
-                        if (midi::is_onset(data->data(), data->sz_data)) {
-                                DBG << "trigger on event: time=" << data->time;
-                                start_recording(data->time);
+                else if (dtype == SAMPLED && it->detector && id == it->detect_channel) {
+                        data = peek(offset);
+                        bool open;
+                        int pos = it->detector(static_cast<sample_t const *>(data->data()),
+                                               nframes, open);
+                        if (pos >= 0) {
+                                event_time = time + pos;
+                                onset = open;
+                                offset_event = !open;
                         }
                 }
+                else
+                        continue;
+                if (it->recording && offset_event) {
+                        DBG << it->port << ": trigger off event: time=" << event_time;
+                        stop_recording(*it, event_time);
+                }
+                else if (!it->recording && onset) {
+                        DBG << it->port << ": trigger on event: time=" << event_time;
+                        start_recording(*it, event_time, offset);
+                }
         }
 
-        if (_recording) {
-                // Executed when an onset trigger has occurred and
-                // stop_recording was not called, so write full block.
-
-                // sanity check if data is flushed. can't compare pointers
-                // directly because the same data may have multiple addresses in
-                // the buffer
-                data_block_t const * tail = _buffer->peek();
-                assert(tail->time == data->time && tail->id() == id);
-                _writer->write(data, 0, 0);
-                _buffer->release();
-                if (__sync_bool_compare_and_swap(&_reset, true, false)) {
-                        stop_recording(data->time + nframes);
+        /* snapshot: write the pretrigger windows up through this period */
+        if (__sync_bool_compare_and_swap(&_snapshot, 1, 0)) {
+                for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                        if (it->recording) {
+                                INFO << it->port << ": ignoring snapshot request (already recording)";
+                                continue;
+                        }
+                        INFO << it->port << ": taking snapshot";
+                        start_recording(*it, time + nframes, offset);
+                        // write through the end of the period, then close
+                        it->recording = false;
+                        it->last_offset = time + nframes;
                 }
         }
-        else if (_writer->ready()) {
-                // executed when stop_recording was called, so we're writing
-                // post-trigger periods. If enough data has been written, close
-                // entry.
-                framediff_t compare = _last_offset - data->time;
-                if (compare < 0) {
-                        _writer->close_entry();
+
+        nframes_t max_pretrigger = 0;
+        bool idle = false;
+        for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                if (it->recording) {
+                        // Executed when an onset trigger has occurred and
+                        // stop_recording was not called, so write full block.
+                        if (it->records(id))
+                                write_block(*it->writer, peek(offset));
+                        continue;
                 }
-                else {
-                        _writer->write(data, 0, (nframes_t)compare);
+                if (it->writer->ready()) {
+                        // executed when stop_recording was called, so we're writing
+                        // post-trigger periods. If enough data has been written, close
+                        // entry. Only frames before last_offset are written,
+                        // and write_block() takes a stop of 0 to mean the
+                        // whole block, so a block that starts at last_offset
+                        // also closes the entry.
+                        framediff_t compare = it->last_offset - time;
+                        if (compare <= 0)
+                                close_entry(*it->writer);
+                        else if (it->records(id))
+                                write_block(*it->writer, peek(offset), 0, (nframes_t)compare);
                 }
-                _buffer->release();
+                idle = true;
+                max_pretrigger = std::max(max_pretrigger, it->pretrigger);
         }
-        else {
-                // not writing: drop blocks on tail of queue as needed
-                data_block_t const * tail = _buffer->peek();
-                while (tail && (data->time + nframes) - (tail->time + nframes) > _pretrigger) {
-                        _buffer->release();
-                        tail = _buffer->peek();
+
+        if (__sync_bool_compare_and_swap(&_reset, true, false)) {
+                for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                        if (it->recording) stop_recording(*it, time + nframes);
                 }
         }
+
+        // drop blocks on tail of queue that are too old for any pretrigger
+        if (idle)
+                release_to(seek(time + nframes - max_pretrigger));
+        else
+                release_to(read_ahead_space());
+}
+
+void
+triggered_data_writer::store_xrun()
+{
+        std::vector<trigger_t>::iterator it;
+        for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                it->writer->xrun();
+        }
+}
+
+void
+triggered_data_writer::flush()
+{
+        std::vector<trigger_t>::iterator it;
+        for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                it->writer->flush();
+        }
+}
+
+void
+triggered_data_writer::close_entries()
+{
+        std::vector<trigger_t>::iterator it;
+        for (it = _triggers.begin(); it != _triggers.end(); ++it) {
+                it->writer->close_entry();
+        }
 }
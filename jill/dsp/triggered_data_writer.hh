@@ -1,6 +1,10 @@
 #ifndef _TRIGGERED_DATA_WRITER_HH
 #define _TRIGGERED_DATA_WRITER_HH
 
+#include <deque>
+#include <set>
+#include <vector>
+#include <boost/function.hpp>
 #include "buffered_data_writer.hh"
 
 namespace jill { namespace dsp {
@@ -18,10 +22,47 @@ namespace jill { namespace dsp {
  * "prebuffering" is provided, so that data before an onset event can be written
  * to disk.  Similarly, the object can be configured to continue writing for
  * some time after an offset event.
+ *
+ * Additional triggers can be added with add_trigger(). Each trigger has its
+ * own trigger port, output, pre/posttrigger windows, and set of channels, and
+ * starts and stops independently of the others. All the triggers share the
+ * same buffer, which retains enough data to satisfy the longest pretrigger of
+ * any trigger that's not recording.
+ *
+ * Triggers can also be driven by a detector function that analyzes one of the
+ * sampled channels (@see set_detector). The detector runs in the consumer
+ * thread as data are read ahead from the buffer, so it adds no load to the
+ * realtime thread.
+ *
+ * The pretrigger windows can also be written out on demand with snapshot().
+ * This supports a retroactive capture mode, where the buffer always holds the
+ * last N seconds of data and nothing is written until the user decides it was
+ * worth keeping.
+ *
+ * Pretrigger data are written by the consumer thread in one step, when a
+ * trigger starts or a snapshot is taken, and the buffer keeps filling while
+ * this happens. Leave room in the buffer for the data that arrive during the
+ * longest such write.
+ *
+ * To avoid walking through the buffer block by block (which gets expensive with
+ * long pretrigger windows and many channels), the writer keeps a time index of
+ * the unreleased data. Each entry records the position of a block that
+ * extends the latest frame seen so far, so the index is sorted by time and
+ * pretrigger onsets and release points can be found with a binary search.
+ * Old blocks are released in one step.
  */
 class triggered_data_writer : public buffered_data_writer {
         friend class triggered_data_writer_test;
 public:
+        /**
+         * Type of function used to detect onsets and offsets in sampled
+         * data. It's called with each period of data from the monitored
+         * channel, and should return the offset (in frames) of the first
+         * state change in the period, or -1 if the state didn't change. The
+         * last argument is set to true if the change was an onset.
+         */
+        typedef boost::function<int (sample_t const *, nframes_t, bool &)> detector_type;
+
         /**
          * Initialize buffered writer.
          *
@@ -38,23 +79,106 @@ public:
 
         ~triggered_data_writer();
 
+        /**
+         * Add an independent trigger. Must be called before the thread is
+         * started.
+         *
+         * @param writer              the sink for the data
+         * @param trigger_port        id of channel carrying of trigger events
+         * @param channels            the ids of the channels to record. If
+         *                            empty, all channels are recorded. The
+         *                            trigger channel is always recorded.
+         * @param pretrigger_frames   the number of frames to record from before
+         *                            trigger onset events
+         * @param posttrigger_frames  the number of frames to record from after
+         *                            trigger offset events
+         */
+        void add_trigger(boost::shared_ptr<data_writer> writer,
+                         std::string const & trigger_port,
+                         std::vector<std::string> const & channels,
+                         nframes_t pretrigger_frames, nframes_t posttrigger_frames);
+
+        /**
+         * Drive a trigger from the data in a sampled channel, in addition to
+         * events in its trigger port. Must be called before the thread is
+         * started.
+         *
+         * @param trigger_port  the trigger port identifying the trigger
+         * @param channel       the id of the channel to monitor
+         * @param detector      the function used to analyze the data
+         */
+        void set_detector(std::string const & trigger_port, std::string const & channel,
+                          detector_type detector);
+
+        /**
+         * Write the data in the pretrigger window of each trigger to a new
+         * entry in its output. The snapshot is taken when the consumer thread
+         * next processes a block, and is skipped for triggers that are
+         * already recording. Safe to call from any thread or from a signal
+         * handler.
+         */
+        void snapshot();
+
 protected:
 
         /** @see buffered_data_writer::write() */
         void write(data_block_t const *);
 
+        /* these act on all the outputs */
+        void store_xrun();
+        void flush();
+        void close_entries();
+
+        /** Handles the "snapshot" command */
+        void command(std::string const & cmd);
+
 private:
-        /** start recording at time - pretrigger */
-        void start_recording(nframes_t time);
+        struct trigger_t {
+                boost::shared_ptr<data_writer> writer;
+                std::string port;
+                std::set<std::string> channels;
+                nframes_t pretrigger;
+                nframes_t posttrigger;
+                bool recording;         // flag to track whether data are being written
+                nframes_t last_offset;  // track time since last offset
+                std::string detect_channel;
+                detector_type detector;
+
+                /** true if the trigger records data from channel id */
+                bool records(std::string const & id) const {
+                        return channels.empty() || id == port || channels.count(id);
+                }
+        };
+
+        /**
+         * start recording at time - pretrigger
+         *
+         * @param trig     the trigger
+         * @param time     the time of the onset event
+         * @param offset   the position of the current block in the buffer
+         */
+        void start_recording(trigger_t & trig, nframes_t time, std::size_t offset);
         /** stop recording at time + posttrigger */
-        void stop_recording(nframes_t time);
+        void stop_recording(trigger_t & trig, nframes_t time);
 
-        std::string _trigger_port;
-        const nframes_t _pretrigger;
-        const nframes_t _posttrigger;
+        /** add the block at offset to the time index */
+        void index_block(data_block_t const * data, std::size_t offset);
+        /** @return the offset of the first block that may contain frames after time */
+        std::size_t seek(nframes_t time) const;
+        /** release all the blocks before offset */
+        void release_to(std::size_t offset);
 
-        bool _recording;        // flag to track whether data are being written
-        nframes_t _last_offset; // track time since last offset
+        std::vector<trigger_t> _triggers;
+        int _snapshot;          // flag to request a snapshot
+
+        /*
+         * index of (end frame, position) pairs. Positions count bytes since
+         * the thread started, so they don't change when data are released.
+         */
+        typedef std::pair<nframes_t, std::size_t> index_entry;
+        std::deque<index_entry> _index;
+        nframes_t _high_water;  // the latest frame in any indexed block
+        std::size_t _released;  // total bytes released
 };
 
 }}
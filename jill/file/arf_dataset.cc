@@ -0,0 +1,75 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "arf_dataset.hh"
+#include "../logging.hh"
+#include "../util/string.hh"
+
+#include <hdf5.h>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+using namespace jill::file;
+using std::string;
+
+BOOST_STATIC_ASSERT((boost::is_same<jill::sample_t, float>::value));
+
+namespace {
+
+/* closes an hdf5 object when it goes out of scope */
+struct h5_handle {
+        hid_t id;
+        herr_t (*close)(hid_t);
+        h5_handle(hid_t i, herr_t (*c)(hid_t)) : id(i), close(c) {}
+        ~h5_handle() { if (id >= 0) close(id); }
+};
+
+}
+
+arf_dataset::arf_dataset(string const & path, string const & entry, string const & dataset)
+        : _name(entry + "/" + dataset), _nframes(0), _samplerate(0)
+{
+        h5_handle file(H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose);
+        if (file.id < 0)
+                throw jill::FileError("unable to open ARF file " + path);
+        h5_handle dset(H5Dopen2(file.id, _name.c_str(), H5P_DEFAULT), H5Dclose);
+        if (dset.id < 0)
+                throw jill::FileError(util::make_string() << "unable to open " << _name << " in " << path);
+
+        h5_handle type(H5Dget_type(dset.id), H5Tclose);
+        H5T_class_t cls = H5Tget_class(type.id);
+        h5_handle space(H5Dget_space(dset.id), H5Sclose);
+        if ((cls != H5T_INTEGER && cls != H5T_FLOAT) || H5Sget_simple_extent_ndims(space.id) != 1)
+                throw jill::FileError(_name + " is not a one-dimensional sampled dataset");
+
+        if (H5Aexists(dset.id, "sampling_rate") <= 0)
+                throw jill::FileError(_name + " has no sampling_rate attribute");
+        h5_handle attr(H5Aopen(dset.id, "sampling_rate", H5P_DEFAULT), H5Aclose);
+        double rate = 0;
+        if (H5Aread(attr.id, H5T_NATIVE_DOUBLE, &rate) < 0 || rate <= 0)
+                throw jill::FileError(_name + " has an invalid sampling rate");
+        _samplerate = rate;
+
+        _nframes = H5Sget_simple_extent_npoints(space.id);
+        _buffer.reset(new sample_t[_nframes]);
+        if (_nframes > 0 &&
+            H5Dread(dset.id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, _buffer.get()) < 0)
+                throw jill::FileError("unable to read samples from " + _name);
+        LOG << "read " << _nframes << " frames from " << path << ":" << _name << " at " << _samplerate;
+}
+
+void
+arf_dataset::load_samples(nframes_t samplerate)
+{
+        if (samplerate != 0 && samplerate != _samplerate)
+                throw jill::FileError(util::make_string() << _name << " was recorded at " << _samplerate
+                                      << " Hz and can't be resampled to " << samplerate << " Hz");
+}
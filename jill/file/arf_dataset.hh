@@ -0,0 +1,67 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _ARF_DATASET_HH
+#define _ARF_DATASET_HH
+
+#include <string>
+#include <boost/scoped_array.hpp>
+#include "../stimulus.hh"
+
+namespace jill { namespace file {
+
+/**
+ * A sampled dataset in an ARF file, such as one written by arf_writer. This
+ * implementation of stimulus_t reads the samples when the object is created,
+ * so the data can be fed to an offline_client input. Integer data are
+ * converted to sample_t without scaling. The dataset's sampling_rate
+ * attribute gives the sampling rate; the data are not resampled, so the
+ * client has to run at the same rate.
+ */
+class arf_dataset : public jill::stimulus_t {
+
+public:
+        /**
+         * Read a dataset from an ARF file.
+         *
+         * @param path     the location of the ARF file
+         * @param entry    the name of the entry
+         * @param dataset  the name of the dataset in the entry
+         *
+         * @throws jill::FileError if the dataset can't be read, or isn't a
+         *         one-dimensional sampled dataset
+         */
+        arf_dataset(std::string const & path, std::string const & entry, std::string const & dataset);
+
+        char const * name() const { return _name.c_str(); }
+
+        nframes_t nframes() const { return _nframes; }
+        nframes_t samplerate() const { return _samplerate; }
+
+        sample_t const * buffer() const { return _buffer.get(); }
+
+        /**
+         * The samples are already loaded, so this only checks the rate.
+         *
+         * @throws jill::FileError if samplerate is not 0 or the dataset's rate
+         */
+        void load_samples(nframes_t samplerate=0);
+
+private:
+        std::string _name;
+        nframes_t _nframes;
+        nframes_t _samplerate;
+
+        boost::scoped_array<sample_t> _buffer;
+};
+
+}} // namespace jill::file
+
+#endif
@@ -8,6 +8,8 @@
 #include "../midi.hh"
 
 #define JILL_LOGDATASET_NAME "jill_log"
+#define JILL_STAGING_NAME "jill_staging"
+#define JILL_INDEXDATASET_NAME "jill_entries"
 #define ARF_CHUNK_SIZE 1024
 
 using namespace std;
@@ -36,6 +38,17 @@ struct event_t {
         char const * message;   // message (hex encoded for standard midi status)
 };
 
+/**
+ * @brief Storage format for the entry index
+ */
+struct entry_record_t {
+        char const * name;
+        boost::uint32_t jack_frame;
+        boost::uint64_t jack_usec;
+        boost::int64_t sec;
+        boost::int64_t usec;
+};
+
 /**
  * convert a midi message to hex
  * @param in   the midi message
@@ -86,15 +99,33 @@ struct datatype_traits<event_t> {
         }
 };
 
+template<>
+struct datatype_traits<entry_record_t> {
+	static hid_t value() {
+                hid_t str = H5Tcopy(H5T_C_S1);
+                H5Tset_size(str, H5T_VARIABLE);
+                H5Tset_cset(str, H5T_CSET_UTF8);
+                hid_t ret = H5Tcreate(H5T_COMPOUND, sizeof(entry_record_t));
+                H5Tinsert(ret, "name", HOFFSET(entry_record_t, name), str);
+                H5Tinsert(ret, "jack_frame", HOFFSET(entry_record_t, jack_frame), H5T_NATIVE_UINT32);
+                H5Tinsert(ret, "jack_usec", HOFFSET(entry_record_t, jack_usec), H5T_NATIVE_UINT64);
+                H5Tinsert(ret, "sec", HOFFSET(entry_record_t, sec), H5T_NATIVE_INT64);
+                H5Tinsert(ret, "usec", HOFFSET(entry_record_t, usec), H5T_NATIVE_INT64);
+                H5Tclose(str);
+                return ret;
+        }
+};
+
 }}}
 
 arf_writer::arf_writer(string const & filename,
                        data_source const & source,
                        map<string,string> const & entry_attrs,
-                       int compression)
+                       int compression, bool swmr)
         : _data_source(source),
           _attrs(entry_attrs),
           _compression(compression),
+          _swmr_requested(swmr), _swmr(false),
           _entry_start(0), _entry_idx(0)
 {
         _base_usec = _data_source.time();
@@ -103,6 +134,12 @@ arf_writer::arf_writer(string const & filename,
 
         _file.reset(new arf::file(filename, "a"));
         LOG << "opened file: " << filename;
+        if (_swmr_requested) {
+                // SWMR requires objects be created in the latest format
+                if (H5Fset_libver_bounds(_file->hid(), H5F_LIBVER_LATEST, H5F_LIBVER_LATEST) < 0)
+                        throw arf::Exception("unable to set file format for SWMR access");
+                INFO << "file will be opened for concurrent reads with first entry";
+        }
         if (!_file->has_attribute("file_creator")) {
                 _file->write_attribute("file_creator", "org.meliza.jill/jrecord " JILL_VERSION);
         }
@@ -122,17 +159,75 @@ arf_writer::arf_writer(string const & filename,
                                                        logtype, ARF_CHUNK_SIZE, _compression));
                 INFO << "created log dataset /" << JILL_LOGDATASET_NAME;
         }
-        _get_last_entry_index();
+
+        // open/create entry index. If there are entries but no index, or
+        // the index has no record for this source (e.g. the index was
+        // created by another client), fall back to scanning the file
+        arf::h5t::wrapper<entry_record_t> it;
+        arf::h5t::datatype indextype(it);
+        if (_file->contains(JILL_INDEXDATASET_NAME)) {
+                _index.reset(new arf::h5pt::packet_table(_file->hid(), JILL_INDEXDATASET_NAME));
+                if (indextype != *(_index->datatype())) {
+                        throw arf::Exception(JILL_INDEXDATASET_NAME " has wrong datatype");
+                }
+                hid_t aid = -1;
+                bool found = false;
+                if (H5Aexists(_index->hid(), _data_source.name()) > 0 &&
+                    (aid = H5Aopen(_index->hid(), _data_source.name(), H5P_DEFAULT)) >= 0) {
+                        unsigned int val;
+                        if (H5Aread(aid, H5T_NATIVE_UINT, &val) >= 0) {
+                                _entry_idx = val;
+                                found = true;
+                        }
+                        H5Aclose(aid);
+                }
+                if (found) {
+                        INFO << "next entry index (from /" << JILL_INDEXDATASET_NAME << "): " << _entry_idx;
+                }
+                else {
+                        _get_last_entry_index();
+                }
+        }
+        else {
+                _get_last_entry_index();
+                _index.reset(new arf::h5pt::packet_table(_file->hid(), JILL_INDEXDATASET_NAME,
+                                                         indextype, ARF_CHUNK_SIZE, _compression));
+                INFO << "created entry index /" << JILL_INDEXDATASET_NAME;
+        }
+
+        // remove staging group left by a process that didn't exit cleanly
+        if (_file->contains(JILL_STAGING_NAME)) {
+                H5Ldelete(_file->hid(), JILL_STAGING_NAME, H5P_DEFAULT);
+        }
 }
 
 arf_writer::~arf_writer()
-{}
+{
+        if (_swmr) {
+                // can't modify structure of file in SWMR mode
+                _dsets.clear();
+                _entry.reset();
+                return;
+        }
+        close_entry();
+        _staged.clear();
+        if (_staging) {
+                _staging.reset();
+                H5Ldelete(_file->hid(), JILL_STAGING_NAME, H5P_DEFAULT);
+        }
+}
 
 void
 arf_writer::new_entry(nframes_t frame_count)
 {
         utime_t frame_usec = 0;
 
+        if (_swmr) {
+                LOG << "WARNING: can't create new entries in SWMR mode; continuing "
+                    << _entry->name();
+                return;
+        }
+
         std::ostringstream name;
         name << _data_source.name() << '_' << setw(4) << setfill('0') << _entry_idx++;
 
@@ -154,11 +249,39 @@ arf_writer::new_entry(nframes_t frame_count)
         a("jack_sampling_rate", _data_source.sampling_rate());
         a("entry_creator", "org.meliza.jill/jrecord " JILL_VERSION);
         for_each(_attrs.begin(), _attrs.end(), a);
+
+        _index_entry(frame_usec, ts.total_seconds(), ts.fractional_seconds());
+
+        if (_swmr_requested && !_swmr) {
+                start_swmr();
+        }
+}
+
+void
+arf_writer::start_swmr()
+{
+        std::map<string, bool>::const_iterator it;
+        for (it = _template.begin(); it != _template.end(); ++it) {
+                get_dataset(it->first, it->second);
+        }
+        _staged.clear();
+        if (_staging) {
+                _staging.reset();
+                H5Ldelete(_file->hid(), JILL_STAGING_NAME, H5P_DEFAULT);
+        }
+        if (H5Fstart_swmr_write(_file->hid()) < 0)
+                throw arf::Exception("unable to start SWMR mode");
+        _swmr = true;
+        LOG << "started SWMR mode: file can be read by other processes";
 }
 
 void
 arf_writer::close_entry()
 {
+        if (_swmr) {
+                _file->flush();
+                return;
+        }
         _dsets.clear();         // release any old packet tables
         if (_entry) {
                 log_msg o;
@@ -179,7 +302,7 @@ void
 arf_writer::xrun()
 {
         LOG << "ERROR: xrun" ;
-        if (_entry) {
+        if (_entry && !_swmr) {
                 // tag entry as possibly corrupt
                 _entry->write_attribute("jill_error","data xrun");
         }
@@ -204,6 +327,10 @@ arf_writer::write(data_block_t const * data, nframes_t start_frame, nframes_t st
                 new_entry(data->time);
         }
         /* write the data */
+        if (_swmr && _dsets.find(id) == _dsets.end()) {
+                DBG << "can't create dataset in SWMR mode: " << id;
+                return;
+        }
         if (data->dtype == SAMPLED) {
                 dset = get_dataset(id, true);
                 sample_t const * samples = reinterpret_cast<sample_t const *>(data->data());
@@ -229,9 +356,37 @@ arf_writer::write(data_block_t const * data, nframes_t start_frame, nframes_t st
 void
 arf_writer::flush()
 {
+        if (!_swmr) prepare_entry();
         _file->flush();
 }
 
+void
+arf_writer::set_sampling_rate(string const & name, nframes_t rate)
+{
+        _rates[name] = rate;
+}
+
+void
+arf_writer::add_template(string const & name, bool is_sampled)
+{
+        _template[name] = is_sampled;
+}
+
+void
+arf_writer::prepare_entry()
+{
+        std::map<string, bool>::const_iterator it;
+        for (it = _template.begin(); it != _template.end(); ++it) {
+                if (_staged.count(it->first) || _dsets.count(it->first)) continue;
+                if (!_staging) {
+                        _staging.reset(new arf::entry(*_file, JILL_STAGING_NAME));
+                }
+                arf::packet_table_ptr pt = create_dataset(*_staging, it->first, it->second);
+                _staged.insert(make_pair(it->first, pt));
+                DBG << "prepared dataset: " << it->first;
+        }
+}
+
 void
 arf_writer::log(timestamp_t const &utc, string const & source, string const & msg)
 {
@@ -259,24 +414,74 @@ arf_writer::_get_last_entry_index()
 }
 
 
+void
+arf_writer::_index_entry(utime_t usec, boost::int64_t sec, boost::int64_t frac)
+{
+        string name = _entry->name();
+        // entry names returned by HDF5 are absolute paths
+        if (!name.empty() && name[0] == '/') name = name.substr(1);
+        entry_record_t record = { name.c_str(), _entry_start, usec, sec, frac };
+        _index->write(&record, 1);
+
+        // store next entry number for this source
+        hid_t aid;
+        if (H5Aexists(_index->hid(), _data_source.name()) > 0) {
+                aid = H5Aopen(_index->hid(), _data_source.name(), H5P_DEFAULT);
+        }
+        else {
+                hid_t sid = H5Screate(H5S_SCALAR);
+                aid = H5Acreate2(_index->hid(), _data_source.name(), H5T_NATIVE_UINT, sid,
+                                 H5P_DEFAULT, H5P_DEFAULT);
+                H5Sclose(sid);
+        }
+        if (aid >= 0) {
+                unsigned int val = _entry_idx;
+                H5Awrite(aid, H5T_NATIVE_UINT, &val);
+                H5Aclose(aid);
+        }
+}
+
 arf_writer::dset_map_type::iterator
 arf_writer::get_dataset(string const & name, bool is_sampled)
 {
         dset_map_type::iterator dset = _dsets.find(name);
         if (dset == _dsets.end()) {
                 arf::packet_table_ptr pt;
-                if (is_sampled) {
-                        pt = _entry->create_packet_table<sample_t>(name, "", arf::UNDEFINED,
-                                                                          false, ARF_CHUNK_SIZE, _compression);
+                dset_map_type::iterator staged = _staged.find(name);
+                if (staged != _staged.end() && _template[name] == is_sampled &&
+                    !_entry->contains(name)) {
+                        // open objects stay valid when their links are moved
+                        H5Lmove(_staging->hid(), name.c_str(), _entry->hid(), name.c_str(),
+                                H5P_DEFAULT, H5P_DEFAULT);
+                        pt = staged->second;
+                        _staged.erase(staged);
+                        LOG << "moved prepared dataset: " << _entry->name() << "/" << name;
                 }
                 else {
-                        pt = _entry->create_packet_table<event_t>(name, "samples", arf::EVENT,
-                                                                          false, ARF_CHUNK_SIZE, _compression);
+                        pt = create_dataset(*_entry, name, is_sampled);
+                        LOG << "created dataset: " << pt->name() ;
                 }
-                pt->write_attribute("sampling_rate", _data_source.sampling_rate());
-                LOG << "created dataset: " << pt->name() ;
+                _template[name] = is_sampled;
                 dset = _dsets.insert(dset, make_pair(name,pt));
         }
         return dset;
 }
 
+arf::packet_table_ptr
+arf_writer::create_dataset(arf::entry & entry, string const & name, bool is_sampled)
+{
+        arf::packet_table_ptr pt;
+        if (is_sampled) {
+                pt = entry.create_packet_table<sample_t>(name, "", arf::UNDEFINED,
+                                                         false, ARF_CHUNK_SIZE, _compression);
+        }
+        else {
+                pt = entry.create_packet_table<event_t>(name, "samples", arf::EVENT,
+                                                        false, ARF_CHUNK_SIZE, _compression);
+        }
+        std::map<string, nframes_t>::const_iterator rate = _rates.find(name);
+        pt->write_attribute("sampling_rate", (rate != _rates.end()) ? rate->second :
+                            _data_source.sampling_rate());
+        return pt;
+}
+
@@ -16,6 +16,29 @@ namespace file {
 
 /**
  * Class for storing data in an ARF file. Access is not thread-safe.
+ *
+ * Creating the datasets for a new entry takes time, and in triggered
+ * recording this happens just when the writer is busiest. To avoid this, the
+ * writer keeps a template of the channels it has written (or that have been
+ * added with add_template), and when it's idle (i.e., flush() is called) it
+ * creates datasets for the next entry in a staging group. When the channel is
+ * first written in a new entry, the dataset is moved into the entry, which
+ * only requires updating a link.
+ *
+ * The writer can also operate in HDF5 single-writer/multiple-reader (SWMR)
+ * mode, which lets other processes read the file while it's being written.
+ * The file is switched to the latest format, and SWMR writing starts when the
+ * first entry is created, after datasets for all the channels in the template
+ * have been built. Because HDF5 doesn't allow objects to be created in SWMR
+ * mode, only one entry can be written, and the set of channels must be known
+ * in advance. Closing the entry only flushes data until the writer is
+ * destroyed.
+ *
+ * Each new entry is recorded in an index dataset (jill_entries), which holds
+ * the entry name, start frame, start usec, and timestamp. The next entry
+ * number for each source is stored as an attribute of the index, so the
+ * writer doesn't have to scan all the entries when it opens the file. Files
+ * without an index can be indexed with jrecord_index.py.
  */
 class arf_writer : public data_writer {
 public:
@@ -27,11 +50,12 @@ public:
          * @param entry_attrs  map of attributes to set on newly-created entries
          * @param data_source  the source of the data. may be null
          * @param compression  the compression level for new datasets
+         * @param swmr         if true, allow concurrent reads of the file
          */
         arf_writer(std::string const & filename,
                    jill::data_source const & source,
                    std::map<std::string,std::string> const & entry_attrs,
-                   int compression=0);
+                   int compression=0, bool swmr=false);
         ~arf_writer();
 
         /* data_writer overrides */
@@ -42,6 +66,19 @@ public:
         void write(data_block_t const *, nframes_t, nframes_t);
         void log(timestamp_t const &, std::string const &, std::string const &);
         void flush();
+        void set_sampling_rate(std::string const &, nframes_t);
+
+        /**
+         * Add a channel to the template used to prepare datasets for new
+         * entries. Channels are also added when they're first written.
+         *
+         * @param name         the name of the dataset (channel)
+         * @param is_sampled   whether the dataset holds samples or events
+         */
+        void add_template(std::string const & name, bool is_sampled);
+
+        /** Create datasets for any channels in the template that aren't staged */
+        void prepare_entry();
 
 protected:
         typedef std::map<std::string, arf::packet_table_ptr> dset_map_type;
@@ -55,9 +92,18 @@ protected:
          */
         dset_map_type::iterator get_dataset(std::string const & name, bool is_sampled);
 
+        /** Build datasets for the template and switch to SWMR mode */
+        void start_swmr();
+
+        /** Create a dataset in an entry */
+        arf::packet_table_ptr create_dataset(arf::entry & entry, std::string const & name,
+                                             bool is_sampled);
+
 private:
         /* find last entry index */
         void _get_last_entry_index();
+        /* record entry in index dataset */
+        void _index_entry(utime_t usec, boost::int64_t sec, boost::int64_t frac);
 
         // references
         jill::data_source const & _data_source;
@@ -66,9 +112,16 @@ private:
         arf::file_ptr _file;                       // output file
         std::map<std::string, std::string> _attrs; // attributes for new entries
         arf::packet_table_ptr _log;                // log dataset
+        arf::packet_table_ptr _index;              // entry index dataset
         arf::entry_ptr _entry;                     // current entry (owned by thread)
         dset_map_type _dsets;                      // pointers to packet tables (owned)
+        std::map<std::string, bool> _template;     // channels to prepare for new entries
+        std::map<std::string, nframes_t> _rates;   // channels not at the source's rate
+        arf::entry_ptr _staging;                   // group holding prepared datasets
+        dset_map_type _staged;                     // prepared datasets
         int _compression;                          // compression level for new datasets
+        bool _swmr_requested;                      // start SWMR with first entry
+        bool _swmr;                                // in SWMR mode (no new objects)
 
         // these variables allow more precise timestamps; they are registered to
         // each other when set_data_source is called
@@ -15,21 +15,31 @@
 #include <jack/statistics.h>
 #include <jack/midiport.h>
 #include <cerrno>
+#include <cstring>
+#include <ctime>
 #include <algorithm>
 
 using namespace jill;
 using std::string;
 
 jack_client::jack_client(string const & name)
-        : _nports(0)
+        : _nports(0), _port_table(new port_table_t), _cycles(0), _active(false),
+          _timing_interval(60), _timing_running(false)
 {
+        _rt_table = _port_table;
+        pthread_mutex_init(&_timing_lock, 0);
+        pthread_cond_init(&_timing_stop, 0);
         start_client(name.c_str(), 0);
         set_callbacks();
 }
 
 jack_client::jack_client(string const & name, string const & server)
-        : _nports(0)
+        : _nports(0), _port_table(new port_table_t), _cycles(0), _active(false),
+          _timing_interval(60), _timing_running(false)
 {
+        _rt_table = _port_table;
+        pthread_mutex_init(&_timing_lock, 0);
+        pthread_cond_init(&_timing_stop, 0);
         if (!server.empty())
                 start_client(name.c_str(), server.c_str());
         else
@@ -40,9 +50,15 @@ jack_client::jack_client(string const & name, string const & server)
 
 jack_client::~jack_client()
 {
+        stop_timing_thread();
 	if (_client) {
                 jack_client_close(_client);
         }
+        for (std::size_t i = 0; i < _retired.size(); ++i)
+                delete _retired[i].first;
+        delete _port_table;
+        pthread_mutex_destroy(&_timing_lock);
+        pthread_cond_destroy(&_timing_stop);
 }
 
 void
@@ -88,6 +104,7 @@ jack_client::register_port(string const & name, string const & type,
         }
         _ports.push_back(port);
         _nports += 1;
+        update_port_table();
         return port;
 }
 
@@ -105,25 +122,71 @@ jack_client::unregister_port(jack_port_t *port)
                 throw JackError(util::make_string() << "unable to unregister port (err=" << ret << ")");
         _ports.remove(port);
         _nports += -1;
+        update_port_table();
         LOG << "port unregistered: " << jack_port_name(port) ;
 }
 
+void
+jack_client::update_port_table()
+{
+        port_table_t * table = new port_table_t;
+        port_list_type::const_iterator it;
+        for (it = _ports.begin(); it != _ports.end(); ++it) {
+                port_info_t info;
+                info.port = *it;
+                info.name = jack_port_short_name(*it);
+                info.dtype = (strcmp(jack_port_type(*it), JACK_DEFAULT_AUDIO_TYPE) == 0) ? SAMPLED : EVENT;
+                info.is_output = jack_port_flags(*it) & JackPortIsOutput;
+                table->ports.push_back(info);
+        }
+        table->buffers.resize(table->ports.size(), 0);
+
+        port_table_t * old = __sync_lock_test_and_set(&_port_table, table);
+        if (!_active) _rt_table = table;
+        // the current period may still be using the old table, so it's
+        // freed by a later call instead of waiting for the process thread
+        _retired.push_back(std::make_pair(old, (unsigned long)_cycles));
+        reclaim_port_tables();
+}
+
+void
+jack_client::reclaim_port_tables()
+{
+        std::vector<std::pair<port_table_t*, unsigned long> >::iterator it = _retired.begin();
+        while (it != _retired.end()) {
+                // a period that started after the swap has finished
+                if (!_active || _cycles - it->second >= 2) {
+                        delete it->first;
+                        it = _retired.erase(it);
+                }
+                else
+                        ++it;
+        }
+}
+
 void
 jack_client::activate()
 {
         int ret = jack_activate(_client);
         if (ret)
                 throw JackError(util::make_string() << "unable to activate client (err=" << ret << ")");
+        _active = true;
         LOG << "activated client (load=" << jack_cpu_load(_client) << "%)" ;
+        start_timing_thread();
 }
 
 void
 jack_client::deactivate()
 {
+        stop_timing_thread();
         int ret = jack_deactivate(_client);
         if (ret)
                 throw JackError(util::make_string() << "unable to deactivate client (err=" << ret << ")");
+        _active = false;
+        _rt_table = _port_table;
+        reclaim_port_tables();
         LOG << "deactivated client" ;
+        log_timing();
 }
 
 void
@@ -175,10 +238,15 @@ jack_client::disconnect_all()
         }
 }
 
-sample_t*
-jack_client::samples(string const & name, nframes_t nframes)
+std::size_t
+jack_client::port_index(string const & name) const
 {
-        return samples(jack_port_by_name(_client, name.c_str()), nframes);
+        port_table_t const & table = *_port_table;
+        for (std::size_t i = 0; i < table.size(); ++i) {
+                if (table.ports[i].name == name)
+                        return i;
+        }
+        throw JackError(util::make_string() << "the client has no port named " << name);
 }
 
 
@@ -203,6 +271,96 @@ jack_client::events(jack_port_t *port, nframes_t nframes)
                 return 0;
 }
 
+sample_t *
+jack_client::port_samples(port_id port, nframes_t)
+{
+        return static_cast<sample_t*>(_rt_table->buffers[port]);
+}
+
+std::size_t
+jack_client::nevents(port_id port)
+{
+        return jack_midi_get_event_count(_rt_table->buffers[port]);
+}
+
+jack_client::event_ref_t
+jack_client::event(port_id port, std::size_t index)
+{
+        jack_midi_event_t e;
+        jack_midi_event_get(&e, _rt_table->buffers[port], index);
+        event_ref_t out = { e.time, e.size, e.buffer };
+        return out;
+}
+
+int
+jack_client::write_event(port_id port, nframes_t time, void const * data, std::size_t size)
+{
+        return jack_midi_event_write(_rt_table->buffers[port], time,
+                                     static_cast<jack_midi_data_t const *>(data), size);
+}
+
+void
+jack_client::log_timing()
+{
+        util::process_timer::stats_t stats = _timer.snapshot();
+        util::process_timer::stats_t since = stats;
+        since -= _timer_logged;
+        _timer_logged = stats;
+        if (since.count == 0) return;
+        utime_t period = utime_t(buffer_size()) * 1000000 / sampling_rate();
+        LOG << "process timing: " << since << " (mean load="
+            << since.mean_load(period) * 100 << "%)";
+}
+
+void
+jack_client::start_timing_thread()
+{
+        if (_timing_running || _timing_interval == 0) return;
+        _timing_running = true;
+        int ret = pthread_create(&_timing_thread_id, NULL, jack_client::timing_thread, this);
+        if (ret != 0) {
+                _timing_running = false;
+                LOG << "WARNING: unable to start timing thread (err=" << ret << ")";
+        }
+}
+
+void
+jack_client::stop_timing_thread()
+{
+        if (!_timing_running) return;
+        pthread_mutex_lock(&_timing_lock);
+        _timing_running = false;
+        pthread_cond_signal(&_timing_stop);
+        pthread_mutex_unlock(&_timing_lock);
+        pthread_join(_timing_thread_id, NULL);
+}
+
+/*
+ * Logs timing statistics every _timing_interval seconds. The process callback
+ * only updates the counters in _timer, so this is how the statistics get
+ * published (through the log) while the client is running.
+ */
+void *
+jack_client::timing_thread(void * arg)
+{
+        jack_client * self = static_cast<jack_client*>(arg);
+        timespec deadline;
+        pthread_mutex_lock(&self->_timing_lock);
+        while (self->_timing_running) {
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += self->_timing_interval;
+                int ret = 0;
+                while (self->_timing_running && ret != ETIMEDOUT)
+                        ret = pthread_cond_timedwait(&self->_timing_stop, &self->_timing_lock, &deadline);
+                if (!self->_timing_running) break;
+                pthread_mutex_unlock(&self->_timing_lock);
+                self->log_timing();
+                pthread_mutex_lock(&self->_timing_lock);
+        }
+        pthread_mutex_unlock(&self->_timing_lock);
+        return 0;
+}
+
 jack_port_t*
 jack_client::get_port(string const & name) const
 {
@@ -264,7 +422,19 @@ jack_client::process_callback_(nframes_t nframes, void *arg)
 {
 	jack_client *self = static_cast<jack_client*>(arg);
         nframes_t time = jack_last_frame_time(self->_client);
-	return (self->_process_cb) ? self->_process_cb(self, nframes, time) : 0;
+        utime_t start = jack_get_time();
+        port_table_t * table = self->_port_table;
+        for (std::size_t i = 0; i < table->size(); ++i) {
+                table->buffers[i] = jack_port_get_buffer(table->ports[i].port, nframes);
+                if (table->ports[i].dtype == EVENT && table->ports[i].is_output)
+                        jack_midi_clear_buffer(table->buffers[i]);
+        }
+        self->_rt_table = table;
+	int ret = (self->_process_cb) ? self->_process_cb(self, nframes, time) : 0;
+        utime_t period = utime_t(nframes) * 1000000 / jack_get_sample_rate(self->_client);
+        self->_timer.record(jack_get_time() - start, period);
+        __sync_add_and_fetch(&self->_cycles, 1);
+        return ret;
 }
 
 void
@@ -319,6 +489,8 @@ jack_client::xrun_callback_(void *arg)
 	jack_client *self = static_cast<jack_client*>(arg);
         float delay = jack_get_xrun_delayed_usecs(self->_client);
         LOG << "jack xrun (us): " << delay ;
+        util::process_timer::stats_t stats = self->_timer.snapshot();
+        DBG << "process timing: " << stats;
 	return (self->_xrun_cb) ? self->_xrun_cb(self, delay) : 0;
 }
 
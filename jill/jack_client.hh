@@ -14,10 +14,13 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/function.hpp>
+#include <pthread.h>
 #include <jack/jack.h>
-#include "data_source.hh"
+#include "process_client.hh"
+#include "util/process_timer.hh"
 
 /**
  * @defgroup clientgroup Creating and controlling JACK clients
@@ -41,9 +44,10 @@ namespace jill {
  * field.  Encapsulation will break if ports are registered or unregistered
  * using this pointer, or if the process callback is changed.
  *
- *
+ * The process_client functions address ports by their index in port_table(),
+ * so process callbacks that take a process_client* also run in offline_client.
  */
-class jack_client : public data_source {
+class jack_client : public process_client {
 
 public:
 
@@ -90,6 +94,26 @@ public:
 
         typedef std::list<jack_port_t*> port_list_type;
 
+        /** Description of a port owned by the client */
+        struct port_info_t {
+                jack_port_t * port;
+                std::string name;       // short name
+                dtype_t dtype;          // SAMPLED or EVENT
+                bool is_output;
+        };
+
+        /**
+         * Snapshot of the client's ports, in order of registration. The
+         * buffers array is filled at the start of each period with the result
+         * of jack_port_get_buffer() for each port, so process callbacks can
+         * loop over it by index. Event output buffers are cleared.
+         */
+        struct port_table_t {
+                std::vector<port_info_t> ports;
+                std::vector<void*> buffers;
+                std::size_t size() const { return ports.size(); }
+        };
+
 	/**
 	 * Initialize a new JACK client. All clients are identified to the JACK
 	 * server by an alphanumeric name, which is specified here. Creates the
@@ -184,9 +208,14 @@ public:
 	void disconnect_all();
 
         /** Get sample buffer for port */
-        sample_t * samples(std::string const & name, nframes_t nframes);
         sample_t * samples(jack_port_t *port, nframes_t nframes);
 
+        /* Implementations of process_client functions; ports are indices in port_table() */
+        sample_t * port_samples(port_id port, nframes_t nframes);
+        std::size_t nevents(port_id port);
+        event_ref_t event(port_id port, std::size_t index);
+        int write_event(port_id port, nframes_t time, void const * data, std::size_t size);
+
         /** Get event buffer for port. If the port is an output port it's cleared. */
         void * events(jack_port_t *port, nframes_t);
 
@@ -199,6 +228,20 @@ public:
         port_list_type const & ports() const { return _ports;}
         std::size_t nports() const { return _nports; }
 
+        /**
+         * The table of ports and buffers for the current period. Only valid
+         * in the process callback. Realtime safe.
+         */
+        port_table_t const & port_table() const { return *_rt_table; }
+
+        /**
+         * The index of one of the client's ports in port_table(). Indices
+         * change only when ports are (un)registered. Not RT safe.
+         *
+         * @throws JackError if the client doesn't own a port with that name
+         */
+        std::size_t port_index(std::string const & name) const;
+
         /**
          * Look up a jack port by name. The port doesn't have to be owned by the
          * client. Not RT safe.
@@ -210,6 +253,30 @@ public:
         /** The size of the client's buffer */
         nframes_t buffer_size() const;
 
+        /**
+         * Statistics on the duration of the process callback since the client
+         * was created. Safe to call from any thread.
+         */
+        util::process_timer::stats_t timing() const { return _timer.snapshot(); }
+
+        /**
+         * Log statistics on the duration of the process callback since the
+         * last call to this function. Not RT safe. While the client is
+         * active, this is called periodically by the timing thread (@see
+         * set_timing_interval), and other threads should use timing().
+         */
+        void log_timing();
+
+        /**
+         * Set how often timing statistics are logged while the client is
+         * active. The statistics are logged by a separate thread, which is
+         * started by activate() and stopped by deactivate().
+         *
+         * @param seconds  the interval between log messages, or 0 to log
+         *                 only when the client is deactivated
+         */
+        void set_timing_interval(unsigned int seconds) { _timing_interval = seconds; }
+
 	/**  JACK client name (long form) */
 	char const * name() const;
 
@@ -236,8 +303,32 @@ private:
         XrunCallback _xrun_cb;
         ShutdownCallback _shutdown_cb;
 
+        /* port table, replaced by a new copy when ports are (un)registered */
+        port_table_t * volatile _port_table;
+        port_table_t * volatile _rt_table;              // used by current period
+        volatile unsigned long _cycles;                 // number of completed periods
+        bool _active;
+        /* replaced tables and the value of _cycles when they were replaced */
+        std::vector<std::pair<port_table_t*, unsigned long> > _retired;
+
+        util::process_timer _timer;
+        util::process_timer::stats_t _timer_logged; // last logged values
+
+        /* thread that logs timing statistics while the client is active */
+        unsigned int _timing_interval;                  // seconds
+        bool _timing_running;
+        pthread_t _timing_thread_id;
+        pthread_mutex_t _timing_lock;
+        pthread_cond_t _timing_stop;                    // signaled to stop the thread
+
         void start_client(char const * name, char const * server_name=0);
         void set_callbacks();
+        void update_port_table();
+        /** free retired port tables that the process thread can't be using */
+        void reclaim_port_tables();
+        void start_timing_thread();
+        void stop_timing_thread();
+        static void * timing_thread(void *);
 
         /* static callback functions actually registered with JACK server */
 	static int process_callback_(nframes_t, void *);
@@ -0,0 +1,324 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <algorithm>
+#include <cstring>
+#include "offline_client.hh"
+#include "stimulus.hh"
+#include "logging.hh"
+#include "util/string.hh"
+
+using namespace jill;
+using std::string;
+
+offline_client::offline_client(string const & name, nframes_t sampling_rate, nframes_t period_size)
+        : _name(name), _sampling_rate(sampling_rate), _period_size(period_size), _frame(0)
+{
+        if (sampling_rate == 0 || period_size == 0)
+                throw Error("sampling rate and period size must be nonzero");
+        LOG << "created offline client: " << _name << " (rate=" << _sampling_rate
+            << ", period=" << _period_size << ")";
+}
+
+offline_client::~offline_client() {}
+
+offline_client::port_id
+offline_client::add_port(string const & name, dtype_t dtype, bool is_input)
+{
+        for (std::vector<port_t>::const_iterator it = _ports.begin(); it != _ports.end(); ++it) {
+                if (it->name == name)
+                        throw Error(util::make_string() << "port " << name << " already exists");
+        }
+        port_t p;
+        p.name = name;
+        p.dtype = dtype;
+        p.is_input = is_input;
+        p.next_event = 0;
+        if (dtype == SAMPLED)
+                p.buffer.resize(_period_size, 0);
+        _ports.push_back(p);
+        return _ports.size() - 1;
+}
+
+offline_client::port_id
+offline_client::add_input(string const & name, sample_t const * samples, nframes_t nframes)
+{
+        port_id id = add_port(name, SAMPLED, true);
+        _ports[id].samples.assign(samples, samples + nframes);
+        return id;
+}
+
+offline_client::port_id
+offline_client::add_input(string const & name, stimulus_t & stim)
+{
+        stim.load_samples(_sampling_rate);
+        return add_input(name, stim.buffer(), stim.nframes());
+}
+
+namespace {
+bool event_before(offline_client::event_t const & a, offline_client::event_t const & b)
+{
+        return a.time < b.time;
+}
+}
+
+offline_client::port_id
+offline_client::add_event_input(string const & name, std::vector<event_t> const & events)
+{
+        port_id id = add_port(name, EVENT, true);
+        _ports[id].events = events;
+        std::stable_sort(_ports[id].events.begin(), _ports[id].events.end(), event_before);
+        return id;
+}
+
+offline_client::port_id
+offline_client::add_output(string const & name)
+{
+        return add_port(name, SAMPLED, false);
+}
+
+offline_client::port_id
+offline_client::add_event_output(string const & name)
+{
+        return add_port(name, EVENT, false);
+}
+
+offline_client::port_id
+offline_client::port_index(string const & name) const
+{
+        for (port_id i = 0; i < _ports.size(); ++i) {
+                if (_ports[i].name == name) return i;
+        }
+        throw Error(util::make_string() << "the port " << name << " does not exist");
+}
+
+offline_client::port_t &
+offline_client::get(port_id port)
+{
+        if (port >= _ports.size())
+                throw Error(util::make_string() << "invalid port id " << port);
+        return _ports[port];
+}
+
+offline_client::port_t const &
+offline_client::get(port_id port) const
+{
+        if (port >= _ports.size())
+                throw Error(util::make_string() << "invalid port id " << port);
+        return _ports[port];
+}
+
+void
+offline_client::set_process_callback(ProcessCallback const & cb)
+{
+        _process_cb = cb;
+}
+
+void
+offline_client::set_sample_rate_callback(SamplingRateCallback const & cb)
+{
+        _sampling_rate_cb = cb;
+        if (cb) cb(this, _sampling_rate);
+}
+
+void
+offline_client::set_buffer_size_callback(BufferSizeCallback const & cb)
+{
+        _buffer_size_cb = cb;
+        if (cb) cb(this, _period_size);
+}
+
+void
+offline_client::set_buffer_size(nframes_t period_size)
+{
+        if (period_size == 0)
+                throw Error("period size must be nonzero");
+        _period_size = period_size;
+        for (std::vector<port_t>::iterator it = _ports.begin(); it != _ports.end(); ++it) {
+                if (it->dtype == SAMPLED) it->buffer.resize(_period_size, 0);
+        }
+        INFO << "period size (frames): " << _period_size;
+        if (_buffer_size_cb) _buffer_size_cb(this, _period_size);
+}
+
+nframes_t
+offline_client::input_size() const
+{
+        nframes_t n = 0;
+        for (std::vector<port_t>::const_iterator it = _ports.begin(); it != _ports.end(); ++it) {
+                if (!it->is_input) continue;
+                if (it->dtype == SAMPLED)
+                        n = std::max<nframes_t>(n, it->samples.size());
+                else if (!it->events.empty())
+                        n = std::max<nframes_t>(n, it->events.back().time + 1);
+        }
+        return n;
+}
+
+nframes_t
+offline_client::run(nframes_t nframes)
+{
+        std::vector<port_t>::iterator it;
+        if (nframes == 0) nframes = input_size() - std::min(input_size(), _frame);
+        nframes_t start = _frame;
+        nframes_t stop = _frame + nframes;
+
+        while (_frame < stop) {
+                /* set up buffers */
+                for (it = _ports.begin(); it != _ports.end(); ++it) {
+                        if (it->dtype == SAMPLED) {
+                                std::fill(it->buffer.begin(), it->buffer.end(), 0);
+                                if (it->is_input && _frame < it->samples.size()) {
+                                        std::size_t n = std::min<std::size_t>(_period_size,
+                                                                              it->samples.size() - _frame);
+                                        std::copy(it->samples.begin() + _frame,
+                                                  it->samples.begin() + _frame + n,
+                                                  it->buffer.begin());
+                                }
+                        }
+                        else {
+                                it->period_events.clear();
+                                if (!it->is_input) continue;
+                                while (it->next_event < it->events.size() &&
+                                       it->events[it->next_event].time < _frame + _period_size) {
+                                        event_t e = it->events[it->next_event++];
+                                        if (e.time < _frame) continue; // added after start
+                                        e.time -= _frame;
+                                        it->period_events.push_back(e);
+                                }
+                        }
+                }
+
+                int ret = (_process_cb) ? _process_cb(this, _period_size, _frame) : 0;
+
+                /* collect outputs */
+                for (it = _ports.begin(); it != _ports.end(); ++it) {
+                        if (it->is_input) continue;
+                        if (it->dtype == SAMPLED) {
+                                it->samples.insert(it->samples.end(), it->buffer.begin(), it->buffer.end());
+                        }
+                        else {
+                                std::vector<event_t>::iterator e;
+                                for (e = it->period_events.begin(); e != it->period_events.end(); ++e) {
+                                        e->time += _frame;
+                                        it->events.push_back(*e);
+                                }
+                        }
+                }
+                _frame += _period_size;
+                if (ret != 0) {
+                        LOG << "process callback returned " << ret << "; stopping";
+                        break;
+                }
+        }
+        return _frame - start;
+}
+
+void
+offline_client::reset()
+{
+        _frame = 0;
+        for (std::vector<port_t>::iterator it = _ports.begin(); it != _ports.end(); ++it) {
+                it->next_event = 0;
+                it->period_events.clear();
+                if (!it->is_input) {
+                        it->samples.clear();
+                        it->events.clear();
+                }
+        }
+}
+
+sample_t *
+offline_client::port_samples(port_id port, nframes_t)
+{
+        port_t & p = get(port);
+        return (p.dtype == SAMPLED) ? &p.buffer[0] : 0;
+}
+
+std::vector<offline_client::event_t> const &
+offline_client::events(port_id port) const
+{
+        return get(port).period_events;
+}
+
+std::size_t
+offline_client::nevents(port_id port)
+{
+        return get(port).period_events.size();
+}
+
+offline_client::event_ref_t
+offline_client::event(port_id port, std::size_t index)
+{
+        event_t const & e = get(port).period_events.at(index);
+        event_ref_t out = { e.time, e.data.size(), e.data.empty() ? 0 : &e.data[0] };
+        return out;
+}
+
+int
+offline_client::write_event(port_id port, nframes_t time, void const * data, std::size_t size)
+{
+        port_t & p = get(port);
+        if (p.is_input || p.dtype != EVENT)
+                throw Error(util::make_string() << "can't write events to port " << p.name);
+        event_t e;
+        e.time = time;
+        e.data.assign(static_cast<char const *>(data), static_cast<char const *>(data) + size);
+        p.period_events.push_back(e);
+        return 0;
+}
+
+std::vector<sample_t> const &
+offline_client::output(port_id port) const
+{
+        return get(port).samples;
+}
+
+std::vector<offline_client::event_t> const &
+offline_client::output_events(port_id port) const
+{
+        return get(port).events;
+}
+
+char const *
+offline_client::name() const
+{
+        return _name.c_str();
+}
+
+nframes_t
+offline_client::sampling_rate() const
+{
+        return _sampling_rate;
+}
+
+nframes_t
+offline_client::frame() const
+{
+        return _frame;
+}
+
+nframes_t
+offline_client::frame(utime_t usec) const
+{
+        return usec * _sampling_rate / 1000000;
+}
+
+utime_t
+offline_client::time(nframes_t frame) const
+{
+        return utime_t(frame) * 1000000 / _sampling_rate;
+}
+
+utime_t
+offline_client::time() const
+{
+        return time(_frame);
+}
@@ -0,0 +1,169 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _OFFLINE_CLIENT_HH
+#define _OFFLINE_CLIENT_HH
+
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include "process_client.hh"
+
+namespace jill {
+
+class stimulus_t;
+
+/**
+ * @ingroup clientgroup
+ * @brief Runs process callbacks offline, without a JACK server
+ *
+ * This class implements the process_client interface for testing and
+ * benchmarking processing code, so process callbacks that take a
+ * process_client* run here as they would in a jack_client. Input ports are
+ * fed from sample arrays or stimuli (e.g., sound files loaded with
+ * file::stimfile, or recorded data loaded with file::arf_dataset) and from
+ * lists of events; output ports are collected into arrays. The process callback is
+ * called for each period as fast as the CPU allows, and the frame counter
+ * starts at zero, so results are deterministic. The period size can be changed
+ * between runs to check how processing depends on it.
+ *
+ * Because the client implements data_source, it can also be used with the
+ * data_writer classes to store results to disk.
+ */
+class offline_client : public process_client {
+
+public:
+        /** @see jack_client::ProcessCallback */
+        typedef boost::function<int (offline_client* client, nframes_t size, nframes_t time)> ProcessCallback;
+        typedef boost::function<int (offline_client* client, nframes_t srate)> SamplingRateCallback;
+        typedef boost::function<int (offline_client* client, nframes_t nframes)> BufferSizeCallback;
+
+        /** An event. Time is relative to the period in callbacks, and absolute otherwise */
+        struct event_t {
+                nframes_t time;
+                std::vector<char> data;
+        };
+
+        /**
+         * Initialize the client.
+         *
+         * @param name           the name of the client
+         * @param sampling_rate  the sampling rate of the data
+         * @param period_size    the number of frames in each period
+         */
+        offline_client(std::string const & name, nframes_t sampling_rate, nframes_t period_size);
+        ~offline_client();
+
+        /** Add a sampled input port, fed from an array of samples (copied) */
+        port_id add_input(std::string const & name, sample_t const * samples, nframes_t nframes);
+
+        /** Add a sampled input port, fed from a stimulus, which is loaded at the client's rate */
+        port_id add_input(std::string const & name, stimulus_t & stim);
+
+        /** Add an event input port, fed from a list of events (absolute times) */
+        port_id add_event_input(std::string const & name, std::vector<event_t> const & events);
+
+        /** Add a sampled output port */
+        port_id add_output(std::string const & name);
+
+        /** Add an event output port */
+        port_id add_event_output(std::string const & name);
+
+        /** Look up a port by name. Not intended for process callbacks. */
+        port_id port_index(std::string const & name) const;
+
+        void set_process_callback(ProcessCallback const & cb);
+        /** Called immediately with the client's sampling rate */
+        void set_sample_rate_callback(SamplingRateCallback const & cb);
+        /** Called immediately and when the period size changes */
+        void set_buffer_size_callback(BufferSizeCallback const & cb);
+
+        /** Change the period size. Inputs are not rewound. */
+        void set_buffer_size(nframes_t period_size);
+
+        /**
+         * Run the process callback until the inputs are exhausted or the
+         * callback returns a nonzero value.
+         *
+         * @param nframes  the number of frames to process, or 0 to process all
+         *                 the input. Rounded up to a whole number of periods.
+         * @return the number of frames processed
+         */
+        nframes_t run(nframes_t nframes=0);
+
+        /** Rewind inputs to the start and discard collected outputs */
+        void reset();
+
+        /* -- Port buffers for process callbacks -- */
+
+        /** Get sample buffer for port */
+        sample_t * port_samples(port_id port, nframes_t nframes=0);
+
+        /** Get events arriving in an input port in the current period */
+        std::vector<event_t> const & events(port_id port) const;
+
+        std::size_t nevents(port_id port);
+        event_ref_t event(port_id port, std::size_t index);
+
+        /** Write an event to an output port in the current period */
+        int write_event(port_id port, nframes_t time, void const * data, std::size_t size);
+
+        /* -- Results -- */
+
+        /** Samples collected from an output port */
+        std::vector<sample_t> const & output(port_id port) const;
+
+        /** Events collected from an output port */
+        std::vector<event_t> const & output_events(port_id port) const;
+
+        nframes_t buffer_size() const { return _period_size; }
+        std::size_t nports() const { return _ports.size(); }
+
+        /* Implementations of data_source functions */
+        char const * name() const;
+	nframes_t sampling_rate() const;
+	nframes_t frame() const;
+        nframes_t frame(utime_t) const;
+        utime_t time(nframes_t) const;
+        utime_t time() const;
+
+private:
+        struct port_t {
+                std::string name;
+                dtype_t dtype;
+                bool is_input;
+                std::vector<sample_t> samples;   // input signal or collected output
+                std::vector<event_t> events;     // input events or collected output
+                std::vector<sample_t> buffer;    // period buffer
+                std::vector<event_t> period_events;
+                std::size_t next_event;          // input cursor
+        };
+
+        port_id add_port(std::string const & name, dtype_t dtype, bool is_input);
+        port_t & get(port_id port);
+        port_t const & get(port_id port) const;
+
+        /** the number of frames of input data */
+        nframes_t input_size() const;
+
+        std::string _name;
+        nframes_t _sampling_rate;
+        nframes_t _period_size;
+        nframes_t _frame;       // start of current period
+        std::vector<port_t> _ports;
+
+	ProcessCallback _process_cb;
+        SamplingRateCallback _sampling_rate_cb;
+        BufferSizeCallback _buffer_size_cb;
+};
+
+} // namespace jill
+
+#endif
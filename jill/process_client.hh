@@ -0,0 +1,82 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+#ifndef _PROCESS_CLIENT_HH
+#define _PROCESS_CLIENT_HH
+
+#include <string>
+#include "data_source.hh"
+
+namespace jill {
+
+/**
+ * @ingroup clientgroup
+ * @brief ABC for clients that run process callbacks
+ *
+ * This is the part of the client interface that process callbacks need:
+ * access to the buffers of the client's ports for the current period, plus
+ * the timing functions of data_source. It's implemented by jack_client, which
+ * runs in a JACK server, and by offline_client, which runs from arrays or
+ * files, so processing code written against this interface can run in either.
+ *
+ * Ports are identified by their index, in order of registration. Look up
+ * indices with port_index() before the client starts processing; the other
+ * functions are realtime safe, and are only valid in the process callback.
+ *
+ * The process, sampling rate, and buffer size callbacks of both clients are
+ * passed a pointer to the client, so a function that takes a process_client*
+ * can be registered with either one.
+ */
+class process_client : public data_source {
+
+public:
+        /** Handle for ports, which are numbered in order of registration */
+        typedef std::size_t port_id;
+
+        /** An event in an input port. The data are valid until the end of the period */
+        struct event_ref_t {
+                nframes_t time;         // offset from the start of the period
+                std::size_t size;
+                void const * data;
+        };
+
+        /** The number of frames in each period */
+        virtual nframes_t buffer_size() const = 0;
+
+        /**
+         * Look up one of the client's ports by its short name. Not RT safe.
+         *
+         * @throws jill::Error (or a subclass) if there's no such port
+         */
+        virtual port_id port_index(std::string const & name) const = 0;
+
+        /** Get sample buffer for port */
+        virtual sample_t * port_samples(port_id port, nframes_t nframes) = 0;
+
+        /** The number of events arriving in an input port in the current period */
+        virtual std::size_t nevents(port_id port) = 0;
+
+        /** Get an event from an input port. index must be less than nevents(port) */
+        virtual event_ref_t event(port_id port, std::size_t index) = 0;
+
+        /**
+         * Write an event to an output port. Events in a period must be
+         * written in order of time. Output buffers are cleared at the start
+         * of each period.
+         *
+         * @return 0 on success, nonzero if there wasn't space for the event
+         */
+        virtual int write_event(port_id port, nframes_t time, void const * data, std::size_t size) = 0;
+};
+
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include "logging.hh"
 #include "logger.hh"
 #include "program_options.hh"
+#include "util/thread_policy.hh"
 
 using namespace jill;
 using std::string;
@@ -32,6 +33,15 @@ program_options::program_options(std::string const &program_name)
 		("config,C",  po::value<string>(), "load options from a ini file (overruled by command-line)");
 	cmd_opts.add(generic);
 	visible_opts.add(generic);
+
+        po::options_description threads("Threading options");
+        threads.add_options()
+                ("sched",     po::value<vector<string> >(),
+                 "set scheduling for background threads (role[:fifo|other[:prio]][@cpus]; "
+                 "roles: writer, readahead, worker)")
+                ("mlock",     "lock all process memory in RAM");
+	cmd_opts.add(threads);
+	visible_opts.add(threads);
 }
 
 void
@@ -84,10 +94,34 @@ program_options::parse(int argc, char **argv)
         }
 
 	po::notify(vmap);
+        process_thread_options();
 	process_options();
 }
 
 
+void
+program_options::process_thread_options()
+{
+        if (vmap.count("sched")) {
+                vector<string> const & specs = vmap["sched"].as<vector<string> >();
+                for (vector<string>::const_iterator it = specs.begin(); it != specs.end(); ++it) {
+                        util::thread_policy policy;
+                        util::thread_role role;
+                        try {
+                                role = util::parse_thread_policy(*it, policy);
+                        }
+                        catch (std::invalid_argument const & e) {
+                                throw po::invalid_option_value(e.what());
+                        }
+                        util::set_thread_policy(role, policy);
+                        LOG << "thread policy: " << *it;
+                }
+        }
+        if (vmap.count("mlock"))
+                util::lock_all_memory();
+}
+
+
 int
 program_options::parse_keyvals(map<string, string> & dict, string const & name)
 {
@@ -154,6 +154,9 @@ protected:
 	 */
 	virtual void print_usage();
 
+        /** Set thread policies and lock memory. Called by parse() */
+        void process_thread_options();
+
 };
 
 
@@ -15,7 +15,7 @@ transfer_function::transfer_function(poly b, poly a) {
 transfer_function::transfer_function(std::vector<complex_t> z, 
                                      std::vector<complex_t> p,
                                      COEF_t k) {
-        complex_t identity[0];
+        complex_t identity[1];
         identity[0] = complex_t(1,0);
         complex_poly num(identity, 0);
         complex_poly denom(identity, 0);
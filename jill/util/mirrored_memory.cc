@@ -15,10 +15,12 @@
  */
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdexcept>
 #include "mirrored_memory.hh"
+#include "thread_policy.hh"
 
 using namespace jill::util;
 using std::size_t;
@@ -30,16 +32,7 @@ using std::size_t;
 mirrored_memory::mirrored_memory(size_t arg_size, size_t guard_size, bool lock_pages)
 {
         int shm_id;
-        size_t page_size = getpagesize();
-
-        // make sure size will not overflow size_t arithmetic
-        if (arg_size > ( ( (~(size_t)0) >> 2 ) - page_size))
-                throw std::out_of_range("Argument size exceeds address space");
-
-        // round to multiple of page size
-        if ( ! arg_size ) arg_size = 1;
-        _size = arg_size + ( page_size - 1 );
-        _size -= _size & ( page_size - 1 );
+        _size = page_round(arg_size);
 
         // The mmap call ensures that there are two contiguous pages in virtual
         // address space.
@@ -53,9 +46,6 @@ mirrored_memory::mirrored_memory(size_t arg_size, size_t guard_size, bool lock_p
         if (mem_ptr == MAP_FAILED)
                 throw std::runtime_error("anonymous mmap failed");
 
-        if (lock_pages)
-                mlock(mem_ptr, total_size());
-
         _buf = mem_ptr;
         upper_ptr = _buf + _size;
 
@@ -80,10 +70,69 @@ mirrored_memory::mirrored_memory(size_t arg_size, size_t guard_size, bool lock_p
         if ( 0 > shmctl( shm_id, IPC_RMID, NULL ) )
                 throw std::runtime_error("failed to tag shared memory for deletion");
 
+        // lock the attached segment (the initial mapping was replaced, so
+        // this can't be done any earlier). Touching the pages faults them in.
+        if (lock_pages && !memory_locked())
+                mlock(_buf, total_size());
+
         // zero out the memory
         memset(_buf, 0, _size);
 }
 
+mirrored_memory::mirrored_memory(std::string const & path, size_t arg_size)
+{
+        _size = page_round(arg_size);
+
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0)
+                throw std::runtime_error("unable to open backing file " + path);
+
+        // reserve the blocks now so that stores to the mapping can't fail
+        // later for lack of disk space
+        int ret = ftruncate(fd, _size);
+#ifdef __linux__
+        if (ret == 0) ret = posix_fallocate(fd, 0, _size);
+#endif
+        if (ret != 0) {
+                close(fd);
+                unlink(path.c_str());
+                throw std::runtime_error("unable to allocate backing file " + path);
+        }
+
+        // reserve contiguous address space, then map the file into both halves
+        mem_ptr = (char*) mmap (NULL,
+                        _size + _size,
+                        PROT_NONE,
+                        MAP_ANONYMOUS | MAP_PRIVATE,
+                        -1,
+                        0);
+        if (mem_ptr == MAP_FAILED) {
+                close(fd);
+                unlink(path.c_str());
+                throw std::runtime_error("anonymous mmap failed");
+        }
+
+        _buf = mem_ptr;
+        upper_ptr = _buf + _size;
+
+        if (mmap(_buf, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(upper_ptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                munmap(mem_ptr, total_size());
+                close(fd);
+                unlink(path.c_str());
+                throw std::runtime_error("failed to map backing file " + path);
+        }
+
+        // mlockall(MCL_FUTURE) would pin the file mapping; undo this so the
+        // kernel can page it out
+        if (memory_locked())
+                munlock(_buf, total_size());
+
+        // the mappings keep the file alive
+        close(fd);
+        unlink(path.c_str());
+}
+
 mirrored_memory::~mirrored_memory()
 {
         // clean up mmaps and shm attaches. all these calls are safe to make
@@ -99,3 +148,19 @@ mirrored_memory::total_size() const
 {
         return _size + _size;
 }
+
+size_t
+mirrored_memory::page_round(size_t arg_size)
+{
+        size_t page_size = getpagesize();
+
+        // make sure size will not overflow size_t arithmetic
+        if (arg_size > ( ( (~(size_t)0) >> 2 ) - page_size))
+                throw std::out_of_range("Argument size exceeds address space");
+
+        // round to multiple of page size
+        if ( ! arg_size ) arg_size = 1;
+        size_t size = arg_size + ( page_size - 1 );
+        size -= size & ( page_size - 1 );
+        return size;
+}
@@ -12,6 +12,7 @@
 #ifndef _MIRRORED_MEMORY_HH
 #define _MIRRORED_MEMORY_HH
 
+#include <string>
 #include <boost/noncopyable.hpp>
 
 namespace jill { namespace util {
@@ -34,9 +35,24 @@ public:
          * @param guard_size  requested size guard pages on either side of the
          *                 allocated memory. Not implemented
          *
-         * @param lock_pages  try to lock the buffer in memory
+         * @param lock_pages  try to lock the buffer in memory. Redundant if
+         *                    util::lock_all_memory() has been called
          */
         mirrored_memory(std::size_t req_size=0, std::size_t guard_size=0, bool lock_pages=true);
+
+        /**
+         * Request mirrored memory of at least req_size bytes, backed by a
+         * file instead of shared memory. The file is created (or truncated),
+         * preallocated on disk, and unlinked once it has been mapped, so it
+         * disappears when the object is destroyed. The pages are not locked,
+         * even if util::lock_all_memory() has been called, so the kernel is
+         * free to write them out.
+         *
+         * @param path     the location of the backing file
+         * @param req_size the requested number of bytes. Will be rounded up to
+         *                 multiple of the page size
+         */
+        mirrored_memory(std::string const & path, std::size_t req_size);
         ~mirrored_memory();
 
         /** Pointer to the allocated buffer */
@@ -53,6 +69,9 @@ protected:
         /** total (virtual) size including guards */
         std::size_t total_size() const;
 
+        /** round size up to a multiple of the page size */
+        static std::size_t page_round(std::size_t req_size);
+
         char *_buf;
         std::size_t _size;
 
@@ -0,0 +1,85 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <iostream>
+#include <algorithm>
+#include "process_timer.hh"
+
+using namespace jill::util;
+
+process_timer::stats_t::stats_t()
+        : count(0), misses(0), total_usec(0), max_usec(0)
+{
+        std::fill(duration, duration + duration_bins, 0);
+        std::fill(load, load + load_bins, 0);
+}
+
+process_timer::stats_t &
+process_timer::stats_t::operator-=(stats_t const & other)
+{
+        count -= other.count;
+        misses -= other.misses;
+        total_usec -= other.total_usec;
+        for (std::size_t i = 0; i < duration_bins; ++i)
+                duration[i] -= other.duration[i];
+        for (std::size_t i = 0; i < load_bins; ++i)
+                load[i] -= other.load[i];
+        return *this;
+}
+
+double
+process_timer::stats_t::mean_load(jill::utime_t period) const
+{
+        if (count == 0 || period == 0) return 0.0;
+        return double(total_usec) / count / period;
+}
+
+process_timer::process_timer() {}
+
+process_timer::stats_t
+process_timer::snapshot() const
+{
+        // atomic reads of each counter; the set as a whole may be slightly
+        // inconsistent if the writer is active
+        stats_t * s = const_cast<stats_t *>(&_stats);
+        stats_t out;
+        out.count = __sync_fetch_and_add(&s->count, 0);
+        out.misses = __sync_fetch_and_add(&s->misses, 0);
+        out.total_usec = __sync_fetch_and_add(&s->total_usec, 0);
+        out.max_usec = __sync_fetch_and_add(&s->max_usec, 0);
+        for (std::size_t i = 0; i < duration_bins; ++i)
+                out.duration[i] = __sync_fetch_and_add(s->duration + i, 0);
+        for (std::size_t i = 0; i < load_bins; ++i)
+                out.load[i] = __sync_fetch_and_add(s->load + i, 0);
+        return out;
+}
+
+std::ostream &
+jill::util::operator<< (std::ostream & os, process_timer::stats_t const & stats)
+{
+        os << "callbacks=" << stats.count << ", misses=" << stats.misses
+           << ", max=" << stats.max_usec << " us";
+        if (stats.count > 0)
+                os << ", mean=" << stats.total_usec / stats.count << " us";
+        os << "; duration (us):";
+        for (std::size_t i = 0; i < process_timer::duration_bins; ++i) {
+                if (stats.duration[i] == 0) continue;
+                os << " " << ((i == 0) ? 0 : (1ULL << i)) << "-" << (2ULL << i) << ":" << stats.duration[i];
+        }
+        os << "; load (%):";
+        for (std::size_t i = 0; i < process_timer::load_bins; ++i) {
+                if (stats.load[i] == 0) continue;
+                if (i == process_timer::load_bins - 1)
+                        os << " >=" << i * 10 << ":" << stats.load[i];
+                else
+                        os << " " << i * 10 << "-" << (i + 1) * 10 << ":" << stats.load[i];
+        }
+        return os;
+}
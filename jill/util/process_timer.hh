@@ -0,0 +1,88 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _PROCESS_TIMER_HH
+#define _PROCESS_TIMER_HH
+
+#include <iosfwd>
+#include <boost/noncopyable.hpp>
+#include "../types.hh"
+
+namespace jill { namespace util {
+
+/**
+ * Accumulates statistics about how long the process callback takes to run.
+ * Durations are binned on a log2 scale (in microseconds), and the ratio of the
+ * duration to the period is binned in steps of 10%, with the last bin
+ * counting deadline misses (callbacks that took longer than the period).
+ *
+ * record() is called by a single (realtime) thread and is wait-free. Any
+ * other thread may call snapshot() to read the counters.
+ */
+class process_timer : boost::noncopyable {
+
+public:
+        /** bin k holds durations in [2^k, 2^(k+1)) us; bin 0 also holds 0 us */
+        static const std::size_t duration_bins = 24;
+        /** bin k holds loads in [10k%, 10(k+1)%); the last bin holds loads >= 100% */
+        static const std::size_t load_bins = 11;
+
+        struct stats_t {
+                unsigned long long count;       // number of callbacks
+                unsigned long long misses;      // number of callbacks longer than the period
+                unsigned long long total_usec;  // total time in callbacks
+                unsigned long long max_usec;    // longest callback
+                unsigned long long duration[duration_bins];
+                unsigned long long load[load_bins];
+
+                stats_t();
+                /** subtract counts from an earlier snapshot. max_usec is not changed */
+                stats_t & operator-=(stats_t const & other);
+                /** average fraction of the period spent in the callback */
+                double mean_load(utime_t period) const;
+        };
+
+        process_timer();
+
+        /**
+         * Record the duration of a callback. Wait-free; only call from one
+         * thread.
+         *
+         * @param duration  the time spent in the callback (us)
+         * @param period    the duration of the period (us)
+         */
+        void record(utime_t duration, utime_t period) {
+                std::size_t bin = (duration > 0) ? 63 - __builtin_clzll(duration) : 0;
+                if (bin >= duration_bins) bin = duration_bins - 1;
+                __sync_add_and_fetch(_stats.duration + bin, 1);
+
+                bin = (period > 0) ? duration * 10 / period : load_bins - 1;
+                if (bin >= load_bins) bin = load_bins - 1;
+                __sync_add_and_fetch(_stats.load + bin, 1);
+
+                if (duration > period) __sync_add_and_fetch(&_stats.misses, 1);
+                if (duration > _stats.max_usec) __sync_lock_test_and_set(&_stats.max_usec, duration);
+                __sync_add_and_fetch(&_stats.total_usec, duration);
+                __sync_add_and_fetch(&_stats.count, 1);
+        }
+
+        /** Copy the current counts. Safe to call from any thread */
+        stats_t snapshot() const;
+
+private:
+        stats_t _stats;
+};
+
+/** Print a summary of the statistics, with nonempty bins of the histograms */
+std::ostream & operator<< (std::ostream & os, process_timer::stats_t const & stats);
+
+}} // namespace jill::util
+
+#endif
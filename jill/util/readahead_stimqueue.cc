@@ -10,6 +10,7 @@
  */
 #include "../logging.hh"
 #include "readahead_stimqueue.hh"
+#include "thread_policy.hh"
 
 using namespace jill::util;
 
@@ -50,6 +51,7 @@ void *
 readahead_stimqueue::thread(void * arg)
 {
 	pthread_setcanceltype (PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+        apply_thread_policy(READAHEAD_THREAD);
         readahead_stimqueue * self = static_cast<readahead_stimqueue *>(arg);
         self->loop();
         return 0;
@@ -0,0 +1,165 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <sched.h>
+#include <unistd.h>
+#include <stdexcept>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "../logging.hh"
+#include "rt_pool.hh"
+#include "thread_policy.hh"
+
+using namespace jill::util;
+
+namespace {
+
+/* wait until *addr != val; may return spuriously */
+void
+wait_change(volatile int * addr, int val)
+{
+#ifdef __linux__
+        syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, 0, 0, 0);
+#else
+        if (*addr == val) sched_yield();
+#endif
+}
+
+void
+wake_all(volatile int * addr)
+{
+#ifdef __linux__
+        syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 0x7fffffff, 0, 0, 0);
+#endif
+}
+
+inline void
+cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+}
+
+}
+
+rt_pool::rt_pool(std::size_t nthreads, int priority, bool pin)
+        : _job(0), _njobs(0), _next_job(0), _running(0), _generation(0), _stop(0)
+{
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        for (std::size_t i = 0; i < nthreads; ++i) {
+                pthread_t thread_id;
+                pthread_attr_t attr;
+                pthread_attr_init(&attr);
+                if (priority >= 0) {
+                        sched_param param;
+                        param.sched_priority = priority;
+                        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+                        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+                        pthread_attr_setschedparam(&attr, &param);
+                }
+                int ret = pthread_create(&thread_id, &attr, rt_pool::thread, this);
+                if (ret != 0 && priority >= 0) {
+                        LOG << "unable to start realtime worker thread (err=" << ret
+                            << "); using default scheduler";
+                        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+                        ret = pthread_create(&thread_id, &attr, rt_pool::thread, this);
+                }
+                pthread_attr_destroy(&attr);
+                if (ret != 0) {
+                        stop();
+                        throw std::runtime_error("Failed to start worker thread");
+                }
+#ifdef __linux__
+                if (pin && ncpus > 1) {
+                        cpu_set_t cpus;
+                        CPU_ZERO(&cpus);
+                        CPU_SET((i + 1) % ncpus, &cpus);
+                        pthread_setaffinity_np(thread_id, sizeof(cpus), &cpus);
+                }
+#endif
+                _threads.push_back(thread_id);
+        }
+        INFO << "started " << nthreads << " worker threads (priority=" << priority << ")";
+}
+
+rt_pool::~rt_pool()
+{
+        stop();
+}
+
+void
+rt_pool::stop()
+{
+        __sync_lock_test_and_set(&_stop, 1);
+        __sync_add_and_fetch(&_generation, 1);
+        wake_all(&_generation);
+        for (std::vector<pthread_t>::iterator it = _threads.begin(); it != _threads.end(); ++it)
+                pthread_join(*it, NULL);
+        _threads.clear();
+}
+
+void
+rt_pool::run(job_type const & job, std::size_t njobs)
+{
+        if (_threads.empty() || njobs < 2) {
+                for (std::size_t i = 0; i < njobs; ++i) job(i);
+                return;
+        }
+        _job = &job;
+        _njobs = njobs;
+        _next_job = 0;
+        _running = _threads.size();
+        // publish the job before releasing the workers
+        __sync_add_and_fetch(&_generation, 1);
+        wake_all(&_generation);
+
+        do_jobs();
+        while (__sync_fetch_and_add(&_running, 0) > 0) {
+                cpu_relax();
+        }
+}
+
+void
+rt_pool::do_jobs()
+{
+        std::size_t i;
+        job_type const & job = *_job;
+        while ((i = __sync_fetch_and_add(&_next_job, 1)) < _njobs) {
+                job(i);
+        }
+}
+
+void *
+rt_pool::thread(void * arg)
+{
+        rt_pool * self = static_cast<rt_pool *>(arg);
+        apply_thread_policy(WORKER_THREAD);
+        self->loop();
+        return 0;
+}
+
+void
+rt_pool::loop()
+{
+        int generation = 0;     // value at construction
+        while (1) {
+                int current;
+                while ((current = __sync_fetch_and_add(&_generation, 0)) == generation) {
+                        wait_change(&_generation, generation);
+                }
+                generation = current;
+                if (_stop) break;
+                do_jobs();
+                __sync_sub_and_fetch(&_running, 1);
+        }
+}
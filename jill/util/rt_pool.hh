@@ -0,0 +1,78 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _RT_POOL_HH
+#define _RT_POOL_HH
+
+#include <vector>
+#include <pthread.h>
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+
+namespace jill { namespace util {
+
+/**
+ * A pool of worker threads for splitting independent jobs (e.g., filtering
+ * separate channels) across CPUs within a single period. The calling thread
+ * (normally the JACK process thread) hands out job indices with an atomic
+ * counter, works on jobs itself, and then spins until all the workers are
+ * finished. Idle workers sleep on a futex (or yield, on systems without
+ * futexes).
+ *
+ * run() does not allocate memory or take locks, but the caller does have to
+ * wait for the slowest job, so jobs should take about the same amount of time.
+ */
+class rt_pool : boost::noncopyable {
+
+public:
+        /** Function called for each job, with the index of the job */
+        typedef boost::function<void (std::size_t)> job_type;
+
+        /**
+         * Start worker threads.
+         *
+         * @param nthreads  the number of worker threads (not including the caller)
+         * @param priority  the SCHED_FIFO priority of the workers, or -1 to use
+         *                  the default scheduler. Normally this should be the
+         *                  priority of the JACK process thread.
+         * @param pin       if true, pin worker i to cpu (i + 1) % ncpus
+         */
+        rt_pool(std::size_t nthreads, int priority=-1, bool pin=false);
+        ~rt_pool();
+
+        /**
+         * Call job(i) for i in [0, njobs), in parallel, and return when all the
+         * calls are complete. Wait-free for the caller, apart from waiting for
+         * the jobs. Only call from one thread at a time.
+         */
+        void run(job_type const & job, std::size_t njobs);
+
+        /** The number of worker threads */
+        std::size_t size() const { return _threads.size(); }
+
+private:
+        static void * thread(void * arg); // thread entry point
+        void loop();                      // called by threads
+        void do_jobs();
+        void stop();                      // stop and join workers
+
+        std::vector<pthread_t> _threads;
+
+        job_type const * volatile _job;
+        volatile std::size_t _njobs;
+        volatile std::size_t _next_job;         // next job to hand out
+        volatile std::size_t _running;          // workers still busy
+        volatile int _generation;               // incremented for each run
+        volatile int _stop;
+};
+
+}} // namespace jill::util
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "../logging.hh"
+#include "thread_policy.hh"
+
+using namespace jill::util;
+using std::string;
+
+namespace {
+
+char const * role_names[] = { "writer", "readahead", "worker" };
+
+thread_policy policies[NUM_THREAD_ROLES];
+bool policy_set[NUM_THREAD_ROLES] = { false };
+bool locked = false;
+
+int
+to_int(string const & s, string const & spec)
+{
+        char * end;
+        long v = strtol(s.c_str(), &end, 10);
+        if (s.empty() || *end != '\0')
+                throw std::invalid_argument("bad number in thread policy: " + spec);
+        return int(v);
+}
+
+}
+
+thread_policy::thread_policy()
+        : sched(SCHED_OTHER), priority(0) {}
+
+void
+jill::util::set_thread_policy(thread_role role, thread_policy const & policy)
+{
+        policies[role] = policy;
+        policy_set[role] = true;
+}
+
+thread_role
+jill::util::parse_thread_policy(string const & spec, thread_policy & policy)
+{
+        string s = spec;
+        string::size_type at = s.find('@');
+        if (at != string::npos) {
+                string cpus = s.substr(at + 1);
+                s = s.substr(0, at);
+                string::size_type pos = 0;
+                while (pos <= cpus.size()) {
+                        string::size_type comma = cpus.find(',', pos);
+                        if (comma == string::npos) comma = cpus.size();
+                        string item = cpus.substr(pos, comma - pos);
+                        string::size_type dash = item.find('-');
+                        if (dash == string::npos) {
+                                policy.cpus.push_back(to_int(item, spec));
+                        }
+                        else {
+                                int first = to_int(item.substr(0, dash), spec);
+                                int last = to_int(item.substr(dash + 1), spec);
+                                for (int i = first; i <= last; ++i)
+                                        policy.cpus.push_back(i);
+                        }
+                        pos = comma + 1;
+                }
+        }
+
+        std::vector<string> fields;
+        string::size_type pos = 0;
+        while (1) {
+                string::size_type colon = s.find(':', pos);
+                fields.push_back(s.substr(pos, colon - pos));
+                if (colon == string::npos) break;
+                pos = colon + 1;
+        }
+        if (fields.size() > 3)
+                throw std::invalid_argument("too many fields in thread policy: " + spec);
+
+        int role;
+        for (role = 0; role < NUM_THREAD_ROLES; ++role)
+                if (fields[0] == role_names[role]) break;
+        if (role == NUM_THREAD_ROLES)
+                throw std::invalid_argument("unknown thread role in policy: " + spec);
+
+        if (fields.size() > 1) {
+                if (fields[1] == "fifo") policy.sched = SCHED_FIFO;
+                else if (fields[1] == "other") policy.sched = SCHED_OTHER;
+                else throw std::invalid_argument("unknown scheduler in thread policy: " + spec);
+        }
+        if (fields.size() > 2)
+                policy.priority = to_int(fields[2], spec);
+        return static_cast<thread_role>(role);
+}
+
+bool
+jill::util::apply_thread_policy(thread_role role)
+{
+        if (!policy_set[role]) return true;
+        thread_policy const & policy = policies[role];
+        bool ok = true;
+        int ret;
+
+        sched_param param;
+        param.sched_priority = (policy.sched == SCHED_FIFO) ? policy.priority : 0;
+        ret = pthread_setschedparam(pthread_self(), policy.sched, &param);
+        if (ret != 0) {
+                LOG << "WARNING: unable to set scheduler for " << role_names[role]
+                    << " thread (" << strerror(ret) << ")";
+                ok = false;
+        }
+#ifdef __linux__
+        if (policy.sched == SCHED_OTHER && policy.priority != 0) {
+                // on linux, nice values are per-thread
+                if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), policy.priority) != 0) {
+                        LOG << "WARNING: unable to set nice value for " << role_names[role]
+                            << " thread (" << strerror(errno) << ")";
+                        ok = false;
+                }
+        }
+        if (!policy.cpus.empty()) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                for (std::vector<int>::const_iterator it = policy.cpus.begin(); it != policy.cpus.end(); ++it)
+                        CPU_SET(*it, &cpus);
+                ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+                if (ret != 0) {
+                        LOG << "WARNING: unable to set cpu affinity for " << role_names[role]
+                            << " thread (" << strerror(ret) << ")";
+                        ok = false;
+                }
+        }
+#endif
+        if (ok) {
+                INFO << "applied scheduling policy to " << role_names[role] << " thread";
+        }
+        return ok;
+}
+
+bool
+jill::util::lock_all_memory()
+{
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+                LOG << "ERROR: unable to lock memory (" << strerror(errno) << ")";
+                return false;
+        }
+        locked = true;
+        LOG << "locked process memory";
+        return true;
+}
+
+bool
+jill::util::memory_locked()
+{
+        return locked;
+}
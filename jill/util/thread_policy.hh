@@ -0,0 +1,74 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * additions Copyright (C) 2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _THREAD_POLICY_HH
+#define _THREAD_POLICY_HH
+
+#include <string>
+#include <vector>
+
+namespace jill { namespace util {
+
+/** The kinds of background threads started by JILL classes */
+enum thread_role {
+        WRITER_THREAD = 0,      // disk and spill threads of buffered_data_writer
+        READAHEAD_THREAD,       // loads stimuli in readahead_stimqueue
+        WORKER_THREAD,          // rt_pool workers
+        NUM_THREAD_ROLES
+};
+
+/**
+ * Scheduling settings for a thread role. Threads call apply_thread_policy()
+ * when they start, so policies need to be set before the objects that start
+ * the threads are created. program_options sets them from the --sched option.
+ */
+struct thread_policy {
+        int sched;              // SCHED_OTHER or SCHED_FIFO
+        int priority;           // realtime priority for SCHED_FIFO, nice value for SCHED_OTHER
+        std::vector<int> cpus;  // cpus the thread may run on; empty for any
+
+        thread_policy();
+};
+
+/** Set the policy for threads with a given role */
+void set_thread_policy(thread_role role, thread_policy const & policy);
+
+/**
+ * Parse a policy specification of the form role[:policy[:priority]][@cpus],
+ * where role is writer, readahead, or worker; policy is fifo or other;
+ * priority is the realtime priority (fifo) or nice value (other); and cpus
+ * is a list of cpus or ranges (e.g. 2,4-5). Throws std::invalid_argument
+ * for malformed specifications.
+ */
+thread_role parse_thread_policy(std::string const & spec, thread_policy & policy);
+
+/**
+ * Apply the policy for a role to the calling thread. Does nothing if no
+ * policy was set for the role. Failures (e.g. lack of permission for
+ * realtime scheduling) are logged but not fatal.
+ *
+ * @return true if no policy was set or it was applied without errors
+ */
+bool apply_thread_policy(thread_role role);
+
+/**
+ * Lock all current and future pages of the process into memory
+ * (mlockall). Logs an error if this fails.
+ *
+ * @return true if successful
+ */
+bool lock_all_memory();
+
+/** True if lock_all_memory() succeeded */
+bool memory_locked();
+
+}} // namespace jill::util
+
+#endif
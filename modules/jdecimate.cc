@@ -0,0 +1,228 @@
+/*
+ * Records inputs to an ARF file at a reduced sampling rate
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ */
+#include <iostream>
+#include <signal.h>
+#include <cstdio>
+#include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "jill/jack_client.hh"
+#include "jill/program_options.hh"
+#include "jill/logging.hh"
+#include "jill/file/arf_writer.hh"
+#include "jill/dsp/buffered_data_writer.hh"
+#include "jill/dsp/decimating_writer.hh"
+
+#define PROGRAM_NAME "jdecimate"
+
+using namespace jill;
+using std::string;
+typedef std::vector<string> svec;
+
+class jdecimate_options : public program_options {
+
+public:
+	jdecimate_options(string const &program_name);
+
+	/** The server name */
+	string server_name;
+	/** The client name (used in internal JACK representations) */
+	string client_name;
+
+	/** Ports to connect to */
+        svec input_ports;
+        int nports;
+
+        string output_file;
+        std::map<string, string> additional_options;
+        int factor;
+        float buffer_size_s;
+        int compression;
+
+protected:
+
+	virtual void print_usage();
+	virtual void process_options();
+
+};
+
+
+static jdecimate_options options(PROGRAM_NAME);
+static boost::shared_ptr<jack_client> client;
+static boost::shared_ptr<dsp::buffered_data_writer> arf_thread;
+
+
+/*
+ * The process callback only copies data into the ringbuffer; the data are
+ * filtered and downsampled in the disk thread.
+ */
+int
+process(jack_client *client, nframes_t nframes, nframes_t time)
+{
+        jack_client::port_table_t const & ports = client->port_table();
+        for (std::size_t i = 0; i < ports.size(); ++i) {
+                void * buffer = ports.buffers[i];
+                if (buffer == 0) continue;
+                arf_thread->push(time, SAMPLED, ports.ports[i].name.c_str(),
+                                 nframes * sizeof(sample_t), buffer);
+        }
+        arf_thread->data_ready();
+        return 0;
+}
+
+int
+jack_bufsize(jack_client *client, nframes_t nframes)
+{
+        std::size_t bytes = client->sampling_rate() * options.buffer_size_s * client->nports();
+        bytes = arf_thread->request_buffer_size(bytes * sizeof(sample_t));
+        arf_thread->reset();
+        LOG << "ringbuffer size (bytes): " << bytes;
+        return 0;
+}
+
+int
+jack_xrun(jack_client *client, float delay)
+{
+        arf_thread->xrun();
+        return 0;
+}
+
+void
+jack_shutdown(jack_status_t code, char const * msg)
+{
+        LOG << "jackd shut the client down (" << msg << ")";
+        if (arf_thread) {
+                arf_thread->stop();
+        }
+}
+
+void
+signal_handler(int sig)
+{
+        if (arf_thread) {
+                arf_thread->stop();
+        }
+}
+
+int
+main(int argc, char **argv)
+{
+        int ret = 0;
+	try {
+		options.parse(argc,argv);
+                client.reset(new jack_client(options.client_name, options.server_name));
+                boost::shared_ptr<file::arf_writer> writer(
+                        new file::arf_writer(options.output_file, *client,
+                                             options.additional_options, options.compression));
+                boost::shared_ptr<dsp::decimating_writer> decimator(
+                        new dsp::decimating_writer(writer, options.factor, client->sampling_rate()));
+                arf_thread.reset(new dsp::buffered_data_writer(decimator));
+                arf_thread->bind_logger(options.server_name);
+
+                /* one port for each input; only the decimated data are stored */
+                for (int i = 0; i < options.nports; ++i) {
+                        char buf[32];
+                        snprintf(buf, sizeof(buf), "pcm_%03d", i);
+                        client->register_port(buf, JACK_DEFAULT_AUDIO_TYPE,
+                                              JackPortIsInput | JackPortIsTerminal, 0);
+                        decimator->add_channel(buf, buf, false);
+                        writer->add_template(buf, true);
+                }
+
+                signal(SIGINT,  signal_handler);
+                signal(SIGTERM, signal_handler);
+                signal(SIGHUP,  signal_handler);
+
+                client->set_shutdown_callback(jack_shutdown);
+                client->set_xrun_callback(jack_xrun);
+                client->set_process_callback(process);
+                client->set_buffer_size_callback(jack_bufsize);
+
+                client->activate();
+                arf_thread->start();
+
+                for (std::size_t i = 0; i < options.input_ports.size(); ++i) {
+                        char buf[32];
+                        snprintf(buf, sizeof(buf), "pcm_%03lu", (unsigned long)i);
+                        client->connect_port(options.input_ports[i], buf);
+                }
+
+                arf_thread->join();
+	}
+	catch (Exit const &e) {
+		ret = e.status();
+	}
+	catch (std::exception const &e) {
+                LOG << "ERROR: " << e.what();
+		ret = EXIT_FAILURE;
+	}
+
+        if (client) client->deactivate();
+        return ret;
+}
+
+
+jdecimate_options::jdecimate_options(string const &program_name)
+        : program_options(program_name)
+{
+        po::options_description jillopts("JILL options");
+        jillopts.add_options()
+                ("server,s",  po::value<string>(&server_name)->default_value("default"),
+                 "connect to specific jack server")
+                ("name,n",    po::value<string>(&client_name)->default_value(_program_name),
+                 "set client name")
+                ("in,i",      po::value<svec>(&input_ports), "add connection to input port")
+                ("ports,p",   po::value<int>(&nports)->default_value(1),
+                 "number of input ports to create (at least one per connection)")
+                ("buffer",    po::value<float>(&buffer_size_s)->default_value(2.0),
+                 "minimum ringbuffer size (s)");
+
+        po::options_description opts("Decimation options");
+        opts.add_options()
+                ("factor,d",  po::value<int>(&factor)->default_value(20),
+                 "factor by which to reduce the sampling rate (must divide the rate)")
+                ("attr,a",     po::value<svec>(),
+                 "set additional attributes for recorded entries (key=value)")
+                ("compression", po::value<int>(&compression)->default_value(0),
+                 "set compression in output file (0-9)");
+
+        cmd_opts.add(jillopts).add(opts);
+        cmd_opts.add_options()
+                ("output-file,f", po::value<string>(), "output filename");
+        pos_opts.add("output-file", -1);
+        visible_opts.add(jillopts).add(opts);
+}
+
+void
+jdecimate_options::print_usage()
+{
+        std::cout << "Usage: " << _program_name << " [options] output-file\n"
+                  << visible_opts << std::endl
+                  << "Ports:\n"
+                  << " * pcm_NNN:   sampled inputs, stored after low-pass filtering and downsampling\n"
+                  << std::endl;
+}
+
+void
+jdecimate_options::process_options()
+{
+        program_options::process_options();
+        if (!assign(output_file, "output-file")) {
+                LOG << "ERROR: missing required output file name";
+                throw Exit(EXIT_FAILURE);
+        }
+        parse_keyvals(additional_options, "attr");
+        if (factor < 2) {
+                LOG << "ERROR: decimation factor must be at least 2";
+                throw Exit(EXIT_FAILURE);
+        }
+        nports = std::max(nports, int(input_ports.size()));
+}
@@ -1,5 +1,5 @@
 /*
- * Simple crossing-based signal detector
+ * Simple crossing-based or spectral signal detector, for one or more inputs
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -9,15 +9,16 @@
  * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
  */
 #include <iostream>
+#include <cstdio>
 #include <signal.h>
 #include <boost/shared_ptr.hpp>
 
 #include "jill/logging.hh"
 #include "jill/jack_client.hh"
+#include "jill/component.hh"
+#include "jill/components/detector.hh"
 #include "jill/program_options.hh"
 #include "jill/midi.hh"
-#include "jill/dsp/ringbuffer.hh"
-#include "jill/dsp/crossing_trigger.hh"
 
 #define PROGRAM_NAME "jdetect"
 
@@ -38,6 +39,10 @@ public:
 	std::vector<string> output_ports;
         /** The MIDI output channel */
         midi::data_type output_chan;
+        /** The number of inputs */
+        int nports;
+        /** Whether each input gets its own MIDI output */
+        bool split_outputs;
 
 	float open_threshold;
 	float close_threshold;
@@ -49,133 +54,56 @@ public:
 	float open_crossing_period_ms;
 	float close_crossing_period_ms;
 
+        /** The detector: crossing or spectral */
+        string detector;
+        /** The edges of the detection band (Hz; spectral detector) */
+        std::vector<float> band;
+        float open_ratio;         // dB
+        float close_ratio;
+        float min_power;          // dB re full scale
+        float open_fraction;      // of periods in the window
+        float close_fraction;
+        int fft_size;
+
 protected:
 
 	virtual void print_usage();
+	virtual void process_options();
 
 }; // jdetect_options
 
 
 jdetect_options options(PROGRAM_NAME);
 boost::shared_ptr<jack_client> client;
-boost::shared_ptr<dsp::crossing_trigger<sample_t> > trigger;
-jack_port_t *port_in, *port_trig, *port_count;
-int stopping = 0;               // set to 1 to get process to clean up
-
-/* data storage for event times */
-struct event_t {
-        nframes_t time;
-        int status;
-};
-dsp::ringbuffer<event_t> trig_times(128);
-
-int
-process(jack_client *client, nframes_t nframes, nframes_t time)
-{
-	sample_t *in = client->samples(port_in, nframes);
-        sample_t *out = (port_count) ? client->samples(port_count, nframes) : 0;
-        void *trig_buffer = client->events(port_trig, nframes);
-        jack_midi_data_t buf[] = { jack_midi_data_t(options.output_chan & midi::chan_nib),
-                                   midi::default_pitch, midi::default_velocity };
-
-        if (stopping && trigger->open()) {
-                buf[0] += midi::note_off;
-                jack_midi_event_write(trig_buffer, 0, buf, 3);
-                __sync_add_and_fetch(&stopping, -1);
-                return 0;
-        }
-
-	// Step 1: Pass samples to window discriminator; its state may
-	// change, in which case the return value will be > -1 and
-	// indicate the frame in which the gate opened or closed. It
-	// also takes care of copying the current state of the buffer
-	// to the count monitor port (if not NULL)
-	int offset = trigger->push(in, nframes, out);
-        if (offset < 0) return 0;
-
-        if (trigger->open()) buf[0] += midi::note_on;
-        else buf[0] += midi::note_off;
-
-        event_t event = { time + offset, buf[0] & midi::type_nib }; // data sent to logger
-        if (jack_midi_event_write(trig_buffer, offset, buf, 3) != 0) {
-                // indicate error to logger function
-                event.status = midi::sysex;
-        }
-        trig_times.push(event);
-
-	return 0;
-}
-
-/** visitor function for gate time ringbuffer */
-std::size_t log_times(event_t const * events, std::size_t count)
-{
-        event_t const *e;
-        std::size_t i;
-	for (i = 0; i < count; ++i) {
-                e = events+i;
-                log_msg msg;
-                if (e->status==midi::note_on)
-                        msg << "signal on: ";
-                else if (e->status==midi::note_off)
-                        msg << "signal off:";
-                else
-                        msg << "WARNING: detected but couldn't send event: ";
-                msg << " frames=" << e->time << ", us=" << client->time(e->time);
-        }
-        return i;
-}
+boost::shared_ptr<component_host> host;
+boost::shared_ptr<components::detector> detector;
+int ret = EXIT_SUCCESS;
+int running = 1;
 
 void
 signal_handler(int sig)
 {
-        __sync_add_and_fetch(&stopping, 1);
-        // wait for at least one process loop; not strictly async safe
-        usleep(2e6 * client->buffer_size() / client->sampling_rate());
-        exit(sig);
+        ret = sig;
+        running = 0;
 }
 
 void
 jack_shutdown(jack_status_t code, char const *)
 {
-        __sync_add_and_fetch(&stopping, 1);
-        // wait for at least one process loop
-        usleep(2e6 * client->buffer_size() / client->sampling_rate());
-        exit(-1);
+        ret = -1;
+        running = 0;
 }
 
-/**
- * Callback for samplerate changes. This function is only called once.
- */
-int
-samplerate_callback(jack_client *client, nframes_t samplerate)
+/* the name of port i, or just base if there is only one */
+string
+port_name(string const & base, int i, int n)
 {
-        using std::endl;
-	nframes_t period_size = options.period_size_ms * samplerate / 1000;
-	int open_crossing_periods = options.open_crossing_period_ms / options.period_size_ms;
-	int close_crossing_periods  = options.close_crossing_period_ms / options.period_size_ms;
-	int open_count_thresh = options.open_crossing_rate * period_size / 1000 * open_crossing_periods;
-	int close_count_thresh = options.close_crossing_rate * period_size / 1000 * close_crossing_periods;
-
-        trigger.reset(new dsp::crossing_trigger<sample_t>(options.open_threshold,
-                                                         open_count_thresh,
-                                                         open_crossing_periods,
-                                                         options.close_threshold,
-                                                         close_count_thresh,
-                                                         close_crossing_periods,
-                                                         period_size));
-
-        // Log parameters
-        LOG << "period size: " << options.period_size_ms << " ms, " << period_size << " samples";
-        LOG << "open threshold: " << options.open_threshold;
-        LOG << "open count thresh: " << open_count_thresh;
-        LOG << "open integration window: " << options.open_crossing_period_ms << " ms, " << open_crossing_periods << " periods ";
-        LOG << "close threshold: " << options.close_threshold;
-        LOG << "close count thresh: " << close_count_thresh;
-        LOG << "close integration window: " << options.close_crossing_period_ms << " ms, " << close_crossing_periods << " periods ";
-        return 0;
+        if (n == 1) return base;
+        char buf[16];
+        sprintf(buf, "_%03d", i);
+        return base + buf;
 }
 
-
 int
 main(int argc, char **argv)
 {
@@ -184,14 +112,38 @@ main(int argc, char **argv)
 		options.parse(argc, argv);
                 client.reset(new jack_client(options.client_name, options.server_name));
 
-                port_in = client->register_port("in", JACK_DEFAULT_AUDIO_TYPE,
-                                               JackPortIsInput, 0);
-                port_trig = client->register_port("trig_out",JACK_DEFAULT_MIDI_TYPE,
-                                                JackPortIsOutput, 0);
-                if (options.count("count-port")) {
-                        port_count = client->register_port("count",JACK_DEFAULT_AUDIO_TYPE,
-                                                          JackPortIsOutput, 0);
+                int const n = options.nports;
+                int const ntrig = options.split_outputs ? n : 1;
+                components::detector::options_type dopts;
+                for (int i = 0; i < n; ++i) {
+                        dopts.inputs.push_back(port_name("in", i, n));
+                        if (options.count("count-port"))
+                                dopts.counts.push_back(port_name("count", i, n));
                 }
+                for (int i = 0; i < ntrig; ++i)
+                        dopts.outputs.push_back(port_name("trig_out", i, ntrig));
+                dopts.chan = options.output_chan;
+                dopts.type = options.detector;
+                dopts.crossing.open_threshold = options.open_threshold;
+                dopts.crossing.close_threshold = options.close_threshold;
+                dopts.crossing.open_crossing_rate = options.open_crossing_rate;
+                dopts.crossing.close_crossing_rate = options.close_crossing_rate;
+                dopts.crossing.period_size_ms = options.period_size_ms;
+                dopts.crossing.open_crossing_period_ms = options.open_crossing_period_ms;
+                dopts.crossing.close_crossing_period_ms = options.close_crossing_period_ms;
+                dopts.band = options.band;
+                dopts.open_ratio = options.open_ratio;
+                dopts.close_ratio = options.close_ratio;
+                dopts.min_power = options.min_power;
+                dopts.open_fraction = options.open_fraction;
+                dopts.close_fraction = options.close_fraction;
+                dopts.fft_size = options.fft_size;
+
+                // the detector is created here, so that the FFT for the
+                // spectral detector is prepared before the process callback starts
+                host.reset(new component_host(*client));
+                detector.reset(new components::detector(dopts));
+                host->add("", detector, component::config_type());
 
                 // register signal handlers
 		signal(SIGINT,  signal_handler);
@@ -199,19 +151,30 @@ main(int argc, char **argv)
 		signal(SIGHUP,  signal_handler);
 
                 client->set_shutdown_callback(jack_shutdown);
-                client->set_sample_rate_callback(samplerate_callback);
-                client->set_process_callback(process);
-                client->activate();
+                host->activate();
 
-                client->connect_ports(options.input_ports.begin(), options.input_ports.end(), "in");
-                client->connect_ports("trig_out", options.output_ports.begin(), options.output_ports.end());
+                // with one input, all the connections go to it; otherwise
+                // they are made to each input in turn
+                if (n == 1)
+                        client->connect_ports(options.input_ports.begin(), options.input_ports.end(), "in");
+                else
+                        for (std::size_t i = 0; i < options.input_ports.size(); ++i)
+                                client->connect_port(options.input_ports[i], port_name("in", i, n));
+                if (ntrig == 1)
+                        client->connect_ports("trig_out", options.output_ports.begin(),
+                                              options.output_ports.end());
+                else
+                        for (std::size_t i = 0; i < options.output_ports.size(); ++i)
+                                client->connect_port(port_name("trig_out", i, ntrig), options.output_ports[i]);
 
-                while(1) {
+                while (running) {
                         sleep(1);
-                        trig_times.pop(log_times); // calls visitor function on ringbuffer
+                        detector->log_events();
                 }
 
-		return EXIT_SUCCESS;
+                // closes any open gates before the client is deactivated
+                host->deactivate();
+		return ret;
 	}
 	catch (Exit const &e) {
 		return e.status();
@@ -237,7 +200,10 @@ jdetect_options::jdetect_options(string const &program_name)
                 ("in,i",      po::value<vector<string> >(&input_ports), "add connection to input port")
                 ("out,o",     po::value<vector<string> >(&output_ports), "add connection to output port")
                 ("chan,c",    po::value<midi::data_type>(&output_chan)->default_value(0),
-                 "set MIDI channel for output messages (0-16)");
+                 "set MIDI channel for output messages (0-16)")
+                ("ports,p",   po::value<int>(&nports)->default_value(1),
+                 "number of inputs to monitor")
+                ("split-out", "create a MIDI output port for each input");
 
         // tropts is a group of options
         po::options_description tropts("Trigger options");
@@ -256,10 +222,29 @@ jdetect_options::jdetect_options(string const &program_name)
                 ("close-rate", po::value<float>(&close_crossing_rate)->default_value(2),
                  "set crossing rate thresh for close gate (s^-1)")
                 ("close-period", po::value<float>(&close_crossing_period_ms)->default_value(5000),
-                 "set integration time for close gate (ms)");
-
-        cmd_opts.add(jillopts).add(tropts);
-        visible_opts.add(jillopts).add(tropts);
+                 "set integration time for close gate (ms)")
+                ("detector", po::value<string>(&detector)->default_value("crossing"),
+                 "set detector type (crossing or spectral)");
+
+        po::options_description specopts("Spectral detector options");
+        specopts.add_options()
+                ("band", po::value<vector<float> >(&band)->multitoken(),
+                 "set frequency band to detect (lo hi, Hz)")
+                ("fft-size", po::value<int>(&fft_size)->default_value(0),
+                 "set FFT size (default period size; rounded up to power of 2)")
+                ("open-ratio", po::value<float>(&open_ratio)->default_value(6),
+                 "set in-band to out-of-band power ratio for open gate (dB)")
+                ("close-ratio", po::value<float>(&close_ratio)->default_value(3),
+                 "set power ratio for close gate (dB)")
+                ("min-power", po::value<float>(&min_power)->default_value(-60),
+                 "set minimum in-band power (dB re full-scale sine)")
+                ("open-frac", po::value<float>(&open_fraction)->default_value(0.5),
+                 "set fraction of periods with signal to open gate")
+                ("close-frac", po::value<float>(&close_fraction)->default_value(0.2),
+                 "set fraction of periods with signal to keep gate open");
+
+        cmd_opts.add(jillopts).add(tropts).add(specopts);
+        visible_opts.add(jillopts).add(tropts).add(specopts);
 }
 
 void
@@ -270,7 +255,42 @@ jdetect_options::print_usage()
                   << "Ports:\n"
                   << " * in:       for input of the signal(s) to be monitored\n"
                   << " * trig_out:  MIDI port producing gate open and close events\n"
-                  << " * count:    (optional) the current estimate of signal power"
+                  << " * count:    (optional) the current estimate of signal power\n\n"
+                  << "With more than one input (--ports), the ports are numbered (in_000, count_000,\n"
+                  << "etc), and each input is monitored separately. The inputs share one trig_out\n"
+                  << "port, with the key number of each event giving the index of the input, unless\n"
+                  << "--split-out is set. Connections (-i, -o) are made to the numbered ports in turn.\n\n"
+                  << "The crossing detector counts crossings of the open and close thresholds. The\n"
+                  << "spectral detector (--detector spectral) scores each period by the ratio of the\n"
+                  << "power in --band to the power outside it, and opens the gate when the fraction\n"
+                  << "of periods with signal in the open window exceeds --open-frac."
                   << std::endl;
 }
 
+void
+jdetect_options::process_options()
+{
+        program_options::process_options();
+        split_outputs = count("split-out");
+        if (nports < 1) {
+                LOG << "ERROR: need at least one input";
+                throw Exit(EXIT_FAILURE);
+        }
+        if (nports > 1 && int(input_ports.size()) > nports) {
+                LOG << "ERROR: more input connections than inputs";
+                throw Exit(EXIT_FAILURE);
+        }
+        if (nports > 128 && !split_outputs) {
+                LOG << "ERROR: more than 128 inputs requires --split-out";
+                throw Exit(EXIT_FAILURE);
+        }
+        if (detector != "crossing" && detector != "spectral") {
+                LOG << "ERROR: unknown detector type " << detector;
+                throw Exit(EXIT_FAILURE);
+        }
+        if (detector == "spectral" && (band.size() != 2 || band[0] < 0 || band[1] <= band[0])) {
+                LOG << "ERROR: the spectral detector requires --band lo hi, with 0 <= lo < hi";
+                throw Exit(EXIT_FAILURE);
+        }
+}
+
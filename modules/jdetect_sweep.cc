@@ -0,0 +1,609 @@
+/*
+ * Offline evaluation of signal detectors. Runs recordings from ARF files
+ * through a detector for each combination of a grid of parameters, compares
+ * the detections against annotated events, and reports precision, recall, and
+ * latency for each set of parameters.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ */
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+#include <hdf5.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "jill/logging.hh"
+#include "jill/program_options.hh"
+#include "jill/midi.hh"
+#include "jill/util/rt_pool.hh"
+#include "jill/dsp/crossing_trigger.hh"
+#include "jill/dsp/crossing_trigger_bank.hh"
+#include "jill/dsp/spectral_trigger_bank.hh"
+#include "jill/dsp/detection_stats.hh"
+
+#define PROGRAM_NAME "jdetect_sweep"
+
+using namespace jill;
+using std::string;
+using std::vector;
+typedef vector<string> stringvec;
+typedef vector<float> floatvec;
+
+class jdetect_sweep_options : public program_options {
+
+public:
+	jdetect_sweep_options(string const &program_name);
+
+        /** The ARF files to read */
+        stringvec input_files;
+        /** The sampled dataset to analyze in each entry */
+        string channel;
+        /** The event dataset with the annotated onsets */
+        string reference;
+        /** The detector: trigger, crossing, or spectral */
+        string detector;
+        /** The number of samples passed to the detector at once */
+        int block_size;
+        /** The number of threads */
+        int nthreads;
+        /** How early (ms) a detection can be and still match an event */
+        float match_before_ms;
+        /** How late (ms) a detection can be and still match an event */
+        float match_after_ms;
+
+        /* parameters; each can have several values */
+        floatvec period_size_ms;
+        floatvec open_period_ms;
+        floatvec close_period_ms;
+        floatvec open_threshold;
+        floatvec open_crossing_rate;
+        floatvec close_threshold;
+        floatvec close_crossing_rate;
+        floatvec open_ratio;
+        floatvec close_ratio;
+        floatvec min_power;
+        floatvec open_fraction;
+        floatvec close_fraction;
+        floatvec fft_size;
+        floatvec band;
+
+protected:
+
+	virtual void print_usage();
+	virtual void process_options();
+
+}; // jdetect_sweep_options
+
+
+/* a parameter in the grid, and its values */
+struct param_t {
+        char const * name;
+        floatvec const * values;
+};
+
+/* a recording and its annotations */
+struct recording_t {
+        string name;
+        double sampling_rate;
+        vector<float> samples;
+        vector<long> onsets;
+};
+
+/* the fields of an event record used for the reference onsets */
+struct event_record {
+        double start;
+        unsigned char status;
+};
+
+/* a set of parameters, in the same order as the grid */
+typedef floatvec config_t;
+
+static jdetect_sweep_options options(PROGRAM_NAME);
+static vector<param_t> grid;
+static vector<recording_t> recordings;
+static vector<std::size_t> recording_order;     // longest first
+static vector<dsp::detection_stats> results;    // [recording][config]
+
+
+/*
+ * crossing_trigger, which is the detector used by jrecord, wrapped in the
+ * interface of the multi-channel detectors.
+ */
+class single_trigger : public dsp::trigger_bank {
+public:
+        single_trigger(sample_type othresh, int ocount, size_type owindow,
+                       sample_type cthresh, int ccount, size_type cwindow, size_type period_size)
+                : _othresh(othresh), _ocount(ocount), _owindow(owindow),
+                  _cthresh(cthresh), _ccount(ccount), _cwindow(cwindow), _period_size(period_size) {
+                reset();
+        }
+
+        size_type push(sample_type const * const * samples, size_type nframes,
+                       event_type * events, size_type max_events,
+                       sample_type * const * counts=0) {
+                int offset = _trigger->push(samples[0], nframes, counts ? counts[0] : 0);
+                if (offset < 0 || max_events == 0) return 0;
+                event_type e = { 0, size_type(offset), _trigger->open() };
+                events[0] = e;
+                return 1;
+        }
+
+        size_type max_events(size_type) const { return 1; }
+        bool open(size_type) const { return _trigger->open(); }
+        void reset() {
+                _trigger.reset(new dsp::crossing_trigger<sample_type>(_othresh, _ocount, _owindow,
+                                                                       _cthresh, _ccount, _cwindow,
+                                                                       _period_size));
+        }
+        size_type nchannels() const { return 1; }
+        size_type period_size() const { return _period_size; }
+
+private:
+        sample_type _othresh;
+        int _ocount;
+        size_type _owindow;
+        sample_type _cthresh;
+        int _ccount;
+        size_type _cwindow;
+        size_type _period_size;
+        boost::scoped_ptr<dsp::crossing_trigger<sample_type> > _trigger;
+};
+
+
+/** the number of parameter sets in the grid */
+std::size_t
+grid_size()
+{
+        std::size_t n = 1;
+        for (vector<param_t>::const_iterator p = grid.begin(); p != grid.end(); ++p)
+                n *= p->values->size();
+        return n;
+}
+
+/** parameter set i in the grid; the last parameter varies fastest */
+config_t
+grid_config(std::size_t i)
+{
+        config_t config(grid.size());
+        for (std::size_t p = grid.size(); p-- > 0; ) {
+                std::size_t const n = grid[p].values->size();
+                config[p] = (*grid[p].values)[i % n];
+                i /= n;
+        }
+        return config;
+}
+
+/** the value of a parameter in a set */
+float
+param(config_t const & config, string const & name)
+{
+        for (std::size_t p = 0; p < grid.size(); ++p)
+                if (name == grid[p].name) return config[p];
+        throw std::invalid_argument("no such parameter: " + name);
+}
+
+/**
+ * Create a detector. The parameters are converted to samples and counts in
+ * the same way as in jdetect and jrecord.
+ */
+boost::shared_ptr<dsp::trigger_bank>
+make_detector(config_t const & config, double samplerate)
+{
+        float const period_ms = param(config, "period-size");
+        std::size_t period_size = period_ms * samplerate / 1000;
+        int open_periods = param(config, "open-period") / period_ms;
+        int close_periods = param(config, "close-period") / period_ms;
+        boost::shared_ptr<dsp::trigger_bank> ret;
+        if (options.detector == "spectral") {
+                dsp::spectral_trigger_bank::params_type p;
+                p.band_lo = options.band[0];
+                p.band_hi = options.band[1];
+                p.open_ratio = param(config, "open-ratio");
+                p.close_ratio = param(config, "close-ratio");
+                p.min_power = param(config, "min-power");
+                p.ocount_thresh = param(config, "open-frac") * open_periods;
+                p.owindow_periods = open_periods;
+                p.ccount_thresh = param(config, "close-frac") * close_periods;
+                p.cwindow_periods = close_periods;
+                p.period_size = period_size;
+                p.fft_size = param(config, "fft-size");
+                ret.reset(new dsp::spectral_trigger_bank(1, samplerate, p));
+        }
+        else {
+                float const othresh = param(config, "open-thresh");
+                float const cthresh = param(config, "close-thresh");
+                int ocount = param(config, "open-rate") * period_size / 1000 * open_periods;
+                int ccount = param(config, "close-rate") * period_size / 1000 * close_periods;
+                if (options.detector == "trigger")
+                        ret.reset(new single_trigger(othresh, ocount, open_periods,
+                                                     cthresh, ccount, close_periods, period_size));
+                else
+                        ret.reset(new dsp::crossing_trigger_bank(1, othresh, ocount, open_periods,
+                                                                 cthresh, ccount, close_periods,
+                                                                 period_size));
+        }
+        return ret;
+}
+
+/**
+ * Run one recording through the detector for one set of parameters. Jobs are
+ * numbered with the longest recordings first, so that the workers finish at
+ * about the same time.
+ */
+void
+run_job(std::size_t job)
+{
+        std::size_t const nconfigs = grid_size();
+        std::size_t const r = recording_order[job / nconfigs];
+        std::size_t const c = job % nconfigs;
+        recording_t const & rec = recordings[r];
+
+        boost::shared_ptr<dsp::trigger_bank> detector = make_detector(grid_config(c), rec.sampling_rate);
+        std::size_t const block = options.block_size;
+        vector<dsp::trigger_bank::event_type> events(detector->max_events(block));
+        vector<long> onsets;
+        for (std::size_t i = 0; i < rec.samples.size(); i += block) {
+                float const * in = &rec.samples[i];
+                std::size_t const n = std::min(block, rec.samples.size() - i);
+                std::size_t const ne = detector->push(&in, n, &events[0], events.size());
+                for (std::size_t e = 0; e < ne; ++e)
+                        if (events[e].open) onsets.push_back(i + events[e].offset);
+        }
+        double const ms = rec.sampling_rate / 1000;
+        results[r * nconfigs + c] = dsp::match_detections(onsets, rec.onsets,
+                                                          long(options.match_before_ms * ms),
+                                                          long(options.match_after_ms * ms));
+}
+
+
+/* read a string attribute, or return def if it doesn't exist */
+string
+read_string_attribute(hid_t obj, char const * name, string const & def)
+{
+        if (H5Aexists(obj, name) <= 0) return def;
+        string ret = def;
+        hid_t attr = H5Aopen(obj, name, H5P_DEFAULT);
+        hid_t type = H5Aget_type(attr);
+        if (H5Tget_class(type) == H5T_STRING) {
+                if (H5Tis_variable_str(type) > 0) {
+                        char * value = 0;
+                        hid_t memtype = H5Tcopy(H5T_C_S1);
+                        H5Tset_size(memtype, H5T_VARIABLE);
+                        if (H5Aread(attr, memtype, &value) >= 0 && value) {
+                                ret = value;
+                                H5free_memory(value);
+                        }
+                        H5Tclose(memtype);
+                }
+                else {
+                        vector<char> value(H5Tget_size(type) + 1, 0);
+                        if (H5Aread(attr, type, &value[0]) >= 0)
+                                ret = &value[0];
+                }
+        }
+        H5Tclose(type);
+        H5Aclose(attr);
+        return ret;
+}
+
+/* read a sampled dataset */
+void
+read_samples(hid_t entry, recording_t & rec)
+{
+        hid_t dset = H5Dopen2(entry, options.channel.c_str(), H5P_DEFAULT);
+        if (dset < 0) throw FileError("unable to open dataset " + rec.name);
+        hid_t space = H5Dget_space(dset);
+        rec.samples.resize(H5Sget_simple_extent_npoints(space));
+        herr_t status = rec.samples.empty() ? 0 :
+                H5Dread(dset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &rec.samples[0]);
+        if (H5Aexists(dset, "sampling_rate") > 0) {
+                hid_t attr = H5Aopen(dset, "sampling_rate", H5P_DEFAULT);
+                H5Aread(attr, H5T_NATIVE_DOUBLE, &rec.sampling_rate);
+                H5Aclose(attr);
+        }
+        H5Sclose(space);
+        H5Dclose(dset);
+        if (status < 0) throw FileError("unable to read samples from " + rec.name);
+}
+
+/*
+ * Read the onsets from an event dataset. Datasets written by jill (with a
+ * compound type) have start times in samples and a MIDI status; only the
+ * onsets are used. Other datasets are read as a list of times, in the units
+ * given by the units attribute (samples, s, or ms).
+ */
+void
+read_onsets(hid_t entry, recording_t & rec)
+{
+        hid_t dset = H5Dopen2(entry, options.reference.c_str(), H5P_DEFAULT);
+        if (dset < 0) throw FileError("unable to open reference dataset in " + rec.name);
+        string const units = read_string_attribute(dset, "units", "samples");
+        double const scale = (units == "s") ? rec.sampling_rate :
+                (units == "ms") ? rec.sampling_rate / 1000 : 1.0;
+        hid_t type = H5Dget_type(dset);
+        hid_t space = H5Dget_space(dset);
+        std::size_t const n = H5Sget_simple_extent_npoints(space);
+        herr_t status = 0;
+        if (H5Tget_class(type) == H5T_COMPOUND) {
+                if (H5Tget_member_index(type, "start") < 0)
+                        throw FileError("reference dataset in " + rec.name + " has no start field");
+                bool const has_status = H5Tget_member_index(type, "status") >= 0;
+                hid_t memtype = H5Tcreate(H5T_COMPOUND, sizeof(event_record));
+                H5Tinsert(memtype, "start", HOFFSET(event_record, start), H5T_NATIVE_DOUBLE);
+                if (has_status)
+                        H5Tinsert(memtype, "status", HOFFSET(event_record, status), H5T_NATIVE_UCHAR);
+                vector<event_record> events(n);
+                if (n)
+                        status = H5Dread(dset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, &events[0]);
+                for (std::size_t i = 0; i < n && status >= 0; ++i)
+                        if (!has_status || (events[i].status & midi::type_nib) == midi::note_on)
+                                rec.onsets.push_back(lround(events[i].start * scale));
+                H5Tclose(memtype);
+        }
+        else {
+                vector<double> times(n);
+                if (n)
+                        status = H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &times[0]);
+                for (std::size_t i = 0; i < n && status >= 0; ++i)
+                        rec.onsets.push_back(lround(times[i] * scale));
+        }
+        H5Sclose(space);
+        H5Tclose(type);
+        H5Dclose(dset);
+        if (status < 0) throw FileError("unable to read reference events from " + rec.name);
+        std::sort(rec.onsets.begin(), rec.onsets.end());
+}
+
+/** load the entries with both datasets from an ARF file */
+void
+load_file(string const & path)
+{
+        hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (file < 0) throw FileError("unable to open " + path);
+        H5G_info_t info;
+        H5Gget_info(file, &info);
+        for (hsize_t i = 0; i < info.nlinks; ++i) {
+                char name[256];
+                H5Lget_name_by_idx(file, ".", H5_INDEX_NAME, H5_ITER_INC, i, name, sizeof(name),
+                                   H5P_DEFAULT);
+                // skip the groups jrecord uses for staging datasets
+                if (string(name) == "jill_staging") continue;
+                hid_t obj = H5Oopen(file, name, H5P_DEFAULT);
+                if (obj < 0) continue;
+                if (H5Iget_type(obj) == H5I_GROUP &&
+                    H5Lexists(obj, options.channel.c_str(), H5P_DEFAULT) > 0) {
+                        recording_t rec;
+                        rec.name = path + ":" + name;
+                        rec.sampling_rate = 0;
+                        if (H5Lexists(obj, options.reference.c_str(), H5P_DEFAULT) > 0) {
+                                read_samples(obj, rec);
+                                read_onsets(obj, rec);
+                                if (rec.sampling_rate <= 0)
+                                        LOG << "WARNING: " << rec.name << " has no sampling rate; skipping";
+                                else if (!rec.samples.empty())
+                                        recordings.push_back(rec);
+                        }
+                        else
+                                LOG << "WARNING: " << rec.name << " has no reference events; skipping";
+                }
+                H5Oclose(obj);
+        }
+        H5Fclose(file);
+}
+
+/** compare recordings by length, longest first */
+bool
+longer(std::size_t a, std::size_t b)
+{
+        return recordings[a].samples.size() > recordings[b].samples.size();
+}
+
+
+int
+main(int argc, char **argv)
+{
+	using namespace std;
+	try {
+		options.parse(argc, argv);
+
+                for (stringvec::const_iterator it = options.input_files.begin();
+                     it != options.input_files.end(); ++it)
+                        load_file(*it);
+                if (recordings.empty()) {
+                        LOG << "ERROR: no entries with " << options.channel << " and " << options.reference;
+                        return EXIT_FAILURE;
+                }
+                double total_s = 0;
+                size_t total_onsets = 0;
+                for (size_t r = 0; r < recordings.size(); ++r) {
+                        recording_order.push_back(r);
+                        total_s += recordings[r].samples.size() / recordings[r].sampling_rate;
+                        total_onsets += recordings[r].onsets.size();
+                }
+                sort(recording_order.begin(), recording_order.end(), longer);
+
+                size_t const nconfigs = grid_size();
+                LOG << "recordings: " << recordings.size() << " (" << total_s << " s, "
+                    << total_onsets << " annotated onsets)";
+                LOG << "detector: " << options.detector << ", parameter sets: " << nconfigs;
+
+                // check the parameters before starting the workers
+                for (size_t c = 0; c < nconfigs; ++c)
+                        make_detector(grid_config(c), recordings[0].sampling_rate);
+
+                results.resize(nconfigs * recordings.size());
+                boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+                {
+                        util::rt_pool pool(options.nthreads - 1);
+                        pool.run(util::rt_pool::job_type(run_job), results.size());
+                }
+                double elapsed = (boost::posix_time::microsec_clock::universal_time() - start)
+                        .total_microseconds() * 1e-6;
+                LOG << "analyzed " << total_s * nconfigs << " s of data in " << elapsed << " s ("
+                    << total_s * nconfigs / elapsed << "x real time, " << options.nthreads << " threads)";
+
+                // one row per parameter set
+                for (size_t p = 0; p < grid.size(); ++p)
+                        cout << grid[p].name << '\t';
+                cout << "tp\tfp\tfn\tprecision\trecall\tf1\tlatency_ms\tmax_latency_ms" << endl;
+                double const ms = recordings[0].sampling_rate / 1000;
+                streamsize const prec = cout.precision();
+                size_t best = 0;
+                double best_f1 = -1;
+                for (size_t c = 0; c < nconfigs; ++c) {
+                        dsp::detection_stats stats;
+                        for (size_t r = 0; r < recordings.size(); ++r)
+                                stats += results[r * nconfigs + c];
+                        config_t config = grid_config(c);
+                        for (size_t p = 0; p < config.size(); ++p)
+                                cout << config[p] << '\t';
+                        cout << stats.true_pos << '\t' << stats.false_pos << '\t' << stats.false_neg
+                             << '\t' << fixed << setprecision(3) << stats.precision() << '\t'
+                             << stats.recall() << '\t' << stats.f1() << '\t'
+                             << setprecision(1) << stats.mean_latency() / ms << '\t'
+                             << (stats.true_pos ? stats.latency_max / ms : NAN) << endl;
+                        cout.unsetf(ios::floatfield);
+                        cout.precision(prec);
+                        if (stats.f1() > best_f1) {
+                                best_f1 = stats.f1();
+                                best = c;
+                        }
+                }
+                config_t config = grid_config(best);
+                log_msg msg;
+                msg << "best (f1=" << best_f1 << "):";
+                for (size_t p = 0; p < config.size(); ++p)
+                        msg << " --" << grid[p].name << " " << config[p];
+
+		return EXIT_SUCCESS;
+	}
+	catch (Exit const &e) {
+		return e.status();
+	}
+	catch (std::exception const &e) {
+                LOG << "ERROR: " << e.what();
+		return EXIT_FAILURE;
+	}
+
+}
+
+
+/* a list of values, with a default */
+static po::typed_value<floatvec> *
+values(floatvec * v, float def, char const * text)
+{
+        return po::value<floatvec>(v)->multitoken()->default_value(floatvec(1, def), text);
+}
+
+jdetect_sweep_options::jdetect_sweep_options(string const &program_name)
+        : program_options(program_name)
+{
+        po::options_description opts("Evaluation options");
+        opts.add_options()
+                ("channel,c", po::value<string>(&channel)->default_value("pcm_000"),
+                 "sampled dataset to analyze in each entry")
+                ("reference,r", po::value<string>(&reference)->default_value("annotations"),
+                 "event dataset with annotated onsets")
+                ("detector", po::value<string>(&detector)->default_value("crossing"),
+                 "detector type: trigger (jrecord), crossing (jdetect), or spectral")
+                ("block", po::value<int>(&block_size)->default_value(1024),
+                 "samples passed to the detector at a time (JACK period size)")
+                ("threads,j", po::value<int>(&nthreads)->default_value(sysconf(_SC_NPROCESSORS_ONLN)),
+                 "number of threads")
+                ("before", po::value<float>(&match_before_ms)->default_value(50),
+                 "how early a detection can be and match an event (ms)")
+                ("after", po::value<float>(&match_after_ms)->default_value(1000),
+                 "how late a detection can be and match an event (ms)");
+
+        // the same names and defaults as jdetect
+        po::options_description tropts("Detector parameters (each can take several values)");
+        tropts.add_options()
+                ("period-size", values(&period_size_ms, 20, "20"), "analysis period size (ms)")
+                ("open-thresh", values(&open_threshold, 0.01, "0.01"), "sample threshold for open gate")
+                ("open-rate", values(&open_crossing_rate, 20, "20"), "crossing rate thresh for open gate (s^-1)")
+                ("open-period", values(&open_period_ms, 500, "500"), "integration time for open gate (ms)")
+                ("close-thresh", values(&close_threshold, 0.01, "0.01"), "sample threshold for close gate")
+                ("close-rate", values(&close_crossing_rate, 2, "2"), "crossing rate thresh for close gate (s^-1)")
+                ("close-period", values(&close_period_ms, 5000, "5000"), "integration time for close gate (ms)")
+                ("band", po::value<floatvec>(&band)->multitoken(), "frequency band to detect (lo hi, Hz; spectral)")
+                ("fft-size", values(&fft_size, 0, "0"), "FFT size (spectral)")
+                ("open-ratio", values(&open_ratio, 6, "6"), "power ratio for open gate (dB; spectral)")
+                ("close-ratio", values(&close_ratio, 3, "3"), "power ratio for close gate (dB; spectral)")
+                ("min-power", values(&min_power, -60, "-60"), "minimum in-band power (dB; spectral)")
+                ("open-frac", values(&open_fraction, 0.5, "0.5"), "fraction of periods to open gate (spectral)")
+                ("close-frac", values(&close_fraction, 0.2, "0.2"), "fraction of periods to keep gate open (spectral)");
+
+        cmd_opts.add(opts).add(tropts);
+        cmd_opts.add_options()
+                ("input-file", po::value<stringvec>(&input_files), "input ARF files");
+        pos_opts.add("input-file", -1);
+        visible_opts.add(opts).add(tropts);
+}
+
+void
+jdetect_sweep_options::print_usage()
+{
+        std::cout << "Usage: " << _program_name << " [options] file.arf [file.arf ...]\n"
+                  << visible_opts << std::endl
+                  << "Each entry in the files with both the sampled dataset (--channel) and the\n"
+                  << "reference events (--reference) is run through the detector, once for every\n"
+                  << "combination of the parameter values (e.g. --open-thresh 0.01 0.02 0.05), in\n"
+                  << "blocks of --block samples as in JACK. Detected onsets are matched to the\n"
+                  << "reference onsets, and the scores for each set of parameters are written to\n"
+                  << "stdout as a table. Reference datasets written by jill use note_on events as\n"
+                  << "onsets; other datasets are read as times in the units given by their units\n"
+                  << "attribute."
+                  << std::endl;
+}
+
+void
+jdetect_sweep_options::process_options()
+{
+        program_options::process_options();
+        if (input_files.empty()) {
+                LOG << "ERROR: no input files";
+                throw Exit(EXIT_FAILURE);
+        }
+        if (block_size < 1 || nthreads < 1) {
+                LOG << "ERROR: block size and number of threads must be at least 1";
+                throw Exit(EXIT_FAILURE);
+        }
+        param_t common[] = { { "period-size", &period_size_ms },
+                             { "open-period", &open_period_ms },
+                             { "close-period", &close_period_ms } };
+        grid.assign(common, common + 3);
+        if (detector == "trigger" || detector == "crossing") {
+                param_t p[] = { { "open-thresh", &open_threshold },
+                                { "open-rate", &open_crossing_rate },
+                                { "close-thresh", &close_threshold },
+                                { "close-rate", &close_crossing_rate } };
+                grid.insert(grid.end(), p, p + 4);
+        }
+        else if (detector == "spectral") {
+                if (band.size() != 2 || band[0] < 0 || band[1] <= band[0]) {
+                        LOG << "ERROR: the spectral detector requires --band lo hi, with 0 <= lo < hi";
+                        throw Exit(EXIT_FAILURE);
+                }
+                param_t p[] = { { "fft-size", &fft_size },
+                                { "open-ratio", &open_ratio },
+                                { "close-ratio", &close_ratio },
+                                { "min-power", &min_power },
+                                { "open-frac", &open_fraction },
+                                { "close-frac", &close_fraction } };
+                grid.insert(grid.end(), p, p + 6);
+        }
+        else {
+                LOG << "ERROR: unknown detector type " << detector;
+                throw Exit(EXIT_FAILURE);
+        }
+}
@@ -6,9 +6,10 @@
 #include <sstream>
 #include <algorithm>
 
-#include "../jill/digital_filter.hh"
 #include "../jill/logging.hh"
 #include "../jill/jack_client.hh"
+#include "../jill/component.hh"
+#include "../jill/components/filter.hh"
 #include "../jill/program_options.hh"
 
 #define PROGRAM_NAME "jfilter"
@@ -18,7 +19,7 @@ using namespace jill;
 using std::string;
 typedef std::vector<string> svec;
 typedef jack_client::port_list_type plist_t;
-typedef digital_filter::COEF_t COEF_t;
+typedef components::filter::COEF_t COEF_t;
 
 class jfilter_options : public program_options {
 
@@ -33,6 +34,7 @@ public:
         svec output_ports;
   
         int nports;
+        int nthreads;
 
         string filter_class;
         string filter_type;
@@ -41,6 +43,8 @@ public:
 
         std::vector<COEF_t> numerator;
         std::vector<COEF_t> denominator;
+
+        std::size_t fft_block;
         
         
 
@@ -53,59 +57,37 @@ protected:
 
 static jfilter_options options(PROGRAM_NAME);
 static boost::shared_ptr<jack_client> client;
+static boost::shared_ptr<component_host> host;
+static boost::shared_ptr<components::filter> filter;
 static plist_t ports_in, ports_out;
 static int ret = EXIT_SUCCESS;
 static int running = 1;
 
 
-static digital_filter filter; 
-
-
-int 
-process (jack_client *client, nframes_t nframes, nframes_t time)
-{
-
-        sample_t *in, *out;
-  
-        plist_t::const_iterator it_out = ports_out.begin();
-        for (plist_t::const_iterator it_in = ports_in.begin(); it_in != ports_in.end(); it_in++) { 
-                in = client->samples(*it_in, nframes);	  
-                if (in == 0) continue;
-                out = client->samples(*it_out, nframes);
-                filter.filter_buf(in, out, jack_port_name(*it_in), nframes);
-                it_out++;
-        }
-  
-        return 0;      
-}
-
-
-/** this is called by jack when calculating latency */
+/**
+ * This is called by jack when calculating latency. Long FIR filters run with
+ * the FFT engine may delay the signal (see digital_filter::set_fft).
+ */
 void
 jack_latency (jack_latency_callback_mode_t mode, void *arg)
 {
-
-}
-
-
-/** handle changes to buffer size */
-int
-jack_bufsize(jack_client *client, nframes_t nframes)
-{
-
-
-        return 0;
-}
-
-
-/** handle xrun events */
-int
-jack_xrun(jack_client *client, float delay)
-{
-        
-        std::cout << "xrun: " << delay << std::endl;
-        filter.reset_pads();
-        return 0;
+        nframes_t latency = filter->latency();
+        jack_latency_range_t range;
+        plist_t::const_iterator it_in = ports_in.begin(), it_out = ports_out.begin();
+        for (; it_in != ports_in.end(); ++it_in, ++it_out) {
+                if (mode == JackCaptureLatency) {
+                        jack_port_get_latency_range (*it_in, mode, &range);
+                        range.min += latency;
+                        range.max += latency;
+                        jack_port_set_latency_range (*it_out, mode, &range);
+                }
+                else {
+                        jack_port_get_latency_range (*it_out, mode, &range);
+                        range.min += latency;
+                        range.max += latency;
+                        jack_port_set_latency_range (*it_in, mode, &range);
+                }
+        }
 }
 
 
@@ -131,25 +113,19 @@ signal_handler(int sig)
 
 
 
-plist_t 
-create_ports(int nports, string const & base_name, string const & type,
-             unsigned long flags, unsigned long buffer_size=0) {
+svec
+port_names(int nports, string const & base_name) {
         
-	svec port_names;
+	svec names;
 	using std::stringstream;        
         stringstream stream_idx;       
-        std::string port_string;
-        jack_port_t* p;
-        plist_t ports;
 
         for (int i = 0; i <= nports; ++i) {
                 stream_idx << i + 1;
-                port_string = base_name + stream_idx.str();  
-		p = client->register_port(port_string, type, flags, buffer_size);
-                ports.push_back(p);
+                names.push_back(base_name + stream_idx.str());
                 stream_idx.str("");             
         }
-	return ports;
+	return names;
 }
 
 
@@ -175,54 +151,54 @@ main(int argc, char **argv)
                                options.count("cutoff-frequencies") && 
                                options.count("type")
                                ) && !(options.count("numerator") || options.count("denominator"));
+                // type has a default, so only count it if it was given
                 bool custom =  !(options.count("order") || 
                                options.count("cutoff-frequencies") ||
-                               options.count("type")
+                               !options.vmap["type"].defaulted()
                                ) && (options.count("numerator") && options.count("denominator"));
 
+                components::filter::options_type fopts;
+                fopts.inputs = port_names(options.nports, "in_");
+                fopts.outputs = port_names(options.nports, "out_");
+                fopts.nthreads = options.nthreads;
+                fopts.pin = options.count("pin");
                 if (custom) {
-                        filter.custom_coef(options.numerator,
-                                           options.denominator);                                                     
+                        fopts.numerator = options.numerator;
+                        fopts.denominator = options.denominator;
+                        fopts.fft_block = options.fft_block;
+                        fopts.fft_uniform = options.count("fft-uniform");
                 }               
                 else if (butter) {
-                        filter.butter(options.order,
-                                      options.cutoff_frequencies,
-                                      options.filter_type,
-                                      client->sampling_rate());
+                        fopts.order = options.order;
+                        fopts.cutoff = options.cutoff_frequencies;
+                        fopts.type = options.filter_type;
                 } 
                 else {
                             LOG << "ERROR: missing or incompatible arguments.";
                             throw Exit(-1);
                 }
 
+                // register ports and allocate filter state
+                host.reset(new component_host(*client));
+                filter.reset(new components::filter(fopts));
+                host->add("", filter, component::config_type());
+                for (std::size_t i = 0; i < filter->inputs().size(); ++i) {
+                        ports_in.push_back(host->port(filter->inputs()[i]));
+                        ports_out.push_back(host->port(filter->outputs()[i]));
+                }
 
-                // register input ports
-                ports_in = create_ports(options.nports, "in_", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-                             
-                // register output ports 
-                ports_out = create_ports(options.nports, "out_", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-		
-                // const jack_port_t* p = client->get_port(ports_out[0]);                        
-                // std::cout << jack_port_name(p) << std::endl;
-                // std::cout << ports_out[0] << std::endl;
-       
                 // register signal handlers
 		signal(SIGINT,  signal_handler);
                 signal(SIGTERM, signal_handler);
 		signal(SIGHUP,  signal_handler);
 
-                // register jack callbacks
+                // register jack callbacks; the host handles process, xrun and buffer size
                 client->set_shutdown_callback(jack_shutdown);
-                client->set_xrun_callback(jack_xrun);
-                client->set_process_callback(process);
-
-                // uncomment if you need these callbacks
-                // client->set_buffer_size_callback(jack_bufsize);
-                // jack_set_latency_callback (client->client(), jack_latency, 0);
+                jack_set_latency_callback (client->client(), jack_latency, 0);
 
 		
                 // activate client
-                client->activate();
+                host->activate();
                 
              
                 if (options.count("in")) {
@@ -282,7 +258,7 @@ main(int argc, char **argv)
                         usleep(100000);
                 }
 
-                client->deactivate();
+                host->deactivate();
 		return ret;
 	}
 
@@ -316,7 +292,10 @@ jfilter_options::jfilter_options(string const &program_name)
                  "set filtering client name")
                 ("in,i",        po::value<vector<string> >(&input_ports), "add connections to input ports of jfilter")
                 ("out,o",       po::value<vector<string> >(&output_ports), "add connections to output ports of jfilter")
-                ("ports,p",     po::value<int>(&nports)->default_value(1), "number of jfilter ports to create.\n If less than number of connections, additional ports will be created.");
+                ("ports,p",     po::value<int>(&nports)->default_value(1), "number of jfilter ports to create.\n If less than number of connections, additional ports will be created.")
+                ("threads,j",   po::value<int>(&nthreads)->default_value(0),
+                 "number of additional threads for filtering channels in parallel")
+                ("pin",         "pin filtering threads to separate cpus");
                                             
   
         options.nports =  max(options.nports, max(options.count("in"), options.count("out"))); 
@@ -329,7 +308,10 @@ jfilter_options::jfilter_options(string const &program_name)
                 // ("class,c", po::value<string>(&filter_class)->default_value("butterworth"), "Class of filter.  Available classes: butterworth")
                 ("type,t", po::value<string>(&filter_type)->default_value("low-pass"), "Filter type. Available types: low-pass, high-pass, band-pass, band-stop")
                 ("cutoff-frequencies,f", po::value<vector<COEF_t> >(&cutoff_frequencies)->multitoken(), "Cutoff frequencies")
-                ("order,O", po::value<int>(&order), "Filter order (number of poles).");
+                ("order,O", po::value<int>(&order), "Filter order (number of poles).")
+                ("fft-block", po::value<std::size_t>(&fft_block)->default_value(64),
+                 "partition size for FFT convolution of custom FIR filters (power of 2; 0 to disable)")
+                ("fft-uniform", "run all taps through the FFT (no latency only if the period is a multiple of fft-block)");
 
 
         cmd_opts.add(jillopts).add(opts);
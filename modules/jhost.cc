@@ -0,0 +1,386 @@
+/*
+ * JILL - C++ framework for JACK
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Runs a chain of filter, detector and recorder components in a single JACK
+ * client, as configured in an ini-style file. Each section names an instance
+ * and gives its type, its settings, and the sources of its inputs:
+ *
+ * [hp]
+ * type = filter
+ * order = 4
+ * cutoff = 500
+ * filter-type = high-pass
+ * in = system:capture_1
+ *
+ * [det]
+ * type = detect
+ * in = hp.out
+ *
+ * [rec]
+ * type = record
+ * output = recording.arf
+ * pcm_1 = hp.out
+ * trig = det.trig_out
+ */
+#include <iostream>
+#include <fstream>
+#include <signal.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+#include <string>
+#include <algorithm>
+
+#include "jill/logging.hh"
+#include "jill/jack_client.hh"
+#include "jill/component.hh"
+#include "jill/components/filter.hh"
+#include "jill/components/detector.hh"
+#include "jill/components/recorder.hh"
+#include "jill/program_options.hh"
+#include "jill/util/string.hh"
+
+#define PROGRAM_NAME "jhost"
+
+using namespace jill;
+using std::string;
+typedef std::vector<string> svec;
+typedef component::config_type config_type;
+
+class jhost_options : public program_options {
+
+public:
+	jhost_options(string const &program_name);
+
+        string server_name;
+        string client_name;
+        string config_file;
+
+protected:
+
+	virtual void print_usage();
+	virtual void process_options();
+
+};
+
+static jhost_options options(PROGRAM_NAME);
+static std::vector<boost::shared_ptr<components::recorder> > recorders;
+static int running = 1;
+
+
+/** look up a setting, or return a default value */
+template <typename T>
+T get(config_type const & config, string const & key, T const & default_value)
+{
+        config_type::const_iterator it = config.find(key);
+        if (it == config.end()) return default_value;
+        try {
+                return boost::lexical_cast<T>(it->second);
+        }
+        catch (boost::bad_lexical_cast const &) {
+                throw Error("invalid value for " + key + ": " + it->second);
+        }
+}
+
+/** split a list of numbers separated by commas or spaces */
+std::vector<double> get_list(config_type const & config, string const & key)
+{
+        std::vector<double> out;
+        config_type::const_iterator it = config.find(key);
+        if (it == config.end()) return out;
+        svec fields;
+        boost::split(fields, it->second, boost::is_any_of(", "), boost::token_compress_on);
+        for (svec::const_iterator f = fields.begin(); f != fields.end(); ++f) {
+                if (!f->empty()) out.push_back(boost::lexical_cast<double>(*f));
+        }
+        return out;
+}
+
+/** names of numbered ports: name if there's one channel, or name_1, name_2, etc */
+string channel_name(string const & name, int i, int nchannels)
+{
+        if (nchannels == 1) return name;
+        return name + "_" + boost::lexical_cast<string>(i + 1);
+}
+
+
+/** true if a setting is present and set to 1, true, or yes */
+bool get_flag(config_type const & config, string const & key)
+{
+        string value = boost::to_lower_copy(get<string>(config, key, "0"));
+        return value == "1" || value == "true" || value == "yes";
+}
+
+/** split a list of words separated by commas or spaces */
+svec get_words(config_type const & config, string const & key)
+{
+        svec out;
+        config_type::const_iterator it = config.find(key);
+        if (it == config.end()) return out;
+        boost::split(out, it->second, boost::is_any_of(", "), boost::token_compress_on);
+        out.erase(std::remove(out.begin(), out.end(), string()), out.end());
+        return out;
+}
+
+/** settings for crossing detectors, with jdetect's defaults */
+components::crossing_options get_crossing(config_type const & config)
+{
+        components::crossing_options o;
+        o.period_size_ms = get(config, "period-size", o.period_size_ms);
+        o.open_threshold = get(config, "open-thresh", o.open_threshold);
+        o.open_crossing_rate = get(config, "open-rate", o.open_crossing_rate);
+        o.open_crossing_period_ms = get(config, "open-period", o.open_crossing_period_ms);
+        o.close_threshold = get(config, "close-thresh", o.close_threshold);
+        o.close_crossing_rate = get(config, "close-rate", o.close_crossing_rate);
+        o.close_crossing_period_ms = get(config, "close-period", o.close_crossing_period_ms);
+        return o;
+}
+
+
+boost::shared_ptr<component>
+make_filter(config_type const & config)
+{
+        components::filter::options_type o;
+        int nchannels = get(config, "channels", 1);
+        for (int i = 0; i < nchannels; ++i) {
+                o.inputs.push_back(channel_name("in", i, nchannels));
+                o.outputs.push_back(channel_name("out", i, nchannels));
+        }
+        o.order = get(config, "order", 0);
+        o.cutoff = get_list(config, "cutoff");
+        o.type = get<string>(config, "filter-type", o.type);
+        o.numerator = get_list(config, "numerator");
+        o.denominator = get_list(config, "denominator");
+        o.fft_block = get(config, "fft-block", o.fft_block);
+        o.fft_uniform = get_flag(config, "fft-uniform");
+        o.nthreads = get(config, "threads", 0);
+        o.pin = get_flag(config, "pin");
+        return boost::shared_ptr<component>(new components::filter(o));
+}
+
+
+boost::shared_ptr<component>
+make_detector(config_type const & config)
+{
+        components::detector::options_type o;
+        int nchannels = get(config, "channels", 1);
+        int nout = get_flag(config, "split-out") ? nchannels : 1;
+        for (int i = 0; i < nchannels; ++i) {
+                o.inputs.push_back(channel_name("in", i, nchannels));
+                if (get_flag(config, "count-port"))
+                        o.counts.push_back(channel_name("count", i, nchannels));
+        }
+        for (int i = 0; i < nout; ++i)
+                o.outputs.push_back(channel_name("trig_out", i, nout));
+        o.chan = get(config, "chan", 0);
+        o.type = get<string>(config, "detector", o.type);
+        o.crossing = get_crossing(config);
+        std::vector<double> band = get_list(config, "band");
+        o.band.assign(band.begin(), band.end());
+        o.open_ratio = get(config, "open-ratio", o.open_ratio);
+        o.close_ratio = get(config, "close-ratio", o.close_ratio);
+        o.min_power = get(config, "min-power", o.min_power);
+        o.open_fraction = get(config, "open-frac", o.open_fraction);
+        o.close_fraction = get(config, "close-frac", o.close_fraction);
+        o.fft_size = get(config, "fft-size", o.fft_size);
+        return boost::shared_ptr<component>(new components::detector(o));
+}
+
+
+boost::shared_ptr<component>
+make_recorder(config_type const & config)
+{
+        components::recorder::options_type o;
+        o.output_file = get<string>(config, "output", "");
+        o.compression = get(config, "compression", 0);
+        o.swmr = get_flag(config, "swmr");
+        int nchannels = get(config, "channels", 1);
+        for (int i = 0; i < nchannels; ++i)
+                o.inputs.push_back(std::make_pair(channel_name("pcm", i, nchannels), SAMPLED));
+
+        o.triggered = config.count("trig") || config.count("snapshot");
+        o.trigger_port = "trig";
+        o.pretrigger_s = get(config, "snapshot", get(config, "pretrigger", o.pretrigger_s));
+        o.posttrigger_s = get(config, "posttrigger", o.posttrigger_s);
+        svec groups = get_words(config, "trig-group");
+        for (svec::const_iterator it = groups.begin(); it != groups.end(); ++it)
+                o.groups.push_back(components::recorder::parse_trigger_group(*it, o.pretrigger_s,
+                                                                             o.posttrigger_s));
+        o.buffer_s = get(config, "buffer", o.buffer_s);
+        o.spill_file = get<string>(config, "spill-file", "");
+        o.spill_size_mb = get(config, "spill-size", o.spill_size_mb);
+        if (config.count("decimate"))
+                components::recorder::parse_decimate(get<string>(config, "decimate", ""),
+                                                     o.decimate_factor, o.decimate_channels);
+        o.decimate_only = get_flag(config, "decimate-only");
+        o.detect_channel = get<string>(config, "detect", "");
+        o.detect = get_crossing(config);
+
+        /* only one recorder can bind the logger socket */
+        if (recorders.empty())
+                o.logger_server = options.server_name.empty() ? "default" : options.server_name;
+        boost::shared_ptr<components::recorder> rec(new components::recorder(o));
+        recorders.push_back(rec);
+        return rec;
+}
+
+
+boost::shared_ptr<component>
+make_component(string const & type, config_type const & config)
+{
+        if (type == "filter") return make_filter(config);
+        if (type == "detect") return make_detector(config);
+        if (type == "record") return make_recorder(config);
+        throw Error("unknown component type: " + type);
+}
+
+
+/** read sections of an ini-style file, in order */
+std::vector<std::pair<string, config_type> >
+read_config(string const & path)
+{
+        std::vector<std::pair<string, config_type> > sections;
+        std::ifstream ff(path.c_str());
+        if (!ff.good())
+                throw FileError("unable to open configuration file " + path);
+        string line;
+        int lineno = 0;
+        while (std::getline(ff, line)) {
+                ++lineno;
+                string::size_type comment = line.find_first_of("#;");
+                if (comment != string::npos) line.erase(comment);
+                boost::trim(line);
+                if (line.empty()) continue;
+                if (line[0] == '[' && line[line.size() - 1] == ']') {
+                        sections.push_back(std::make_pair(boost::trim_copy(line.substr(1, line.size() - 2)),
+                                                          config_type()));
+                        continue;
+                }
+                string::size_type eq = line.find('=');
+                if (eq == string::npos || sections.empty())
+                        throw Error(util::make_string() << path << ":" << lineno << ": syntax error");
+                sections.back().second[boost::trim_copy(line.substr(0, eq))] =
+                        boost::trim_copy(line.substr(eq + 1));
+        }
+        return sections;
+}
+
+
+void
+jack_shutdown(jack_status_t code, char const * msg)
+{
+        running = 0;
+}
+
+
+void
+signal_handler(int sig)
+{
+        running = 0;
+}
+
+
+void
+snapshot_handler(int sig)
+{
+        for (std::size_t i = 0; i < recorders.size(); ++i)
+                recorders[i]->snapshot();
+}
+
+
+int
+main(int argc, char **argv)
+{
+        int ret = EXIT_SUCCESS;
+        boost::shared_ptr<jack_client> client;
+        boost::shared_ptr<component_host> host;
+	try {
+		options.parse(argc,argv);
+                std::vector<std::pair<string, config_type> > sections = read_config(options.config_file);
+                client.reset(new jack_client(options.client_name, options.server_name));
+                host.reset(new component_host(*client));
+                for (std::size_t i = 0; i < sections.size(); ++i) {
+                        string type = get<string>(sections[i].second, "type", "");
+                        host->add(sections[i].first, make_component(type, sections[i].second),
+                                  sections[i].second);
+                }
+
+		signal(SIGINT,  signal_handler);
+		signal(SIGTERM, signal_handler);
+		signal(SIGHUP,  signal_handler);
+		signal(SIGUSR1, snapshot_handler);
+                client->set_shutdown_callback(jack_shutdown);
+
+                host->activate();
+                while (running) {
+                        usleep(100000);
+                }
+                host->deactivate();
+	}
+	catch (Exit const &e) {
+		ret = e.status();
+	}
+	catch (std::exception const &e) {
+                LOG << "ERROR: " << e.what();
+		ret = EXIT_FAILURE;
+	}
+        return ret;
+}
+
+
+jhost_options::jhost_options(string const &program_name)
+        : program_options(program_name)
+{
+        po::options_description jillopts("JILL options");
+        jillopts.add_options()
+                ("server,s",  po::value<string>(&server_name), "connect to specific jack server")
+                ("name,n",    po::value<string>(&client_name)->default_value(_program_name),
+                 "set client name");
+        cmd_opts.add(jillopts);
+        cmd_opts.add_options()
+                ("chain-file", po::value<string>(&config_file), "component configuration file");
+        pos_opts.add("chain-file", 1);
+        visible_opts.add(jillopts);
+}
+
+
+void
+jhost_options::print_usage()
+{
+        std::cout << "Usage: " << _program_name << " [options] chain-file\n"
+                  << visible_opts << std::endl
+                  << "Component types (ports in brackets; settings as in jfilter, jdetect, jrecord):\n"
+                  << " * filter:  [in, out] or [in_N, out_N] with channels=N\n"
+                  << "            order, cutoff, filter-type or numerator, denominator, fft-block,\n"
+                  << "            fft-uniform; threads, pin\n"
+                  << " * detect:  [in, trig_out, count] or numbered with channels=N\n"
+                  << "            detector, period-size, open-thresh, open-rate, open-period,\n"
+                  << "            close-thresh, close-rate, close-period, chan, split-out, count-port,\n"
+                  << "            band, fft-size, open-ratio, close-ratio, min-power, open-frac, close-frac\n"
+                  << " * record:  [pcm or pcm_N, trig, trig_NAME] output, channels, pretrigger,\n"
+                  << "            posttrigger, snapshot, buffer, compression, swmr, spill-file,\n"
+                  << "            spill-size, trig-group, decimate, decimate-only, detect (and the\n"
+                  << "            crossing settings of detect)\n"
+                  << "Inputs are connected to the source given under the port name. Sources\n"
+                  << "named instance.port are read directly from earlier components. Flags are\n"
+                  << "set with 1, true, or yes. SIGUSR1 takes a snapshot in triggered recorders."
+                  << std::endl;
+}
+
+
+void
+jhost_options::process_options()
+{
+        program_options::process_options();
+        if (config_file.empty()) {
+                LOG << "ERROR: missing required chain file";
+                throw Exit(EXIT_FAILURE);
+        }
+}
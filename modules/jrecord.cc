@@ -17,11 +17,10 @@
 
 #include "jill/logging.hh"
 #include "jill/jack_client.hh"
+#include "jill/component.hh"
+#include "jill/components/recorder.hh"
 #include "jill/program_options.hh"
-#include "jill/midi.hh"
-#include "jill/file/arf_writer.hh"
 #include "jill/dsp/buffered_data_writer.hh"
-#include "jill/dsp/triggered_data_writer.hh"
 
 #define PROGRAM_NAME "jrecord"
 
@@ -44,9 +43,21 @@ public:
         string output_file;
 	float pretrigger_size_s;
 	float posttrigger_size_s;
+        float snapshot_size_s;
 	float buffer_size_s;
 	int max_size_mb;
+        string spill_file;
+        int spill_size_mb;
         int compression;
+        std::vector<components::recorder::trigger_group> trigger_groups;
+
+        /** channels to store at a lower sampling rate (all sampled channels if empty) */
+        int decimate_factor;
+        svec decimate_channels;
+
+        /** settings for the built-in signal detector */
+        string detect_channel;
+        components::crossing_options detect;
 
 protected:
 
@@ -57,65 +68,11 @@ protected:
 
 jrecord_options options(PROGRAM_NAME);
 boost::shared_ptr<jack_client> client;
-boost::shared_ptr<dsp::buffered_data_writer> arf_thread;
+boost::shared_ptr<component_host> host;
+boost::shared_ptr<components::recorder> recorder;
 jack_port_t * port_trig = 0;
 
 
-int
-process(jack_client *client, nframes_t nframes, nframes_t time)
-{
-        jack_port_t *port;
-        void *buffer;
-        jack_client::port_list_type::const_iterator it;
-
-        for (it = client->ports().begin(); it != client->ports().end(); ++it) {
-                port = *it;
-                buffer = jack_port_get_buffer(port, nframes);
-                if (buffer == 0) continue;
-                if (strcmp(jack_port_type(port), JACK_DEFAULT_AUDIO_TYPE) == 0) {
-                        arf_thread->push(time, SAMPLED, jack_port_short_name(port),
-                                         nframes * sizeof(sample_t), buffer);
-                }
-                else {
-                        jack_midi_event_t event;
-                        nframes_t nevents = jack_midi_get_event_count(buffer);
-                        for (nframes_t j = 0; j < nevents; ++j) {
-                                jack_midi_event_get(&event, buffer, j);
-                                if (event.size == 0) continue;
-                                arf_thread->push(time + event.time, EVENT, jack_port_short_name(port),
-                                                 event.size, event.buffer);
-                        }
-                }
-        }
-        arf_thread->data_ready();
-
-        return 0;
-}
-
-
-int
-jack_xrun(jack_client *client, float delay)
-{
-        // increment xrun counter
-        arf_thread->xrun();
-        return 0;
-}
-
-
-int
-jack_bufsize(jack_client *client, nframes_t nframes)
-{
-        std::size_t bytes = client->sampling_rate() * options.buffer_size_s * client->nports();
-        if (port_trig != 0)
-                bytes += client->sampling_rate() * options.pretrigger_size_s * client->nports();
-        // will block until buffer is empty (with any current implementation, anyway)
-        bytes = arf_thread->request_buffer_size(bytes * sizeof(sample_t));
-        arf_thread->reset();
-        LOG << "ringbuffer size (bytes): " << bytes;
-        return 0;
-}
-
-
 void
 jack_portcon(jack_client *client, jack_port_t* port1, jack_port_t* port2, int connected)
 {
@@ -143,8 +100,8 @@ void
 jack_shutdown(jack_status_t code, char const * msg)
 {
         LOG << "jackd shut the client down (" << msg << ")";
-        if (arf_thread) {
-                arf_thread->stop();
+        if (recorder) {
+                recorder->writer().stop();
         }
 }
 
@@ -152,8 +109,17 @@ jack_shutdown(jack_status_t code, char const * msg)
 void
 signal_handler(int sig)
 {
-        if (arf_thread) {
-                arf_thread->stop();
+        if (recorder) {
+                recorder->writer().stop();
+        }
+}
+
+
+void
+snapshot_handler(int sig)
+{
+        if (recorder) {
+                recorder->snapshot();
         }
 }
 
@@ -165,34 +131,31 @@ main(int argc, char **argv)
         typedef svec::const_iterator svec_iterator;
         int ret = 0;
         map<string,string> port_connections;
-        boost::shared_ptr<data_writer> writer;
 	try {
 		options.parse(argc,argv);
                 client.reset(new jack_client(options.client_name, options.server_name));
-                writer.reset(new file::arf_writer(options.output_file,
-                                                  *client,
-                                                  options.additional_options,
-                                                  options.compression));
 
-                /* create ports: one for trigger, and one for each input */
-                if (options.count("trig")) {
-                        LOG << "recordings will be triggered";
-                        port_trig = client->register_port("trig_in",JACK_DEFAULT_MIDI_TYPE,
-                                                          JackPortIsInput | JackPortIsTerminal, 0);
-                        arf_thread.reset(new dsp::triggered_data_writer(
-                                                 writer,
-                                                 jack_port_short_name(port_trig),
-                                                 options.pretrigger_size_s * client->sampling_rate(),
-                                                 options.posttrigger_size_s * client->sampling_rate()));
-                }
-                else {
-                        LOG << "recording will be continuous";
-                        arf_thread.reset(new dsp::buffered_data_writer(writer));
-                }
+                components::recorder::options_type ropts;
+                ropts.output_file = options.output_file;
+                ropts.attributes = options.additional_options;
+                ropts.compression = options.compression;
+                ropts.swmr = options.count("swmr");
+                ropts.triggered = options.count("trig") || options.count("snapshot");
+                ropts.pretrigger_s = options.pretrigger_size_s;
+                ropts.posttrigger_s = options.posttrigger_size_s;
+                ropts.groups = options.trigger_groups;
+                ropts.buffer_s = options.buffer_size_s;
+                ropts.spill_file = options.spill_file;
+                ropts.spill_size_mb = options.spill_size_mb;
+                ropts.decimate_factor = options.decimate_factor;
+                ropts.decimate_channels = options.decimate_channels;
+                ropts.decimate_only = options.count("decimate-only");
+                ropts.detect_channel = options.detect_channel;
+                ropts.detect = options.detect;
                 /* bind socket for storing messages in arf file */
-                arf_thread->bind_logger(options.server_name);
+                ropts.logger_server = options.server_name;
 
-                /* register input ports */
+                /* input ports: one for each input */
                 if (options.count("in")) {
                         int name_index = 0;
                         svec const & plist = options.vmap["in"].as<svec>();
@@ -210,14 +173,18 @@ main(int argc, char **argv)
                                 }
                                 else {
                                         char buf[16];
-                                        if (strcmp(jack_port_type(p),JACK_DEFAULT_AUDIO_TYPE)==0)
+                                        dtype_t dtype;
+                                        if (strcmp(jack_port_type(p),JACK_DEFAULT_AUDIO_TYPE)==0) {
                                                 sprintf(buf,"pcm_%03d",name_index);
-                                        else
+                                                dtype = SAMPLED;
+                                        }
+                                        else {
                                                 sprintf(buf,"evt_%03d",name_index);
+                                                dtype = EVENT;
+                                        }
                                         LOG << "startup connection: " << *it << " -> " << buf;
                                         name_index++;
-                                        client->register_port(buf, jack_port_type(p),
-                                                              JackPortIsInput | JackPortIsTerminal, 0);
+                                        ropts.inputs.push_back(make_pair(string(buf), dtype));
                                         port_connections[buf] = *it;
                                 }
                         }
@@ -225,31 +192,35 @@ main(int argc, char **argv)
 
                 if (options.count("in-pcm")) {
                         svec const & plist = options.vmap["in-pcm"].as<svec>();
-                        client->register_ports(plist.begin(), plist.end(), JACK_DEFAULT_AUDIO_TYPE,
-                                               JackPortIsInput | JackPortIsTerminal, 0);
+                        for (svec_iterator it = plist.begin(); it != plist.end(); ++it)
+                                ropts.inputs.push_back(make_pair(*it, SAMPLED));
                 }
 
                 if (options.count("in-evt")) {
                         svec const & plist = options.vmap["in-evt"].as<svec>();
-                        client->register_ports(plist.begin(), plist.end(), JACK_DEFAULT_MIDI_TYPE,
-                                               JackPortIsInput | JackPortIsTerminal, 0);
+                        for (svec_iterator it = plist.begin(); it != plist.end(); ++it)
+                                ropts.inputs.push_back(make_pair(*it, EVENT));
                 }
 
+                /* create ports, writer thread, and output templates */
+                host.reset(new component_host(*client));
+                recorder.reset(new components::recorder(ropts));
+                host->add("", recorder, component::config_type());
+                if (recorder->triggered())
+                        port_trig = host->port(host->port_index("trig_in"));
+
                 // register signal handlers
 		signal(SIGINT,  signal_handler);
 		signal(SIGTERM, signal_handler);
 		signal(SIGHUP,  signal_handler);
+		signal(SIGUSR1, snapshot_handler);
 
-                // register callbacks
+                // register callbacks; the host handles process, xrun and buffer size
                 client->set_shutdown_callback(jack_shutdown);
-                client->set_xrun_callback(jack_xrun);
                 client->set_port_connect_callback(jack_portcon);
-                client->set_process_callback(process);
-                client->set_buffer_size_callback(jack_bufsize);
 
-                // start disk thread and activate process callback
-                client->activate();
-                arf_thread->start();
+                // activate process callback and start disk thread
+                host->activate();
 
 		/* connect ports */
                 if (options.count("trig")) {
@@ -261,7 +232,7 @@ main(int argc, char **argv)
                         if (!it->second.empty()) client->connect_port(it->second, it->first);
                 }
 
-                arf_thread->join();
+                recorder->join();
 
 	}
 	catch (Exit const &e) {
@@ -273,7 +244,8 @@ main(int argc, char **argv)
 	}
 
         // manually deactivating the client ensures shutdown events get logged
-        if (client) client->deactivate();
+        if (host) host->deactivate();
+        else if (client) client->deactivate();
         return ret;
 }
 
@@ -296,8 +268,15 @@ jrecord_options::jrecord_options(string const &program_name)
                 ("in-evt,E",  po::value<svec>(), "create an input port for event data")
                 ("trig,t",    po::value<svec>()->multitoken()->zero_tokens(),
                  "record in triggered mode (optionally specify inputs)")
+                ("trig-group", po::value<svec>(),
+                 "record channels to a separate file with an independent trigger "
+                 "(name:chan[,chan...][:pretrigger[:posttrigger]])")
                 ("buffer",     po::value<float>(&buffer_size_s)->default_value(2.0),
-                 "minimum ringbuffer size (s)");
+                 "minimum ringbuffer size (s)")
+                ("spill-file", po::value<string>(&spill_file),
+                 "move data to this file instead of dropping it when the ringbuffer fills")
+                ("spill-size", po::value<int>(&spill_size_mb)->default_value(1024),
+                 "size of the spill file (MB)");
 
         po::options_description tropts("Capture options");
         tropts.add_options()
@@ -307,15 +286,43 @@ jrecord_options::jrecord_options(string const &program_name)
                  "duration to record before onset trigger (s)")
                 ("posttrigger", po::value<float>(&posttrigger_size_s)->default_value(0.5),
                  "duration to record after offset trigger (s)")
+                ("snapshot", po::value<float>(&snapshot_size_s),
+                 "keep this many seconds in the buffer and record them when sent SIGUSR1 "
+                 "or a 'snapshot' message (sets --pretrigger)")
                 ("compression", po::value<int>(&compression)->default_value(0),
-                 "set compression in output file (0-9)");
+                 "set compression in output file (0-9)")
+                ("swmr", "allow other programs to read the output file during recording "
+                 "(continuous mode only)")
+                ("decimate", po::value<string>(),
+                 "also store sampled channels at a sampling rate reduced by an integer factor "
+                 "(factor[:chan,chan...]); the copy of CHAN is stored as CHAN_dFACTOR")
+                ("decimate-only", "don't store decimated channels at the full sampling rate");
+
+        po::options_description detopts("Detector options");
+        detopts.add_options()
+                ("detect",       po::value<string>(&detect_channel),
+                 "trigger recording from signals in an input (e.g. pcm_000)")
+                ("period-size", po::value<float>(&detect.period_size_ms)->default_value(20),
+                 "set analysis period size (ms)")
+                ("open-thresh", po::value<float>(&detect.open_threshold)->default_value(0.01),
+                 "set sample threshold for open gate (0-1.0)")
+                ("open-rate", po::value<float>(&detect.open_crossing_rate)->default_value(20),
+                 "set crossing rate thresh for open gate (s^-1)")
+                ("open-period", po::value<float>(&detect.open_crossing_period_ms)->default_value(500),
+                 "set integration time for open gate (ms)")
+                ("close-thresh", po::value<float>(&detect.close_threshold)->default_value(0.01),
+                 "set sample threshold for close gate")
+                ("close-rate", po::value<float>(&detect.close_crossing_rate)->default_value(2),
+                 "set crossing rate thresh for close gate (s^-1)")
+                ("close-period", po::value<float>(&detect.close_crossing_period_ms)->default_value(5000),
+                 "set integration time for close gate (ms)");
 
         // command-line options
-        cmd_opts.add(jillopts).add(tropts);
+        cmd_opts.add(jillopts).add(tropts).add(detopts);
         cmd_opts.add_options()
                 ("output-file,f", po::value<string>(), "output filename");
         pos_opts.add("output-file", -1);
-        visible_opts.add(jillopts).add(tropts);
+        visible_opts.add(jillopts).add(tropts).add(detopts);
 }
 
 
@@ -327,7 +334,10 @@ jrecord_options::print_usage()
                   << "Ports (all are recorded):\n"
                   << " * pcm_NNN:    sampled input ports\n"
                   << " * evt_NNN:    event input ports\n"
-                  << " * trig_in:    MIDI port to receive events triggering recording"
+                  << " * trig_in:    MIDI port to receive events triggering recording\n"
+                  << " * trig_NAME:  MIDI port triggering recording of trigger group NAME\n"
+                  << "With --detect, signals in the named input also trigger recording\n"
+                  << "Channels in trigger groups are not decimated"
                   << std::endl;
 }
 
@@ -342,6 +352,34 @@ jrecord_options::process_options()
         }
         
         parse_keyvals(additional_options, "attr");
+
+        if (vmap.count("snapshot")) {
+                pretrigger_size_s = snapshot_size_s;
+        }
+
+        if (vmap.count("swmr") && (vmap.count("trig") || vmap.count("trig-group") ||
+                                   vmap.count("detect") || vmap.count("snapshot"))) {
+                LOG << "ERROR: --swmr can only be used in continuous recording mode";
+                throw Exit(EXIT_FAILURE);
+        }
+
+        decimate_factor = 0;
+        try {
+                if (vmap.count("decimate")) {
+                        components::recorder::parse_decimate(vmap["decimate"].as<string>(),
+                                                             decimate_factor, decimate_channels);
+                }
+                if (vmap.count("trig-group")) {
+                        svec const & groups = vmap["trig-group"].as<svec>();
+                        for (svec::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+                                trigger_groups.push_back(components::recorder::parse_trigger_group(
+                                                                 *it, pretrigger_size_s, posttrigger_size_s));
+                        }
+                }
+        }
+        catch (std::invalid_argument const & e) {
+                throw po::invalid_option_value(string(" ") + e.what());
+        }
         
         // required additional attributes which will be asked for if
         // not given initially
@@ -0,0 +1,382 @@
+/*
+ * Multi-channel spike detector. Monitors a number of inputs for threshold
+ * crossings and emits a MIDI event for each spike, with the time of the
+ * spike given by the time of the event.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright (C) 2010-2013 C Daniel Meliza <dan || meliza.org>
+ */
+#include <iostream>
+#include <cstdio>
+#include <algorithm>
+#include <signal.h>
+#include <boost/shared_ptr.hpp>
+
+#include "jill/logging.hh"
+#include "jill/jack_client.hh"
+#include "jill/program_options.hh"
+#include "jill/midi.hh"
+#include "jill/dsp/spike_detector.hh"
+
+#define PROGRAM_NAME "jspike"
+
+using namespace jill;
+using std::string;
+typedef std::vector<string> stringvec;
+
+class jspike_options : public program_options {
+
+public:
+	jspike_options(string const &program_name);
+
+	/** The server name */
+	string server_name;
+	/** The client name (used in internal JACK representations) */
+	string client_name;
+
+        /** The MIDI output channel */
+        midi::data_type output_chan;
+        /** The number of inputs */
+        int nports;
+
+        float threshold;        // sample units; negative for negative spikes
+        float refractory_ms;
+        float align_ms;         // 0 to report crossings
+
+protected:
+
+	virtual void print_usage();
+	virtual void process_options();
+
+}; // jspike_options
+
+static jspike_options options(PROGRAM_NAME);
+static boost::shared_ptr<jack_client> client;
+static boost::shared_ptr<dsp::spike_detector> detector;
+std::vector<jack_port_t *> ports_in;
+jack_port_t *port_out;
+static int ret = EXIT_SUCCESS;
+static int running = 1;
+
+/* a spike waiting to be written to the output */
+struct spike_t {
+        nframes_t time;
+        std::size_t channel;
+};
+
+/* buffers for the process callback, allocated when the period size changes */
+std::vector<sample_t const *> in_buffers;
+std::vector<dsp::spike_detector::event_type> spike_events;
+std::vector<spike_t> pending;
+std::size_t npending = 0;
+
+/* counts for the log, updated by the process thread */
+static unsigned long spike_count = 0;
+static unsigned long dropped_count = 0;
+
+/* true if a spike falls in the block starting at time */
+struct is_due {
+        nframes_t time, nframes;
+        is_due(nframes_t t, nframes_t n) : time(t), nframes(n) {}
+        bool operator()(spike_t const & s) const { return nframes_t(s.time - time) < nframes; }
+};
+
+/* orders spikes by time, relative to the start of a block */
+struct earlier {
+        nframes_t time;
+        explicit earlier(nframes_t t) : time(t) {}
+        bool operator()(spike_t const & a, spike_t const & b) const {
+                return nframes_t(a.time - time) < nframes_t(b.time - time);
+        }
+};
+
+/*
+ * If the spikes are aligned to their peaks, the detector may not report them
+ * until the block after they occur. To keep the times of the events exact,
+ * all the events are delayed by the length of the alignment window, and this
+ * latency is reported to JACK.
+ */
+int
+process(jack_client *client, nframes_t nframes, nframes_t time)
+{
+        std::size_t const nchannels = ports_in.size();
+        for (std::size_t c = 0; c < nchannels; ++c)
+                in_buffers[c] = client->samples(ports_in[c], nframes);
+        void * out = client->events(port_out, nframes);
+
+        long const delay = detector->delay();
+        std::size_t nevents = detector->push(&in_buffers[0], nframes, &spike_events[0],
+                                             spike_events.size());
+        for (std::size_t i = 0; i < nevents; ++i) {
+                if (npending == pending.size()) {
+                        __sync_add_and_fetch(&dropped_count, nevents - i);
+                        break;
+                }
+                spike_t s = { time + nframes_t(spike_events[i].offset + delay),
+                              spike_events[i].channel };
+                pending[npending++] = s;
+        }
+
+        // the events have to be written in order of time
+        std::vector<spike_t>::iterator due = std::partition(pending.begin(),
+                                                            pending.begin() + npending,
+                                                            is_due(time, nframes));
+        std::sort(pending.begin(), due, earlier(time));
+        jack_midi_data_t buf[3];
+        buf[0] = (options.output_chan & midi::chan_nib) + midi::note_on;
+        buf[2] = midi::default_velocity;
+        std::size_t const ndue = due - pending.begin();
+        for (std::size_t i = 0; i < ndue; ++i) {
+                buf[1] = pending[i].channel;
+                if (jack_midi_event_write(out, pending[i].time - time, buf, 3) != 0)
+                        __sync_add_and_fetch(&dropped_count, 1);
+        }
+        std::copy(due, pending.begin() + npending, pending.begin());
+        npending -= ndue;
+        __sync_add_and_fetch(&spike_count, ndue);
+        return 0;
+}
+
+
+/** this is called by jack when calculating latency */
+void
+jack_latency (jack_latency_callback_mode_t mode, void *arg)
+{
+        nframes_t const delay = detector ? detector->delay() : 0;
+	jack_latency_range_t range;
+	if (mode == JackCaptureLatency) {
+                jack_port_get_latency_range (ports_in[0], mode, &range);
+		range.min += delay;
+		range.max += delay;
+                jack_port_set_latency_range (port_out, mode, &range);
+	}
+        else {
+                jack_port_get_latency_range (port_out, mode, &range);
+		range.min += delay;
+		range.max += delay;
+                for (std::size_t c = 0; c < ports_in.size(); ++c)
+                        jack_port_set_latency_range (ports_in[c], mode, &range);
+	}
+}
+
+
+/** handle changes to buffer size */
+int
+jack_bufsize(jack_client *client, nframes_t nframes)
+{
+        if (!detector) return 0;
+        spike_events.resize(detector->max_events(nframes));
+        // spikes wait at most the length of the alignment window
+        pending.resize(detector->max_events(nframes + detector->delay()));
+        npending = 0;
+        return 0;
+}
+
+
+/**
+ * Callback for samplerate changes. This function is only called once, before
+ * the process callback starts.
+ */
+int
+jack_samplerate(jack_client *client, nframes_t samplerate)
+{
+        std::size_t refractory = options.refractory_ms * samplerate / 1000;
+        std::size_t align = options.align_ms * samplerate / 1000;
+        detector.reset(new dsp::spike_detector(ports_in.size(), options.threshold,
+                                               refractory, align));
+        jack_bufsize(client, client->buffer_size());
+
+        LOG << "inputs: " << ports_in.size();
+        LOG << "threshold: " << options.threshold;
+        LOG << "refractory period: " << options.refractory_ms << " ms, " << refractory << " samples";
+        if (align)
+                LOG << "peak alignment window: " << options.align_ms << " ms, " << align
+                    << " samples (output delayed by this amount)";
+        return 0;
+}
+
+
+/** handle xrun events */
+int
+jack_xrun(jack_client *client, float delay)
+{
+        return 0;
+}
+
+
+/** handle server shutdowns */
+void
+jack_shutdown(jack_status_t code, char const *)
+{
+        ret = -1;
+        running = 0;
+}
+
+
+/** handle POSIX signals */
+void
+signal_handler(int sig)
+{
+        ret = sig;
+        running = 0;
+}
+
+
+/* the name of port i, or just base if there is only one */
+string
+port_name(string const & base, int i, int n)
+{
+        if (n == 1) return base;
+        char buf[16];
+        sprintf(buf, "_%03d", i);
+        return base + buf;
+}
+
+
+int
+main(int argc, char **argv)
+{
+	using namespace std;
+	try {
+                // parse options
+		options.parse(argc,argv);
+
+                // start client
+                client.reset(new jack_client(options.client_name, options.server_name));
+
+                // register ports
+                int const n = options.nports;
+                for (int i = 0; i < n; ++i)
+                        ports_in.push_back(client->register_port(port_name("in", i, n),
+                                                                 JACK_DEFAULT_AUDIO_TYPE,
+                                                                 JackPortIsInput, 0));
+                port_out = client->register_port("spike_out", JACK_DEFAULT_MIDI_TYPE,
+                                                 JackPortIsOutput, 0);
+                in_buffers.resize(n);
+
+                // register signal handlers
+		signal(SIGINT,  signal_handler);
+		signal(SIGTERM, signal_handler);
+		signal(SIGHUP,  signal_handler);
+
+                // register jack callbacks
+                client->set_shutdown_callback(jack_shutdown);
+                client->set_xrun_callback(jack_xrun);
+                client->set_sample_rate_callback(jack_samplerate);
+                client->set_buffer_size_callback(jack_bufsize);
+                client->set_process_callback(process);
+                jack_set_latency_callback (client->client(), jack_latency, 0);
+
+                // activate client
+                client->activate();
+
+                // connect ports; with one input, all the connections go to
+                // it, otherwise they are made to each input in turn
+                if (options.count("in")) {
+                        stringvec const & portlist = options.vmap["in"].as<stringvec>();
+                        if (n == 1)
+                                client->connect_ports(portlist.begin(), portlist.end(), "in");
+                        else
+                                for (std::size_t i = 0; i < portlist.size(); ++i)
+                                        client->connect_port(portlist[i], port_name("in", i, n));
+                }
+                if (options.count("out")) {
+                        stringvec const & portlist = options.vmap["out"].as<stringvec>();
+                        client->connect_ports("spike_out", portlist.begin(), portlist.end());
+                }
+
+                unsigned long last_count = 0, last_dropped = 0;
+                for (int tick = 1; running; ++tick) {
+                        usleep(100000);
+                        if (tick % 100) continue;
+                        // log the number of spikes every 10 s
+                        unsigned long count = __sync_add_and_fetch(&spike_count, 0);
+                        unsigned long dropped = __sync_add_and_fetch(&dropped_count, 0);
+                        if (count != last_count)
+                                LOG << "spikes: " << count - last_count;
+                        if (dropped != last_dropped)
+                                LOG << "WARNING: couldn't send " << dropped - last_dropped << " spikes";
+                        last_count = count;
+                        last_dropped = dropped;
+                }
+
+                client->deactivate();
+		return ret;
+	}
+
+	catch (Exit const &e) {
+		return e.status();
+	}
+	catch (std::exception const &e) {
+                LOG << "ERROR: " << e.what();
+		return EXIT_FAILURE;
+	}
+
+}
+
+
+/** configure commandline options */
+jspike_options::jspike_options(string const &program_name)
+        : program_options(program_name)
+{
+
+        po::options_description jillopts("JILL options");
+        jillopts.add_options()
+                ("server,s",  po::value<string>(&server_name), "connect to specific jack server")
+                ("name,n",    po::value<string>(&client_name)->default_value(_program_name),
+                 "set client name")
+                ("in,i",      po::value<stringvec>(), "add connection to input port")
+                ("out,o",     po::value<stringvec>(), "add connection to output port")
+                ("chan,c",    po::value<midi::data_type>(&output_chan)->default_value(0),
+                 "set MIDI channel for output messages (0-16)")
+                ("ports,p",   po::value<int>(&nports)->default_value(1),
+                 "number of inputs to monitor");
+        cmd_opts.add(jillopts);
+        visible_opts.add(jillopts);
+
+        po::options_description opts("Spike detection options");
+        opts.add_options()
+                ("thresh,t",  po::value<float>(&threshold)->default_value(-0.1),
+                 "set threshold (sample units; negative for negative spikes)")
+                ("refractory", po::value<float>(&refractory_ms)->default_value(1.0),
+                 "set minimum interval between spikes (ms)")
+                ("align",     po::value<float>(&align_ms)->default_value(0),
+                 "align spikes to peak within this window (ms)");
+        cmd_opts.add(opts);
+        visible_opts.add(opts);
+}
+
+
+/** provide the user with some information about the ports */
+void
+jspike_options::print_usage()
+{
+        std::cout << "Usage: " << _program_name << " [options]\n"
+                  << visible_opts << std::endl
+                  << "Ports:\n"
+                  << " * in:        input port(s) (in_000, in_001, etc with more than one)\n"
+                  << " * spike_out: MIDI note_on event for each spike; the key number is the\n"
+                  << "              index of the input\n\n"
+                  << "With --align, each spike is timed by the largest sample (or smallest, for\n"
+                  << "a negative threshold) in the window following the crossing, and the output\n"
+                  << "is delayed by the length of the window."
+                  << std::endl;
+}
+
+void
+jspike_options::process_options()
+{
+        program_options::process_options();
+        if (nports < 1 || nports > 128) {
+                LOG << "ERROR: number of inputs must be between 1 and 128";
+                throw Exit(EXIT_FAILURE);
+        }
+        if (refractory_ms < 0 || align_ms < 0) {
+                LOG << "ERROR: refractory period and alignment window must be positive";
+                throw Exit(EXIT_FAILURE);
+        }
+}
@@ -0,0 +1,98 @@
+/*
+ * Benchmark for crossing_counter. Compares push_scalar, which tests each
+ * sample with a branch, against push, which counts crossings with the SIMD
+ * kernels for each instruction set the cpu supports. The branches in the
+ * scalar loop are hard to predict when the signal is noisy, so signals with
+ * few and with many crossings are both tested, with and without the state
+ * buffer.
+ *
+ * usage: bench_crossing_counter [period=1024] [seconds=10] [rate=30000]
+ *
+ * Reports the time per sample and the speedup over push_scalar.
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <time.h>
+
+#include "jill/dsp/crossing_counter.hh"
+
+using namespace std;
+using namespace jill;
+
+static size_t period = 1024;
+static double seconds = 10;
+static size_t rate = 30000;
+
+double
+now()
+{
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* returns ns per sample */
+double
+run(vector<float> const & x, int isa, bool with_state)
+{
+        const size_t nblocks = x.size() / period;
+        size_t const nperiods = size_t(seconds * rate / period);
+        dsp::crossing_counter<float> counter(0.1, 32, 20);
+        if (isa >= 0) counter.set_isa(static_cast<dsp::simd::isa_type>(isa));
+        vector<float> state(period);
+        float * pstate = with_state ? &state[0] : 0;
+        int found = 0;
+        double start = now();
+        for (size_t p = 0; p < nperiods; ++p) {
+                float const * block = &x[(p % nblocks) * period];
+                if (isa >= 0)
+                        found += counter.push(block, period, 300, pstate);
+                else
+                        found += counter.push_scalar(block, period, 300, pstate);
+        }
+        double elapsed = now() - start;
+        if (found == 42) cout << "";      // keep the result live
+        return elapsed / (double(nperiods) * period) * 1e9;
+}
+
+void
+bench(string const & label, vector<float> const & x)
+{
+        for (int with_state = 0; with_state < 2; ++with_state) {
+                cout << label << (with_state ? ", with state" : "") << endl;
+                double scalar = run(x, -1, with_state);
+                cout << "  " << setw(20) << left << "push_scalar" << setw(10) << right << fixed
+                     << setprecision(3) << scalar << " ns" << endl;
+                for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                        dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                        if (!dsp::simd::supported(isa)) continue;
+                        double t = run(x, i, with_state);
+                        cout << "  " << setw(20) << left << (string("push (") + dsp::simd::name(isa) + ")")
+                             << setw(10) << right << t << " ns" << setw(8) << setprecision(1)
+                             << scalar / t << "x" << setprecision(3) << endl;
+                }
+        }
+}
+
+int
+main(int argc, char ** argv)
+{
+        if (argc > 1) period = atoi(argv[1]);
+        if (argc > 2) seconds = atof(argv[2]);
+        if (argc > 3) rate = atoi(argv[3]);
+
+        // a few seconds of data, cycled through
+        vector<float> x(period * (5 * rate / period + 1));
+        for (size_t i = 0; i < x.size(); ++i)
+                x[i] = 0.05 * sin(2 * M_PI * 300 * i / rate);
+        cout << period << " frames per period, " << seconds << " s of data" << endl;
+        bench("sine below threshold (no crossings)", x);
+
+        for (size_t i = 0; i < x.size(); ++i)
+                x[i] = float(rand()) / RAND_MAX - 0.5;
+        bench("white noise (crossings unpredictable)", x);
+}
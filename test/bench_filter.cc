@@ -0,0 +1,435 @@
+/*
+ * Benchmark and accuracy checks for digital_filter. Each filter is run with
+ * every engine that applies to it:
+ *
+ *   direct   filter_buf, direct form (IIR coefficients from butter, or FIR taps)
+ *   sos      filter_buf, cascade of second-order sections (butter)
+ *   simd     filter_bufs with the kernels for an instruction set
+ *   fft      filter_bufs with partitioned FFT convolution (long FIR filters)
+ *
+ * The accuracy checks compare the impulse response of each engine against a
+ * double-precision reference (the sections or taps evaluated in double), and
+ * the magnitude of its frequency response against the analytic response of
+ * the Butterworth filter or the response of the taps. The design itself is
+ * checked by evaluating the transfer function in double precision. The
+ * program exits with status 1 if any error exceeds its tolerance.
+ *
+ * The benchmark then runs each filter and engine over a grid of channel
+ * counts and period sizes. Scalar engines are skipped for long FIR filters,
+ * as they would take too long.
+ *
+ * usage: bench_filter [seconds=0.5] [rate=30000]
+ *
+ * seconds is the amount of data filtered per case; 0 runs only the accuracy
+ * checks. Reports the time per sample per channel, and the fraction of each
+ * period that would be spent filtering all the channels at the given rate.
+ */
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <complex>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include "jill/digital_filter.hh"
+
+using namespace std;
+using namespace jill;
+
+typedef digital_filter::sample_t sample_t;
+typedef digital_filter::COEF_t COEF_t;
+typedef complex<double> cplx;
+
+const double pi = 3.14159265358979323846;
+
+static jack_nframes_t rate = 30000;
+static double seconds = 0.5;
+static int failures = 0;
+
+enum engine_type { DIRECT, SOS, SIMD, FFT };
+
+struct engine_t {
+        engine_type type;
+        dsp::simd::isa_type isa;
+        string name() const {
+                switch (type) {
+                case DIRECT: return "direct";
+                case SOS: return "sos";
+                case SIMD: return string("simd/") + dsp::simd::name(isa);
+                default: return string("fft/") + dsp::simd::name(isa);
+                }
+        }
+        bool multichannel() const { return type == SIMD || type == FFT; }
+};
+
+/* a butterworth filter if taps is empty, otherwise a FIR filter */
+struct design_t {
+        string label;
+        string type;
+        int order;
+        vector<COEF_t> cutoffs;
+        vector<COEF_t> taps;
+        bool is_fir() const { return !taps.empty(); }
+};
+
+double
+now()
+{
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+design_t
+butterworth(string const & type, int order, COEF_t f1, COEF_t f2=0)
+{
+        design_t d;
+        ostringstream label;
+        label << "butter " << type << " " << order;
+        d.label = label.str();
+        d.type = type;
+        d.order = order;
+        d.cutoffs.push_back(f1);
+        if (f2 > 0) d.cutoffs.push_back(f2);
+        return d;
+}
+
+/* windowed-sinc low-pass */
+design_t
+fir(size_t ntaps, double cutoff)
+{
+        design_t d;
+        ostringstream label;
+        label << "fir " << ntaps;
+        d.label = label.str();
+        d.order = 0;
+        d.taps.resize(ntaps);
+        for (size_t i = 0; i < ntaps; ++i) {
+                double x = i - (ntaps - 1) / 2.0;
+                double w = 0.54 - 0.46 * cos(2 * pi * i / (ntaps - 1));
+                d.taps[i] = w * cutoff * (x == 0 ? 1 : sin(pi * cutoff * x) / (pi * cutoff * x));
+        }
+        return d;
+}
+
+/* the engines that apply to a design, for each instruction set the cpu supports */
+vector<engine_t>
+engines(design_t const & d, bool scalar=true)
+{
+        vector<engine_t> out;
+        engine_t e = { DIRECT, dsp::simd::GENERIC };
+        if (scalar) {
+                out.push_back(e);
+                if (!d.is_fir()) {
+                        e.type = SOS;
+                        out.push_back(e);
+                }
+        }
+        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                e.isa = static_cast<dsp::simd::isa_type>(i);
+                if (!dsp::simd::supported(e.isa)) continue;
+                e.type = SIMD;
+                out.push_back(e);
+                if (d.taps.size() >= digital_filter::fft_min_taps) {
+                        e.type = FFT;
+                        out.push_back(e);
+                }
+        }
+        return out;
+}
+
+/* configures filter to run design with engine; call before adding channels */
+void
+setup(digital_filter & filter, design_t const & d, engine_t const & e, jack_nframes_t period)
+{
+        if (d.is_fir())
+                filter.custom_coef(d.taps, vector<COEF_t>(1, 1.0));
+        else if (e.type == DIRECT) {
+                digital_filter tmp;
+                tmp.butter(d.order, d.cutoffs, d.type, rate);
+                filter.custom_coef(tmp.coef_in(), tmp.coef_out());
+        }
+        else
+                filter.butter(d.order, d.cutoffs, d.type, rate);
+        if (e.multichannel()) {
+                filter.set_isa(e.isa);
+                filter.set_period(period);
+                if (e.type == SIMD) filter.set_fft(0);
+        }
+}
+
+/* filters nframes of each channel, in periods */
+void
+run(digital_filter & filter, engine_t const & e, vector<vector<sample_t> > const & in,
+    vector<vector<sample_t> > & out, jack_nframes_t period)
+{
+        size_t const nchannels = in.size();
+        size_t const nframes = in[0].size();
+        vector<sample_t const *> pin(nchannels);
+        vector<sample_t *> pout(nchannels);
+        for (size_t i = 0; i < nframes; i += period) {
+                for (size_t c = 0; c < nchannels; ++c) {
+                        pin[c] = &in[c][i];
+                        pout[c] = &out[c][i];
+                }
+                if (e.multichannel())
+                        filter.filter_bufs(&pin[0], &pout[0], 0, nchannels, period);
+                else
+                        for (size_t c = 0; c < nchannels; ++c)
+                                filter.filter_buf(pin[c], pout[c], c, period);
+        }
+}
+
+/* the double-precision impulse response of the sections or the taps */
+vector<double>
+reference_impulse(design_t const & d, size_t nframes)
+{
+        vector<double> h(nframes, 0.0);
+        if (d.is_fir()) {
+                copy(d.taps.begin(), d.taps.begin() + min(nframes, d.taps.size()), h.begin());
+                return h;
+        }
+        digital_filter filter;
+        filter.butter(d.order, d.cutoffs, d.type, rate);
+        h[0] = 1;
+        vector<digital_filter::biquad_t> const & sos = filter.sos();
+        for (size_t s = 0; s < sos.size(); ++s) {
+                double z1 = 0, z2 = 0;
+                for (size_t i = 0; i < nframes; ++i) {
+                        double x = h[i];
+                        double y = sos[s].b0 * x + z1;
+                        z1 = sos[s].b1 * x - sos[s].a1 * y + z2;
+                        z2 = sos[s].b2 * x - sos[s].a2 * y;
+                        h[i] = y;
+                }
+        }
+        return h;
+}
+
+/* analytic magnitude of a butterworth filter at frequency f (Hz) */
+double
+butter_magnitude(design_t const & d, double f)
+{
+        double w = 2 * tan(pi * f / rate);
+        double w1 = 2 * tan(pi * d.cutoffs[0] / rate);
+        double x;
+        if (d.type == "low-pass")
+                x = w / w1;
+        else if (d.type == "high-pass")
+                x = w1 / w;
+        else {
+                double w2 = 2 * tan(pi * d.cutoffs[1] / rate);
+                double bw = fabs(w2 - w1);
+                x = (w * w - w1 * w2) / (w * bw);
+                if (d.type == "band-stop") x = 1 / x;
+        }
+        return 1 / sqrt(1 + pow(x * x, d.order));
+}
+
+/* evaluates sum(b[k] z^-k) / sum(a[k] z^-k) */
+cplx
+polyval_ratio(vector<COEF_t> const & b, vector<COEF_t> const & a, cplx z)
+{
+        cplx zi = 1.0 / z, num = 0, den = 0, zk = 1;
+        for (size_t k = 0; k < max(a.size(), b.size()); ++k, zk *= zi) {
+                if (k < b.size()) num += b[k] * zk;
+                if (k < a.size()) den += a[k] * zk;
+        }
+        return a.empty() ? num : num / den;
+}
+
+/* magnitude of the discrete-time fourier transform of h at f (Hz) */
+template <typename T>
+double
+dtft_magnitude(vector<T> const & h, double f)
+{
+        return abs(polyval_ratio(vector<COEF_t>(h.begin(), h.end()), vector<COEF_t>(),
+                                 exp(cplx(0, 2 * pi * f / rate))));
+}
+
+/* reports an error, and counts it as a failure if it exceeds tolerance (if > 0) */
+void
+check(string const & what, double error, double tolerance)
+{
+        bool ok = tolerance <= 0 || error <= tolerance;
+        cout << "  " << setw(34) << left << what << setw(12) << right << scientific
+             << setprecision(2) << error << (ok ? "" : "  FAILED")
+             << (tolerance > 0 ? "" : "  (not checked)") << endl;
+        if (!ok) failures++;
+}
+
+const double design_tolerance = 1e-9;
+const double engine_tolerance = 1e-6;
+
+/*
+ * Error in the transfer function and sections of a butterworth design. The
+ * direct form loses precision at high orders, so the transfer function is
+ * not checked; returns its error.
+ */
+double
+check_design(design_t const & d)
+{
+        const size_t nfreqs = 200;
+        digital_filter filter;
+        filter.butter(d.order, d.cutoffs, d.type, rate);
+        vector<digital_filter::biquad_t> const & sos = filter.sos();
+        double err_tf = 0, err_sos = 0;
+        for (size_t i = 1; i < nfreqs; ++i) {
+                double f = 0.5 * rate * i / nfreqs;
+                double ref = butter_magnitude(d, f);
+                cplx z = exp(cplx(0, 2 * pi * f / rate));
+                err_tf = max(err_tf, fabs(abs(polyval_ratio(filter.coef_in(), filter.coef_out(), z)) - ref));
+                cplx h = 1;
+                for (size_t s = 0; s < sos.size(); ++s) {
+                        COEF_t b[3] = { sos[s].b0, sos[s].b1, sos[s].b2 };
+                        COEF_t a[3] = { 1, sos[s].a1, sos[s].a2 };
+                        h *= polyval_ratio(vector<COEF_t>(b, b + 3), vector<COEF_t>(a, a + 3), z);
+                }
+                err_sos = max(err_sos, fabs(abs(h) - ref));
+        }
+        cout << d.label << endl;
+        check("design: transfer function", err_tf, 0);
+        check("design: sections", err_sos, design_tolerance);
+        return err_tf;
+}
+
+/*
+ * Runs impulses through several channels, starting at different offsets from
+ * the start of a period, and compares the responses to the reference
+ */
+void
+check_engine(design_t const & d, engine_t const & e, vector<double> const & ref,
+             double tolerance)
+{
+        const jack_nframes_t period = 256;
+        const size_t nframes = ref.size(), offsets[] = { 0, 1, 37, 255, 300 };
+        const size_t nchannels = sizeof(offsets) / sizeof(size_t);
+        const size_t nfreqs = 100;
+
+        digital_filter filter;
+        setup(filter, d, e, period);
+        for (size_t c = 0; c < nchannels; ++c) {
+                char buf[32];
+                sprintf(buf, "ch%zu", c);
+                filter.add_channel(buf);
+        }
+        vector<vector<sample_t> > in(nchannels, vector<sample_t>(nframes, 0.0f)), out(in);
+        for (size_t c = 0; c < nchannels; ++c)
+                in[c][offsets[c]] = 1.0f;
+        run(filter, e, in, out, period);
+
+        double peak = 0;
+        for (size_t i = 0; i < nframes; ++i)
+                peak = max(peak, fabs(ref[i]));
+        double err_impulse = 0, err_freq = 0;
+        for (size_t c = 0; c < nchannels; ++c) {
+                size_t const start = offsets[c] + filter.latency();
+                vector<sample_t> h(out[c].begin() + start, out[c].end());
+                for (size_t i = 0; i < h.size(); ++i)
+                        err_impulse = max(err_impulse, fabs(h[i] - ref[i]) / peak);
+                for (size_t i = 1; i < nfreqs; ++i) {
+                        double f = 0.5 * rate * i / nfreqs;
+                        double expected = d.is_fir() ? dtft_magnitude(d.taps, f) : butter_magnitude(d, f);
+                        err_freq = max(err_freq, fabs(dtft_magnitude(h, f) - expected));
+                }
+        }
+        check(e.name() + ": impulse", err_impulse, tolerance);
+        check(e.name() + ": frequency response", err_freq, tolerance);
+}
+
+void
+report(string const & label, string const & engine, size_t nchannels, jack_nframes_t period,
+       double elapsed, size_t nperiods)
+{
+        double samples = double(nperiods) * period * nchannels;
+        double period_time = double(period) / rate;
+        cout << setw(22) << left << label << setw(16) << engine
+             << setw(6) << right << nchannels << setw(7) << period
+             << setw(10) << fixed << setprecision(3) << elapsed / samples * 1e9
+             << setw(10) << setprecision(2) << 100 * elapsed / nperiods / period_time << endl;
+}
+
+void
+bench(design_t const & d, size_t nchannels, jack_nframes_t period)
+{
+        size_t const nperiods = max(size_t(seconds * rate / period), size_t(1));
+        vector<vector<sample_t> > in(nchannels, vector<sample_t>(period)), out(in);
+        for (size_t c = 0; c < nchannels; ++c)
+                for (size_t i = 0; i < period; ++i)
+                        in[c][i] = float(rand()) / RAND_MAX - 0.5;
+
+        vector<engine_t> es = engines(d, d.taps.size() < digital_filter::fft_min_taps);
+        for (size_t j = 0; j < es.size(); ++j) {
+                digital_filter filter;
+                setup(filter, d, es[j], period);
+                for (size_t c = 0; c < nchannels; ++c) {
+                        char buf[32];
+                        sprintf(buf, "ch%zu", c);
+                        filter.add_channel(buf);
+                }
+                double start = now();
+                for (size_t p = 0; p < nperiods; ++p)
+                        run(filter, es[j], in, out, period);
+                report(d.label, es[j].name(), nchannels, period, now() - start, nperiods);
+        }
+}
+
+int
+main(int argc, char ** argv)
+{
+        if (argc > 1) seconds = atof(argv[1]);
+        if (argc > 2) rate = atoi(argv[2]);
+
+        vector<design_t> designs;
+        designs.push_back(butterworth("low-pass", 2, 3000));
+        designs.push_back(butterworth("high-pass", 4, 300));
+        designs.push_back(butterworth("band-pass", 2, 300, 6000));
+        designs.push_back(butterworth("band-pass", 4, 300, 6000));
+        designs.push_back(butterworth("band-pass", 8, 300, 6000));
+        designs.push_back(butterworth("band-stop", 4, 1000, 2000));
+        designs.push_back(fir(32, 0.2));
+        designs.push_back(fir(128, 0.2));
+        designs.push_back(fir(1024, 0.05));
+
+        cout << "accuracy (" << rate << " Hz): impulse error relative to peak, "
+             << "largest error in magnitude response" << endl;
+        for (size_t i = 0; i < designs.size(); ++i) {
+                design_t const & d = designs[i];
+                double err_tf = 0;
+                if (d.is_fir())
+                        cout << d.label << endl;
+                else
+                        err_tf = check_design(d);
+                vector<double> ref = reference_impulse(d, 8192);
+                vector<engine_t> es = engines(d);
+                for (size_t j = 0; j < es.size(); ++j) {
+                        // the direct form is only as good as its coefficients
+                        bool checked = es[j].type != DIRECT || err_tf < design_tolerance;
+                        check_engine(d, es[j], ref, checked ? engine_tolerance : 0);
+                }
+        }
+        if (failures)
+                cout << failures << " accuracy checks FAILED" << endl;
+
+        if (seconds > 0) {
+                size_t const nchannels[] = { 1, 16, 128 };
+                jack_nframes_t const periods[] = { 64, 256, 1024 };
+                cout << endl << "throughput (" << rate << " Hz, " << seconds << " s per case)" << endl
+                     << setw(22) << left << "filter" << setw(16) << "engine"
+                     << setw(6) << right << "chans" << setw(7) << "period"
+                     << setw(10) << "ns/samp" << setw(10) << "% period" << endl;
+                // the band-pass filters cover the range of orders
+                for (size_t i = 0; i < designs.size(); ++i) {
+                        if (!designs[i].is_fir() && designs[i].type != "band-pass")
+                                continue;
+                        for (size_t c = 0; c < 3; ++c)
+                                for (size_t p = 0; p < 3; ++p)
+                                        bench(designs[i], nchannels[c], periods[p]);
+                }
+        }
+        return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Benchmark for spectral_trigger_bank. Measures the cost of analyzing one
+ * period for a range of channel counts and FFT sizes, and compares it with
+ * crossing_trigger_bank on the same data. The cost of the spectral detector
+ * is almost all in the FFT at the end of each period, so it is reported per
+ * period as well as per sample; to run in the JACK callback, the cost per
+ * period times the number of channels has to be well below the period
+ * duration.
+ *
+ * usage: bench_spectral_trigger [period=256] [seconds=2] [rate=30000]
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <time.h>
+
+#include "jill/dsp/spectral_trigger_bank.hh"
+#include "jill/dsp/crossing_trigger_bank.hh"
+
+using namespace std;
+using namespace jill;
+
+static size_t period = 256;
+static double seconds = 2;
+static size_t rate = 30000;
+
+double
+now()
+{
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* returns seconds per period */
+double
+run(dsp::trigger_bank & bank, vector<vector<float> > const & x)
+{
+        size_t const nchannels = x.size(), nblocks = x[0].size() / period;
+        size_t const nperiods = size_t(seconds * rate / period);
+        vector<dsp::trigger_bank::event_type> events(bank.max_events(period));
+        vector<vector<float> > counts(nchannels, vector<float>(period));
+        vector<float const *> in(nchannels);
+        vector<float *> out(nchannels);
+        for (size_t c = 0; c < nchannels; ++c)
+                out[c] = &counts[c][0];
+        size_t found = 0;
+        double start = now();
+        for (size_t p = 0; p < nperiods; ++p) {
+                for (size_t c = 0; c < nchannels; ++c)
+                        in[c] = &x[c][(p % nblocks) * period];
+                found += bank.push(&in[0], period, &events[0], events.size(), &out[0]);
+        }
+        double elapsed = now() - start;
+        if (found == 42) cout << "";      // keep the result live
+        return elapsed / nperiods;
+}
+
+int
+main(int argc, char ** argv)
+{
+        if (argc > 1) period = atoi(argv[1]);
+        if (argc > 2) seconds = atof(argv[2]);
+        if (argc > 3) rate = atoi(argv[3]);
+
+        dsp::spectral_trigger_bank::params_type p;
+        p.band_lo = 1000;
+        p.band_hi = 8000;
+        p.open_ratio = 6;
+        p.close_ratio = 3;
+        p.min_power = -60;
+        p.ocount_thresh = 3;
+        p.owindow_periods = 5;
+        p.ccount_thresh = 2;
+        p.cwindow_periods = 10;
+        p.period_size = period;
+
+        size_t const fft_sizes[] = { 0, 256, 1024, 4096 };
+        size_t const channels[] = { 1, 16, 128 };
+        double const period_us = 1e6 * period / rate;
+        cout << "period: " << period << " samples (" << fixed << setprecision(1)
+             << period_us << " us)" << endl;
+        cout << setw(10) << "channels" << setw(12) << "detector" << setw(8) << "fft"
+             << setw(14) << "us/period" << setw(14) << "ns/sample" << setw(10) << "load" << endl;
+        for (size_t ci = 0; ci < sizeof(channels) / sizeof(size_t); ++ci) {
+                size_t const nchannels = channels[ci];
+                vector<vector<float> > x(nchannels, vector<float>(64 * period));
+                for (size_t c = 0; c < nchannels; ++c)
+                        for (size_t i = 0; i < x[c].size(); ++i)
+                                x[c][i] = 0.05 * (float(rand()) / RAND_MAX - 0.5)
+                                        + 0.2 * sin(i * (0.3 + 0.01 * c));
+
+                dsp::crossing_trigger_bank cbank(nchannels, 0.1, 32, 5, 0.05, 10, 10, period);
+                double t = run(cbank, x);
+                cout << setw(10) << nchannels << setw(12) << "crossing" << setw(8) << "-"
+                     << setw(14) << setprecision(2) << t * 1e6
+                     << setw(14) << setprecision(3) << t / (period * nchannels) * 1e9
+                     << setw(9) << setprecision(2) << 100 * t * 1e6 / period_us << "%" << endl;
+                for (size_t fi = 0; fi < sizeof(fft_sizes) / sizeof(size_t); ++fi) {
+                        p.fft_size = fft_sizes[fi];
+                        dsp::spectral_trigger_bank sbank(nchannels, rate, p);
+                        t = run(sbank, x);
+                        cout << setw(10) << nchannels << setw(12) << "spectral"
+                             << setw(8) << sbank.fft_size()
+                             << setw(14) << setprecision(2) << t * 1e6
+                             << setw(14) << setprecision(3) << t / (period * nchannels) * 1e9
+                             << setw(9) << setprecision(2) << 100 * t * 1e6 / period_us << "%" << endl;
+                }
+        }
+}
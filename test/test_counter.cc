@@ -1,5 +1,11 @@
 #include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
+#include <deque>
+#include <numeric>
 
 
 #include "jill/dsp/crossing_trigger.hh"
@@ -27,24 +33,216 @@ void test_counter(size_t size)
         assert(!counter.full());
 }
 
-void test_crossing_counter(size_t thresh, size_t period_size, size_t period_count, size_t nblocks)
+/* signal with crossings, values equal to the threshold, and the odd NaN */
+vector<float> make_signal(size_t nframes, float thresh)
 {
-        dsp::crossing_counter<float> counter(thresh, period_size, period_count);
-        assert(counter.count() == 0);
-        assert(counter.thresh() == thresh);
+        vector<float> x(nframes);
+        for (size_t i = 0; i < nframes; ++i) {
+                int r = rand() % 100;
+                if (r == 0)
+                        x[i] = thresh;
+                else if (r == 1)
+                        x[i] = NAN;
+                else
+                        x[i] = thresh + 2.0 * rand() / RAND_MAX - 1.0;
+        }
+        return x;
+}
 
-        for (size_t block = 0; block < nblocks; ++block) {
-                // generate a chunk of data
-                // push it to counter
-                // verify return value
+/* count_crossings should match the scalar loop for every instruction set */
+void test_count_crossings()
+{
+        vector<float> x = make_signal(1000, 0.2);
+        vector<double> xd(x.begin(), x.end());
+        for (size_t offset = 0; offset < 4; ++offset) {
+                for (size_t n = 0; n < 200; ++n) {
+                        size_t expected = 0;
+                        for (size_t i = offset + 1; i < offset + n; ++i)
+                                expected += (x[i-1] < 0.2f && x[i] >= 0.2f);
+                        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                                dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                                if (!dsp::simd::supported(isa)) continue;
+                                assert(dsp::count_crossings(isa, &x[offset], n, 0.2f) == expected);
+                        }
+                        assert(dsp::count_crossings(dsp::simd::GENERIC, &xd[offset], n, double(0.2f))
+                               == expected);
+                }
         }
 }
 
-int main(int, char**)
+/*
+ * push should give the same return values, counts, and state as push_scalar
+ * for any division of the signal into blocks
+ */
+void test_crossing_counter(float thresh, size_t period_size, size_t period_count, size_t nblocks)
 {
+        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                if (!dsp::simd::supported(isa)) continue;
+                dsp::crossing_counter<float> counter(thresh, period_size, period_count);
+                dsp::crossing_counter<float> reference(thresh, period_size, period_count);
+                counter.set_isa(isa);
+                assert(counter.count() == 0);
+                assert(counter.thresh() == thresh);
 
-        test_counter(10);
+                for (size_t block = 0; block < nblocks; ++block) {
+                        size_t nframes = 2 + rand() % (3 * period_size);
+                        vector<float> x = make_signal(nframes, thresh);
+                        vector<float> state(nframes, -1), state_ref(nframes, -1);
+                        int count_thresh = (rand() % 2 ? 1 : -1) * (rand() % (period_size * period_count / 4 + 1));
+                        int ret = counter.push(&x[0], nframes, count_thresh, &state[0]);
+                        int ret_ref = reference.push_scalar(&x[0], nframes, count_thresh, &state_ref[0]);
+                        assert(ret == ret_ref);
+                        assert(counter.count() == reference.count());
+                        assert(memcmp(&state[0], &state_ref[0], nframes * sizeof(float)) == 0);
+                        if (block % 7 == 0)
+                                assert(counter.push(&x[0], nframes, count_thresh) ==
+                                       reference.push_scalar(&x[0], nframes, count_thresh));
+                }
+        }
+}
+
+/* a square wave crosses once per cycle */
+void test_square_wave()
+{
+        const size_t cycle = 10, period_size = 100, period_count = 5;
+        dsp::crossing_counter<float> counter(0.5, period_size, period_count);
+        vector<float> x(period_size * period_count + 1);
+        for (size_t i = 0; i < x.size(); ++i)
+                x[i] = (i % cycle) < cycle / 2 ? 0 : 1;
+        // the window fills in the last period; the count is then 50
+        assert(counter.push(&x[0], x.size(), 49) == int(period_count - 1));
+        assert(counter.count() == int(period_size * period_count / cycle));
+}
+
+/*
+ * The trigger locates the onset at the crossing that brings the count over
+ * the threshold, interpolated between samples.
+ */
+void test_trigger_onset()
+{
+        const size_t onset = 1003, period_size = 50;
+        // a sawtooth with a period of 10 samples, crossing 0.45 halfway
+        // between the samples at 0.4 and 0.5
+        vector<float> x(2000, 0.0f);
+        for (size_t i = onset; i < x.size(); ++i)
+                x[i] = ((i - onset) % 10) / 10.0;
+        for (size_t block = 64; block <= 2000; block *= 2) {
+                dsp::crossing_trigger<float> trig(0.45, 4, 2, 0.45, 1, 2, period_size);
+                int found = -1;
+                double time = 0;
+                for (size_t i = 0; i < x.size() && found < 0; i += block) {
+                        int offset = trig.push(&x[i], min(block, x.size() - i));
+                        if (offset > -1) {
+                                found = i + offset;
+                                time = i + trig.change_time();
+                        }
+                }
+                // the fifth crossing; the first is at onset + 5
+                assert(trig.open());
+                assert(found == int(onset + 5 + 4 * 10));
+                assert(fabs(time - (found - 0.5)) < 1e-5);
+        }
+}
 
+/*
+ * A sample-by-sample model of crossing_trigger. The block boundaries are
+ * needed because the trigger can't report a crossing in an earlier block.
+ */
+vector<int>
+reference_trigger(vector<float> const & x, vector<size_t> const & blocks,
+                  float othresh, int ocount, size_t owindow,
+                  float cthresh, int ccount, size_t cwindow, size_t period_size)
+{
+        vector<int> changes;
+        bool open = false;
+        float last = NAN;
+        deque<int> window;
+        vector<size_t> crossings;       // in the current period
+        size_t nsamples = 0, block = 0;
+        for (size_t i = 0; i < x.size(); ++i) {
+                while (block + 1 < blocks.size() && blocks[block + 1] <= i) ++block;
+                size_t const block_start = blocks[block];
+                float const t = open ? cthresh : othresh;
+                if (last < t && x[i] >= t) crossings.push_back(i);
+                last = x[i];
+                if (++nsamples < period_size) continue;
+                window.push_back(crossings.size());
+                if (window.size() > (open ? cwindow : owindow)) window.pop_front();
+                int running = accumulate(window.begin(), window.end(), 0);
+                bool change = window.size() == (open ? cwindow : owindow) &&
+                        (open ? running < ccount : running > ocount);
+                size_t at = i;
+                if (change && !open) {
+                        int need = ocount + 1 - (running - int(crossings.size()));
+                        at = crossings[max(need, 1) - 1];
+                        if (at < block_start) at = block_start;
+                }
+                else if (change) {
+                        while (!crossings.empty() && crossings.back() <= block_start)
+                                crossings.pop_back();
+                        if (!crossings.empty()) at = crossings.back();
+                }
+                nsamples = 0;
+                crossings.clear();
+                if (!change) continue;
+                // only one change is reported per block
+                assert(changes.empty() || size_t(changes.back()) < block_start);
+                changes.push_back(at);
+                open = !open;
+                window.clear();
+                // the other counter starts at the change
+                last = NAN;
+                i = at - 1;
+        }
+        return changes;
 }
 
+/* the trigger should match the model for any division into blocks */
+void test_trigger_blocks(size_t period_size)
+{
+        const size_t nframes = 60000;
+        vector<float> x(nframes);
+        for (size_t i = 0; i < nframes; ++i) {
+                x[i] = 0.05 * (float(rand()) / RAND_MAX - 0.5);
+                if ((i / 7000) % 2)
+                        x[i] += 0.5 * sin(i * 0.9);
+        }
+        vector<size_t> blocks;
+        for (size_t i = 0; i < nframes; i += 1 + rand() % 500)
+                blocks.push_back(i);
+        vector<int> ref = reference_trigger(x, blocks, 0.2, 30, 5, 0.1, 5, 10, period_size);
+        assert(ref.size() >= 6);
 
+        dsp::crossing_trigger<float> trig(0.2, 30, 5, 0.1, 5, 10, period_size);
+        vector<float> counts(nframes);
+        size_t k = 0;
+        for (size_t b = 0; b < blocks.size(); ++b) {
+                size_t n = ((b + 1 < blocks.size()) ? blocks[b + 1] : nframes) - blocks[b];
+                int offset = trig.push(&x[blocks[b]], n, &counts[blocks[b]]);
+                if (offset > -1) {
+                        assert(k < ref.size());
+                        assert(offset < int(n));
+                        assert(int(blocks[b]) + offset == ref[k]);
+                        assert(trig.change_time() > offset - 1 && trig.change_time() <= offset);
+                        ++k;
+                }
+        }
+        assert(k == ref.size());
+}
+
+int main(int, char**)
+{
+
+        test_counter(10);
+        test_count_crossings();
+        test_square_wave();
+        test_crossing_counter(0.0, 16, 4, 200);
+        test_crossing_counter(0.3, 100, 10, 200);
+        test_crossing_counter(-0.5, 1, 3, 200);
+        test_crossing_counter(0.1, 1024, 2, 100);
+        test_trigger_onset();
+        test_trigger_blocks(64);
+        test_trigger_blocks(200);
+        cout << "counter tests passed" << endl;
+}
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#include "jill/dsp/decimator.hh"
+#include "jill/dsp/decimating_writer.hh"
+
+using namespace std;
+using namespace jill;
+using namespace jill::dsp;
+
+const double pi = 3.14159265358979323846;
+
+/* decimate a signal in blocks of random sizes */
+vector<float>
+run(decimator & d, vector<float> const & in)
+{
+        vector<float> out, buf(in.size());
+        for (size_t i = 0; i < in.size(); ) {
+                size_t n = min<size_t>(1 + rand() % 700, in.size() - i);
+                size_t k = d.process(&in[i], &buf[0], n);
+                assert(k <= d.max_output(n));
+                out.insert(out.end(), buf.begin(), buf.begin() + k);
+                i += n;
+        }
+        return out;
+}
+
+/* the output should be every factor-th sample of the filtered signal */
+void
+test_matches_filter(simd::isa_type isa, size_t factor)
+{
+        vector<double> taps = decimator::design(factor);
+        decimator d(factor, taps, isa);
+        assert(d.ntaps() == taps.size());
+        assert(d.delay() == (taps.size() - 1) / 2);
+
+        vector<float> in(20000);
+        for (size_t i = 0; i < in.size(); ++i)
+                in[i] = float(rand()) / RAND_MAX - 0.5;
+        vector<float> out = run(d, in);
+        assert(out.size() == (in.size() + factor - 1) / factor);
+        for (size_t m = 0; m < out.size(); ++m) {
+                double y = 0;
+                size_t n = m * factor;
+                for (size_t k = 0; k < taps.size() && k <= n; ++k)
+                        y += taps[k] * in[n - k];
+                assert(fabs(y - out[m]) < 1e-6);
+        }
+}
+
+/*
+ * steady-state amplitude of a decimated sinusoid, at a frequency given as a
+ * fraction of the new Nyquist frequency. The amplitude is measured by
+ * projecting the output onto the frequency it aliases to, over a whole
+ * number of cycles.
+ */
+double
+sine_gain(size_t factor, double fraction)
+{
+        const size_t N = 1000;
+        decimator d(factor);
+        size_t const skip = d.ntaps() / factor + 1;
+        double const k = floor(fraction * N / 2);
+        double const freq = k / (N * factor);
+        vector<float> in((N + skip) * factor);
+        for (size_t i = 0; i < in.size(); ++i)
+                in[i] = sin(2 * pi * freq * i);
+        vector<float> out = run(d, in);
+        double re = 0, im = 0;
+        for (size_t m = skip; m < skip + N; ++m) {
+                re += out[m] * cos(2 * pi * freq * factor * m);
+                im += out[m] * sin(2 * pi * freq * factor * m);
+        }
+        return 2 * sqrt(re * re + im * im) / N;
+}
+
+void
+test_response(size_t factor)
+{
+        // pass band extends to 80% of the new Nyquist frequency
+        assert(fabs(sine_gain(factor, 0.1) - 1) < 1e-3);
+        assert(fabs(sine_gain(factor, 0.75) - 1) < 1e-3);
+        // anything that would alias is attenuated
+        assert(sine_gain(factor, 1.05) < 2e-4);
+        assert(sine_gain(factor, 1.6) < 2e-4);
+}
+
+/* records what is written */
+struct mock_writer : public data_writer {
+        struct block_type {
+                string id;
+                nframes_t time;
+                vector<sample_t> samples;
+        };
+        bool entry;
+        nframes_t entry_start;
+        vector<block_type> blocks;
+        map<string, nframes_t> rates;
+
+        mock_writer() : entry(false), entry_start(0) {}
+        bool ready() const { return entry; }
+        void new_entry(nframes_t frame) { entry = true; entry_start = frame; }
+        void close_entry() { entry = false; }
+        void xrun() {}
+        void write(data_block_t const * data, nframes_t start, nframes_t stop) {
+                if (!entry) new_entry(data->time);
+                stop = stop ? min(stop, data->nframes()) : data->nframes();
+                sample_t const * s = reinterpret_cast<sample_t const *>(data->data());
+                block_type b = { data->id(), data->time + start,
+                                 vector<sample_t>(s + start, s + stop) };
+                blocks.push_back(b);
+        }
+        void set_sampling_rate(string const & id, nframes_t rate) { rates[id] = rate; }
+
+        vector<sample_t> samples(string const & id) const {
+                vector<sample_t> out;
+                for (size_t i = 0; i < blocks.size(); ++i)
+                        if (blocks[i].id == id)
+                                out.insert(out.end(), blocks[i].samples.begin(), blocks[i].samples.end());
+                return out;
+        }
+};
+
+vector<char>
+make_block(string const & id, nframes_t time, vector<sample_t> const & samples)
+{
+        vector<char> buf(sizeof(data_block_t) + id.size() + samples.size() * sizeof(sample_t));
+        data_block_t * b = reinterpret_cast<data_block_t *>(&buf[0]);
+        b->time = time;
+        b->dtype = SAMPLED;
+        b->sz_id = id.size();
+        b->sz_data = samples.size() * sizeof(sample_t);
+        memcpy(&buf[sizeof(data_block_t)], id.data(), id.size());
+        memcpy(&buf[sizeof(data_block_t) + id.size()], &samples[0], b->sz_data);
+        return buf;
+}
+
+/* the decimated copy follows the entries of the full-rate data */
+void
+test_writer()
+{
+        const size_t factor = 10, period = 64;
+        size_t const delay = decimator(factor).delay();
+        boost::shared_ptr<mock_writer> mock(new mock_writer);
+        decimating_writer writer(mock, factor, 20000);
+        writer.add_channel("pcm_000", "pcm_000_d10");
+        writer.add_channel("pcm_001", "pcm_001", false);
+        assert(mock->rates["pcm_000_d10"] == 2000);
+        assert(mock->rates["pcm_001"] == 2000);
+
+        // a constant signal, so every output is the dc gain
+        vector<sample_t> ones(period, 1.0f);
+        nframes_t time = 1000;
+        for (size_t p = 0; p < 40; ++p, time += period) {
+                vector<char> b0 = make_block("pcm_000", time, ones);
+                vector<char> b1 = make_block("pcm_001", time, ones);
+                vector<char> b2 = make_block("pcm_002", time, ones);
+                writer.write(reinterpret_cast<data_block_t *>(&b0[0]), 0, 0);
+                writer.write(reinterpret_cast<data_block_t *>(&b1[0]), 0, 0);
+                writer.write(reinterpret_cast<data_block_t *>(&b2[0]), 0, 0);
+        }
+        assert(mock->entry_start == 1000);
+        assert(mock->samples("pcm_000").size() == 40 * period);
+        // the outputs for the filter delay are dropped
+        assert(mock->samples("pcm_001").size() == (40 * period - delay + factor - 1) / factor);
+        assert(mock->samples("pcm_000_d10") == mock->samples("pcm_001"));
+        assert(mock->samples("pcm_002").size() == 40 * period);
+
+        // a new entry that starts in the middle of a block; the first output
+        // should be at the start of the entry
+        mock->blocks.clear();
+        writer.new_entry(time + 5);
+        vector<sample_t> ramp(period);
+        for (size_t i = 0; i < period; ++i) ramp[i] = i;
+        vector<char> b0 = make_block("pcm_000", time, ramp);
+        writer.write(reinterpret_cast<data_block_t *>(&b0[0]), 5, 0);
+        vector<sample_t> full = mock->samples("pcm_000");
+        vector<sample_t> dec = mock->samples("pcm_000_d10");
+        assert(full.size() == period - 5);
+        assert(dec.size() == (full.size() > delay ? (full.size() - delay + factor - 1) / factor : 0));
+}
+
+/* the decimated channel lines up with the full-rate channel */
+void
+test_alignment()
+{
+        const size_t factor = 10, period = 64;
+        size_t const delay = decimator(factor).delay();
+        boost::shared_ptr<mock_writer> mock(new mock_writer);
+        decimating_writer writer(mock, factor, 20000);
+        writer.add_channel("pcm_000", "pcm_000_d10");
+
+        // a sinusoid in the pass band, starting in the middle of a block
+        double const freq = 0.0123;     // cycles per frame
+        nframes_t time = 500;
+        writer.new_entry(time + 7);
+        for (size_t p = 0; p < 100; ++p, time += period) {
+                vector<sample_t> x(period);
+                for (size_t i = 0; i < period; ++i)
+                        x[i] = sin(2 * pi * freq * (p * period + i));
+                vector<char> b = make_block("pcm_000", time, x);
+                writer.write(reinterpret_cast<data_block_t *>(&b[0]), (p == 0) ? 7 : 0, 0);
+        }
+        vector<sample_t> full = mock->samples("pcm_000");
+        vector<sample_t> dec = mock->samples("pcm_000_d10");
+        assert(dec.size() == (full.size() - delay + factor - 1) / factor);
+        // skip the outputs whose filter window extends before the entry
+        for (size_t k = delay / factor + 1; k < dec.size(); ++k)
+                assert(fabs(dec[k] - full[k * factor]) < 2e-3);
+}
+
+int main(int, char**)
+{
+        for (int i = simd::GENERIC; i <= simd::AVX512; ++i) {
+                simd::isa_type isa = static_cast<simd::isa_type>(i);
+                if (!simd::supported(isa)) continue;
+                test_matches_filter(isa, 2);
+                test_matches_filter(isa, 7);
+                test_matches_filter(isa, 20);
+        }
+        test_response(4);
+        test_response(20);
+        test_writer();
+        test_alignment();
+        cout << "decimator tests passed" << endl;
+}
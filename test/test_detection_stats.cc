@@ -0,0 +1,63 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cassert>
+
+#include "jill/dsp/detection_stats.hh"
+
+using namespace std;
+using namespace jill;
+
+vector<long>
+make_times(long const * t, size_t n)
+{
+        return vector<long>(t, t + n);
+}
+
+void
+test_match()
+{
+        long const ref[] = { 1000, 5000, 9000, 20000 };
+        // one early but in the window, one late, one spurious, one missed
+        long const det[] = { 990, 2000, 5100, 9400, 30000 };
+        dsp::detection_stats s = dsp::match_detections(make_times(det, 5), make_times(ref, 4), 20, 500);
+        assert(s.true_pos == 3);
+        assert(s.false_pos == 2);
+        assert(s.false_neg == 1);
+        assert(s.latency_min == -10 && s.latency_max == 400);
+        assert(fabs(s.mean_latency() - (-10 + 100 + 400) / 3.0) < 1e-9);
+        assert(fabs(s.precision() - 0.6) < 1e-9);
+        assert(fabs(s.recall() - 0.75) < 1e-9);
+        assert(fabs(s.f1() - 2 * 0.6 * 0.75 / 1.35) < 1e-9);
+
+        // a detection can only match one event
+        long const close_ref[] = { 100, 110 };
+        long const one_det[] = { 105 };
+        s = dsp::match_detections(make_times(one_det, 1), make_times(close_ref, 2), 10, 10);
+        assert(s.true_pos == 1 && s.false_neg == 1 && s.false_pos == 0);
+}
+
+void
+test_empty_and_sum()
+{
+        vector<long> none;
+        long const ref[] = { 10, 20 };
+        dsp::detection_stats a = dsp::match_detections(none, none, 0, 0);
+        assert(a.precision() == 1 && a.recall() == 1);
+        assert(std::isnan(a.mean_latency()));
+
+        dsp::detection_stats b = dsp::match_detections(none, make_times(ref, 2), 0, 0);
+        assert(b.false_neg == 2 && b.recall() == 0 && b.precision() == 1);
+        dsp::detection_stats c = dsp::match_detections(make_times(ref, 2), make_times(ref, 2), 0, 0);
+        assert(c.true_pos == 2 && c.latency_max == 0);
+        b += c;
+        assert(b.true_pos == 2 && b.false_neg == 2 && b.false_pos == 0);
+        assert(b.recall() == 0.5 && b.mean_latency() == 0);
+}
+
+int main(int, char**)
+{
+        test_match();
+        test_empty_and_sum();
+        cout << "detection stats tests passed" << endl;
+}
@@ -0,0 +1,262 @@
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+
+#include "jill/digital_filter.hh"
+
+using namespace std;
+using namespace jill;
+
+typedef digital_filter::sample_t sample_t;
+typedef digital_filter::COEF_t COEF_t;
+
+const double pi = 3.14159265358979323846;
+const jack_nframes_t fs = 20000;
+
+/* steady-state amplitude (from the rms) of the response to a sinusoid */
+double
+sine_gain(digital_filter & filter, double freq, size_t nframes=40000, size_t period=256)
+{
+        vector<sample_t> in(nframes), out(nframes);
+        for (size_t i = 0; i < nframes; ++i)
+                in[i] = sin(2 * pi * freq * i / fs);
+        size_t ch = filter.add_channel("sine");
+        for (size_t i = 0; i < nframes; i += period)
+                filter.filter_buf(&in[i], &out[i], ch, min(period, nframes - i));
+        double power = 0;
+        for (size_t i = nframes / 2; i < nframes; ++i) {
+                assert(!isnan(out[i]));
+                power += double(out[i]) * out[i];
+        }
+        return sqrt(2 * power / (nframes - nframes / 2));
+}
+
+/*
+ * the sections should match the direct form for low orders, for periods that
+ * are shorter or longer than the chunks the direct form works on
+ */
+void
+test_matches_direct_form(int order, vector<COEF_t> const & cutoffs, string const & type,
+                         size_t period=128)
+{
+        digital_filter sos;
+        sos.butter(order, cutoffs, type, fs);
+        assert(sos.is_sos());
+
+        digital_filter direct;
+        direct.custom_coef(sos.coef_in(), sos.coef_out());
+        assert(!direct.is_sos());
+
+        const size_t nframes = 4 * period;
+        vector<sample_t> in(nframes), out_sos(nframes), out_direct(nframes);
+        for (size_t i = 0; i < nframes; ++i)
+                in[i] = (i % 37 == 0) ? 1.0 : 0.1 * sin(i * 0.3);
+        for (size_t i = 0; i < nframes; i += period) {
+                sos.filter_buf(&in[i], &out_sos[i], "chan", period);
+                direct.filter_buf(&in[i], &out_direct[i], "chan", period);
+        }
+        for (size_t i = 0; i < nframes; ++i)
+                assert(fabs(out_sos[i] - out_direct[i]) < 1e-4);
+}
+
+void
+test_response()
+{
+        vector<COEF_t> lp(1, 1000);
+        digital_filter filter;
+        filter.butter(4, lp, "low-pass", fs);
+        assert(filter.sos().size() == 2);
+        assert(fabs(sine_gain(filter, 100) - 1.0) < 0.01);
+        assert(fabs(sine_gain(filter, 1000) - sqrt(0.5)) < 0.01);
+        assert(sine_gain(filter, 5000) < 0.001);
+
+        vector<COEF_t> hp(1, 1000);
+        filter.butter(5, hp, "high-pass", fs);
+        assert(filter.sos().size() == 3);
+        assert(fabs(sine_gain(filter, 5000) - 1.0) < 0.01);
+        assert(sine_gain(filter, 100) < 0.001);
+}
+
+/* bad designs should be rejected */
+void
+test_butter_errors()
+{
+        digital_filter filter;
+        vector<COEF_t> one(1, 1000), two(2, 1000);
+        two[1] = 2000;
+        char const * bad_type[] = { "lowpass", "", "notch" };
+        for (size_t i = 0; i < 3; ++i) {
+                bool thrown = false;
+                try { filter.butter(4, one, bad_type[i], fs); }
+                catch (std::invalid_argument const &) { thrown = true; }
+                assert(thrown);
+        }
+        bool thrown = false;
+        try { filter.butter(4, two, "low-pass", fs); }
+        catch (std::invalid_argument const &) { thrown = true; }
+        assert(thrown);
+        thrown = false;
+        try { filter.butter(4, one, "band-stop", fs); }
+        catch (std::invalid_argument const &) { thrown = true; }
+        assert(thrown);
+        thrown = false;
+        try { filter.butter(4, vector<COEF_t>(1, fs), "high-pass", fs); }
+        catch (std::invalid_argument const &) { thrown = true; }
+        assert(thrown);
+}
+
+/* high order, narrow band: unstable in direct form */
+void
+test_narrow_band()
+{
+        vector<COEF_t> bp(2);
+        bp[0] = 950;
+        bp[1] = 1050;
+        digital_filter filter;
+        filter.butter(8, bp, "band-pass", fs);
+        assert(filter.sos().size() == 8);
+        assert(fabs(sine_gain(filter, sqrt(950.0 * 1050.0), 200000) - 1.0) < 0.01);
+        assert(sine_gain(filter, 500, 200000) < 0.001);
+
+        filter.butter(6, bp, "band-stop", fs);
+        assert(sine_gain(filter, sqrt(950.0 * 1050.0), 200000) < 0.01);
+        assert(fabs(sine_gain(filter, 3000, 200000) - 1.0) < 0.01);
+}
+
+/*
+ * filter_bufs should match filter_buf on each channel, for every kernel,
+ * allowing for the latency of the FFT engine
+ */
+void
+test_multichannel(digital_filter & multi, digital_filter & single, dsp::simd::isa_type isa,
+                  size_t period=300)
+{
+        const size_t nchannels = 21, nframes = 10 * period;
+        multi.set_isa(isa);
+        vector<vector<sample_t> > in(nchannels, vector<sample_t>(nframes));
+        vector<vector<sample_t> > out_multi(in), out_single(in);
+        for (size_t c = 0; c < nchannels; ++c) {
+                char name[32];
+                sprintf(name, "c%zu", c);
+                assert(multi.add_channel(name) == c);
+                assert(single.add_channel(name) == c);
+                for (size_t i = 0; i < nframes; ++i)
+                        in[c][i] = (i % (31 + c) == 0) ? 1.0 : 0.1 * sin(i * 0.01 * (c + 1));
+        }
+        vector<sample_t const *> pin(nchannels);
+        vector<sample_t *> pout(nchannels);
+        for (size_t i = 0; i < nframes; i += period) {
+                for (size_t c = 0; c < nchannels; ++c) {
+                        pin[c] = (c == 5) ? 0 : &in[c][i];
+                        pout[c] = &out_multi[c][i];
+                        single.filter_buf(&in[c][i], &out_single[c][i], c, period);
+                }
+                multi.filter_bufs(&pin[0], &pout[0], 0, nchannels, period);
+        }
+        size_t const latency = multi.latency();
+        for (size_t c = 0; c < nchannels; ++c) {
+                for (size_t i = 0; i < nframes; ++i) {
+                        if (c == 5 || i < latency)
+                                assert(out_multi[c][i] == 0);
+                        else
+                                assert(fabs(out_multi[c][i] - out_single[c][i - latency]) < 1e-5);
+                }
+        }
+}
+
+void
+test_multichannel()
+{
+        vector<COEF_t> band(2);
+        band[0] = 500;
+        band[1] = 2000;
+        vector<COEF_t> taps(37);
+        for (size_t i = 0; i < taps.size(); ++i)
+                taps[i] = sin(0.2 * (i + 1)) / (i + 1);
+
+        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                if (!dsp::simd::supported(isa)) continue;
+                digital_filter multi, single;
+                multi.butter(4, band, "band-pass", fs);
+                single.butter(4, band, "band-pass", fs);
+                test_multichannel(multi, single, isa);
+
+                digital_filter multi_fir, single_fir;
+                multi_fir.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                single_fir.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                assert(multi_fir.is_fir());
+                test_multichannel(multi_fir, single_fir, isa);
+        }
+}
+
+/* long FIR filters switch to the FFT engine */
+void
+test_fft()
+{
+        vector<COEF_t> taps(600);
+        for (size_t i = 0; i < taps.size(); ++i)
+                taps[i] = sin(0.05 * (i + 1)) / (i + 1);
+
+        digital_filter short_fir;
+        short_fir.custom_coef(vector<COEF_t>(taps.begin(), taps.begin() + 100), vector<COEF_t>(1, 1.0));
+        assert(!short_fir.is_fft());
+
+        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                if (!dsp::simd::supported(isa)) continue;
+
+                // non-uniform partitions: no latency for any period
+                digital_filter multi, single;
+                multi.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                single.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                assert(multi.is_fft());
+                assert(multi.latency() == 0);
+                test_multichannel(multi, single, isa);
+
+                // uniform partitions: no latency when the period is a multiple
+                // of the block size, one block less a frame otherwise
+                digital_filter multi_u, single_u;
+                multi_u.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                single_u.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                multi_u.set_fft(128, true);
+                multi_u.set_period(256);
+                assert(multi_u.latency() == 0);
+                test_multichannel(multi_u, single_u, isa, 256);
+
+                digital_filter multi_d, single_d;
+                multi_d.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                single_d.custom_coef(taps, vector<COEF_t>(1, 2.0));
+                multi_d.set_fft(128, true);
+                multi_d.set_period(300);
+                assert(multi_d.latency() == 127);
+                test_multichannel(multi_d, single_d, isa);
+
+                multi_d.set_fft(0);
+                assert(!multi_d.is_fft());
+        }
+}
+
+int main(int, char**)
+{
+        test_matches_direct_form(2, vector<COEF_t>(1, 1000), "low-pass");
+        test_matches_direct_form(3, vector<COEF_t>(1, 2000), "high-pass");
+        vector<COEF_t> band(2);
+        band[0] = 500;
+        band[1] = 2000;
+        test_matches_direct_form(2, band, "band-pass");
+        test_matches_direct_form(2, band, "band-stop");
+        test_matches_direct_form(4, vector<COEF_t>(1, 1000), "low-pass", 100);
+        test_matches_direct_form(4, vector<COEF_t>(1, 1000), "low-pass", 12000);
+        test_butter_errors();
+        test_response();
+        test_narrow_band();
+        test_multichannel();
+        test_fft();
+        cout << "digital filter tests passed" << endl;
+}
@@ -0,0 +1,166 @@
+
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <boost/bind.hpp>
+
+#include "jill/offline_client.hh"
+#include "jill/component.hh"
+#include "jill/components/detector.hh"
+#include "jill/midi.hh"
+#include "jill/dsp/crossing_trigger.hh"
+
+using namespace std;
+using namespace jill;
+
+typedef dsp::crossing_trigger<sample_t> trigger_t;
+
+struct detector {
+        trigger_t trig;
+        offline_client::port_id in, out, trig_out;
+        detector(offline_client::port_id i, offline_client::port_id o, offline_client::port_id t)
+                : trig(0.1, 20, 4, 0.1, 5, 4, 64), in(i), out(o), trig_out(t) {}
+
+        // only uses the process_client interface, so it could also run in a jack_client
+        int process(process_client * client, nframes_t nframes, nframes_t) {
+                sample_t * input = client->port_samples(in, nframes);
+                sample_t * output = client->port_samples(out, nframes);
+                for (nframes_t i = 0; i < nframes; ++i)
+                        output[i] = input[i] * 2;
+                int offset = trig.push(input, nframes);
+                if (offset > -1) {
+                        char state = trig.open();
+                        client->write_event(trig_out, offset, &state, 1);
+                }
+                return 0;
+        }
+};
+
+vector<sample_t> make_signal()
+{
+        vector<sample_t> signal(16384, 0);
+        for (size_t i = 4096; i < 8192; ++i)
+                signal[i] = (i % 2) ? 0.5 : -0.5;
+        return signal;
+}
+
+vector<offline_client::event_t> run_detector(vector<sample_t> const & signal, nframes_t period_size)
+{
+        offline_client client("test_offline", 20000, period_size);
+        offline_client::port_id in = client.add_input("in", &signal[0], signal.size());
+        offline_client::port_id out = client.add_output("out");
+        offline_client::port_id trig_out = client.add_event_output("trig_out");
+        assert(client.port_index("trig_out") == trig_out);
+
+        detector d(in, out, trig_out);
+        client.set_process_callback(boost::bind(&detector::process, &d, _1, _2, _3));
+        nframes_t n = client.run();
+        assert(n == signal.size());
+        assert(client.frame() == signal.size());
+
+        vector<sample_t> const & output = client.output(out);
+        assert(output.size() == signal.size());
+        for (size_t i = 0; i < signal.size(); ++i)
+                assert(output[i] == signal[i] * 2);
+
+        vector<offline_client::event_t> events = client.output_events(trig_out);
+        assert(events.size() == 2);
+        assert(events[0].data[0] == 1 && events[1].data[0] == 0);
+        // the gate opens at the 21st crossing (count_thresh + 1) after the
+        // onset, which crosses on odd samples
+        assert(events[0].time == 4096 + 2 * 20 + 1);
+        // and closes at the end of the period where the window has been
+        // quiet; the period clock starts at the onset
+        assert(events[1].time > 8192 + 4 * 64 && events[1].time <= 8192 + 5 * 64);
+        assert((events[1].time + 1 - events[0].time) % 64 == 0);
+
+        // outputs are discarded on reset
+        client.reset();
+        assert(client.frame() == 0);
+        assert(client.output(out).empty());
+        return events;
+}
+
+void test_event_input()
+{
+        vector<offline_client::event_t> events(3);
+        events[0].time = 300; events[1].time = 10; events[2].time = 129;
+        offline_client client("test_offline", 20000, 128);
+        offline_client::port_id in = client.add_event_input("events", events);
+        size_t count = 0;
+        client.set_buffer_size(100);
+        assert(client.buffer_size() == 100);
+        struct counter {
+                static int process(offline_client * c, nframes_t, nframes_t time,
+                                   offline_client::port_id port, size_t * count) {
+                        vector<offline_client::event_t> const & ev = c->events(port);
+                        assert(c->nevents(port) == ev.size());
+                        for (size_t i = 0; i < ev.size(); ++i) {
+                                process_client::event_ref_t e = c->event(port, i);
+                                assert(e.time == ev[i].time && e.size == ev[i].data.size());
+                                assert(ev[i].time < c->buffer_size());
+                                assert(ev[i].time + time == 10 || ev[i].time + time == 129 ||
+                                       ev[i].time + time == 300);
+                        }
+                        *count += ev.size();
+                        return 0;
+                }
+        };
+        client.set_process_callback(boost::bind(&counter::process, _1, _2, _3, in, &count));
+        assert(client.run() == 400);
+        assert(count == 3);
+}
+
+/* the detector component, run by a component_host, finds the same gates */
+void test_component(vector<sample_t> const & signal, vector<offline_client::event_t> const & expected)
+{
+        offline_client client("test_offline", 32000, 128);
+        client.add_input("in", &signal[0], signal.size());
+        components::detector::options_type o;
+        o.inputs.push_back("in");
+        o.outputs.push_back("trig_out");
+        // the settings of the trigger in detector (in samples) at 32 kHz
+        o.crossing.period_size_ms = 2;
+        o.crossing.open_threshold = o.crossing.close_threshold = 0.1;
+        o.crossing.open_crossing_period_ms = o.crossing.close_crossing_period_ms = 8;
+        o.crossing.open_crossing_rate = 78.125;
+        o.crossing.close_crossing_rate = 19.53125;
+        boost::shared_ptr<components::detector> det(new components::detector(o));
+
+        component_host host(client);
+        host.add("", det, component::config_type());
+        assert(host.port(0) == 0);
+        host.activate();
+        assert(client.run() == signal.size());
+        host.deactivate();
+
+        vector<offline_client::event_t> const & events =
+                client.output_events(client.port_index("trig_out"));
+        assert(events.size() == expected.size());
+        for (size_t i = 0; i < events.size(); ++i) {
+                assert(events[i].data.size() == 3);
+                midi::data_type status = events[i].data[0] & midi::type_nib;
+                assert(status == (expected[i].data[0] ? midi::note_on : midi::note_off));
+        }
+        assert(events[0].time == expected[0].time);
+        // the component's trigger bank keeps its analysis periods aligned to
+        // the start of the stream, so the gate can close up to a period
+        // earlier than in crossing_trigger
+        assert(events[1].time + 64 >= expected[1].time && events[1].time <= expected[1].time);
+        assert((events[1].time + 1) % 64 == 0);
+}
+
+int main(int, char**)
+{
+        vector<sample_t> signal = make_signal();
+        vector<offline_client::event_t> a = run_detector(signal, 128);
+        vector<offline_client::event_t> b = run_detector(signal, 512);
+        // detection times don't depend on period size
+        assert(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); ++i)
+                assert(a[i].time == b[i].time);
+        test_event_input();
+        test_component(signal, a);
+        cout << "offline client tests passed" << endl;
+        return 0;
+}
@@ -0,0 +1,48 @@
+
+#include <iostream>
+#include <cassert>
+
+#include "jill/util/process_timer.hh"
+
+using namespace std;
+using namespace jill;
+using jill::util::process_timer;
+
+void test_bins()
+{
+        process_timer timer;
+        timer.record(0, 1000);          // duration bin 0, load bin 0
+        timer.record(3, 1000);          // duration bin 1
+        timer.record(450, 1000);        // duration bin 8, load bin 4
+        timer.record(1000, 1000);       // load bin 10, not a miss
+        timer.record(5000, 1000);       // miss
+
+        process_timer::stats_t stats = timer.snapshot();
+        assert(stats.count == 5);
+        assert(stats.misses == 1);
+        assert(stats.max_usec == 5000);
+        assert(stats.total_usec == 6453);
+        assert(stats.duration[0] == 1);
+        assert(stats.duration[1] == 1);
+        assert(stats.duration[8] == 1);
+        assert(stats.duration[9] == 1);
+        assert(stats.duration[12] == 1);
+        assert(stats.load[0] == 2);
+        assert(stats.load[4] == 1);
+        assert(stats.load[process_timer::load_bins - 1] == 2);
+
+        // interval statistics
+        timer.record(100, 1000);
+        process_timer::stats_t since = timer.snapshot();
+        since -= stats;
+        assert(since.count == 1);
+        assert(since.misses == 0);
+        assert(since.load[1] == 1);
+        assert(since.mean_load(1000) == 0.1);
+        cout << since << endl;
+}
+
+int main(int, char**)
+{
+        test_bins();
+}
@@ -27,6 +27,25 @@ test_mmemory()
         assert(memcmp(m.buffer(), m.buffer() + m.size(), m.size()) == 0);
 }
 
+void
+test_mmemory_file()
+{
+        printf("Testing file-backed mirrored memory\n");
+        char buf[BUFSIZE];
+        std::size_t i;
+        for (i = 0; i < BUFSIZE; ++i) {
+                buf[i] = nrand48(seed);
+        }
+
+        char const * path = "test_ringbuf.spill";
+        jill::util::mirrored_memory m(path, BUFSIZE);
+        assert( m.size() == BUFSIZE);
+        // file should be unlinked once mapped
+        assert(access(path, F_OK) != 0);
+        memcpy(m.buffer(), buf, BUFSIZE);
+        assert(memcmp(m.buffer(), m.buffer() + m.size(), m.size()) == 0);
+}
+
 template <typename T>
 void
 test_ringbuffer(std::size_t chunksize, std::size_t reps)
@@ -124,10 +143,96 @@ test_period_ringbuf(std::size_t nchannels)
         }
 }
 
+void
+test_block_transfer(std::size_t nblocks)
+{
+        using namespace jill::dsp;
+        jill::sample_t buf[BUFSIZE];
+        char chan_name[32];
+        std::size_t idx, data_bytes;
+        data_bytes = BUFSIZE * sizeof(jill::sample_t);
+
+        printf("Testing block transfer nblocks=%zu\n", nblocks);
+        block_ringbuffer rb(data_bytes * (nblocks + 1));
+        block_ringbuffer spill(data_bytes * (nblocks + 1), "test_ringbuf.spill");
+
+        for (idx = 0; idx < BUFSIZE; ++idx) {
+                buf[idx] = nrand48(seed);
+        }
+        for (idx = 0; idx < nblocks; ++idx) {
+                sprintf(chan_name, "chan_%03zu", idx);
+                rb.push(idx, jill::SAMPLED, chan_name, data_bytes, buf);
+        }
+
+        // read ahead the first block, then move it and the next one
+        assert(rb.peek_ahead()->time == 0);
+        assert(rb.transfer(spill) > 0);
+        assert(rb.transfer(spill) > 0);
+        assert(rb.read_ahead_space() == 0);
+        assert(spill.empty_ahead() == false);
+        assert(spill.read_ahead_space() == spill.peek()->size());
+
+        // combined sequence is still in order
+        jill::data_block_t const * info = spill.peek_ahead();
+        assert(info->time == 1);
+        assert(spill.peek_ahead() == 0);
+        for (idx = 2; idx < nblocks; ++idx) {
+                info = rb.peek_ahead();
+                assert(info->time == idx);
+                assert(memcmp(buf, info->data(), info->sz_data) == 0);
+        }
+        assert(rb.peek_ahead() == 0);
+
+        spill.release();
+        info = spill.peek();
+        sprintf(chan_name, "chan_%03d", 1);
+        assert(info->id() == chan_name);
+        assert(memcmp(buf, info->data(), info->sz_data) == 0);
+        spill.release();
+        assert(spill.empty());
+        assert(rb.peek()->time == 2);
+}
+
+void
+test_block_seek(std::size_t nblocks)
+{
+        using namespace jill::dsp;
+        jill::sample_t buf[BUFSIZE];
+        char chan_name[32];
+        std::size_t idx, offset, data_bytes;
+        data_bytes = BUFSIZE * sizeof(jill::sample_t);
+
+        printf("Testing block seek and bulk release nblocks=%zu\n", nblocks);
+        block_ringbuffer rb(data_bytes * (nblocks + 1));
+        for (idx = 0; idx < nblocks; ++idx) {
+                sprintf(chan_name, "chan_%03zu", idx);
+                rb.push(idx, jill::SAMPLED, chan_name, data_bytes, buf);
+        }
+
+        // walk through the blocks by offset
+        for (idx = 0, offset = 0; idx < nblocks; ++idx) {
+                jill::data_block_t const * info = rb.peek(offset);
+                assert(info->time == idx);
+                offset += info->size();
+        }
+        assert(rb.peek(offset) == 0);
+
+        // read ahead two blocks and release them in one step
+        rb.peek_ahead();
+        offset = rb.peek_ahead()->size() * 2;
+        rb.release(0);
+        assert(rb.peek()->time == 0);
+        rb.release(offset);
+        assert(rb.read_ahead_space() == 0);
+        assert(rb.peek()->time == 2);
+        assert(rb.peek_ahead()->time == 2);
+}
+
 int
 main(int argc, char **argv)
 {
         test_mmemory();
+        test_mmemory_file();
         test_ringbuffer<char>(BUFSIZE/2,3);
         test_ringbuffer<char>(BUFSIZE/3+5,5);
         test_ringbuffer<float>(BUFSIZE/2,2);
@@ -135,6 +240,9 @@ main(int argc, char **argv)
         test_period_ringbuf(1);
         test_period_ringbuf(3);
 
+        test_block_transfer(3);
+        test_block_seek(5);
+
         printf("passed tests\n");
         return 0;
 }
@@ -0,0 +1,39 @@
+
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <boost/bind.hpp>
+
+#include "jill/util/rt_pool.hh"
+
+using namespace std;
+using jill::util::rt_pool;
+
+void
+increment(vector<int> * counts, size_t i)
+{
+        (*counts)[i] += 1;
+}
+
+void test_pool(size_t nthreads, size_t njobs, size_t nruns)
+{
+        rt_pool pool(nthreads);
+        assert(pool.size() == nthreads);
+        vector<int> counts(njobs, 0);
+        rt_pool::job_type job = boost::bind(increment, &counts, _1);
+        for (size_t run = 0; run < nruns; ++run) {
+                pool.run(job, njobs);
+                // every job runs exactly once per call
+                for (size_t i = 0; i < njobs; ++i)
+                        assert(counts[i] == int(run + 1));
+        }
+}
+
+int main(int, char**)
+{
+        test_pool(0, 16, 10);
+        test_pool(1, 1, 10);
+        test_pool(3, 2, 1000);
+        test_pool(3, 64, 10000);
+        cout << "rt_pool tests passed" << endl;
+}
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <stdexcept>
+
+#include "jill/dsp/spectral_trigger_bank.hh"
+
+using namespace std;
+using namespace jill;
+
+typedef dsp::spectral_trigger_bank bank_type;
+
+const double rate = 20000;
+const size_t period_size = 128;
+
+bank_type::params_type
+make_params()
+{
+        bank_type::params_type p;
+        p.band_lo = 2000;
+        p.band_hi = 4000;
+        p.open_ratio = 6;
+        p.close_ratio = 0;
+        p.min_power = -50;
+        p.ocount_thresh = 3;
+        p.owindow_periods = 5;
+        p.ccount_thresh = 2;
+        p.cwindow_periods = 10;
+        p.period_size = period_size;
+        p.fft_size = 256;
+        return p;
+}
+
+float
+noise(float amplitude)
+{
+        // uniform noise with the rms of a sinusoid of this amplitude
+        return amplitude * sqrt(6.0) * (float(rand()) / RAND_MAX - 0.5);
+}
+
+/* run a signal through the bank in random blocks, returning the events */
+vector<bank_type::event_type>
+run(bank_type & bank, vector<vector<float> > const & x, vector<vector<float> > * counts=0)
+{
+        size_t const nchannels = x.size(), nframes = x[0].size();
+        vector<bank_type::event_type> events(bank.max_events(nframes)), found;
+        vector<float const *> in(nchannels);
+        vector<float *> out(nchannels);
+        for (size_t i = 0; i < nframes; ) {
+                size_t n = min<size_t>(1 + rand() % 400, nframes - i);
+                for (size_t c = 0; c < nchannels; ++c) {
+                        in[c] = &x[c][i];
+                        if (counts) out[c] = &(*counts)[c][i];
+                }
+                size_t ne = bank.push(&in[0], n, &events[0], events.size(),
+                                      counts ? &out[0] : 0);
+                assert(ne <= bank.max_events(n));
+                for (size_t e = 0; e < ne; ++e) {
+                        assert(events[e].offset < n);
+                        assert((events[e].offset + i + 1) % period_size == 0);
+                        events[e].offset += i;
+                        found.push_back(events[e]);
+                }
+                i += n;
+        }
+        return found;
+}
+
+/*
+ * channel 0: a tone in the band; 1: noise with the same power; 2: a tone
+ * below the band; 3: silence. The tone and noise are on for 10000 samples.
+ */
+void
+test_detects_tone()
+{
+        const size_t nchannels = 4, nframes = 30000, onset = 5000, offset = 15000;
+        vector<vector<float> > x(nchannels, vector<float>(nframes, 0.0f));
+        for (size_t i = onset; i < offset; ++i) {
+                x[0][i] = 0.1 * sin(2 * M_PI * 3000 * i / rate);
+                x[1][i] = noise(0.1);
+                x[2][i] = 0.1 * sin(2 * M_PI * 500 * i / rate);
+        }
+        for (size_t i = 0; i < nframes; ++i)
+                x[1][i] += noise(0.001);
+
+        bank_type bank(nchannels, rate, make_params());
+        assert(bank.fft_size() == 256);
+        vector<vector<float> > counts(nchannels, vector<float>(nframes));
+        vector<bank_type::event_type> events = run(bank, x, &counts);
+        assert(events.size() == 2);
+        assert(events[0].channel == 0 && events[0].open);
+        assert(events[1].channel == 0 && !events[1].open);
+        // the opening window needs ocount_thresh + 1 detections
+        assert(events[0].offset > onset && events[0].offset < onset + 6 * period_size);
+        assert(events[1].offset > offset && events[1].offset < offset + 11 * period_size);
+        for (size_t c = 0; c < nchannels; ++c) {
+                assert(!bank.open(c));
+                for (size_t i = 0; i < nframes; ++i)
+                        assert(counts[c][i] >= 0 && counts[c][i] <= 1);
+        }
+        // the last periods are silent
+        assert(bank.power(0) < -100);
+        assert(bank.power(3) < -100);
+}
+
+/* the power of a full-scale tone in the band is 0 dB */
+void
+test_power_scale()
+{
+        bank_type::params_type p = make_params();
+        bank_type bank(1, rate, p);
+        vector<float> x(4 * bank.fft_size());
+        for (size_t i = 0; i < x.size(); ++i)
+                x[i] = sin(2 * M_PI * 2500 * i / rate);
+        float const * in = &x[0];
+        vector<bank_type::event_type> events(bank.max_events(x.size()));
+        bank.push(&in, x.size(), &events[0], events.size());
+        assert(fabs(bank.power(0)) < 0.1);
+        assert(bank.ratio(0) > 30);
+}
+
+/* the events don't depend on the block size, and reset restores the initial state */
+void
+test_blocking()
+{
+        const size_t nchannels = 3, nframes = 20000;
+        vector<vector<float> > x(nchannels, vector<float>(nframes));
+        for (size_t c = 0; c < nchannels; ++c) {
+                size_t onset = 2000 + c * 3000;
+                for (size_t i = 0; i < nframes; ++i) {
+                        x[c][i] = noise(0.01);
+                        if (i >= onset && i < onset + 4000)
+                                x[c][i] += 0.2 * sin(2 * M_PI * (2200 + 500 * c) * i / rate);
+                }
+        }
+        bank_type::params_type p = make_params();
+        p.fft_size = 0;
+        bank_type bank(nchannels, rate, p);
+        assert(bank.fft_size() == period_size);
+        vector<vector<float> > counts(nchannels, vector<float>(nframes)), counts2(counts);
+        vector<bank_type::event_type> a = run(bank, x, &counts);
+        bank.reset();
+        vector<bank_type::event_type> b = run(bank, x, &counts2);
+        assert(a.size() == 2 * nchannels);
+        assert(a.size() == b.size());
+        for (size_t e = 0; e < a.size(); ++e) {
+                assert(a[e].channel == b[e].channel);
+                assert(a[e].offset == b[e].offset);
+                assert(a[e].open == b[e].open);
+                if (e > 0) assert(a[e].offset >= a[e-1].offset);
+        }
+        for (size_t c = 0; c < nchannels; ++c)
+                assert(memcmp(&counts[c][0], &counts2[c][0], nframes * sizeof(float)) == 0);
+}
+
+void
+test_bad_params()
+{
+        bank_type::params_type p = make_params();
+        p.band_hi = rate;
+        try {
+                bank_type bank(1, rate, p);
+                assert(false);
+        }
+        catch (std::invalid_argument const &) {}
+        p = make_params();
+        p.band_lo = 3000;
+        p.band_hi = 3001;
+        try {
+                bank_type bank(1, rate, p);
+                assert(false);
+        }
+        catch (std::invalid_argument const &) {}
+}
+
+int main(int, char**)
+{
+        test_detects_tone();
+        test_power_scale();
+        test_blocking();
+        test_bad_params();
+        cout << "spectral trigger tests passed" << endl;
+}
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cassert>
+
+#include "jill/dsp/spike_detector.hh"
+
+using namespace std;
+using namespace jill;
+
+typedef dsp::spike_detector detector_type;
+
+struct spike {
+        size_t channel;
+        long time;
+        float value;
+};
+
+/* noise with spikes of both polarities at random times */
+vector<vector<float> >
+make_signal(size_t nchannels, size_t nframes)
+{
+        vector<vector<float> > x(nchannels, vector<float>(nframes));
+        for (size_t c = 0; c < nchannels; ++c) {
+                for (size_t i = 0; i < nframes; ++i)
+                        x[c][i] = 0.1 * (float(rand()) / RAND_MAX - 0.5);
+                for (size_t i = 0; i + 20 < nframes; i += 5 + rand() % 200) {
+                        float a = (rand() % 2 ? 1 : -1) * (0.3 + float(rand()) / RAND_MAX);
+                        // a spike with a rounded peak a few samples in
+                        for (size_t k = 0; k < 12; ++k)
+                                x[c][i + k] += a * sin(M_PI * k / 12);
+                }
+        }
+        return x;
+}
+
+/* the spikes on one channel, one sample at a time */
+vector<spike>
+reference(vector<float> const & x, size_t channel, float thresh, size_t refractory, size_t align)
+{
+        vector<spike> out;
+        size_t const dead = max(max(refractory, align), size_t(1));
+        float const sign = thresh >= 0 ? 1 : -1;
+        for (size_t i = 1; i < x.size(); ++i) {
+                bool crossed = (thresh >= 0) ? (x[i-1] < thresh && x[i] >= thresh)
+                        : (x[i-1] >= thresh && x[i] < thresh);
+                if (!crossed) continue;
+                spike s = { channel, long(i), x[i] };
+                if (align) {
+                        // spikes whose window runs past the end are not reported
+                        if (i + align > x.size()) break;
+                        for (size_t k = i; k < i + align; ++k)
+                                if (sign * x[k] > sign * s.value) {
+                                        s.time = k;
+                                        s.value = x[k];
+                                }
+                }
+                out.push_back(s);
+                i += dead - 1;
+        }
+        return out;
+}
+
+void
+test_matches_reference(dsp::simd::isa_type isa, size_t nchannels, float thresh,
+                       size_t refractory, size_t align)
+{
+        const size_t nframes = 30000;
+        vector<vector<float> > x = make_signal(nchannels, nframes);
+        detector_type det(nchannels, thresh, refractory, align);
+        det.set_isa(isa);
+        assert(det.delay() == align);
+
+        vector<vector<spike> > found(nchannels);
+        vector<detector_type::event_type> events(det.max_events(nframes));
+        vector<float const *> in(nchannels);
+        for (size_t i = 0; i < nframes; ) {
+                size_t n = min<size_t>(1 + rand() % 300, nframes - i);
+                for (size_t c = 0; c < nchannels; ++c)
+                        in[c] = &x[c][i];
+                size_t ne = det.push(&in[0], n, &events[0], events.size());
+                assert(ne <= det.max_events(n));
+                for (size_t e = 0; e < ne; ++e) {
+                        detector_type::event_type const & ev = events[e];
+                        assert(ev.offset < long(n));
+                        assert(ev.offset > -long(align) || (align == 0 && ev.offset >= 0));
+                        if (e > 0) {
+                                assert(ev.channel >= events[e-1].channel);
+                                if (ev.channel == events[e-1].channel)
+                                        assert(ev.offset > events[e-1].offset);
+                        }
+                        spike s = { ev.channel, long(i) + ev.offset, ev.value };
+                        found[ev.channel].push_back(s);
+                }
+                i += n;
+        }
+
+        for (size_t c = 0; c < nchannels; ++c) {
+                vector<spike> ref = reference(x[c], c, thresh, refractory, align);
+                assert(ref.size() > 20);
+                assert(found[c].size() == ref.size());
+                for (size_t k = 0; k < ref.size(); ++k) {
+                        assert(found[c][k].time == ref[k].time);
+                        assert(found[c][k].value == ref[k].value);
+                        // aligned spikes can be closer than the refractory period
+                        if (k > 0 && align == 0)
+                                assert(size_t(ref[k].time - ref[k-1].time) >= refractory);
+                }
+        }
+}
+
+/* a single spike at a known time, split across two blocks */
+void
+test_alignment()
+{
+        vector<float> x(200, 0.0f);
+        for (size_t k = 0; k < 9; ++k)
+                x[100 + k] = -float(k < 5 ? k : 8 - k);        // trough of -4 at 104
+        detector_type det(1, -1.5, 20, 10);
+        detector_type::event_type events[4];
+        float const * in = &x[0];
+        // the crossing is at 102, and the block ends before the trough
+        size_t ne = det.push(&in, 103, events, 4);
+        assert(ne == 0);
+        in = &x[103];
+        ne = det.push(&in, 97, events, 4);
+        assert(ne == 1);
+        assert(events[0].offset == 1);
+        assert(events[0].value == -4);
+
+        // without alignment the crossing is reported
+        detector_type det2(1, -1.5, 20);
+        in = &x[0];
+        ne = det2.push(&in, 200, events, 4);
+        assert(ne == 1 && events[0].offset == 102 && events[0].value == -2);
+        det2.reset();
+        ne = det2.push(&in, 200, events, 4);
+        assert(ne == 1);
+}
+
+int main(int, char**)
+{
+        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                if (!dsp::simd::supported(isa)) continue;
+                test_matches_reference(isa, 1, 0.25, 30, 0);
+                test_matches_reference(isa, 7, -0.25, 30, 0);
+                test_matches_reference(isa, 16, 0.25, 30, 10);
+                test_matches_reference(isa, 16, -0.25, 5, 10);
+                test_matches_reference(isa, 3, 0.25, 0, 0);
+        }
+        test_alignment();
+        cout << "spike detector tests passed" << endl;
+}
@@ -0,0 +1,214 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#include "jill/dsp/crossing_trigger_bank.hh"
+
+using namespace std;
+using namespace jill;
+
+typedef dsp::crossing_trigger_bank bank_type;
+
+const float othresh = 0.2, cthresh = 0.1;
+const int ocount = 30, ccount = 5;
+const size_t owindow = 5, cwindow = 10, period_size = 64;
+
+/*
+ * The trigger for one channel, one sample at a time. State changes are
+ * located like crossing_trigger does; block_start is the start of the block
+ * being pushed to the bank, which limits how far back the bank can look.
+ */
+struct reference_trigger {
+        bool open;
+        float last;
+        vector<size_t> crossings;       // times of the crossings in the period
+        deque<int> window;
+        size_t change_time;
+
+        reference_trigger() : open(false), last(NAN), change_time(0) {}
+
+        /* returns true if the state changed at the end of a period */
+        bool push(float x, size_t i, bool period_end, size_t block_start, float & count) {
+                float t = open ? cthresh : othresh;
+                if (last < t && x >= t) crossings.push_back(i);
+                last = x;
+                size_t w = open ? cwindow : owindow;
+                bool change = false;
+                if (period_end) {
+                        int const ncross = crossings.size();
+                        window.push_back(ncross);
+                        if (window.size() > w) window.pop_front();
+                        int running = accumulate(window.begin(), window.end(), 0);
+                        if (window.size() == w &&
+                            (open ? running < ccount : running > ocount)) {
+                                size_t const start = max(i + 1 - period_size, block_start);
+                                if (!open) {
+                                        // the crossing that took the count over
+                                        int target = max(ocount + 1 - (running - ncross), 1);
+                                        change_time = (target <= ncross) ?
+                                                max(crossings[target - 1], block_start) : start;
+                                }
+                                else {
+                                        // the last crossing, not counting one
+                                        // at the start of the block
+                                        change_time = i;
+                                        for (size_t k = ncross; k-- > 0; ) {
+                                                if (crossings[k] > block_start) {
+                                                        change_time = crossings[k];
+                                                        break;
+                                                }
+                                        }
+                                        if (change_time < start) change_time = i;
+                                }
+                                open = !open;
+                                window.clear();
+                                change = true;
+                                w = open ? cwindow : owindow;
+                        }
+                        crossings.clear();
+                }
+                count = float(accumulate(window.begin(), window.end(), 0)) / (w * period_size / 2);
+                return change;
+        }
+};
+
+bank_type::event_type
+event(size_t channel, size_t offset, bool open)
+{
+        bank_type::event_type e = { channel, offset, open };
+        return e;
+}
+
+struct earlier {
+        bool operator()(bank_type::event_type const & a, bank_type::event_type const & b) const {
+                return a.offset < b.offset;
+        }
+};
+
+/* noise and clicks, with bursts of oscillation on each channel at different times */
+vector<vector<float> >
+make_signal(size_t nchannels, size_t nframes)
+{
+        vector<vector<float> > x(nchannels, vector<float>(nframes));
+        for (size_t c = 0; c < nchannels; ++c) {
+                size_t onset = (c * 1777) % (nframes / 2);
+                size_t offset = onset + 2000 + (c * 311) % 3000;
+                for (size_t i = 0; i < nframes; ++i) {
+                        x[c][i] = 0.05 * (float(rand()) / RAND_MAX - 0.5);
+                        // sparse clicks that cross the closing threshold
+                        if ((i + 13 * c) % 211 == 0)
+                                x[c][i] += 0.15;
+                        if (i >= onset && i < offset)
+                                x[c][i] += 0.5 * sin(i * 0.7);
+                }
+        }
+        return x;
+}
+
+/* the bank should match a reference trigger on each channel for any blocking */
+void
+test_matches_reference(dsp::simd::isa_type isa, size_t nchannels)
+{
+        const size_t nframes = 40000;
+        vector<vector<float> > x = make_signal(nchannels, nframes);
+        vector<vector<float> > counts(nchannels, vector<float>(nframes)), ref_counts(counts);
+
+        bank_type bank(nchannels, othresh, ocount, owindow, cthresh, ccount, cwindow, period_size);
+        bank.set_isa(isa);
+        vector<bank_type::event_type> events(bank.max_events(nframes));
+        vector<bank_type::event_type> found;
+        vector<float const *> in(nchannels);
+        vector<float *> out(nchannels);
+        vector<size_t> block_start(nframes);
+        for (size_t i = 0; i < nframes; ) {
+                size_t n = min<size_t>(1 + rand() % 300, nframes - i);
+                fill(block_start.begin() + i, block_start.begin() + i + n, i);
+                for (size_t c = 0; c < nchannels; ++c) {
+                        in[c] = &x[c][i];
+                        out[c] = &counts[c][i];
+                }
+                size_t ne = bank.push(&in[0], n, &events[0], events.size(), &out[0]);
+                assert(ne <= bank.max_events(n));
+                for (size_t e = 0; e < ne; ++e) {
+                        assert(events[e].offset < n);
+                        if (e > 0) assert(events[e].offset >= events[e-1].offset);
+                }
+                for (size_t e = 0; e < ne; ++e) {
+                        events[e].offset += i;
+                        found.push_back(events[e]);
+                }
+                i += n;
+        }
+
+        // the reference, in the same order (by frame and then by channel)
+        vector<reference_trigger> ref(nchannels);
+        vector<bank_type::event_type> expected;
+        for (size_t i = 0; i < nframes; ++i) {
+                bool period_end = (i + 1) % period_size == 0;
+                for (size_t c = 0; c < nchannels; ++c) {
+                        if (ref[c].push(x[c][i], i, period_end, block_start[i], ref_counts[c][i]))
+                                expected.push_back(event(c, ref[c].change_time, ref[c].open));
+                }
+        }
+        // the bank orders the events in each block by time
+        stable_sort(expected.begin(), expected.end(), earlier());
+        assert(expected.size() == found.size());
+        for (size_t k = 0; k < found.size(); ++k) {
+                assert(found[k].channel == expected[k].channel);
+                assert(found[k].offset == expected[k].offset);
+                assert(found[k].open == expected[k].open);
+        }
+        // every channel has a burst, so each should have opened and closed
+        assert(found.size() >= 2 * nchannels);
+        for (size_t c = 0; c < nchannels; ++c) {
+                assert(bank.open(c) == ref[c].open);
+                assert(memcmp(&counts[c][0], &ref_counts[c][0], nframes * sizeof(float)) == 0);
+        }
+}
+
+/* a burst on one channel doesn't affect the others */
+void
+test_independent()
+{
+        const size_t nchannels = 5, nframes = 20 * period_size;
+        vector<vector<float> > x(nchannels, vector<float>(nframes, 0.0f));
+        for (size_t i = 0; i < nframes; ++i)
+                x[3][i] = (i % 4 < 2) ? 1.0 : 0.0;
+        bank_type bank(nchannels, othresh, ocount, owindow, cthresh, ccount, cwindow, period_size);
+        vector<float const *> in(nchannels);
+        for (size_t c = 0; c < nchannels; ++c)
+                in[c] = &x[c][0];
+        vector<bank_type::event_type> events(bank.max_events(nframes));
+        // no counts, and room for just one event
+        size_t ne = bank.push(&in[0], nframes, &events[0], 1);
+        assert(ne == 1);
+        assert(events[0].channel == 3 && events[0].open);
+        // the window fills at the end of period owindow, when the count is
+        // already over the threshold, so the onset is the first crossing in
+        // that period
+        assert(events[0].offset == (owindow - 1) * period_size);
+        for (size_t c = 0; c < nchannels; ++c)
+                assert(bank.open(c) == (c == 3));
+        bank.reset();
+        assert(!bank.open(3));
+        assert(bank.count(3) == 0);
+}
+
+int main(int, char**)
+{
+        for (int i = dsp::simd::GENERIC; i <= dsp::simd::AVX512; ++i) {
+                dsp::simd::isa_type isa = static_cast<dsp::simd::isa_type>(i);
+                if (!dsp::simd::supported(isa)) continue;
+                test_matches_reference(isa, 1);
+                test_matches_reference(isa, 16);
+                test_matches_reference(isa, 21);
+        }
+        test_independent();
+        cout << "trigger bank tests passed" << endl;
+}
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# -*- mode: python -*-
+"""Rebuild or query the entry index in jill arf files
+
+Usage: jrecord_index.py rebuild <arffiles>
+       jrecord_index.py find <arffile> <jack_frame|timestamp>
+
+jrecord keeps an index of entries in the jill_entries dataset, which holds the
+name, start frame, start usec, and timestamp of each entry. The 'rebuild'
+command regenerates the index from the entry attributes, for files created
+before the index was added (or modified by other programs). The 'find' command
+looks up the entry containing a time, given as an integer frame count or a
+floating point timestamp (seconds since the epoch).
+
+Copyright (C) 2013 Dan Meliza <dmeliza@gmail.com>
+"""
+
+import bisect
+import sys
+import h5py
+import numpy as nx
+
+INDEX_NAME = "jill_entries"
+index_dtype = nx.dtype([('name', h5py.special_dtype(vlen=unicode)),
+                        ('jack_frame', nx.uint32),
+                        ('jack_usec', nx.uint64),
+                        ('sec', nx.int64),
+                        ('usec', nx.int64)])
+
+
+def rebuild_index(fp):
+    """ regenerate the entry index from entry attributes """
+    records = []
+    next_entry = {}
+    for name, entry in fp.iteritems():
+        if not isinstance(entry, h5py.Group) or 'jack_frame' not in entry.attrs:
+            continue
+        ts = entry.attrs['timestamp']
+        records.append((name, entry.attrs['jack_frame'], entry.attrs['jack_usec'], ts[0], ts[1]))
+        source, sep, idx = name.rpartition('_')
+        if sep and idx.isdigit():
+            next_entry[source] = max(next_entry.get(source, 0), int(idx) + 1)
+    records.sort(key=lambda r: (r[3], r[4]))
+
+    if INDEX_NAME in fp:
+        del fp[INDEX_NAME]
+    dset = fp.create_dataset(INDEX_NAME, data=nx.array(records, dtype=index_dtype),
+                             maxshape=(None,), chunks=(1024,))
+    for source, idx in next_entry.iteritems():
+        dset.attrs.create(source, idx, dtype=nx.uint32)
+    return len(records)
+
+
+def find_entry(fp, value):
+    """ find the entry that starts at or before value (a frame count or timestamp) """
+    index = fp[INDEX_NAME][...]
+    if isinstance(value, float):
+        keys = (index['sec'] + index['usec'] * 1e-6).tolist()
+    else:
+        keys = index['jack_frame'].tolist()
+    order = sorted(range(len(keys)), key=keys.__getitem__)
+    pos = bisect.bisect_right([keys[i] for i in order], value)
+    if pos == 0:
+        return None
+    return index[order[pos - 1]]
+
+
+def main(argv=None):
+    argv = argv or sys.argv[1:]
+    if len(argv) < 2 or argv[0] not in ('rebuild', 'find'):
+        print __doc__
+        return 1
+    if argv[0] == 'rebuild':
+        for path in argv[1:]:
+            with h5py.File(path, 'a') as fp:
+                print "%s: indexed %d entries" % (path, rebuild_index(fp))
+    else:
+        value = float(argv[2]) if '.' in argv[2] else int(argv[2])
+        with h5py.File(argv[1], 'r') as fp:
+            rec = find_entry(fp, value)
+            if rec is None:
+                print "no entry found"
+                return 1
+            print "%s: jack_frame=%d, jack_usec=%d, timestamp=%d.%06d" % tuple(rec)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
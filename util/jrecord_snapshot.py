@@ -0,0 +1,35 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# -*- mode: python -*-
+"""Tell a running jrecord to write out its pretrigger buffer
+
+Usage: jrecord_snapshot.py [server]
+
+jrecord needs to be running in triggered mode (e.g. with --snapshot). The
+command is sent to the message socket jrecord binds for the jack server (the
+default server if not specified). It can also be sent with kill -USR1.
+
+Copyright (C) 2013 Dan Meliza <dmeliza@gmail.com>
+"""
+
+import os
+import sys
+import zmq
+
+
+def send_command(server, command):
+    """send a command to the jrecord process logging for server"""
+    path = os.path.join("/tmp/org.meliza.jill", server, "msg")
+    ctx = zmq.Context()
+    socket = ctx.socket(zmq.DEALER)
+    socket.setsockopt(zmq.LINGER, 1000)
+    socket.connect("ipc://" + path)
+    # commands are single-part messages; log messages have three parts
+    socket.send(command)
+    socket.close()
+    ctx.term()
+
+
+if __name__ == "__main__":
+    server = sys.argv[1] if len(sys.argv) > 1 else "default"
+    send_command(server, "snapshot")